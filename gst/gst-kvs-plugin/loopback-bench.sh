@@ -0,0 +1,297 @@
+#!/bin/bash
+# Runs a test pipeline against the loopback stand-ins of the KVS service calls
+# and prints the last kvs-stats message together with the process footprint.
+# With -n the WebRTC fan-out is measured instead over a number of loopback viewers.
+# With -e the test source feeds that many elements, which share a single KVS client.
+# With -p the test source also feeds that many additional video pads of the element.
+# With -c the loopback viewers are preceded by that many early ICE candidates of peers which never send an offer.
+# With -z the bytes copied per frame on the WebRTC path are measured over AvCC and Annex-B input with the KVS ingest running.
+# The source loops a clip encoded ahead of the run so the encoder isn't part of the measured process. -f picks the clip
+# and -x encodes live instead, for example with a hardware encoder handing out the buffers of its pool.
+
+DURATION=60
+FRAMERATE=30
+ACK_DELAY=200
+BANDWIDTH=2000000
+VIEWERS=
+ELEMENTS=1
+PADS=0
+CANDIDATES=
+ZERO_COPY_VIEWERS=
+ENCODER=
+CLIP=
+STREAM_FORMAT=avc
+SYNC_MODE=none
+STREAM_NAME=LoopbackBench
+CHANNEL_NAME=LoopbackBenchChannel
+
+if [[ -z $GST_LAUNCH ]] ; then
+    GST_LAUNCH=gst-launch-1.0
+fi
+
+if [[ -z $GST_PLUGIN_PATH ]] ; then
+    export GST_PLUGIN_PATH=`pwd`/build
+fi
+
+parse_args() {
+	while [[ $# -gt 0 ]]
+	do
+	key="$1"
+		case $key in
+		    -t)
+		    DURATION=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -r)
+		    FRAMERATE=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -a)
+		    ACK_DELAY=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -b)
+		    BANDWIDTH=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -n)
+		    VIEWERS=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -e)
+		    ELEMENTS=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -p)
+		    PADS=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -s)
+		    SYNC_MODE=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -c)
+		    CANDIDATES=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -z)
+		    ZERO_COPY_VIEWERS=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -x)
+		    ENCODER=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -f)
+		    CLIP=$2
+		    shift # past argument
+		    shift # past value
+		    ;;
+		    -h|--help)
+			echo "-t: Seconds to run the pipeline for, 60 by default"
+			echo "-r: Frame rate of the test source, 30 by default"
+			echo "-a: Loopback ack delay in milliseconds, 200 by default"
+			echo "-b: Loopback upload rate in bits per second, 2000000 by default"
+			echo "-n: Quoted list of the loopback viewer counts to measure the WebRTC fan-out with, for example \"1 10 100\""
+			echo "-e: Number of the elements fed by the test source, 1 by default. The kvs-stats are the ones of the last element"
+			echo "-p: Number of the additional video pads of the element fed by the test source, 0 by default"
+			echo "-s: Sync mode of the element with the additional video pads, none by default"
+			echo "-c: Number of the early ICE candidates flooding the element ahead of the loopback viewers, 1 viewer unless set with -n"
+			echo "-z: Number of the loopback viewers to measure the bytes copied per frame on the WebRTC path with. Runs AvCC and Annex-B input"
+			echo "    with the ingest queue and with the synchronous puts"
+			echo "-x: Quoted encoder element with its properties to encode the test source live with instead of looping the clip"
+			echo "-f: H.264 byte-stream clip to loop, encoded once with x264enc tune=zerolatency key-int-max=<frame rate> by default"
+		    exit 0
+		    ;;
+		    *)    # unknown option
+		    echo "Unknown option $key"
+		    exit 1
+		    ;;
+		esac
+	done
+}
+
+# Runs the pipeline with the kvsplugin properties passed in and reports on it
+run_pipeline() {
+	LOG=`mktemp`
+
+	# Keep SIGINT for the background pipeline so that it gets to the end of the stream
+	set -m
+
+	if [[ -n $ENCODER ]] ; then
+		SOURCE=(videotestsrc is-live=true ! video/x-raw,framerate=$FRAMERATE/1 ! $ENCODER)
+	else
+		# The file source isn't live so the clip is paced to the frame rate by the identity
+		SOURCE=(multifilesrc location=$CLIP loop=true caps=video/x-h264,stream-format=byte-stream,framerate=$FRAMERATE/1 !
+			h264parse ! identity sync=true)
+	fi
+
+	# The stats are posted every second to keep the frame count close to the CPU time sampled at the end
+	PIPELINE=("${SOURCE[@]}" ! video/x-h264,stream-format=$STREAM_FORMAT,alignment=au)
+	PROPERTIES=(loopback=true loopback-ack-delay=$ACK_DELAY loopback-bandwidth=$BANDWIDTH stats-interval=1 log-level=3 "$@")
+
+	if [[ $PADS -gt 0 ]] ; then
+		# Every pad is fed from a queue of its own so the pads are chained on their own threads
+		PIPELINE+=(! tee name=t kvsplugin name=kvs stream-name=$STREAM_NAME channel-name=$CHANNEL_NAME sync-mode=$SYNC_MODE "${PROPERTIES[@]}")
+		for I in `seq 0 $PADS`
+		do
+			PIPELINE+=(t. ! queue ! kvs.)
+		done
+	elif [[ $ELEMENTS -eq 1 ]] ; then
+		PIPELINE+=(! kvsplugin stream-name=$STREAM_NAME channel-name=$CHANNEL_NAME "${PROPERTIES[@]}")
+	else
+		PIPELINE+=(! tee name=t)
+		for I in `seq 1 $ELEMENTS`
+		do
+			PIPELINE+=(t. ! queue ! kvsplugin stream-name=$STREAM_NAME-$I channel-name=$CHANNEL_NAME-$I "${PROPERTIES[@]}")
+		done
+	fi
+
+	$GST_LAUNCH -e -m "${PIPELINE[@]}" > $LOG 2>&1 &
+	PID=$!
+
+	sleep $DURATION
+
+	# Sampled before the end of the stream while all of the threads are still up
+	RSS=`ps -o rss= -p $PID`
+	THREADS=`ps -o nlwp= -p $PID`
+	CPU_TICKS=`awk '{ print $14 + $15 }' /proc/$PID/stat`
+
+	kill -INT $PID
+	wait $PID
+
+	# The nested session structures are escaped so only the top level fields are split on
+	STATS=`grep "kvs-stats" $LOG | tail -1 | sed -e 's/.*kvs-stats, //' -e 's/;$//' -e 's/, /\n/g'`
+
+	echo "elements=$ELEMENTS"
+	if [[ $PADS -gt 0 ]] ; then
+		echo "pads=$((PADS + 1))"
+		echo "sync-mode=$SYNC_MODE"
+	fi
+	echo "resident-set-size=${RSS// /}KB"
+	echo "threads=${THREADS// /}"
+	echo "$STATS" | grep -v "^session-" | sed -e 's/=([a-z0-9]*)/=/'
+	summarize_sessions
+	summarize_copies
+	summarize_throughput
+	grep "latency over" $LOG
+
+	# The store is at its fullest before the candidates expire so the peak is taken over all of the stats
+	if [[ -n $CANDIDATES ]] ; then
+		grep "kvs-stats" $LOG | grep -o 'pending-candidates=(guint64)[0-9]*' | sed -e 's/.*)//' | sort -n | tail -1 | \
+			sed -e 's/^/pending-candidates-max=/'
+	fi
+
+	rm -f $LOG
+}
+
+# Sums the per viewer counters up and takes the worst of the write latencies
+summarize_sessions() {
+	echo "$STATS" | grep "^session-" | sed -e 's/\\//g' | grep -o '\(written-frames\|write-latency-p99\|write-cpu-time\)=(guint64)[0-9]*' | \
+		sed -e 's/=(guint64)/ /' | awk '
+		$1 == "write-latency-p99" { if ($2 > max) max = $2; next }
+		{ sum[$1] += $2 }
+		END {
+			if (NR == 0) exit
+			print "session-written-frames=" sum["written-frames"] + 0
+			print "session-write-latency-p99-max=" max + 0
+			print "session-write-cpu-time=" sum["write-cpu-time"] + 0
+		}'
+}
+
+# Bytes copied on the WebRTC path for every frame fanned out to the viewers
+summarize_copies() {
+	FRAMES=`echo "$STATS" | grep "^webrtc-frames=" | sed -e 's/.*)//'`
+	COPIED=`echo "$STATS" | grep "^webrtc-copied-bytes=" | sed -e 's/.*)//'`
+	if [[ -n $FRAMES && -n $COPIED && $FRAMES -ne 0 ]] ; then
+		echo "webrtc-copied-bytes-per-frame=$((COPIED / FRAMES))"
+	fi
+}
+
+# Frame rate over the stats posted once the pipeline is up, and the CPU time of the process per frame put.
+# The frames are the ones of the last element, the tee feeding the same number to every element.
+summarize_throughput() {
+	grep "kvs-stats" $LOG | grep -o 'video-frames=(guint64)[0-9]*' | sed -e 's/.*)//' | \
+		awk -v ticks=$CPU_TICKS -v hz=`getconf CLK_TCK` -v elements=$ELEMENTS '
+		NR == 1 { first = $1 }
+		{ last = $1 }
+		END {
+			if (NR > 1) printf "frames-per-second=%.1f\n", (last - first) / (NR - 1)
+			if (last > 0) printf "cpu-time-per-frame=%.0fus\n", ticks * 1000000 / hz / (last * elements)
+		}'
+}
+
+# Encodes the clip looped by the source once, outside of the measured process
+prepare_clip() {
+	if [[ -n $CLIP ]] ; then
+		if [[ ! -s $CLIP ]] ; then
+			echo "Clip $CLIP not found"
+			exit 1
+		fi
+		return
+	fi
+
+	CLIP=${TMPDIR:-/tmp}/loopback-bench-$FRAMERATE.h264
+	if [[ ! -s $CLIP ]] ; then
+		$GST_LAUNCH -q videotestsrc num-buffers=$((FRAMERATE * 10)) ! video/x-raw,framerate=$FRAMERATE/1 ! \
+			x264enc tune=zerolatency key-int-max=$FRAMERATE ! video/x-h264,stream-format=byte-stream,alignment=au ! \
+			filesink location=$CLIP > /dev/null 2>&1 || { rm -f $CLIP; echo "Failed to encode $CLIP"; exit 1; }
+	fi
+}
+
+parse_args "$@"
+
+if [[ -z $ENCODER ]] ; then
+	prepare_clip
+fi
+
+# The Annex-B bits are shared with the viewers as they are. The AvCC bits are only adapted in place with
+# the synchronous puts and unpooled buffers. The ingest queue holds on to the buffer and the buffers of an
+# upstream pool can't be held by the viewers, so those get a single adapted copy shared between the viewers.
+# The parsed clip isn't pooled, a hardware encoder passed with -x usually is.
+if [[ -n $ZERO_COPY_VIEWERS ]] ; then
+	echo "source=${ENCODER:-$CLIP}"
+	echo
+	for STREAM_FORMAT in avc byte-stream
+	do
+		for INGEST in queue sync
+		do
+			echo "stream-format=$STREAM_FORMAT"
+			echo "ingest=$INGEST"
+			if [[ $INGEST == queue ]] ; then
+				run_pipeline webrtc-loopback-viewers=$ZERO_COPY_VIEWERS max-viewers=$ZERO_COPY_VIEWERS
+			else
+				run_pipeline webrtc-loopback-viewers=$ZERO_COPY_VIEWERS max-viewers=$ZERO_COPY_VIEWERS ingest-queue-size=0
+			fi
+			echo
+		done
+	done
+	exit 0
+fi
+
+if [[ -n $CANDIDATES && -z $VIEWERS ]] ; then
+	VIEWERS=1
+fi
+
+if [[ -z $VIEWERS ]] ; then
+	run_pipeline connect-webrtc=false
+	exit 0
+fi
+
+for N in $VIEWERS
+do
+	echo "loopback-viewers=$N"
+	run_pipeline webrtc-loopback-viewers=$N max-viewers=$N ${CANDIDATES:+webrtc-loopback-early-candidates=$CANDIDATES}
+	echo
+done
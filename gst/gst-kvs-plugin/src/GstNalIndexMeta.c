@@ -0,0 +1,316 @@
+#define LOG_CLASS "GstNalIndexMeta"
+#include "GstPlugin.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static gboolean gst_nal_index_meta_init(GstMeta* meta, gpointer params, GstBuffer* buffer)
+{
+    GstNalIndexMeta* pNalIndexMeta = (GstNalIndexMeta*) meta;
+
+    UNUSED_PARAM(params);
+    UNUSED_PARAM(buffer);
+
+    MEMSET(&pNalIndexMeta->nalIndex, 0x00, SIZEOF(NalIndex));
+
+    return TRUE;
+}
+
+static void gst_nal_index_meta_free(GstMeta* meta, GstBuffer* buffer)
+{
+    GstNalIndexMeta* pNalIndexMeta = (GstNalIndexMeta*) meta;
+
+    UNUSED_PARAM(buffer);
+
+    freeNalIndex(&pNalIndexMeta->nalIndex);
+}
+
+static gboolean gst_nal_index_meta_transform(GstBuffer* dest, GstMeta* meta, GstBuffer* buffer, GQuark type, gpointer data)
+{
+    GstNalIndexMeta* pNalIndexMeta = (GstNalIndexMeta*) meta;
+    GstNalIndexMeta* pDestNalIndexMeta;
+    GstMetaTransformCopy* pCopy = (GstMetaTransformCopy*) data;
+
+    UNUSED_PARAM(buffer);
+
+    // The offsets are only valid for a full copy of the bits. Nothing to carry over otherwise.
+    if (!GST_META_TRANSFORM_IS_COPY(type) || pCopy->region) {
+        return TRUE;
+    }
+
+    if (NULL == (pDestNalIndexMeta = (GstNalIndexMeta*) gst_buffer_add_meta(dest, GST_NAL_INDEX_META_INFO, NULL))) {
+        return FALSE;
+    }
+
+    return STATUS_SUCCEEDED(copyNalIndex(&pNalIndexMeta->nalIndex, &pDestNalIndexMeta->nalIndex));
+}
+
+GType gst_nal_index_meta_api_get_type(void)
+{
+    static GType type = 0;
+    // The index describes the contents of the memory
+    static const gchar* tags[] = {GST_META_TAG_MEMORY_STR, NULL};
+
+    if (g_once_init_enter(&type)) {
+        GType _type = gst_meta_api_type_register("GstNalIndexMetaAPI", tags);
+        g_once_init_leave(&type, _type);
+    }
+
+    return type;
+}
+
+const GstMetaInfo* gst_nal_index_meta_get_info(void)
+{
+    static const GstMetaInfo* pMetaInfo = NULL;
+
+    if (g_once_init_enter(&pMetaInfo)) {
+        const GstMetaInfo* pInfo = gst_meta_register(GST_NAL_INDEX_META_API_TYPE, "GstNalIndexMeta", SIZEOF(GstNalIndexMeta),
+                                                     gst_nal_index_meta_init, gst_nal_index_meta_free, gst_nal_index_meta_transform);
+        g_once_init_leave(&pMetaInfo, pInfo);
+    }
+
+    return pMetaInfo;
+}
+
+PBYTE findAnnexBStartCode(PBYTE pStart, PBYTE pEnd)
+{
+    // Looking for the 0x01 byte of the 00 00 01 sequence and checking the two preceding bytes.
+    // The 0x01 byte is rare enough in the NALu payload to make the check cheap.
+    PBYTE pCurPnt = pStart + 2, pMatch;
+
+#if defined(__SSE2__)
+    __m128i ones = _mm_set1_epi8(0x01);
+    UINT32 mask, index;
+
+    for (; pCurPnt + SIZEOF(__m128i) <= pEnd; pCurPnt += SIZEOF(__m128i)) {
+        mask = (UINT32) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) pCurPnt), ones));
+        while (mask != 0) {
+            index = (UINT32) __builtin_ctz(mask);
+            pMatch = pCurPnt + index;
+            if (*(pMatch - 1) == 0x00 && *(pMatch - 2) == 0x00) {
+                return pMatch;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON)
+    uint8x16_t ones = vdupq_n_u8(0x01);
+    UINT64 mask;
+    UINT32 index;
+
+    for (; pCurPnt + SIZEOF(uint8x16_t) <= pEnd; pCurPnt += SIZEOF(uint8x16_t)) {
+        // Narrow the comparison result to a 64 bit mask with 4 bits per byte
+        mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(vld1q_u8(pCurPnt), ones)), 4)), 0);
+        while (mask != 0) {
+            index = (UINT32) __builtin_ctzll(mask) >> 2;
+            pMatch = pCurPnt + index;
+            if (*(pMatch - 1) == 0x00 && *(pMatch - 2) == 0x00) {
+                return pMatch;
+            }
+
+            mask &= ~(0x0FULL << (index << 2));
+        }
+    }
+#endif
+
+    // Scalar version for the tail or when no SIMD is available
+    for (; pCurPnt < pEnd; pCurPnt++) {
+        if (*pCurPnt == 0x01 && *(pCurPnt - 1) == 0x00 && *(pCurPnt - 2) == 0x00) {
+            return pCurPnt;
+        }
+    }
+
+    return NULL;
+}
+
+static STATUS addNalIndexEntry(PNalIndex pNalIndex, PBYTE pData, UINT32 offset, UINT32 length, BOOL isH265)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PNalIndexEntry pEntry;
+    UINT32 capacity;
+    BYTE header = pData[offset];
+    BOOL idr, parameterSet;
+
+    if (pNalIndex->nalCount == pNalIndex->nalCapacity) {
+        capacity = pNalIndex->nalCapacity == 0 ? NAL_INDEX_DEFAULT_NAL_CAPACITY : pNalIndex->nalCapacity * 2;
+        CHK(NULL != (pEntry = (PNalIndexEntry) MEMREALLOC(pNalIndex->nals, capacity * SIZEOF(NalIndexEntry))), STATUS_NOT_ENOUGH_MEMORY);
+        pNalIndex->nals = pEntry;
+        pNalIndex->nalCapacity = capacity;
+    }
+
+    pEntry = &pNalIndex->nals[pNalIndex->nalCount++];
+    pEntry->offset = offset;
+    pEntry->length = length;
+
+    if (isH265) {
+        pEntry->type = (header >> 1) & 0x3f;
+        idr = IS_NALU_H265_IDR_HEADER(header);
+        parameterSet = IS_NALU_H265_VPS_SPS_PPS_HEADER(header);
+
+        // Even VCL types up to RSV_VCL_N14 are sub-layer non-reference pictures
+        pEntry->reference = pEntry->type < H265_VPS_NALU_TYPE && !(pEntry->type <= 14 && (pEntry->type & 0x01) == 0);
+    } else {
+        pEntry->type = header & 0x1f;
+        idr = IS_NALU_H264_IDR_HEADER(header);
+        parameterSet = IS_NALU_H264_SPS_PPS_HEADER(header);
+
+        // Non-zero nal_ref_idc on a VCL NALu
+        pEntry->reference = pEntry->type >= 1 && pEntry->type <= IDR_NALU_TYPE && (header & 0x60) != 0;
+    }
+
+    pNalIndex->parameterSets = pNalIndex->parameterSets || (parameterSet && !pNalIndex->idr);
+    pNalIndex->idr = pNalIndex->idr || idr;
+    pNalIndex->reference = pNalIndex->reference || pEntry->reference;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS buildNalIndex(PBYTE pData, UINT32 size, BOOL isH265, PNalIndex pNalIndex)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PBYTE pCurPnt, pEndPnt, pNalStart, pNalEnd;
+    BYTE start3ByteCode[] = {0x00, 0x00, 0x01};
+    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
+    BYTE start5ByteCode[] = {0x00, 0x00, 0x00, 0x00, 0x01};
+    UINT32 runLen;
+
+    CHK(pData != NULL && pNalIndex != NULL, STATUS_NULL_ARG);
+
+    pNalIndex->format = ELEMENTARY_STREAM_NAL_FORMAT_UNKNOWN;
+    pNalIndex->idr = FALSE;
+    pNalIndex->parameterSets = FALSE;
+    pNalIndex->reference = FALSE;
+    pNalIndex->nalCount = 0;
+
+    CHK(size > SIZEOF(start5ByteCode), STATUS_FORMAT_ERROR);
+
+    pEndPnt = pData + size;
+
+    // NOTE: Some "bad" encoders encode an extra 0 at the end of the NALu resulting in
+    // an extra zero interfering with the Annex-B start code so we check for 4 zeroes and 1
+    if ((0 == MEMCMP(pData, start5ByteCode, SIZEOF(start5ByteCode))) || (0 == MEMCMP(pData, start4ByteCode, SIZEOF(start4ByteCode))) ||
+        (0 == MEMCMP(pData, start3ByteCode, SIZEOF(start3ByteCode)))) {
+        pNalIndex->format = ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B;
+
+        pCurPnt = findAnnexBStartCode(pData, pEndPnt);
+        while (pCurPnt != NULL) {
+            pNalStart = pCurPnt + 1;
+            pCurPnt = findAnnexBStartCode(pNalStart, pEndPnt);
+
+            // Trim the leading zero of the 4 byte start code and any trailing zeroes
+            pNalEnd = pCurPnt == NULL ? pEndPnt : pCurPnt - 2;
+            while (pNalEnd > pNalStart && *(pNalEnd - 1) == 0x00) {
+                pNalEnd--;
+            }
+
+            if (pNalEnd != pNalStart) {
+                CHK_STATUS(addNalIndexEntry(pNalIndex, pData, (UINT32) (pNalStart - pData), (UINT32) (pNalEnd - pNalStart), isH265));
+            }
+        }
+
+        CHK(FALSE, retStatus);
+    }
+
+    // For AvCC we will walk through all NALus
+    for (pCurPnt = pData; pCurPnt != pEndPnt; pCurPnt += NAL_INDEX_RUN_LENGTH_SIZE + runLen) {
+        // Check if we can still read 32 bit and the run fits
+        CHK(pCurPnt + NAL_INDEX_RUN_LENGTH_SIZE < pEndPnt, retStatus);
+        runLen = (UINT32) GET_UNALIGNED_BIG_ENDIAN((PUINT32) pCurPnt);
+        CHK(runLen != 0 && runLen <= (UINT32) (pEndPnt - pCurPnt - NAL_INDEX_RUN_LENGTH_SIZE), retStatus);
+
+        CHK_STATUS(addNalIndexEntry(pNalIndex, pData, (UINT32) (pCurPnt - pData + NAL_INDEX_RUN_LENGTH_SIZE), runLen, isH265));
+    }
+
+    // All checks, must be AvCC or HEVC
+    pNalIndex->format = isH265 ? ELEMENTARY_STREAM_NAL_FORMAT_HEVC : ELEMENTARY_STREAM_NAL_FORMAT_AVCC;
+
+CleanUp:
+
+    // Partially indexed bits are of no use
+    if (pNalIndex != NULL && pNalIndex->format == ELEMENTARY_STREAM_NAL_FORMAT_UNKNOWN) {
+        pNalIndex->idr = FALSE;
+        pNalIndex->parameterSets = FALSE;
+        pNalIndex->reference = FALSE;
+        pNalIndex->nalCount = 0;
+    }
+
+    return retStatus;
+}
+
+STATUS copyNalIndex(PNalIndex pSrcNalIndex, PNalIndex pDstNalIndex)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PNalIndexEntry pNals;
+
+    CHK(pSrcNalIndex != NULL && pDstNalIndex != NULL, STATUS_NULL_ARG);
+
+    if (pDstNalIndex->nalCapacity < pSrcNalIndex->nalCount) {
+        CHK(NULL != (pNals = (PNalIndexEntry) MEMREALLOC(pDstNalIndex->nals, pSrcNalIndex->nalCount * SIZEOF(NalIndexEntry))),
+            STATUS_NOT_ENOUGH_MEMORY);
+        pDstNalIndex->nals = pNals;
+        pDstNalIndex->nalCapacity = pSrcNalIndex->nalCount;
+    }
+
+    if (pSrcNalIndex->nalCount != 0) {
+        MEMCPY(pDstNalIndex->nals, pSrcNalIndex->nals, pSrcNalIndex->nalCount * SIZEOF(NalIndexEntry));
+    }
+
+    pDstNalIndex->format = pSrcNalIndex->format;
+    pDstNalIndex->idr = pSrcNalIndex->idr;
+    pDstNalIndex->parameterSets = pSrcNalIndex->parameterSets;
+    pDstNalIndex->reference = pSrcNalIndex->reference;
+    pDstNalIndex->nalCount = pSrcNalIndex->nalCount;
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID freeNalIndex(PNalIndex pNalIndex)
+{
+    if (pNalIndex != NULL) {
+        SAFE_MEMFREE(pNalIndex->nals);
+        pNalIndex->nalCapacity = 0;
+        pNalIndex->nalCount = 0;
+    }
+}
+
+STATUS getBufferNalIndex(GstBuffer* pBuffer, PBYTE pData, UINT32 size, BOOL isH265, PNalIndex pScratchNalIndex, PNalIndex* ppNalIndex)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    GstNalIndexMeta* pNalIndexMeta;
+    PNalIndex pNalIndex = NULL;
+
+    CHK(pBuffer != NULL && pData != NULL && pScratchNalIndex != NULL && ppNalIndex != NULL, STATUS_NULL_ARG);
+
+    // Reuse the index if it has already been computed for the buffer
+    if (NULL != (pNalIndexMeta = gst_buffer_get_nal_index_meta(pBuffer))) {
+        pNalIndex = &pNalIndexMeta->nalIndex;
+        CHK(FALSE, retStatus);
+    }
+
+    // Attach the index to the buffer if possible. Otherwise, the scratch index is used which
+    // stays valid until the next call with the same scratch index.
+    if (gst_buffer_is_writable(pBuffer) &&
+        NULL != (pNalIndexMeta = (GstNalIndexMeta*) gst_buffer_add_meta(pBuffer, GST_NAL_INDEX_META_INFO, NULL))) {
+        pNalIndex = &pNalIndexMeta->nalIndex;
+    } else {
+        pNalIndex = pScratchNalIndex;
+    }
+
+    CHK_STATUS(buildNalIndex(pData, size, isH265, pNalIndex));
+
+CleanUp:
+
+    if (ppNalIndex != NULL) {
+        *ppNalIndex = STATUS_SUCCEEDED(retStatus) ? pNalIndex : NULL;
+    }
+
+    return retStatus;
+}
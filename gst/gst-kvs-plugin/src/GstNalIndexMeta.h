@@ -0,0 +1,67 @@
+#ifndef __KVS_GST_NAL_INDEX_META_H__
+#define __KVS_GST_NAL_INDEX_META_H__
+
+#define GST_NAL_INDEX_META_API_TYPE (gst_nal_index_meta_api_get_type())
+#define GST_NAL_INDEX_META_INFO     (gst_nal_index_meta_get_info())
+
+#define gst_buffer_get_nal_index_meta(b) ((GstNalIndexMeta*) gst_buffer_get_meta((b), GST_NAL_INDEX_META_API_TYPE))
+
+// Initial number of NALu entries to allocate for the index
+#define NAL_INDEX_DEFAULT_NAL_CAPACITY 16
+
+// AvCC/HEVC NALu run length size
+#define NAL_INDEX_RUN_LENGTH_SIZE SIZEOF(UINT32)
+
+/**
+ * Location and type of a single NALu within a frame. The offset points to
+ * the NALu header right after the start code or the run length.
+ */
+typedef struct __NalIndexEntry NalIndexEntry;
+struct __NalIndexEntry {
+    UINT32 offset;
+    UINT32 length;
+    BYTE type;
+    BOOL reference;
+};
+typedef struct __NalIndexEntry* PNalIndexEntry;
+
+/**
+ * NALu layout of a video frame computed in a single pass and reused by
+ * every consumer of the frame bits.
+ */
+typedef struct __NalIndex NalIndex;
+struct __NalIndex {
+    // Annex-B, AvCC or HEVC. Unknown if the bits couldn't be parsed
+    ELEMENTARY_STREAM_NAL_FORMAT format;
+
+    // Whether the frame has an IDR NALu
+    BOOL idr;
+
+    // Whether parameter set NALus precede the first IDR NALu
+    BOOL parameterSets;
+
+    // Whether any of the VCL NALus is used as a reference
+    BOOL reference;
+
+    UINT32 nalCount;
+    UINT32 nalCapacity;
+    PNalIndexEntry nals;
+};
+typedef struct __NalIndex* PNalIndex;
+
+typedef struct __GstNalIndexMeta GstNalIndexMeta;
+struct __GstNalIndexMeta {
+    GstMeta meta;
+    NalIndex nalIndex;
+};
+
+GType gst_nal_index_meta_api_get_type(void);
+const GstMetaInfo* gst_nal_index_meta_get_info(void);
+
+STATUS buildNalIndex(PBYTE, UINT32, BOOL, PNalIndex);
+STATUS copyNalIndex(PNalIndex, PNalIndex);
+VOID freeNalIndex(PNalIndex);
+STATUS getBufferNalIndex(GstBuffer*, PBYTE, UINT32, BOOL, PNalIndex, PNalIndex*);
+PBYTE findAnnexBStartCode(PBYTE, PBYTE);
+
+#endif //__KVS_GST_NAL_INDEX_META_H__
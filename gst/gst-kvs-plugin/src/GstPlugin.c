@@ -92,6 +92,40 @@ GType gst_kvs_plugin_connection_mode_get_type(VOID)
     return kvsPluginWebRtcMode;
 }
 
+#define GST_TYPE_KVS_PLUGIN_INGEST_DROP_POLICY (gst_kvs_plugin_ingest_drop_policy_get_type())
+GType gst_kvs_plugin_ingest_drop_policy_get_type(VOID)
+{
+    static GType kvsPluginIngestDropPolicy = 0;
+    static GEnumValue enumType[] = {
+        {KVS_INGEST_DROP_POLICY_DROP, "Drop the frames until the next key frame", "drop"},
+        {KVS_INGEST_DROP_POLICY_BLOCK, "Block the streaming thread until there is space", "block"},
+        {0, NULL, NULL},
+    };
+
+    if (kvsPluginIngestDropPolicy == 0) {
+        kvsPluginIngestDropPolicy = g_enum_register_static("KVS_INGEST_DROP_POLICY", enumType);
+    }
+
+    return kvsPluginIngestDropPolicy;
+}
+
+#define GST_TYPE_KVS_PLUGIN_SYNC_MODE (gst_kvs_plugin_sync_mode_get_type())
+GType gst_kvs_plugin_sync_mode_get_type(VOID)
+{
+    static GType kvsPluginSyncMode = 0;
+    static GEnumValue enumType[] = {
+        {KVS_SYNC_MODE_COLLECT, "Process the buffers of all the pads in timestamp order", "collect"},
+        {KVS_SYNC_MODE_NONE, "Process the buffers of each pad as they arrive", "none"},
+        {0, NULL, NULL},
+    };
+
+    if (kvsPluginSyncMode == 0) {
+        kvsPluginSyncMode = g_enum_register_static("KVS_SYNC_MODE", enumType);
+    }
+
+    return kvsPluginSyncMode;
+}
+
 GstStaticPadTemplate audiosink_templ = GST_STATIC_PAD_TEMPLATE(
     "audio_%u", GST_PAD_SINK, GST_PAD_REQUEST,
     GST_STATIC_CAPS("audio/mpeg, mpegversion = (int) { 2, 4 }, stream-format = (string) raw, channels = (int) [ 1, MAX ], rate = (int) [ 1, MAX ] ; "
@@ -114,7 +148,6 @@ STATUS initKinesisVideoStructs(PGstKvsPlugin pGstPlugin)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PCHAR pAccessKey = NULL, pSecretKey = NULL, pSessionToken = NULL;
-    IotInfo iotInfo;
 
     CHK(pGstPlugin != NULL, STATUS_NULL_ARG);
 
@@ -136,6 +169,12 @@ STATUS initKinesisVideoStructs(PGstKvsPlugin pGstPlugin)
         pSecretKey = pGstPlugin->gstParams.secretKey;
     }
 
+    // Nothing leaves the process in the loopback mode so the placeholder credentials do
+    if (pGstPlugin->gstParams.loopback && (pAccessKey == NULL || pSecretKey == NULL)) {
+        pAccessKey = pGstPlugin->gstParams.accessKey;
+        pSecretKey = pGstPlugin->gstParams.secretKey;
+    }
+
     if (NULL == (pGstPlugin->pRegion = GETENV(DEFAULT_REGION_ENV_VAR))) {
         pGstPlugin->pRegion = pGstPlugin->gstParams.awsRegion;
     }
@@ -150,24 +189,8 @@ STATUS initKinesisVideoStructs(PGstKvsPlugin pGstPlugin)
             createFileLogger(FILE_LOGGING_BUFFER_SIZE, MAX_NUMBER_OF_LOG_FILES, (PCHAR) FILE_LOGGER_LOG_FILE_DIRECTORY_PATH, TRUE, TRUE, NULL));
     }
 
-    // Create the Credential Provider which will be used by both the producer and the signaling client
-    // Check if we have access key then use static credential provider.
-    // If we have IoT struct then use IoT credential provider.
-    // If we have File then we use file credential provider.
-    // We also need to set the appropriate free function pointer.
-    if (pAccessKey != NULL) {
-        CHK_STATUS(
-            createStaticCredentialProvider(pAccessKey, 0, pSecretKey, 0, pSessionToken, 0, MAX_UINT64, &pGstPlugin->kvsContext.pCredentialProvider));
-        pGstPlugin->kvsContext.freeCredentialProviderFn = freeStaticCredentialProvider;
-    } else if (pGstPlugin->gstParams.iotCertificate != NULL) {
-        CHK_STATUS(gstStructToIotInfo(pGstPlugin->gstParams.iotCertificate, &iotInfo));
-        CHK_STATUS(createCurlIotCredentialProvider(iotInfo.endPoint, iotInfo.certPath, iotInfo.privateKeyPath, iotInfo.caCertPath, iotInfo.roleAlias,
-                                                   pGstPlugin->gstParams.streamName, &pGstPlugin->kvsContext.pCredentialProvider));
-        pGstPlugin->kvsContext.freeCredentialProviderFn = freeIotCredentialProvider;
-    } else if (pGstPlugin->gstParams.credentialFilePath != NULL) {
-        CHK_STATUS(createFileCredentialProvider(pGstPlugin->gstParams.credentialFilePath, &pGstPlugin->kvsContext.pCredentialProvider));
-        pGstPlugin->kvsContext.freeCredentialProviderFn = freeFileCredentialProvider;
-    }
+    // Create or reuse the producer client of the elements with the same region, credentials and endpoint
+    CHK_STATUS(acquireKvsSharedClient(pGstPlugin, pAccessKey, pSecretKey, pSessionToken));
 
 CleanUp:
 
@@ -333,6 +356,12 @@ VOID gst_kvs_plugin_class_init(GstKvsPluginClass* klass)
                                     g_param_spec_boxed("stream-tags", "Stream Tags", "key-value pair that you can define and assign to each stream",
                                                        GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+    g_object_class_install_property(gobject_class, PROP_PAD_STREAM_NAMES,
+                                    g_param_spec_boxed("pad-stream-names", "Pad Stream Names",
+                                                       "Stream name of each additional video pad keyed by the pad name, i.e. "
+                                                       "\"names,video_1=camera-2\". Defaults to the stream name suffixed with the pad index",
+                                                       GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
     g_object_class_install_property(gobject_class, PROP_FILE_START_TIME,
                                     g_param_spec_uint64("file-start-time", "File Start Time",                            "Epoch time that the file starts in kinesis video stream. By default, current time is used. Unit: Seconds",
                                                         0, G_MAXULONG, 0,
@@ -357,6 +386,108 @@ VOID gst_kvs_plugin_class_init(GstKvsPluginClass* klass)
                                     g_param_spec_boolean("connect-webrtc", "WebRTC Connect", "Whether to connect to WebRTC signaling channel",
                                                          DEFAULT_WEBRTC_CONNECT, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+    g_object_class_install_property(gobject_class, PROP_MAX_VIEWERS,
+                                    g_param_spec_uint("max-viewers", "Max viewers", "Maximum number of concurrent WebRTC viewers", 1, G_MAXUINT,
+                                                      DEFAULT_MAX_VIEWERS, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_INGEST_QUEUE_SIZE,
+                                    g_param_spec_uint("ingest-queue-size", "Ingest queue size",
+                                                      "Maximum number of frames queued for the KVS ingest thread. 0 puts the frames synchronously",
+                                                      0, G_MAXUINT, DEFAULT_INGEST_QUEUE_SIZE,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_INGEST_DROP_POLICY,
+                                    g_param_spec_enum("ingest-drop-policy", "Ingest drop policy", "What to do when the KVS ingest queue is full",
+                                                      GST_TYPE_KVS_PLUGIN_INGEST_DROP_POLICY, DEFAULT_INGEST_DROP_POLICY,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SYNC_MODE,
+                                    g_param_spec_enum("sync-mode", "Sync mode",
+                                                      "Whether the buffers of the pads are synchronized by timestamp before processing. "
+                                                      "Needs to be set before the pads are requested",
+                                                      GST_TYPE_KVS_PLUGIN_SYNC_MODE, DEFAULT_SYNC_MODE,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_LOOPBACK,
+                                    g_param_spec_boolean("loopback", "Loopback",
+                                                         "Whether to consume and ack the KVS stream in the process instead of sending it to the "
+                                                         "service. Used to measure the plugin itself",
+                                                         DEFAULT_LOOPBACK, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_LOOPBACK_ACK_DELAY,
+                                    g_param_spec_uint("loopback-ack-delay", "Loopback ack delay",
+                                                      "Milliseconds between the end of a fragment and its persisted ack in the loopback mode", 0,
+                                                      G_MAXUINT, DEFAULT_LOOPBACK_ACK_DELAY_MS,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_LOOPBACK_BANDWIDTH,
+                                    g_param_spec_uint("loopback-bandwidth", "Loopback bandwidth",
+                                                      "Upload rate in bits per second the stream is consumed at in the loopback mode. 0 is unlimited",
+                                                      0, G_MAXUINT, DEFAULT_LOOPBACK_BANDWIDTH_BPS,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_WEBRTC_LOOPBACK_VIEWERS,
+                                    g_param_spec_uint("webrtc-loopback-viewers", "WebRTC loopback viewers",
+                                                      "Number of in-process viewers connected over the host candidates in place of the "
+                                                      "signaling channel. 0 connects to the signaling channel",
+                                                      0, G_MAXUINT, DEFAULT_WEBRTC_LOOPBACK_VIEWERS,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_WEBRTC_LOOPBACK_EARLY_CANDIDATES,
+                                    g_param_spec_uint("webrtc-loopback-early-candidates", "WebRTC loopback early candidates",
+                                                      "Number of ICE candidates sent ahead of the loopback viewers by peers which never "
+                                                      "send an offer. Floods the store of the early candidates",
+                                                      0, G_MAXUINT, DEFAULT_WEBRTC_LOOPBACK_EARLY_CANDIDATES,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SPOOL_PATH,
+                                    g_param_spec_string("spool-path", "Spool path",
+                                                        "Directory the frames are spilled to while the content store is under pressure. "
+                                                        "Empty disables the spool",
+                                                        DEFAULT_SPOOL_PATH, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SPOOL_SIZE,
+                                    g_param_spec_uint("spool-size", "Spool size",
+                                                      "Disk space in MB the spool is bounded to. The oldest frames are dropped past it", 0,
+                                                      G_MAXUINT, DEFAULT_SPOOL_SIZE_MB, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_SPOOL_CATCHUP_RATE,
+                                    g_param_spec_uint("spool-catchup-rate", "Spool catch-up rate",
+                                                      "Rate in bits per second the spilled frames are replayed at. "
+                                                      "0 is as fast as the content store takes them",
+                                                      0, G_MAXUINT, DEFAULT_SPOOL_CATCHUP_RATE,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_CHECKPOINT_PATH,
+                                    g_param_spec_string("checkpoint-path", "Checkpoint path",
+                                                        "File the offline uploads record their last persisted fragment in to be resumed "
+                                                        "from on a restart. Empty disables the checkpoints",
+                                                        DEFAULT_CHECKPOINT_PATH, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_API_CACHE_PATH,
+                                    g_param_spec_string("api-cache-path", "API cache path",
+                                                        "File the stream descriptions and endpoints are cached in across the runs. "
+                                                        "Empty is a file in the user cache directory",
+                                                        DEFAULT_API_CACHE_PATH, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_PRE_EVENT_DURATION,
+                                    g_param_spec_uint("pre-event-duration", "Pre-event duration",
+                                                      "Seconds of frames held from the last key frame while the streaming is disabled and "
+                                                      "put ahead of the live ones once it's enabled. 0 drops them",
+                                                      0, G_MAXUINT, DEFAULT_PRE_EVENT_DURATION_SECONDS,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_STATS,
+                                    g_param_spec_boxed("stats", "Stats",
+                                                       "Runtime statistics of the tracks, the KVS ingest and the WebRTC sessions",
+                                                       GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+    g_object_class_install_property(gobject_class, PROP_STATS_INTERVAL,
+                                    g_param_spec_uint("stats-interval", "Stats interval",
+                                                      "Period of the stats element messages posted on the bus. 0 disables them. Unit: seconds",
+                                                      0, G_MAXUINT, DEFAULT_STATS_INTERVAL_SECONDS,
+                                                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
     g_object_class_install_property(gobject_class, PROP_STREAM_CREATE_TIMEOUT,
                                     g_param_spec_uint("stream-create-timeout", "Stream creation timeout", "Stream create timeout. Unit: seconds", 0,
                                                       G_MAXUINT, DEFAULT_STREAM_CREATE_TIMEOUT_SECONDS,
@@ -387,6 +518,7 @@ VOID gst_kvs_plugin_init(PGstKvsPlugin pGstKvsPlugin)
     pGstKvsPlugin->numStreams = 0;
     pGstKvsPlugin->numAudioStreams = 0;
     pGstKvsPlugin->numVideoStreams = 0;
+    pGstKvsPlugin->pPadStreams = NULL;
 
     // Stream definition
     pGstKvsPlugin->gstParams.streamName = g_strdup(DEFAULT_STREAM_NAME);
@@ -425,12 +557,68 @@ VOID gst_kvs_plugin_init(PGstKvsPlugin pGstKvsPlugin)
     pGstKvsPlugin->gstParams.trickleIce = DEFAULT_TRICKLE_ICE_MODE;
     pGstKvsPlugin->gstParams.enableStreaming = DEFAULT_ENABLE_STREAMING;
     pGstKvsPlugin->gstParams.webRtcConnect = DEFAULT_WEBRTC_CONNECT;
+    pGstKvsPlugin->gstParams.maxViewers = DEFAULT_MAX_VIEWERS;
+    pGstKvsPlugin->gstParams.ingestQueueSize = DEFAULT_INGEST_QUEUE_SIZE;
+    pGstKvsPlugin->gstParams.ingestDropPolicy = DEFAULT_INGEST_DROP_POLICY;
+    pGstKvsPlugin->gstParams.statsInterval = DEFAULT_STATS_INTERVAL_SECONDS;
+    pGstKvsPlugin->gstParams.syncMode = DEFAULT_SYNC_MODE;
+    pGstKvsPlugin->gstParams.loopback = DEFAULT_LOOPBACK;
+    pGstKvsPlugin->gstParams.loopbackAckDelay = DEFAULT_LOOPBACK_ACK_DELAY_MS;
+    pGstKvsPlugin->gstParams.loopbackBandwidth = DEFAULT_LOOPBACK_BANDWIDTH_BPS;
+    pGstKvsPlugin->gstParams.webRtcLoopbackViewers = DEFAULT_WEBRTC_LOOPBACK_VIEWERS;
+    pGstKvsPlugin->gstParams.webRtcLoopbackEarlyCandidates = DEFAULT_WEBRTC_LOOPBACK_EARLY_CANDIDATES;
+    pGstKvsPlugin->gstParams.spoolPath = g_strdup(DEFAULT_SPOOL_PATH);
+    pGstKvsPlugin->gstParams.spoolSize = DEFAULT_SPOOL_SIZE_MB;
+    pGstKvsPlugin->gstParams.spoolCatchupRate = DEFAULT_SPOOL_CATCHUP_RATE;
+    pGstKvsPlugin->gstParams.checkpointPath = g_strdup(DEFAULT_CHECKPOINT_PATH);
+    pGstKvsPlugin->gstParams.preEventDurationInSeconds = DEFAULT_PRE_EVENT_DURATION_SECONDS;
+    pGstKvsPlugin->gstParams.apiCachePath = g_strdup(DEFAULT_API_CACHE_PATH);
+    pGstKvsPlugin->mediaLock = MUTEX_CREATE(FALSE);
+
+    pGstKvsPlugin->kvsStartupTid = INVALID_TID_VALUE;
+    pGstKvsPlugin->webRtcStartupTid = INVALID_TID_VALUE;
+    pGstKvsPlugin->startupLock = MUTEX_CREATE(FALSE);
+    pGstKvsPlugin->startupCvar = CVAR_CREATE();
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->kvsStartupDone, FALSE);
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->kvsStreamReady, FALSE);
+    ATOMIC_STORE(&pGstKvsPlugin->firstPutLatency, 0);
 
     ATOMIC_STORE_BOOL(&pGstKvsPlugin->enableStreaming, pGstKvsPlugin->gstParams.enableStreaming);
     ATOMIC_STORE_BOOL(&pGstKvsPlugin->connectWebRtc, pGstKvsPlugin->gstParams.webRtcConnect);
 
-    pGstKvsPlugin->adaptedFrameBufSize = 0;
-    pGstKvsPlugin->pAdaptedFrameBuf = NULL;
+    MEMSET(&pGstKvsPlugin->nalIndex, 0x00, SIZEOF(NalIndex));
+    ATOMIC_STORE(&pGstKvsPlugin->webRtcFrameCount, 0);
+    ATOMIC_STORE(&pGstKvsPlugin->webRtcCopiedBytes, 0);
+    MEMSET((PVOID) pGstKvsPlugin->trackFrameCount, 0x00, SIZEOF(pGstKvsPlugin->trackFrameCount));
+    MEMSET((PVOID) pGstKvsPlugin->trackByteCount, 0x00, SIZEOF(pGstKvsPlugin->trackByteCount));
+
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->keyUnitRequested, FALSE);
+    pGstKvsPlugin->lastKeyUnitEventTime = 0;
+    pGstKvsPlugin->keyUnitEventCount = 0;
+    pGstKvsPlugin->lastBitrateHintTime = 0;
+    pGstKvsPlugin->lastBitrateHint = 0;
+
+    pGstKvsPlugin->pIngestRing = NULL;
+    pGstKvsPlugin->ingestTid = INVALID_TID_VALUE;
+    pGstKvsPlugin->ingestLock = INVALID_MUTEX_VALUE;
+    pGstKvsPlugin->ingestCvar = INVALID_CVAR_VALUE;
+    MEMSET((PVOID) pGstKvsPlugin->latencyHistograms, 0x00, SIZEOF(pGstKvsPlugin->latencyHistograms));
+    ATOMIC_STORE(&pGstKvsPlugin->iceConnectCount, 0);
+    ATOMIC_STORE(&pGstKvsPlugin->iceConnectTotalTime, 0);
+
+    // The timers are cancelled on finalize even if the state change never got to adding them
+    pGstKvsPlugin->statsTimerId = MAX_UINT32;
+    pGstKvsPlugin->iceCandidatePairStatsTimerId = MAX_UINT32;
+    pGstKvsPlugin->iceConfigRefreshTimerId = MAX_UINT32;
+    pGstKvsPlugin->pregenerateCertTimerId = MAX_UINT32;
+    pGstKvsPlugin->serviceRoutineTimerId = MAX_UINT32;
+    pGstKvsPlugin->timersCancelled = FALSE;
+
+    pGstKvsPlugin->sessionWorkerTid = INVALID_TID_VALUE;
+    pGstKvsPlugin->sessionWorkerLock = INVALID_MUTEX_VALUE;
+    pGstKvsPlugin->sessionWorkerCvar = INVALID_CVAR_VALUE;
+
+    pGstKvsPlugin->pSignalingWorkers = NULL;
 
     // Mark plugin as sink
     GST_OBJECT_FLAG_SET(pGstKvsPlugin, GST_ELEMENT_FLAG_SINK);
@@ -444,34 +632,58 @@ VOID gst_kvs_plugin_finalize(GObject* object)
         return;
     }
 
-    if (pGstKvsPlugin->kvsContext.pDeviceInfo != NULL) {
-        freeDeviceInfo(&pGstKvsPlugin->kvsContext.pDeviceInfo);
+    // The startup threads are using the stream info and the clients
+    if (IS_VALID_TID_VALUE(pGstKvsPlugin->kvsStartupTid)) {
+        THREAD_JOIN(pGstKvsPlugin->kvsStartupTid, NULL);
+        pGstKvsPlugin->kvsStartupTid = INVALID_TID_VALUE;
+    }
+
+    if (IS_VALID_TID_VALUE(pGstKvsPlugin->webRtcStartupTid)) {
+        THREAD_JOIN(pGstKvsPlugin->webRtcStartupTid, NULL);
+        pGstKvsPlugin->webRtcStartupTid = INVALID_TID_VALUE;
     }
 
+    // The timers are run on the queue of the shared client and would otherwise fire into the state freed below
+    cancelGstKvsPluginTimers(pGstKvsPlugin);
+
     if (pGstKvsPlugin->kvsContext.pStreamInfo != NULL) {
         freeStreamInfoProvider(&pGstKvsPlugin->kvsContext.pStreamInfo);
     }
 
+    // Stop the ingest and the spool replay threads before the stream they put the frames to is freed
+    clearKinesisVideoPreEventRing(pGstKvsPlugin);
+    stopKinesisVideoIngest(pGstKvsPlugin);
+    stopKinesisVideoSpool(pGstKvsPlugin);
+    stopKinesisVideoCheckpoint(pGstKvsPlugin, FALSE);
+
     if (IS_VALID_STREAM_HANDLE(pGstKvsPlugin->kvsContext.streamHandle)) {
         freeKinesisVideoStream(&pGstKvsPlugin->kvsContext.streamHandle);
     }
 
-    if (IS_VALID_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.clientHandle)) {
-        freeKinesisVideoClient(&pGstKvsPlugin->kvsContext.clientHandle);
-    }
+    freeKinesisVideoPadStreams(pGstKvsPlugin);
+
+    freeGstKvsWebRtcPlugin(pGstKvsPlugin);
+
+    // Last object to be released as the credential provider is used by the signaling client
+    releaseKvsSharedClient(pGstKvsPlugin);
 
-    if (pGstKvsPlugin->kvsContext.pClientCallbacks != NULL) {
-        freeCallbacksProvider(&pGstKvsPlugin->kvsContext.pClientCallbacks);
+    gst_object_unref(pGstKvsPlugin->collect);
+
+    if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->mediaLock)) {
+        MUTEX_FREE(pGstKvsPlugin->mediaLock);
+        pGstKvsPlugin->mediaLock = INVALID_MUTEX_VALUE;
     }
 
-    freeGstKvsWebRtcPlugin(pGstKvsPlugin);
+    if (IS_VALID_CVAR_VALUE(pGstKvsPlugin->startupCvar)) {
+        CVAR_FREE(pGstKvsPlugin->startupCvar);
+        pGstKvsPlugin->startupCvar = INVALID_CVAR_VALUE;
+    }
 
-    // Last object to be freed
-    if (pGstKvsPlugin->kvsContext.pCredentialProvider != NULL) {
-        pGstKvsPlugin->kvsContext.freeCredentialProviderFn(&pGstKvsPlugin->kvsContext.pCredentialProvider);
+    if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->startupLock)) {
+        MUTEX_FREE(pGstKvsPlugin->startupLock);
+        pGstKvsPlugin->startupLock = INVALID_MUTEX_VALUE;
     }
 
-    gst_object_unref(pGstKvsPlugin->collect);
     g_free(pGstKvsPlugin->gstParams.streamName);
     g_free(pGstKvsPlugin->gstParams.channelName);
     g_free(pGstKvsPlugin->gstParams.contentType);
@@ -480,6 +692,9 @@ VOID gst_kvs_plugin_finalize(GObject* object)
     g_free(pGstKvsPlugin->gstParams.accessKey);
     g_free(pGstKvsPlugin->audioCodecId);
     g_free(pGstKvsPlugin->gstParams.fileLogPath);
+    g_free(pGstKvsPlugin->gstParams.spoolPath);
+    g_free(pGstKvsPlugin->gstParams.checkpointPath);
+    g_free(pGstKvsPlugin->gstParams.apiCachePath);
 
     if (pGstKvsPlugin->gstParams.iotCertificate != NULL) {
         gst_structure_free(pGstKvsPlugin->gstParams.iotCertificate);
@@ -491,7 +706,12 @@ VOID gst_kvs_plugin_finalize(GObject* object)
         pGstKvsPlugin->gstParams.streamTags = NULL;
     }
 
-    SAFE_MEMFREE(pGstKvsPlugin->pAdaptedFrameBuf);
+    if (pGstKvsPlugin->gstParams.padStreamNames != NULL) {
+        gst_structure_free(pGstKvsPlugin->gstParams.padStreamNames);
+        pGstKvsPlugin->gstParams.padStreamNames = NULL;
+    }
+
+    freeNalIndex(&pGstKvsPlugin->nalIndex);
 
     G_OBJECT_CLASS(parent_class)->finalize(object);
 }
@@ -626,6 +846,16 @@ VOID gst_kvs_plugin_set_property(GObject* object, guint propId, const GValue* va
             pGstKvsPlugin->gstParams.streamTags = (tagsStruct != NULL) ? gst_structure_copy(tagsStruct) : NULL;
             break;
         }
+        case PROP_PAD_STREAM_NAMES: {
+            const GstStructure* namesStruct = gst_value_get_structure(value);
+
+            if (pGstKvsPlugin->gstParams.padStreamNames != NULL) {
+                gst_structure_free(pGstKvsPlugin->gstParams.padStreamNames);
+            }
+
+            pGstKvsPlugin->gstParams.padStreamNames = (namesStruct != NULL) ? gst_structure_copy(namesStruct) : NULL;
+            break;
+        }
         case PROP_FILE_START_TIME:
             pGstKvsPlugin->gstParams.fileStartTime = g_value_get_uint64(value);
             break;
@@ -649,6 +879,57 @@ VOID gst_kvs_plugin_set_property(GObject* object, guint propId, const GValue* va
             pGstKvsPlugin->gstParams.webRtcConnect = g_value_get_boolean(value);
             ATOMIC_STORE_BOOL(&pGstKvsPlugin->connectWebRtc, pGstKvsPlugin->gstParams.webRtcConnect);
             break;
+        case PROP_MAX_VIEWERS:
+            pGstKvsPlugin->gstParams.maxViewers = g_value_get_uint(value);
+            break;
+        case PROP_INGEST_QUEUE_SIZE:
+            pGstKvsPlugin->gstParams.ingestQueueSize = g_value_get_uint(value);
+            break;
+        case PROP_INGEST_DROP_POLICY:
+            pGstKvsPlugin->gstParams.ingestDropPolicy = (KVS_INGEST_DROP_POLICY) g_value_get_enum(value);
+            break;
+        case PROP_STATS_INTERVAL:
+            pGstKvsPlugin->gstParams.statsInterval = g_value_get_uint(value);
+            break;
+        case PROP_SYNC_MODE:
+            pGstKvsPlugin->gstParams.syncMode = (KVS_SYNC_MODE) g_value_get_enum(value);
+            break;
+        case PROP_LOOPBACK:
+            pGstKvsPlugin->gstParams.loopback = g_value_get_boolean(value);
+            break;
+        case PROP_LOOPBACK_ACK_DELAY:
+            pGstKvsPlugin->gstParams.loopbackAckDelay = g_value_get_uint(value);
+            break;
+        case PROP_LOOPBACK_BANDWIDTH:
+            pGstKvsPlugin->gstParams.loopbackBandwidth = g_value_get_uint(value);
+            break;
+        case PROP_WEBRTC_LOOPBACK_VIEWERS:
+            pGstKvsPlugin->gstParams.webRtcLoopbackViewers = g_value_get_uint(value);
+            break;
+        case PROP_WEBRTC_LOOPBACK_EARLY_CANDIDATES:
+            pGstKvsPlugin->gstParams.webRtcLoopbackEarlyCandidates = g_value_get_uint(value);
+            break;
+        case PROP_SPOOL_PATH:
+            g_free(pGstKvsPlugin->gstParams.spoolPath);
+            pGstKvsPlugin->gstParams.spoolPath = g_strdup(g_value_get_string(value));
+            break;
+        case PROP_SPOOL_SIZE:
+            pGstKvsPlugin->gstParams.spoolSize = g_value_get_uint(value);
+            break;
+        case PROP_SPOOL_CATCHUP_RATE:
+            pGstKvsPlugin->gstParams.spoolCatchupRate = g_value_get_uint(value);
+            break;
+        case PROP_CHECKPOINT_PATH:
+            g_free(pGstKvsPlugin->gstParams.checkpointPath);
+            pGstKvsPlugin->gstParams.checkpointPath = g_strdup(g_value_get_string(value));
+            break;
+        case PROP_PRE_EVENT_DURATION:
+            pGstKvsPlugin->gstParams.preEventDurationInSeconds = g_value_get_uint(value);
+            break;
+        case PROP_API_CACHE_PATH:
+            g_free(pGstKvsPlugin->gstParams.apiCachePath);
+            pGstKvsPlugin->gstParams.apiCachePath = g_strdup(g_value_get_string(value));
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, propId, pspec);
             break;
@@ -763,6 +1044,9 @@ VOID gst_kvs_plugin_get_property(GObject* object, guint propId, GValue* value, G
         case PROP_STREAM_TAGS:
             gst_value_set_structure(value, pGstKvsPlugin->gstParams.streamTags);
             break;
+        case PROP_PAD_STREAM_NAMES:
+            gst_value_set_structure(value, pGstKvsPlugin->gstParams.padStreamNames);
+            break;
         case PROP_FILE_START_TIME:
             g_value_set_uint64(value, pGstKvsPlugin->gstParams.fileStartTime);
             break;
@@ -784,6 +1068,57 @@ VOID gst_kvs_plugin_get_property(GObject* object, guint propId, GValue* value, G
         case PROP_WEBRTC_CONNECT:
             g_value_set_boolean(value, pGstKvsPlugin->gstParams.webRtcConnect);
             break;
+        case PROP_MAX_VIEWERS:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.maxViewers);
+            break;
+        case PROP_INGEST_QUEUE_SIZE:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.ingestQueueSize);
+            break;
+        case PROP_INGEST_DROP_POLICY:
+            g_value_set_enum(value, pGstKvsPlugin->gstParams.ingestDropPolicy);
+            break;
+        case PROP_STATS:
+            g_value_take_boxed(value, createPluginStats(pGstKvsPlugin));
+            break;
+        case PROP_STATS_INTERVAL:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.statsInterval);
+            break;
+        case PROP_SYNC_MODE:
+            g_value_set_enum(value, pGstKvsPlugin->gstParams.syncMode);
+            break;
+        case PROP_LOOPBACK:
+            g_value_set_boolean(value, pGstKvsPlugin->gstParams.loopback);
+            break;
+        case PROP_LOOPBACK_ACK_DELAY:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.loopbackAckDelay);
+            break;
+        case PROP_LOOPBACK_BANDWIDTH:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.loopbackBandwidth);
+            break;
+        case PROP_WEBRTC_LOOPBACK_VIEWERS:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.webRtcLoopbackViewers);
+            break;
+        case PROP_WEBRTC_LOOPBACK_EARLY_CANDIDATES:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.webRtcLoopbackEarlyCandidates);
+            break;
+        case PROP_SPOOL_PATH:
+            g_value_set_string(value, pGstKvsPlugin->gstParams.spoolPath);
+            break;
+        case PROP_SPOOL_SIZE:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.spoolSize);
+            break;
+        case PROP_SPOOL_CATCHUP_RATE:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.spoolCatchupRate);
+            break;
+        case PROP_CHECKPOINT_PATH:
+            g_value_set_string(value, pGstKvsPlugin->gstParams.checkpointPath);
+            break;
+        case PROP_PRE_EVENT_DURATION:
+            g_value_set_uint(value, pGstKvsPlugin->gstParams.preEventDurationInSeconds);
+            break;
+        case PROP_API_CACHE_PATH:
+            g_value_set_string(value, pGstKvsPlugin->gstParams.apiCachePath);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, propId, pspec);
             break;
@@ -795,6 +1130,7 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
     STATUS retStatus = STATUS_SUCCESS;
     PGstKvsPlugin pGstKvsPlugin = GST_KVS_PLUGIN(user_data);
     PGstKvsPluginTrackData pTrackData = (PGstKvsPluginTrackData) track_data;
+    PKvsPadStream pPadStream = pTrackData->pPadStream;
     GstCaps* gstcaps = NULL;
     UINT64 trackId = pTrackData->trackId;
     BYTE cpd[GST_PLUGIN_MAX_CPD_SIZE];
@@ -810,12 +1146,20 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
 
     switch (GST_EVENT_TYPE(event)) {
         case GST_EVENT_EOS:
-            if (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamStopped)) {
+            if (pPadStream != NULL) {
+                CHK_STATUS(stopKinesisVideoPadStream(pPadStream));
+                break;
+            }
+
+            if (STATUS_SUCCEEDED(awaitKinesisVideoStream(pGstKvsPlugin)) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamStopped)) {
+                flushKinesisVideoIngest(pGstKvsPlugin);
                 if (STATUS_FAILED(retStatus = stopKinesisVideoStreamSync(pGstKvsPlugin->kvsContext.streamHandle))) {
                     GST_ERROR_OBJECT(pGstKvsPlugin, "Failed to stop the stream with 0x%08x", retStatus);
                     CHK_STATUS(retStatus);
                 }
 
+                stopKinesisVideoCheckpoint(pGstKvsPlugin, TRUE);
+
                 ATOMIC_STORE_BOOL(&pGstKvsPlugin->streamStopped, TRUE);
             }
 
@@ -826,7 +1170,19 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
             GstStructure* gststructforcaps = gst_caps_get_structure(gstcaps, 0);
             mediaType = gst_structure_get_name(gststructforcaps);
 
-            if (0 == STRCMP(mediaType, GSTREAMER_MEDIA_TYPE_ALAW) || 0 == STRCMP(mediaType, GSTREAMER_MEDIA_TYPE_MULAW)) {
+            if (pPadStream != NULL) {
+                // Streams of the pads requested after the element has started are created here
+                CHK_STATUS(awaitKinesisVideoStream(pGstKvsPlugin));
+                CHK_STATUS(initKinesisVideoPadStream(pGstKvsPlugin, pPadStream, gstcaps));
+
+                if (!pPadStream->cpdReceived && gst_structure_has_field(gststructforcaps, "codec_data")) {
+                    gstCpd = gst_value_serialize(gst_structure_get_value(gststructforcaps, "codec_data"));
+                    CHK_STATUS(hexDecode(gstCpd, 0, NULL, &cpdSize));
+                    CHK(cpdSize < GST_PLUGIN_MAX_CPD_SIZE, STATUS_INVALID_ARG_LEN);
+                    CHK_STATUS(hexDecode(gstCpd, 0, cpd, &cpdSize));
+                    CHK_STATUS(setKinesisVideoPadStreamCpd(pGstKvsPlugin, pPadStream, cpd, cpdSize));
+                }
+            } else if (0 == STRCMP(mediaType, GSTREAMER_MEDIA_TYPE_ALAW) || 0 == STRCMP(mediaType, GSTREAMER_MEDIA_TYPE_MULAW)) {
                 KVS_PCM_FORMAT_CODE format = KVS_PCM_FORMAT_CODE_MULAW;
 
                 gst_structure_get_int(gststructforcaps, "rate", &samplerate);
@@ -849,7 +1205,7 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
                 }
 
                 // Send cpd to kinesis video stream
-                CHK_STATUS(kinesisVideoStreamFormatChanged(pGstKvsPlugin->kvsContext.streamHandle, KVS_PCM_CPD_SIZE_BYTE, cpd, trackId));
+                CHK_STATUS(setKinesisVideoStreamCpd(pGstKvsPlugin, trackId, cpd, KVS_PCM_CPD_SIZE_BYTE));
             } else if (!pGstKvsPlugin->trackCpdReceived[trackId] && gst_structure_has_field(gststructforcaps, "codec_data")) {
                 const GValue* gstStreamFormat = gst_structure_get_value(gststructforcaps, "codec_data");
                 gstCpd = gst_value_serialize(gstStreamFormat);
@@ -889,11 +1245,11 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
                         nalFlags |= NAL_ADAPTATION_ANNEXB_NALS;
                     }
 
-                    CHK_STATUS(kinesisVideoStreamSetNalAdaptationFlags(pGstKvsPlugin->kvsContext.streamHandle, nalFlags));
+                    CHK_STATUS(setKinesisVideoStreamNalFlags(pGstKvsPlugin, nalFlags));
                 }
 
-                // Send cpd to kinesis video stream
-                CHK_STATUS(kinesisVideoStreamFormatChanged(pGstKvsPlugin->kvsContext.streamHandle, cpdSize, cpd, trackId));
+                // Send cpd to kinesis video stream. Held until the stream is created in the background.
+                CHK_STATUS(setKinesisVideoStreamCpd(pGstKvsPlugin, trackId, cpd, cpdSize));
 
                 // Mark as received
                 pGstKvsPlugin->trackCpdReceived[trackId] = TRUE;
@@ -913,7 +1269,9 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
                 gst_structure_get_boolean(gstStruct, KVS_ADD_METADATA_PERSISTENT, &persistent)) {
                 DLOGD("received " KVS_ADD_METADATA_G_STRUCT_NAME " event");
 
-                CHK_STATUS(putKinesisVideoFragmentMetadata(pGstKvsPlugin->kvsContext.streamHandle, pName, pVal, persistent));
+                CHK_STATUS(awaitKinesisVideoStream(pGstKvsPlugin));
+                CHK_STATUS(putKinesisVideoFragmentMetadata(pPadStream != NULL ? pPadStream->streamHandle : pGstKvsPlugin->kvsContext.streamHandle, pName,
+                                                           pVal, persistent));
 
                 gst_event_unref(event);
                 event = NULL;
@@ -923,6 +1281,13 @@ gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads* pads, GstCollectData
 
                 ATOMIC_STORE_BOOL(&pGstKvsPlugin->enableStreaming, enableStreaming);
 
+                gst_event_unref(event);
+                event = NULL;
+            } else if (gst_structure_has_name(gstStruct, KVS_DUMP_LATENCY_G_STRUCT_NAME)) {
+                DLOGD("received " KVS_DUMP_LATENCY_G_STRUCT_NAME " event");
+
+                logLatencyHistograms(pGstKvsPlugin);
+
                 gst_event_unref(event);
                 event = NULL;
             } else if (gst_structure_has_name(gstStruct, KVS_CONNECT_WEBRTC_G_STRUCT_NAME) &&
@@ -970,21 +1335,53 @@ GstFlowReturn gst_kvs_plugin_handle_buffer(GstCollectPads* pads, GstCollectData*
     UINT64 trackId;
     FRAME_FLAGS frameFlags = FRAME_FLAG_NONE;
     GstMapInfo info;
+    GstMapFlags mapFlags;
+    PNalIndex pNalIndex = NULL;
+    BOOL isH265, streaming, enabled;
+    PKvsPadStream pPadStream;
+    UINT64 arrivalTime = GST_PLUGIN_MONOTONIC_TIME(), stageStartTime;
     STATUS status;
     Frame frame;
+    GstClock* pClock;
+    GstClockTime runningTime;
+    MUTEX mediaLock = INVALID_MUTEX_VALUE;
 
     info.data = NULL;
 
+    // The pad streams are stopped ahead of taking the media lock as the pads take it under their own
+    if (buf == NULL && pTrackData == NULL) {
+        for (pPadStream = pGstKvsPlugin->pPadStreams; pPadStream != NULL; pPadStream = pPadStream->pNext) {
+            MUTEX_LOCK(pPadStream->lock);
+            if (STATUS_FAILED(status = stopKinesisVideoPadStream(pPadStream))) {
+                DLOGW("Failed to stop the stream of pad %s with 0x%08x", pPadStream->padName, status);
+            }
+
+            MUTEX_UNLOCK(pPadStream->lock);
+        }
+    }
+
+    // The pads are chained concurrently when bypassing the collect pads. The additional video pads
+    // feed their own streams so they only serialize with themselves.
+    if (pGstKvsPlugin->gstParams.syncMode == KVS_SYNC_MODE_NONE) {
+        mediaLock = (pTrackData != NULL && pTrackData->pPadStream != NULL) ? pTrackData->pPadStream->lock : pGstKvsPlugin->mediaLock;
+        MUTEX_LOCK(mediaLock);
+    }
+
     // eos reached
     if (buf == NULL && pTrackData == NULL) {
-        if (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamStopped)) {
+        if (STATUS_SUCCEEDED(awaitKinesisVideoStream(pGstKvsPlugin)) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamStopped)) {
+            flushKinesisVideoIngest(pGstKvsPlugin);
             if (STATUS_FAILED(status = stopKinesisVideoStreamSync(pGstKvsPlugin->kvsContext.streamHandle))) {
                 DLOGW("Failed to stop the stream with 0x%08x", status);
+            } else {
+                stopKinesisVideoCheckpoint(pGstKvsPlugin, TRUE);
             }
         }
 
         ATOMIC_STORE_BOOL(&pGstKvsPlugin->streamStopped, TRUE);
 
+        logLatencyHistograms(pGstKvsPlugin);
+
         DLOGD("Sending eos");
 
         // send out eos message to gstreamer bus
@@ -995,7 +1392,8 @@ GstFlowReturn gst_kvs_plugin_handle_buffer(GstCollectPads* pads, GstCollectData*
         goto CleanUp;
     }
 
-    if (STATUS_FAILED(streamStatus)) {
+    // The status is of the main stream which is left to its pads
+    if (STATUS_FAILED(streamStatus) && pTrackData->pPadStream == NULL) {
         // in offline case, we cant tell the pipeline to restream the file again in case of network outage.
         // therefore error out and let higher level application do the retry.
         if (IS_OFFLINE_STREAMING_MODE(pGstKvsPlugin->gstParams.streamingType) || !IS_RETRIABLE_ERROR(streamStatus)) {
@@ -1025,6 +1423,27 @@ GstFlowReturn gst_kvs_plugin_handle_buffer(GstCollectPads* pads, GstCollectData*
         goto CleanUp;
     }
 
+    // Time since the capture including the waits upstream and in the collect pads. The buffer
+    // timestamps are only in running time when clipped.
+    if (!pGstKvsPlugin->gstParams.disableBufferClipping && GST_BUFFER_PTS_IS_VALID(buf) &&
+        NULL != (pClock = gst_element_get_clock(GST_ELEMENT_CAST(pGstKvsPlugin)))) {
+        runningTime = gst_clock_get_time(pClock) - gst_element_get_base_time(GST_ELEMENT_CAST(pGstKvsPlugin));
+        gst_object_unref(pClock);
+        if (runningTime > buf->pts) {
+            latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_CAPTURE],
+                                   (runningTime - buf->pts) / DEFAULT_TIME_UNIT_IN_NANOS);
+        }
+    }
+
+    // Additional video pads are put to their own streams only
+    if (pTrackData->pPadStream != NULL) {
+        if (STATUS_FAILED(status = putKinesisVideoPadFrame(pGstKvsPlugin, pTrackData->pPadStream, buf))) {
+            DLOGW("Failed to put frame of pad %s with 0x%08x", pTrackData->pPadStream->padName, status);
+        }
+
+        goto CleanUp;
+    }
+
     // In offline mode, if user specifies a file_start_time, the stream will be configured to use absolute
     // timestamp. Therefore in here we add the file_start_time to frame pts to create absolute timestamp.
     // If user did not specify file_start_time, file_start_time will be 0 and has no effect.
@@ -1038,10 +1457,6 @@ GstFlowReturn gst_kvs_plugin_handle_buffer(GstCollectPads* pads, GstCollectData*
     pGstKvsPlugin->lastDts = buf->dts;
     trackId = pTrackData->trackId;
 
-    if (!gst_buffer_map(buf, &info, GST_MAP_READ)) {
-        goto CleanUp;
-    }
-
     delta = GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
 
     switch (pGstKvsPlugin->mediaType) {
@@ -1076,23 +1491,93 @@ GstFlowReturn gst_kvs_plugin_handle_buffer(GstCollectPads* pads, GstCollectData*
     frame.decodingTs = buf->dts / DEFAULT_TIME_UNIT_IN_NANOS;
     frame.presentationTs = buf->pts / DEFAULT_TIME_UNIT_IN_NANOS;
     frame.trackId = trackId;
+    frame.size = 0;
+    frame.frameData = NULL;
+    frame.duration = 0;
+
+    // Map the video bits writable if they need to be adapted for WebRTC so the AvCC/HEVC run lengths
+    // can be rewritten in place once the frame has been consumed by the producer. The ingest thread and
+    // the pre-event ring consume the frames later on so the bits they're handed are adapted on a copy for WebRTC.
+    mapFlags = GST_MAP_READ;
+    if (trackId == DEFAULT_VIDEO_TRACK_ID && IS_AVCC_HEVC_CPD_NAL_FORMAT(pGstKvsPlugin->detectedCpdFormat) && pGstKvsPlugin->pIngestRing == NULL &&
+        pGstKvsPlugin->gstParams.preEventDurationInSeconds == 0 && buf->pool == NULL && isGstBufferWritableInPlace(buf)) {
+        mapFlags = GST_MAP_READWRITE;
+    }
+
+    stageStartTime = GST_PLUGIN_MONOTONIC_TIME();
+    if (!gst_buffer_map(buf, &info, mapFlags)) {
+        goto CleanUp;
+    }
+
+    latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_BUFFER_MAP], GST_PLUGIN_MONOTONIC_TIME() - stageStartTime);
+
+    // Index the video frame NALus once for all of the consumers of the bits. This is done ahead of the
+    // ingest taking its reference so that the index is attached to the buffer while it's still writable.
+    if (trackId == DEFAULT_VIDEO_TRACK_ID) {
+        stageStartTime = GST_PLUGIN_MONOTONIC_TIME();
+        isH265 = pGstKvsPlugin->gstParams.codecId != NULL && 0 == STRCMP(pGstKvsPlugin->gstParams.codecId, DEFAULT_CODEC_ID_H265);
+        if (STATUS_FAILED(status = getBufferNalIndex(buf, info.data, (UINT32) info.size, isH265, &pGstKvsPlugin->nalIndex, &pNalIndex))) {
+            DLOGW("Failed to index the frame NALus with 0x%08x", status);
+        }
+
+        latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_NAL_INDEX], GST_PLUGIN_MONOTONIC_TIME() - stageStartTime);
+    }
+
     frame.size = info.size;
     frame.frameData = info.data;
-    frame.duration = 0;
 
-    if (ATOMIC_LOAD_BOOL(&pGstKvsPlugin->enableStreaming)) {
-        if (STATUS_FAILED(status = putKinesisVideoFrame(pGstKvsPlugin->kvsContext.streamHandle, &frame))) {
+    // Hand the buffer over to the ingest thread so the content store backpressure doesn't
+    // stall the live WebRTC path. The queue also holds the frames until the stream has been
+    // created in the background. The frames the stream has persisted before a restart of
+    // the upload are not put again.
+    enabled = ATOMIC_LOAD_BOOL(&pGstKvsPlugin->enableStreaming);
+    streaming = enabled && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamStopped) && !isKinesisVideoFramePersisted(pGstKvsPlugin, &frame);
+
+    // The lead-up held while the streaming is disabled goes ahead of the first frame once it's enabled
+    if (!enabled && pGstKvsPlugin->gstParams.preEventDurationInSeconds != 0 && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamStopped)) {
+        if (STATUS_FAILED(status = holdKinesisVideoPreEventFrame(pGstKvsPlugin, buf, &frame))) {
+            DLOGW("Failed to hold pre-event frame with 0x%08x", status);
+        }
+    } else if (streaming) {
+        flushKinesisVideoPreEventRing(pGstKvsPlugin);
+    }
+
+    if (streaming && pGstKvsPlugin->pIngestRing != NULL) {
+        if (STATUS_FAILED(status = enqueueKinesisVideoFrame(pGstKvsPlugin, buf, &frame, arrivalTime))) {
+            DLOGW("Failed to queue frame for KVS ingest with 0x%08x", status);
+        }
+    }
+
+    if (trackId <= DEFAULT_AUDIO_TRACK_ID) {
+        ATOMIC_INCREMENT(&pGstKvsPlugin->trackFrameCount[trackId - 1]);
+        ATOMIC_ADD(&pGstKvsPlugin->trackByteCount[trackId - 1], (SIZE_T) info.size);
+    }
+
+    // Without the queue the frames are put synchronously once the stream is there
+    if (streaming && pGstKvsPlugin->pIngestRing == NULL && admitKinesisVideoSyncFrame(pGstKvsPlugin, &frame)) {
+        stageStartTime = GST_PLUGIN_MONOTONIC_TIME();
+        if (STATUS_FAILED(status = putKinesisVideoStreamFrame(pGstKvsPlugin, &frame))) {
             DLOGW("Failed to put frame with 0x%08x", status);
         }
+
+        recordPutFrameLatency(pGstKvsPlugin, stageStartTime, arrivalTime);
     }
 
     // Need to produce the frame into peer connections
     // Check whether the frame is in AvCC/HEVC and set the flag to adapt the
-    // bits to Annex-B format for RTP
-    if (STATUS_FAILED(status = putFrameToWebRtcPeers(pGstKvsPlugin, &frame, pGstKvsPlugin->detectedCpdFormat))) {
+    // bits to Annex-B format for RTP. This must follow the producer as the bits might get adapted in place.
+    // NOTE: The mapping might be taken over by the peer connection senders
+    if (STATUS_FAILED(status = putFrameToWebRtcPeers(pGstKvsPlugin, &frame, buf, &info, pNalIndex))) {
         DLOGW("Failed to put frame to peer connections with 0x%08x", status);
     }
 
+    latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_WEBRTC_HANDOFF], GST_PLUGIN_MONOTONIC_TIME() - arrivalTime);
+
+    // Let the encoder adapt to the viewers and the KVS stream rather than have its frames dropped
+    if (trackId == DEFAULT_VIDEO_TRACK_ID) {
+        sendUpstreamFeedback(pGstKvsPlugin);
+    }
+
     pGstKvsPlugin->frameCount++;
 
 CleanUp:
@@ -1105,9 +1590,181 @@ CleanUp:
         gst_buffer_unref(buf);
     }
 
+    if (IS_VALID_MUTEX_VALUE(mediaLock)) {
+        MUTEX_UNLOCK(mediaLock);
+    }
+
     return ret;
 }
 
+GstStructure* createPluginStats(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS status;
+    GstStructure* pStats = gst_structure_new_empty(KVS_STATS_G_STRUCT_NAME);
+
+    // Everything is read from the counters so neither the media path nor the sessions are held up
+    if (STATUS_FAILED(status = addKinesisVideoStats(pGstKvsPlugin, pStats))) {
+        DLOGW("Failed to collect the KVS stats with 0x%08x", status);
+    }
+
+    if (STATUS_FAILED(status = addKvsSpoolStats(pGstKvsPlugin, pStats))) {
+        DLOGW("Failed to collect the KVS spool stats with 0x%08x", status);
+    }
+
+    if (STATUS_FAILED(status = addWebRtcStats(pGstKvsPlugin, pStats))) {
+        DLOGW("Failed to collect the WebRTC stats with 0x%08x", status);
+    }
+
+    return pStats;
+}
+
+VOID logLatencyHistograms(PGstKvsPlugin pGstKvsPlugin)
+{
+    static PCHAR stageNames[GST_PLUGIN_LATENCY_STAGE_COUNT] = {
+        (PCHAR) "Capture to arrival", (PCHAR) "Buffer map",        (PCHAR) "NALu index",        (PCHAR) "NALu adaptation",
+        (PCHAR) "putKinesisVideoFrame", (PCHAR) "KVS ingest",      (PCHAR) "WebRTC hand-off",   (PCHAR) "WebRTC writeFrame",
+        (PCHAR) "Pooled offer-to-answer", (PCHAR) "Cold offer-to-answer",
+    };
+    UINT32 i;
+
+    for (i = 0; i < GST_PLUGIN_LATENCY_STAGE_COUNT; i++) {
+        logLatencyHistogram(&pGstKvsPlugin->latencyHistograms[i], stageNames[i]);
+    }
+}
+
+STATUS statsMessageTimerCallback(UINT32 timerId, UINT64 currentTime, UINT64 customData)
+{
+    UNUSED_PARAM(timerId);
+    UNUSED_PARAM(currentTime);
+    STATUS retStatus = STATUS_SUCCESS;
+    PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) customData;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    gst_element_post_message(GST_ELEMENT_CAST(pGstKvsPlugin),
+                             gst_message_new_element(GST_OBJECT_CAST(pGstKvsPlugin), createPluginStats(pGstKvsPlugin)));
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID postReadyMessage(PGstKvsPlugin pGstKvsPlugin, PCHAR pComponent)
+{
+    UINT64 startupTime = (GST_PLUGIN_MONOTONIC_TIME() - pGstKvsPlugin->startupTime) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+
+    DLOGI("KVS %s is ready %" PRIu64 " ms after the start", pComponent, startupTime);
+
+    gst_element_post_message(GST_ELEMENT_CAST(pGstKvsPlugin),
+                             gst_message_new_element(GST_OBJECT_CAST(pGstKvsPlugin),
+                                                     gst_structure_new(KVS_READY_G_STRUCT_NAME, KVS_READY_COMPONENT_FIELD, G_TYPE_STRING, pComponent,
+                                                                       KVS_READY_STARTUP_TIME_FIELD, G_TYPE_UINT64, (guint64) startupTime, NULL)));
+}
+
+VOID sendUpstreamFeedback(PGstKvsPlugin pGstKvsPlugin)
+{
+    UINT64 now = GST_PLUGIN_MONOTONIC_TIME(), bitrate, kvsBitrate, lastBitrate, change;
+
+    // The key unit requests from the viewers and the ingest are coalesced over the interval
+    if (ATOMIC_LOAD_BOOL(&pGstKvsPlugin->keyUnitRequested) && now >= pGstKvsPlugin->lastKeyUnitEventTime + GST_PLUGIN_KEY_UNIT_EVENT_INTERVAL) {
+        ATOMIC_STORE_BOOL(&pGstKvsPlugin->keyUnitRequested, FALSE);
+        pGstKvsPlugin->lastKeyUnitEventTime = now;
+        pGstKvsPlugin->keyUnitEventCount++;
+
+        DLOGD("Requesting a key frame upstream");
+        pushUpstreamVideoEvent(pGstKvsPlugin,
+                               gst_structure_new(GST_FORCE_KEY_UNIT_G_STRUCT_NAME, "running-time", GST_TYPE_CLOCK_TIME, GST_CLOCK_TIME_NONE,
+                                                 "all-headers", G_TYPE_BOOLEAN, TRUE, "count", G_TYPE_UINT, pGstKvsPlugin->keyUnitEventCount, NULL));
+    }
+
+    if (now < pGstKvsPlugin->lastBitrateHintTime + GST_PLUGIN_BITRATE_HINT_PERIOD) {
+        return;
+    }
+
+    pGstKvsPlugin->lastBitrateHintTime = now;
+
+    // The lower of the slowest viewer and the KVS upload rate when under pressure
+    bitrate = getWebRtcSustainableBitrate(pGstKvsPlugin);
+    if (STATUS_SUCCEEDED(getKinesisVideoSustainableBitrate(pGstKvsPlugin, &kvsBitrate)) && kvsBitrate != 0 &&
+        (bitrate == 0 || kvsBitrate < bitrate)) {
+        bitrate = kvsBitrate;
+    }
+
+    // Only the significant changes go out so the encoder isn't retuned on every estimate
+    lastBitrate = pGstKvsPlugin->lastBitrateHint;
+    change = bitrate > lastBitrate ? bitrate - lastBitrate : lastBitrate - bitrate;
+    if (bitrate == lastBitrate || (bitrate != 0 && lastBitrate != 0 && change * 100 <= lastBitrate * GST_PLUGIN_BITRATE_HINT_THRESHOLD)) {
+        return;
+    }
+
+    pGstKvsPlugin->lastBitrateHint = bitrate;
+
+    DLOGD("Hinting the bitrate upstream: %" PRIu64 " bps", bitrate);
+    pushUpstreamVideoEvent(pGstKvsPlugin, gst_structure_new(KVS_BITRATE_HINT_G_STRUCT_NAME, KVS_BITRATE_HINT_FIELD, G_TYPE_UINT64, bitrate, NULL));
+}
+
+VOID pushUpstreamVideoEvent(PGstKvsPlugin pGstKvsPlugin, GstStructure* pStructure)
+{
+    GSList *walk, *pPads = NULL;
+    PGstKvsPluginTrackData pTrackData;
+
+    // The event goes to the encoders of the main stream video pads. The pads can be requested and released
+    // in the meantime so they are picked under the lock of the collect pads and pushed to outside of it.
+    GST_OBJECT_LOCK(pGstKvsPlugin->collect);
+    for (walk = pGstKvsPlugin->collect->data; walk != NULL; walk = g_slist_next(walk)) {
+        pTrackData = (PGstKvsPluginTrackData) walk->data;
+        if (pTrackData->trackType == MKV_TRACK_INFO_TYPE_VIDEO && pTrackData->pPadStream == NULL) {
+            pPads = g_slist_prepend(pPads, gst_object_ref(pTrackData->collect.pad));
+        }
+    }
+    GST_OBJECT_UNLOCK(pGstKvsPlugin->collect);
+
+    for (walk = pPads; walk != NULL; walk = g_slist_next(walk)) {
+        gst_pad_push_event(GST_PAD(walk->data), gst_event_new_custom(GST_EVENT_CUSTOM_UPSTREAM, gst_structure_copy(pStructure)));
+    }
+
+    g_slist_free_full(pPads, gst_object_unref);
+    gst_structure_free(pStructure);
+}
+
+GstFlowReturn gst_kvs_plugin_pad_chain(GstPad* pad, GstObject* parent, GstBuffer* buf)
+{
+    PGstKvsPlugin pGstKvsPlugin = GST_KVS_PLUGIN(parent);
+    GstCollectData* pCollectData = (GstCollectData*) gst_pad_get_element_private(pad);
+    GstBuffer* pOutBuffer = buf;
+    GstFlowReturn ret;
+
+    // Same running time conversion the collect pads would apply
+    if (!pGstKvsPlugin->gstParams.disableBufferClipping) {
+        pOutBuffer = NULL;
+        if ((ret = gst_collect_pads_clip_running_time(pGstKvsPlugin->collect, pCollectData, buf, &pOutBuffer, NULL)) != GST_FLOW_OK ||
+            pOutBuffer == NULL) {
+            return ret;
+        }
+    }
+
+    return gst_kvs_plugin_handle_buffer(pGstKvsPlugin->collect, pCollectData, pOutBuffer, pGstKvsPlugin);
+}
+
+guint getFreeVideoPadIndex(GstElement* element)
+{
+    GstPad* pad;
+    gchar* name;
+    guint index;
+
+    for (index = 0;; index++) {
+        name = g_strdup_printf("video_%u", index);
+        pad = gst_element_get_static_pad(element, name);
+        g_free(name);
+
+        if (pad == NULL) {
+            return index;
+        }
+
+        gst_object_unref(pad);
+    }
+}
+
 GstPad* gst_kvs_plugin_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* req_name, const GstCaps* caps)
 {
     GstElementClass* klass = GST_ELEMENT_GET_CLASS(element);
@@ -1119,9 +1776,14 @@ GstPad* gst_kvs_plugin_request_new_pad(GstElement* element, GstPadTemplate* temp
     MKV_TRACK_INFO_TYPE trackType = MKV_TRACK_INFO_TYPE_VIDEO;
     gboolean locked = TRUE;
     PGstKvsPluginTrackData pTrackData;
+    PKvsPadStream pPadStream = NULL;
+    GstPad* existingPad = NULL;
+    UINT32 videoIndex;
 
-    if (req_name != NULL) {
-        GST_WARNING_OBJECT(pGstKvsPlugin, "Custom pad name not supported");
+    if (req_name != NULL && NULL != (existingPad = gst_element_get_static_pad(element, req_name))) {
+        gst_object_unref(existingPad);
+        GST_ERROR_OBJECT(pGstKvsPlugin, "Pad '%s' already exists", req_name);
+        goto CleanUp;
     }
 
     // Check if the pad template is supported
@@ -1131,33 +1793,36 @@ GstPad* gst_kvs_plugin_request_new_pad(GstElement* element, GstPadTemplate* temp
             goto CleanUp;
         }
 
-        name = g_strdup_printf("audio_%u", pGstKvsPlugin->numAudioStreams++);
+        name = req_name != NULL ? g_strdup(req_name) : g_strdup("audio_0");
         padName = name;
         trackType = MKV_TRACK_INFO_TYPE_AUDIO;
 
     } else if (templ == gst_element_class_get_pad_template(klass, "video_%u")) {
-        if (pGstKvsPlugin->numVideoStreams == 1) {
-            GST_ERROR_OBJECT(pGstKvsPlugin, "Can not have more than one video stream.");
+        // The index names the pad and is kept apart from the live pad count. Index 0 is the main stream
+        // pad, so a new pad takes it over once video_0 is released.
+        if (req_name == NULL) {
+            videoIndex = getFreeVideoPadIndex(element);
+        } else if (STRNCMP(req_name, "video_", STRLEN("video_")) != 0 ||
+                   STATUS_FAILED(STRTOUI32((PCHAR) req_name + STRLEN("video_"), NULL, 10, &videoIndex))) {
+            GST_ERROR_OBJECT(pGstKvsPlugin, "Invalid video pad name '%s'", req_name);
             goto CleanUp;
         }
 
-        name = g_strdup_printf("video_%u", pGstKvsPlugin->numVideoStreams++);
+        name = g_strdup_printf("video_%u", videoIndex);
         padName = name;
         trackType = MKV_TRACK_INFO_TYPE_VIDEO;
 
+        // Video pads past the first one are put to their own streams on the same client
+        if (videoIndex > 0 && STATUS_FAILED(createKinesisVideoPadStream(pGstKvsPlugin, name, videoIndex, &pPadStream))) {
+            GST_ERROR_OBJECT(pGstKvsPlugin, "Failed to create the stream of pad '%s'", padName);
+            goto CleanUp;
+        }
+
     } else {
         GST_WARNING_OBJECT(pGstKvsPlugin, "Invalid template!");
         goto CleanUp;
     }
 
-    if (pGstKvsPlugin->numVideoStreams > 0 && pGstKvsPlugin->numAudioStreams > 0) {
-        pGstKvsPlugin->mediaType = GST_PLUGIN_MEDIA_TYPE_AUDIO_VIDEO;
-    } else if (pGstKvsPlugin->numVideoStreams > 0) {
-        pGstKvsPlugin->mediaType = GST_PLUGIN_MEDIA_TYPE_VIDEO_ONLY;
-    } else {
-        pGstKvsPlugin->mediaType = GST_PLUGIN_MEDIA_TYPE_AUDIO_ONLY;
-    }
-
     newpad = GST_PAD_CAST(g_object_new(GST_TYPE_PAD, "name", padName, "direction", templ->direction, "template", templ, NULL));
 
     pTrackData =
@@ -1166,20 +1831,47 @@ GstPad* gst_kvs_plugin_request_new_pad(GstElement* element, GstPadTemplate* temp
     pTrackData->pGstKvsPlugin = pGstKvsPlugin;
     pTrackData->trackType = trackType;
     pTrackData->trackId = DEFAULT_VIDEO_TRACK_ID;
+    pTrackData->pPadStream = pPadStream;
+
+    // Take the buffers over from the collect pads. Their events, including the segments
+    // used for clipping and the EOS of all the pads, are still handled by the collect pads.
+    if (pGstKvsPlugin->gstParams.syncMode == KVS_SYNC_MODE_NONE) {
+        gst_pad_set_chain_function(GST_PAD(newpad), GST_DEBUG_FUNCPTR(gst_kvs_plugin_pad_chain));
+    }
 
     if (!gst_element_add_pad(element, GST_PAD(newpad))) {
+        gst_collect_pads_remove_pad(pGstKvsPlugin->collect, GST_PAD(newpad));
         gst_object_unref(newpad);
         newpad = NULL;
         GST_WARNING_OBJECT(pGstKvsPlugin, "Adding the new pad '%s' failed", padName);
         goto CleanUp;
     }
 
+    // Only the live pads are counted so that the counts stay right when a request fails
+    if (trackType == MKV_TRACK_INFO_TYPE_AUDIO) {
+        pGstKvsPlugin->numAudioStreams++;
+    } else {
+        pGstKvsPlugin->numVideoStreams++;
+    }
+
+    if (pGstKvsPlugin->numVideoStreams > 0 && pGstKvsPlugin->numAudioStreams > 0) {
+        pGstKvsPlugin->mediaType = GST_PLUGIN_MEDIA_TYPE_AUDIO_VIDEO;
+    } else if (pGstKvsPlugin->numVideoStreams > 0) {
+        pGstKvsPlugin->mediaType = GST_PLUGIN_MEDIA_TYPE_VIDEO_ONLY;
+    } else {
+        pGstKvsPlugin->mediaType = GST_PLUGIN_MEDIA_TYPE_AUDIO_ONLY;
+    }
+
     pGstKvsPlugin->numStreams++;
 
     DLOGD("Added new request pad");
 
 CleanUp:
 
+    if (newpad == NULL && pPadStream != NULL) {
+        releaseKinesisVideoPadStream(pGstKvsPlugin, pPadStream);
+    }
+
     g_free(name);
     return newpad;
 }
@@ -1187,6 +1879,7 @@ CleanUp:
 VOID gst_kvs_plugin_release_pad(GstElement* element, GstPad* pad)
 {
     PGstKvsPlugin pGstKvsPlugin = GST_KVS_PLUGIN(GST_PAD_PARENT(pad));
+    PKvsPadStream pPadStream = NULL;
     GSList* walk;
 
     if (pGstKvsPlugin == NULL) {
@@ -1206,6 +1899,8 @@ VOID gst_kvs_plugin_release_pad(GstElement* element, GstPad* pad)
             } else if (trackData->trackType == MKV_TRACK_INFO_TYPE_AUDIO) {
                 pGstKvsPlugin->numAudioStreams--;
             }
+
+            pPadStream = trackData->pPadStream;
         }
     }
 
@@ -1213,6 +1908,30 @@ VOID gst_kvs_plugin_release_pad(GstElement* element, GstPad* pad)
     if (gst_element_remove_pad(element, pad)) {
         pGstKvsPlugin->numStreams--;
     }
+
+    // The pad is deactivated by now so its streaming thread is done with the stream
+    if (pPadStream != NULL) {
+        releaseKinesisVideoPadStream(pGstKvsPlugin, pPadStream);
+    }
+}
+
+VOID unwindKinesisVideoStartup(PGstKvsPlugin pGstKvsPlugin)
+{
+    // Don't leave the background startup, the timers and the ingest running for an element which didn't
+    // get to READY. The streams and the clients are released on finalize.
+    if (IS_VALID_TID_VALUE(pGstKvsPlugin->kvsStartupTid)) {
+        THREAD_JOIN(pGstKvsPlugin->kvsStartupTid, NULL);
+        pGstKvsPlugin->kvsStartupTid = INVALID_TID_VALUE;
+    }
+
+    if (IS_VALID_TID_VALUE(pGstKvsPlugin->webRtcStartupTid)) {
+        THREAD_JOIN(pGstKvsPlugin->webRtcStartupTid, NULL);
+        pGstKvsPlugin->webRtcStartupTid = INVALID_TID_VALUE;
+    }
+
+    cancelGstKvsPluginTimers(pGstKvsPlugin);
+    stopKinesisVideoIngest(pGstKvsPlugin);
+    stopKinesisVideoSpool(pGstKvsPlugin);
 }
 
 GstStateChangeReturn gst_kvs_plugin_change_state(GstElement* element, GstStateChange transition)
@@ -1229,11 +1948,6 @@ GstStateChangeReturn gst_kvs_plugin_change_state(GstElement* element, GstStateCh
                 goto CleanUp;
             }
 
-            if (STATUS_FAILED(status = initKinesisVideoProducer(pGstKvsPlugin))) {
-                DLOGE("Failed to initialize KVS producer with 0x%08x", status);
-                ret = GST_STATE_CHANGE_FAILURE;
-                goto CleanUp;
-            }
             if (STATUS_FAILED(status = initTrackData(pGstKvsPlugin))) {
                 DLOGE("Failed to initialize track with 0x%08x", status);
                 ret = GST_STATE_CHANGE_FAILURE;
@@ -1243,16 +1957,42 @@ GstStateChangeReturn gst_kvs_plugin_change_state(GstElement* element, GstStateCh
             pGstKvsPlugin->firstPts = GST_CLOCK_TIME_NONE;
             pGstKvsPlugin->producerStartTime = GST_CLOCK_TIME_NONE;
 
+            // Nothing is put until the background startup has created the stream
+            pGstKvsPlugin->startupTime = GST_PLUGIN_MONOTONIC_TIME();
+            ATOMIC_STORE(&pGstKvsPlugin->firstPutLatency, 0);
+            ATOMIC_STORE_BOOL(&pGstKvsPlugin->kvsStartupDone, FALSE);
+            ATOMIC_STORE_BOOL(&pGstKvsPlugin->kvsStreamReady, FALSE);
+            MEMSET(pGstKvsPlugin->pendingCpdSize, 0x00, SIZEOF(pGstKvsPlugin->pendingCpdSize));
+            pGstKvsPlugin->pendingNalFlagsSet = FALSE;
+
+            // Resuming an upload rebases it on the file start time of the previous run
+            if (STATUS_FAILED(status = startKinesisVideoCheckpoint(pGstKvsPlugin))) {
+                DLOGE("Failed to start KVS checkpoint with 0x%08x", status);
+                ret = GST_STATE_CHANGE_FAILURE;
+                goto CleanUp;
+            }
+
             if (STATUS_FAILED(status = initKinesisVideoStream(pGstKvsPlugin))) {
                 DLOGE("Failed to initialize KVS stream with 0x%08x", status);
                 ret = GST_STATE_CHANGE_FAILURE;
                 goto CleanUp;
             }
 
+            if (STATUS_FAILED(status = startKinesisVideoIngest(pGstKvsPlugin))) {
+                DLOGE("Failed to start KVS ingest with 0x%08x", status);
+                ret = GST_STATE_CHANGE_FAILURE;
+                goto CleanUp;
+            }
+
+            if (STATUS_FAILED(status = startKinesisVideoSpool(pGstKvsPlugin))) {
+                DLOGE("Failed to start KVS spool with 0x%08x", status);
+                ret = GST_STATE_CHANGE_FAILURE;
+                goto CleanUp;
+            }
+
             ATOMIC_STORE_BOOL(&pGstKvsPlugin->streamStopped, FALSE);
             pGstKvsPlugin->streamStatus = STATUS_SUCCESS;
             pGstKvsPlugin->lastDts = 0;
-            pGstKvsPlugin->basePts = 0;
             pGstKvsPlugin->frameCount = 0;
 
             pGstKvsPlugin->detectedCpdFormat = ELEMENTARY_STREAM_NAL_FORMAT_UNKNOWN;
@@ -1263,16 +2003,31 @@ GstStateChangeReturn gst_kvs_plugin_change_state(GstElement* element, GstStateCh
             }
 
             if (STATUS_FAILED(status = initKinesisVideoWebRtc(pGstKvsPlugin))) {
-                DLOGE("Failed to initialize KVS signaling client with 0x%08x", status);
+                DLOGE("Failed to initialize KVS WebRTC with 0x%08x", status);
+                ret = GST_STATE_CHANGE_FAILURE;
+                goto CleanUp;
+            }
+
+            // Create the streams and connect the signaling client concurrently in the background rather than
+            // holding up the state change. Readiness is posted on the bus and the failures as element errors.
+            if (STATUS_FAILED(status = THREAD_CREATE(&pGstKvsPlugin->kvsStartupTid, startKinesisVideoStreamRoutine, (PVOID) pGstKvsPlugin))) {
+                DLOGE("Failed to start the KVS stream creation with 0x%08x", status);
+                ret = GST_STATE_CHANGE_FAILURE;
+                goto CleanUp;
+            }
+
+            if (STATUS_FAILED(status = THREAD_CREATE(&pGstKvsPlugin->webRtcStartupTid, startKinesisVideoWebRtcRoutine, (PVOID) pGstKvsPlugin))) {
+                DLOGE("Failed to start the KVS signaling client with 0x%08x", status);
                 ret = GST_STATE_CHANGE_FAILURE;
                 goto CleanUp;
             }
 
-            // Schedule the WebRTC master session servicing periodic routine
-            if (STATUS_FAILED(status = timerQueueAddTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, GST_PLUGIN_SERVICE_ROUTINE_START,
-                                                          GST_PLUGIN_SERVICE_ROUTINE_PERIOD, sessionServiceHandler, (UINT64) pGstKvsPlugin,
-                                                          &pGstKvsPlugin->serviceRoutineTimerId))) {
-                DLOGE("Failed to schedule WebRTC service routine with 0x%08x", status);
+            if (pGstKvsPlugin->gstParams.statsInterval != 0 &&
+                STATUS_FAILED(status = timerQueueAddTimer(pGstKvsPlugin->kvsContext.timerQueueHandle,
+                                                          (UINT64) pGstKvsPlugin->gstParams.statsInterval * HUNDREDS_OF_NANOS_IN_A_SECOND,
+                                                          (UINT64) pGstKvsPlugin->gstParams.statsInterval * HUNDREDS_OF_NANOS_IN_A_SECOND,
+                                                          statsMessageTimerCallback, (UINT64) pGstKvsPlugin, &pGstKvsPlugin->statsTimerId))) {
+                DLOGE("Failed to schedule the stats messages with 0x%08x", status);
                 ret = GST_STATE_CHANGE_FAILURE;
                 goto CleanUp;
             }
@@ -1292,6 +2047,10 @@ GstStateChangeReturn gst_kvs_plugin_change_state(GstElement* element, GstStateCh
 
 CleanUp:
 
+    if (ret == GST_STATE_CHANGE_FAILURE && transition == GST_STATE_CHANGE_NULL_TO_READY) {
+        unwindKinesisVideoStartup(pGstKvsPlugin);
+    }
+
     if (ret != GST_STATE_CHANGE_SUCCESS) {
         GST_ELEMENT_ERROR(pGstKvsPlugin, LIBRARY, INIT, (NULL), ("Failed to initialize with 0x%08x", status));
     }
@@ -1323,6 +2082,11 @@ STATUS initTrackData(PGstKvsPlugin pGstKvsPlugin)
     for (walk = pGstKvsPlugin->collect->data; walk != NULL; walk = g_slist_next(walk)) {
         PGstKvsPluginTrackData pTrackData = (PGstKvsPluginTrackData) walk->data;
 
+        // Additional video pads don't contribute to the main stream
+        if (pTrackData->pPadStream != NULL) {
+            continue;
+        }
+
         if (pTrackData->trackType == MKV_TRACK_INFO_TYPE_VIDEO) {
             if (pGstKvsPlugin->mediaType == GST_PLUGIN_MEDIA_TYPE_AUDIO_VIDEO) {
                 pTrackData->trackId = DEFAULT_VIDEO_TRACK_ID;
@@ -1407,6 +2171,35 @@ CleanUp:
     return retStatus;
 }
 
+STATUS initKinesisVideoPadStreams(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    GSList* walk;
+    GstCaps* caps;
+
+    for (walk = pGstKvsPlugin->collect->data; walk != NULL; walk = g_slist_next(walk)) {
+        PGstKvsPluginTrackData pTrackData = (PGstKvsPluginTrackData) walk->data;
+
+        if (pTrackData->pPadStream == NULL) {
+            continue;
+        }
+
+        // Unlinked pads get their streams created with the caps event instead
+        caps = gst_pad_get_allowed_caps(pTrackData->collect.pad);
+        if (caps == NULL) {
+            continue;
+        }
+
+        retStatus = initKinesisVideoPadStream(pGstKvsPlugin, pTrackData->pPadStream, caps);
+        gst_caps_unref(caps);
+        CHK_STATUS(retStatus);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
 #define PACKAGE "kvspluginpackage"
 GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, kvsplugin, "GStreamer AWS KVS plugin", plugin_init, "1.0", "Proprietary", "GStreamer",
                   "http://gstreamer.net/")
@@ -39,8 +39,38 @@ typedef struct __GstKvsPlugin GstKvsPlugin;
 typedef struct __GstKvsPlugin* PGstKvsPlugin;
 typedef struct __WebRtcStreamingSession WebRtcStreamingSession;
 typedef struct __WebRtcStreamingSession* PWebRtcStreamingSession;
+typedef struct __WebRtcLoopbackViewer WebRtcLoopbackViewer;
+typedef struct __WebRtcLoopbackViewer* PWebRtcLoopbackViewer;
+typedef struct __WebRtcSessionList WebRtcSessionList;
+typedef struct __WebRtcSessionList* PWebRtcSessionList;
+typedef struct __GopCache GopCache;
+typedef struct __GopCache* PGopCache;
+typedef struct __KvsApiCacheEntry KvsApiCacheEntry;
+typedef struct __KvsApiCacheEntry* PKvsApiCacheEntry;
+typedef struct __KvsApiCacheStream KvsApiCacheStream;
+typedef struct __KvsApiCacheStream* PKvsApiCacheStream;
+typedef struct __KvsCheckpoint KvsCheckpoint;
+typedef struct __KvsCheckpoint* PKvsCheckpoint;
+typedef struct __KvsCheckpointEntry KvsCheckpointEntry;
+typedef struct __KvsCheckpointEntry* PKvsCheckpointEntry;
+typedef struct __KvsIngestFrame KvsIngestFrame;
+typedef struct __KvsIngestFrame* PKvsIngestFrame;
+typedef struct __KvsLoopbackUpload KvsLoopbackUpload;
+typedef struct __KvsLoopbackUpload* PKvsLoopbackUpload;
+typedef struct __KvsLoopbackAck KvsLoopbackAck;
+typedef struct __KvsLoopbackAck* PKvsLoopbackAck;
+typedef struct __KvsPadStream KvsPadStream;
+typedef struct __KvsPadStream* PKvsPadStream;
+typedef struct __KvsPreEventRing KvsPreEventRing;
+typedef struct __KvsPreEventRing* PKvsPreEventRing;
+typedef struct __KvsSharedClient KvsSharedClient;
+typedef struct __KvsSharedClient* PKvsSharedClient;
 typedef struct __PendingMessageQueue PendingMessageQueue;
 typedef struct __PendingMessageQueue* PPendingMessageQueue;
+typedef struct __SignalingWorker SignalingWorker;
+typedef struct __SignalingWorker* PSignalingWorker;
+typedef struct __SignalingWorkItem SignalingWorkItem;
+typedef struct __SignalingWorkItem* PSignalingWorkItem;
 
 #include <gst/gst.h>
 #include <gst/base/gstcollectpads.h>
@@ -48,6 +78,8 @@ typedef struct __PendingMessageQueue* PPendingMessageQueue;
 #include <com/amazonaws/kinesis/video/webrtcclient/Include.h>
 #include "GstPluginUtils.h"
 #include "KvsProducer.h"
+#include "KvsSpool.h"
+#include "GstNalIndexMeta.h"
 #include "KvsWebRtc.h"
 
 typedef enum {
@@ -92,6 +124,24 @@ typedef enum {
     PROP_WEBRTC_CONNECTION_MODE,
     PROP_ENABLE_STREAMING,
     PROP_WEBRTC_CONNECT,
+    PROP_MAX_VIEWERS,
+    PROP_INGEST_QUEUE_SIZE,
+    PROP_INGEST_DROP_POLICY,
+    PROP_PAD_STREAM_NAMES,
+    PROP_STATS,
+    PROP_STATS_INTERVAL,
+    PROP_SYNC_MODE,
+    PROP_LOOPBACK,
+    PROP_LOOPBACK_ACK_DELAY,
+    PROP_LOOPBACK_BANDWIDTH,
+    PROP_WEBRTC_LOOPBACK_VIEWERS,
+    PROP_WEBRTC_LOOPBACK_EARLY_CANDIDATES,
+    PROP_SPOOL_PATH,
+    PROP_SPOOL_SIZE,
+    PROP_SPOOL_CATCHUP_RATE,
+    PROP_CHECKPOINT_PATH,
+    PROP_PRE_EVENT_DURATION,
+    PROP_API_CACHE_PATH,
 } KVS_GST_PLUGIN_PROPS;
 
 #define KVS_ADD_METADATA_G_STRUCT_NAME "kvs-add-metadata"
@@ -105,6 +155,60 @@ typedef enum {
 #define KVS_CONNECT_WEBRTC_G_STRUCT_NAME "kvs-connect-webrtc"
 #define KVS_CONNECT_WEBRTC_FIELD         "connect"
 
+// Upstream events for the encoder. The bitrate hint carries the minimum rate the KVS stream and
+// the viewers can sustain in bits per second, 0 once it's unconstrained again.
+#define KVS_BITRATE_HINT_G_STRUCT_NAME   "kvs-bitrate-hint"
+#define KVS_BITRATE_HINT_FIELD           "bitrate"
+#define GST_FORCE_KEY_UNIT_G_STRUCT_NAME "GstForceKeyUnit"
+
+// Runtime statistics returned by the stats property and posted as element messages
+#define KVS_STATS_G_STRUCT_NAME        "kvs-stats"
+#define DEFAULT_STATS_INTERVAL_SECONDS 0
+
+// Logs the latency histograms on request
+#define KVS_DUMP_LATENCY_G_STRUCT_NAME "kvs-dump-latency"
+
+// Element message posted once the KVS stream or the signaling client set up in the background is ready.
+// The startup time since NULL_TO_READY is in milliseconds.
+#define KVS_READY_G_STRUCT_NAME       "kvs-ready"
+#define KVS_READY_COMPONENT_FIELD     "component"
+#define KVS_READY_STARTUP_TIME_FIELD  "startup-time"
+#define KVS_READY_COMPONENT_STREAM    "stream"
+#define KVS_READY_COMPONENT_SIGNALING "signaling"
+
+/**
+ * Stages of the media and signaling paths with a latency histogram each
+ */
+typedef enum {
+    // Pipeline clock running time at the arrival less the buffer running time
+    GST_PLUGIN_LATENCY_STAGE_CAPTURE,
+    // gst_buffer_map of the incoming buffer
+    GST_PLUGIN_LATENCY_STAGE_BUFFER_MAP,
+    // NALu indexing of the video frame
+    GST_PLUGIN_LATENCY_STAGE_NAL_INDEX,
+    // AvCC/HEVC to Annex-B adaptation for WebRTC
+    GST_PLUGIN_LATENCY_STAGE_NAL_ADAPT,
+    // putKinesisVideoFrame call
+    GST_PLUGIN_LATENCY_STAGE_KVS_PUT,
+    // Buffer arrival to the return of putKinesisVideoFrame including the ingest queue
+    GST_PLUGIN_LATENCY_STAGE_KVS_INGEST,
+    // Buffer arrival to the frame handed off to all of the sessions
+    GST_PLUGIN_LATENCY_STAGE_WEBRTC_HANDOFF,
+    // writeFrame calls of a frame on a session sender
+    GST_PLUGIN_LATENCY_STAGE_WEBRTC_WRITE,
+    // Offer to answer with a prepared session and one created on the offer
+    GST_PLUGIN_LATENCY_STAGE_POOLED_ANSWER,
+    GST_PLUGIN_LATENCY_STAGE_COLD_ANSWER,
+    GST_PLUGIN_LATENCY_STAGE_COUNT,
+} GST_PLUGIN_LATENCY_STAGE;
+
+// Minimum time between the force key unit events. The requests in between are coalesced.
+#define GST_PLUGIN_KEY_UNIT_EVENT_INTERVAL (1 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+
+// Period of the sustainable bitrate checks and the change in percent which triggers a new hint
+#define GST_PLUGIN_BITRATE_HINT_PERIOD    (1 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define GST_PLUGIN_BITRATE_HINT_THRESHOLD 10
+
 #define GSTREAMER_MEDIA_TYPE_H265  "video/x-h265"
 #define GSTREAMER_MEDIA_TYPE_H264  "video/x-h264"
 #define GSTREAMER_MEDIA_TYPE_AAC   "audio/mpeg"
@@ -154,10 +258,148 @@ typedef enum {
     WEBRTC_CONNECTION_MODE_P2P_ONLY
 } WEBRTC_CONNECTION_MODE;
 
+typedef enum {
+    KVS_INGEST_DROP_POLICY_DROP,
+    KVS_INGEST_DROP_POLICY_BLOCK
+} KVS_INGEST_DROP_POLICY;
+
+typedef enum {
+    // The collect pads hand over the buffers of all the pads in timestamp order
+    KVS_SYNC_MODE_COLLECT,
+    // Each pad is chained straight into the buffer handler as its buffers arrive
+    KVS_SYNC_MODE_NONE
+} KVS_SYNC_MODE;
+
 typedef STATUS (*freeCredentialProviderFunc)(PAwsCredentialProvider*);
 
+/**
+ * Producer client shared by the elements of the process which use the same region, credentials
+ * and endpoint. The elements share its threads, API call cache, timer queue and content store.
+ */
+struct __KvsSharedClient {
+    PKvsSharedClient pNext;
+    UINT32 refCount;
+    gchar* key;
+    // Set while the client is being created outside of the list lock along with the result once it's done
+    BOOL creating;
+    STATUS createStatus;
+    PDeviceInfo pDeviceInfo;
+    PAwsCredentialProvider pCredentialProvider;
+    freeCredentialProviderFunc freeCredentialProviderFn;
+    PClientCallbacks pClientCallbacks;
+    CLIENT_HANDLE clientHandle;
+    TIMER_QUEUE_HANDLE timerQueueHandle;
+
+    // Producer API callbacks of the provider wrapped by the file backed API call cache. The entries of the
+    // client are told apart from the other accounts and regions by the checksum of the client key.
+    gchar* region;
+    gchar* apiCachePath;
+    UINT32 apiCacheIdentity;
+    DescribeStreamFunc describeStreamFn;
+    GetStreamingEndpointFunc getStreamingEndpointFn;
+    PutStreamFunc putStreamFn;
+    TagResourceFunc tagResourceFn;
+    // KvsApiCacheStream of the streams on the client keyed by the stream name CRC32. Protected by the API cache lock.
+    PHashTable pApiCacheStreams;
+
+    // In-process stand-ins for the service calls. The loopback clients are never shared with the regular ones.
+    BOOL loopback;
+    UINT64 loopbackAckDelay;
+    UINT32 loopbackBandwidthBps;
+    StreamShutdownFunc streamShutdownFn;
+    volatile SIZE_T loopbackUploadHandle;
+    // PutMedia sessions of the streams on the client protected by the loopback lock
+    MUTEX loopbackLock;
+    PKvsLoopbackUpload pLoopbackUploads;
+
+    // Persisted fragment acks of the streams on the client are routed to their checkpoints
+    StreamCallbacks checkpointStreamCallbacks;
+    // Checkpoints of the offline uploads on the client protected by the checkpoint lock
+    MUTEX checkpointLock;
+    PKvsCheckpoint pCheckpoints;
+    // GST_PLUGIN_SIGNALING_WORKER_COUNT workers handling the signaling messages of the elements on the client.
+    // Started by the first element to initialize WebRTC. Protected by the signaling worker lock.
+    MUTEX signalingWorkerLock;
+    PSignalingWorker pSignalingWorkers;
+};
+
+/**
+ * PutMedia session of the loopback mode. Consumes the stream data of the upload handle on its own thread
+ * and acks the fragments as they complete.
+ */
+struct __KvsLoopbackUpload {
+    PKvsLoopbackUpload pNext;
+    PKvsSharedClient pSharedClient;
+    STREAM_HANDLE streamHandle;
+    UPLOAD_HANDLE uploadHandle;
+    TID tid;
+    volatile ATOMIC_BOOL terminate;
+    volatile ATOMIC_BOOL done;
+};
+
+struct __KvsLoopbackAck {
+    UINT64 timecode;
+    UINT64 dueTime;
+};
+
+/**
+ * Entry of the file backed API call cache. Stored as a line of comma separated fields with the stream ARN last.
+ * The ARN is only known to the runs which have tagged the stream and is empty otherwise.
+ */
+struct __KvsApiCacheEntry {
+    UINT32 identity;
+    CHAR streamName[MAX_STREAM_NAME_LEN + 1];
+    CHAR region[MAX_REGION_NAME_LEN + 1];
+    CHAR endpoint[MAX_URI_CHAR_LEN + 1];
+    UINT64 creationTime;
+    CHAR streamArn[MAX_ARN_LEN + 1];
+};
+
+/**
+ * API call cache state of a stream on the client
+ */
+struct __KvsApiCacheStream {
+    // KVS_API_CACHE_STREAM_STATE or 0 until the stream is described
+    UINT64 state;
+    // The cached results are only good for the tagged streams along with their ARN
+    BOOL tagged;
+    CHAR streamArn[MAX_ARN_LEN + 1];
+};
+
+/**
+ * Entry of the offline upload checkpoint file. Stored as a line of comma separated fields with the source URI last.
+ */
+struct __KvsCheckpointEntry {
+    CHAR streamName[MAX_STREAM_NAME_LEN + 1];
+    UINT64 fileStartTime;
+    UINT64 persistedTimecode;
+    // Points into the parsed line
+    PCHAR sourceUri;
+};
+
+/**
+ * Progress of an offline upload. The timestamp of the last persisted fragment is written to the checkpoint file
+ * as the acks come in so a restarted upload of the same source skips what the stream already has.
+ */
+struct __KvsCheckpoint {
+    PKvsCheckpoint pNext;
+    STREAM_HANDLE streamHandle;
+    CHAR streamName[MAX_STREAM_NAME_LEN + 1];
+    gchar* path;
+    gchar* sourceUri;
+    // File start time in seconds the timestamps of the upload are based on
+    UINT64 fileStartTime;
+    // Timecode of the last persisted fragment in the stream timecode scale. Protected by the checkpoint lock of the shared client.
+    UINT64 persistedTimecode;
+    // Timecode last written to the file and the monotonic time it was written at. Protected by the same lock.
+    UINT64 writtenTimecode;
+    UINT64 lastWriteTime;
+};
+
 typedef struct __KvsContext KvsContext;
 struct __KvsContext {
+    // The device info, credential provider, callbacks, client and timer queue are owned by the shared client
+    PKvsSharedClient pSharedClient;
     PDeviceInfo pDeviceInfo;
     PStreamInfo pStreamInfo;
     PAwsCredentialProvider pCredentialProvider;
@@ -210,6 +452,7 @@ struct __GstParams {
     gchar* credentialFilePath;
     GstStructure* iotCertificate;
     GstStructure* streamTags;
+    GstStructure* padStreamNames;
     guint64 fileStartTime;
     guint streamCreateTimeoutInSeconds;
     guint streamStopTimeoutInSeconds;
@@ -219,13 +462,60 @@ struct __GstParams {
     WEBRTC_CONNECTION_MODE connectionMode;
     gboolean enableStreaming;
     gboolean webRtcConnect;
+    guint maxViewers;
+    guint ingestQueueSize;
+    KVS_INGEST_DROP_POLICY ingestDropPolicy;
+    guint statsInterval;
+    KVS_SYNC_MODE syncMode;
+    gboolean loopback;
+    guint loopbackAckDelay;
+    guint loopbackBandwidth;
+    guint webRtcLoopbackViewers;
+    guint webRtcLoopbackEarlyCandidates;
+    gchar* spoolPath;
+    guint spoolSize;
+    guint spoolCatchupRate;
+    gchar* checkpointPath;
+    guint preEventDurationInSeconds;
+    gchar* apiCachePath;
 };
 typedef struct __GstParams* PGstParams;
 
 struct __PendingMessageQueue {
     UINT64 hashValue;
     UINT64 createTime;
+
+    // Candidate strings in the order of arrival
     PStackQueue messageQueue;
+
+    // Links of the expiry wheel slot
+    PPendingMessageQueue pPrev;
+    PPendingMessageQueue pNext;
+};
+
+/**
+ * Thread handling the signaling messages of the peers hashed to it. The workers belong to the shared client
+ * and serve all of its elements.
+ */
+struct __SignalingWorker {
+    TID tid;
+    MUTEX lock;
+    CVAR cvar;
+    volatile ATOMIC_BOOL terminate;
+
+    // PSignalingWorkItem in the order of arrival. Protected by the worker lock.
+    PStackQueue pMessageQueue;
+
+    // Element of the message being handled, waited out by the element when it stops. Protected by the worker lock.
+    PGstKvsPlugin pActiveGstKvsPlugin;
+};
+
+/**
+ * Copy of a received message queued to a worker along with the element it was received by
+ */
+struct __SignalingWorkItem {
+    PGstKvsPlugin pGstKvsPlugin;
+    ReceivedSignalingMessage receivedSignalingMessage;
 };
 
 typedef struct __RtcMetricsHistory RtcMetricsHistory;
@@ -257,10 +547,52 @@ struct __WebRtcStreamingSession {
     TID receiveAudioVideoSenderTid;
     UINT64 offerReceiveTime;
     UINT64 startUpLatency;
+
+    // Sessions are prepared ahead of the offer and handed out from the pool when possible
+    UINT64 prepareTime;
+    BOOL pooled;
+
+    // Set until the first frame is produced to the connected peer. Accessed on the streaming thread only.
     BOOL firstFrame;
     RtcMetricsHistory rtcMetricsHistory;
     BOOL remoteCanTrickleIce;
 
+    // Frames are handed off by the streaming thread and written out by the per-session sender
+    PSpscRing pFrameRing;
+    TID frameSenderTid;
+    MUTEX frameSenderLock;
+    CVAR frameSenderCvar;
+    volatile ATOMIC_BOOL awaitingKeyFrame;
+    volatile SIZE_T droppedFrameCount;
+
+    // Send budget of the viewer in bps derived from the video bandwidth estimate and the send discards
+    volatile SIZE_T bandwidthEstimate;
+    volatile SIZE_T sendBudgetScale;
+    volatile SIZE_T sendBudgetRate;
+    volatile SIZE_T thinnedFrameCount;
+    // Token bucket in bytes. Accessed on the streaming thread only.
+    INT64 sendTokens;
+    UINT64 sendTokensTime;
+
+    // RTP stats of the selected candidate pair published by the stats timer. Bitrates in bps and the round trip in 100ns.
+    volatile SIZE_T outgoingBitrate;
+    volatile SIZE_T incomingBitrate;
+    volatile SIZE_T roundTripTime;
+    volatile SIZE_T packetsDiscardedOnSend;
+
+    // writeFrame cost of the viewer recorded by the sender. The CPU time is of the sender thread in 100ns.
+    LatencyHistogram writeLatency;
+    volatile SIZE_T writtenFrameCount;
+    volatile SIZE_T writeCpuTime;
+
+    // Local ICE candidates are sent out by the per-session sender so the ICE agent is never blocked on the signaling channel
+    PStackQueue pLocalCandidates;
+    TID candidateSenderTid;
+    MUTEX candidateSenderLock;
+    CVAR candidateSenderCvar;
+    // Set on the ICE agent thread when the first local candidate is gathered
+    UINT64 firstCandidateTime;
+
     // this is called when the WebRtcStreamingSession is being freed
     StreamSessionShutdownCallback shutdownCallback;
     UINT64 shutdownCallbackCustomData;
@@ -269,6 +601,88 @@ struct __WebRtcStreamingSession {
     PGstKvsPlugin pGstKvsPlugin;
 };
 
+/**
+ * Viewer peer connection of the WebRTC loopback mode. Signaled with the master sessions in the
+ * process in place of the signaling channel and connected over the host candidates.
+ */
+struct __WebRtcLoopbackViewer {
+    PGstKvsPlugin pGstKvsPlugin;
+    CHAR peerId[MAX_SIGNALING_CLIENT_ID_LEN + 1];
+    PRtcPeerConnection pPeerConnection;
+    PRtcRtpTransceiver pVideoRtcRtpTransceiver;
+    PRtcRtpTransceiver pAudioRtcRtpTransceiver;
+    volatile SIZE_T receivedFrameCount;
+    volatile SIZE_T receivedByteCount;
+};
+
+/**
+ * Immutable snapshot of the active streaming sessions. Modifications publish a new copy
+ * and the old one is reclaimed once the readers of the previous epoch are done with it.
+ */
+struct __WebRtcSessionList {
+    UINT32 count;
+    PWebRtcStreamingSession* sessions;
+};
+
+/**
+ * Frame queued for the KVS ingest thread. References the buffer rather than copying the bits.
+ */
+struct __KvsIngestFrame {
+    GstBuffer* pBuffer;
+    Frame frame;
+    // Monotonic time of the buffer arrival at the sink
+    UINT64 arrivalTime;
+};
+
+/**
+ * Frames held while the streaming is disabled so the stream gets the lead-up to the event enabling it.
+ * Starts at a key frame and covers the pre-event duration before the newest frame. Accessed on the streaming thread only.
+ */
+struct __KvsPreEventRing {
+    UINT32 head;
+    UINT32 count;
+    UINT64 size;
+    // The ingest queue blocks rather than drops while the ring is flushed into it
+    BOOL flushing;
+    PKvsIngestFrame frames[KVS_PRE_EVENT_MAX_FRAMES];
+};
+
+/**
+ * KVS stream fed by an additional video pad. Created on the client of the element
+ * so the pads share its threads, credentials and content store.
+ */
+struct __KvsPadStream {
+    // Next pad stream of the element
+    PKvsPadStream pNext;
+    gchar* padName;
+    guint padIndex;
+    PStreamInfo pStreamInfo;
+    STREAM_HANDLE streamHandle;
+
+    // Serializes the buffers of the pad with the EOS of the element in place of the media lock
+    MUTEX lock;
+
+    // Accessed on the streaming thread of the pad only
+    BOOL streamStopped;
+    BOOL cpdReceived;
+    UINT64 firstPts;
+    UINT64 lastDts;
+    UINT64 producerStartTime;
+    UINT32 frameCount;
+};
+
+/**
+ * Video frames from the last key frame onward. Replayed to the newly connected peers so
+ * they can start decoding without waiting for the next key frame. Accessed on the streaming thread only.
+ */
+struct __GopCache {
+    // Whether the cache holds the current GoP from its key frame
+    BOOL valid;
+    UINT32 frameCount;
+    UINT64 size;
+    PSharedFrame frames[GST_PLUGIN_GOP_CACHE_MAX_FRAMES];
+};
+
 struct __GstKvsPlugin {
     // NOTE: GstElement has to be the first member of the structure
     GstElement element;
@@ -277,6 +691,27 @@ struct __GstKvsPlugin {
     // Used to store GST params
     GstParams gstParams;
 
+    // Serializes the buffer handler across the main stream pads when the collect pads are bypassed. They share the
+    // timestamps, the NAL index and the single producer ingest queue. The additional video pads take their own lock.
+    MUTEX mediaLock;
+
+    // The KVS streams and the signaling client are set up in the background from NULL_TO_READY. The frames
+    // arriving in the meantime wait in the ingest queue and the CPD is applied once the stream is created.
+    TID kvsStartupTid;
+    TID webRtcStartupTid;
+    MUTEX startupLock;
+    CVAR startupCvar;
+    volatile ATOMIC_BOOL kvsStartupDone;
+    volatile ATOMIC_BOOL kvsStreamReady;
+    // CPD of the main stream tracks received ahead of the stream indexed by the track id - 1. Protected by the startup lock.
+    BYTE pendingCpd[DEFAULT_AUDIO_TRACK_ID][GST_PLUGIN_MAX_CPD_SIZE];
+    UINT32 pendingCpdSize[DEFAULT_AUDIO_TRACK_ID];
+    UINT32 pendingNalFlags;
+    BOOL pendingNalFlagsSet;
+    // Monotonic time of NULL_TO_READY and the time from it to the first frame put in 100ns
+    UINT64 startupTime;
+    volatile SIZE_T firstPutLatency;
+
     // KVS related context
     KvsContext kvsContext;
 
@@ -295,16 +730,38 @@ struct __GstKvsPlugin {
     PCHAR pRegion;
 
     MUTEX sessionLock;
-    MUTEX sessionListReadLock;
     MUTEX signalingLock;
-    PStackQueue pPendingSignalingMessageForRemoteClient;
+    // Early ICE candidates of the peers without a session yet keyed by the peer id CRC32. Each entry is
+    // also linked into the expiry wheel slot of its creation time. Protected by the session lock.
+    PHashTable pPendingSignalingMessageForRemoteClient;
+    PPendingMessageQueue pendingMessageWheel[GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE];
+    UINT64 pendingMessageWheelTick;
+    // Size of the pending store for the stats
+    volatile SIZE_T pendingPeerCount;
+    volatile SIZE_T pendingCandidateCount;
+    volatile SIZE_T droppedPendingCandidateCount;
     PHashTable pRtcPeerConnectionForRemoteClient;
 
-    PWebRtcStreamingSession streamingSessionList[DEFAULT_MAX_CONCURRENT_WEBRTC_STREAMING_SESSION];
-    UINT32 streamingSessionCount;
+    // Offers are answered in parallel by the workers. The sessions being set up outside of the
+    // session lock are counted towards the max viewers. Protected by the session lock.
+    // Workers of the shared client. Set from the WebRTC init until the element stops its signaling.
+    PSignalingWorker pSignalingWorkers;
+    UINT32 offersInProgress;
+
+    // Current PWebRtcSessionList. Updated under the session lock, read without locking on the media path
+    volatile SIZE_T streamingSessionList;
+    volatile SIZE_T sessionListEpoch;
+    volatile SIZE_T sessionListReaders[2];
 
     UINT32 iceUriCount;
 
+    // TURN servers of all the ICE server configurations of the channel, cached for the sessions.
+    // Refreshed ahead of the expiration by the timer. Protected by the session lock.
+    PRtcIceServer pIceServers;
+    UINT32 iceServerCount;
+    UINT64 iceConfigExpiration;
+    UINT32 iceConfigRefreshTimerId;
+
     UINT32 iceCandidatePairStatsTimerId;
 
     RtcOnDataChannel onDataChannel;
@@ -313,13 +770,81 @@ struct __GstKvsPlugin {
     UINT32 serviceRoutineTimerId;
     PStackQueue pregeneratedCertificates; // Max MAX_RTCCONFIGURATION_CERTIFICATES certificates
 
+    // Sessions with the peer connection and transceivers set up, waiting for an offer. Protected by the session lock.
+    PStackQueue pPreparedSessions;
+
+    // Does the blocking session work off the timer thread shared by the elements of the client.
+    // The timers only flag the work and signal the worker.
+    TID sessionWorkerTid;
+    MUTEX sessionWorkerLock;
+    CVAR sessionWorkerCvar;
+    volatile ATOMIC_BOOL sessionWorkerTerminate;
+    volatile ATOMIC_BOOL poolRefillRequested;
+    volatile ATOMIC_BOOL iceConfigRefreshRequested;
+    // Time from the first local candidate to the connected state in milliseconds summed over the sessions
+    volatile SIZE_T iceConnectCount;
+    volatile SIZE_T iceConnectTotalTime;
+
+    // In-process viewers of the loopback mode. Created by the WebRTC startup thread and freed with the sessions.
+    PWebRtcLoopbackViewer pLoopbackViewers;
+    UINT32 loopbackViewerCount;
+
     RtcStats rtcIceCandidatePairMetrics;
 
     UINT32 frameCount;
     GST_PLUGIN_MEDIA_TYPE mediaType;
 
-    PBYTE pAdaptedFrameBuf;
-    UINT32 adaptedFrameBufSize;
+    GopCache gopCache;
+
+    // Set by the viewers and the ingest when they need a key frame. Sent upstream as a force key
+    // unit event at most once per interval. The rest is accessed on the streaming thread only.
+    volatile ATOMIC_BOOL keyUnitRequested;
+    UINT64 lastKeyUnitEventTime;
+    UINT32 keyUnitEventCount;
+    UINT64 lastBitrateHintTime;
+    UINT64 lastBitrateHint;
+
+    // Frames are put to the KVS stream by the ingest thread so the content store backpressure
+    // doesn't hold up the WebRTC peers
+    PSpscRing pIngestRing;
+    TID ingestTid;
+    MUTEX ingestLock;
+    CVAR ingestCvar;
+    volatile ATOMIC_BOOL ingestTerminate;
+    volatile SIZE_T ingestPendingCount;
+    volatile SIZE_T ingestDroppedFrameCount;
+    // Accessed on the streaming thread only
+    BOOL ingestAwaitingKeyFrame;
+
+    // Lead-up to the enabling of the streaming. Empty unless the pre-event duration is set.
+    KvsPreEventRing preEventRing;
+
+    // On-disk spill tier of the stream. NULL unless the spool path is set.
+    PKvsSpool pSpool;
+
+    // Checkpoint of the offline upload. NULL unless the checkpoint path is set.
+    PKvsCheckpoint pCheckpoint;
+    // Frames up to the fragment the previous run has persisted last are dropped. Accessed on the streaming thread only.
+    UINT64 resumeTimecode;
+    UINT64 resumeSkippedFrameCount;
+
+    // Always on latency histograms of the stages. Recorded into from any thread.
+    LatencyHistogram latencyHistograms[GST_PLUGIN_LATENCY_STAGE_COUNT];
+
+    // NALu index of the last video frame which couldn't be attached to the buffer
+    NalIndex nalIndex;
+
+    // Frames produced to the WebRTC peers and the bits copied while doing so
+    volatile SIZE_T webRtcFrameCount;
+    volatile SIZE_T webRtcCopiedBytes;
+
+    // Frames and bytes of the main stream tracks indexed by the track id - 1
+    volatile SIZE_T trackFrameCount[DEFAULT_AUDIO_TRACK_ID];
+    volatile SIZE_T trackByteCount[DEFAULT_AUDIO_TRACK_ID];
+    UINT32 statsTimerId;
+
+    // Set once the timers are cancelled on teardown so that no new ones are added
+    BOOL timersCancelled;
 
     UINT64 lastDts;
     UINT64 basePts;
@@ -331,6 +856,9 @@ struct __GstKvsPlugin {
     guint numAudioStreams;
     guint numVideoStreams;
 
+    // Streams of the video pads past the first one
+    PKvsPadStream pPadStreams;
+
     STATUS streamStatus;
 
     ELEMENTARY_STREAM_NAL_FORMAT detectedCpdFormat;
@@ -346,6 +874,9 @@ struct __GstKvsPluginTrackData {
     MKV_TRACK_INFO_TYPE trackType;
     guint trackId;
     PGstKvsPlugin pGstKvsPlugin;
+
+    // Stream of an additional video pad. NULL for the pads of the main stream
+    PKvsPadStream pPadStream;
 };
 typedef struct __GstKvsPluginTrackData* PGstKvsPluginTrackData;
 
@@ -367,9 +898,24 @@ GstStateChangeReturn gst_kvs_plugin_change_state(GstElement*, GstStateChange);
 
 /* collect pad callback */
 GstFlowReturn gst_kvs_plugin_handle_buffer(GstCollectPads*, GstCollectData*, GstBuffer*, gpointer);
+GstFlowReturn gst_kvs_plugin_pad_chain(GstPad*, GstObject*, GstBuffer*);
 gboolean gst_kvs_plugin_handle_plugin_event(GstCollectPads*, GstCollectData*, GstEvent*, gpointer);
 
+/* runtime statistics */
+GstStructure* createPluginStats(PGstKvsPlugin);
+VOID logLatencyHistograms(PGstKvsPlugin);
+STATUS statsMessageTimerCallback(UINT32, UINT64, UINT64);
+
+/* background startup */
+VOID postReadyMessage(PGstKvsPlugin, PCHAR);
+VOID unwindKinesisVideoStartup(PGstKvsPlugin);
+
+/* upstream encoder feedback */
+VOID sendUpstreamFeedback(PGstKvsPlugin);
+VOID pushUpstreamVideoEvent(PGstKvsPlugin, GstStructure*);
+
 /* Request pad callback */
+guint getFreeVideoPadIndex(GstElement*);
 GstPad* gst_kvs_plugin_request_new_pad(GstElement*, GstPadTemplate*, const gchar*, const GstCaps*);
 VOID gst_kvs_plugin_release_pad(GstElement*, GstPad*);
 
@@ -87,3 +87,321 @@ CleanUp:
 
     return retStatus;
 }
+
+STATUS createSpscRing(UINT32 capacity, PSpscRing* ppSpscRing)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PSpscRing pSpscRing = NULL;
+    UINT32 roundedCapacity = 1;
+
+    CHK(ppSpscRing != NULL, STATUS_NULL_ARG);
+    CHK(capacity != 0 && capacity <= (MAX_UINT32 >> 1) + 1, STATUS_INVALID_ARG);
+
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+
+    CHK(NULL != (pSpscRing = (PSpscRing) MEMCALLOC(1, SIZEOF(SpscRing) + roundedCapacity * SIZEOF(UINT64))), STATUS_NOT_ENOUGH_MEMORY);
+    pSpscRing->capacity = roundedCapacity;
+    pSpscRing->mask = roundedCapacity - 1;
+    pSpscRing->items = (PUINT64) (pSpscRing + 1);
+    ATOMIC_STORE(&pSpscRing->head, 0);
+    ATOMIC_STORE(&pSpscRing->tail, 0);
+
+CleanUp:
+
+    if (ppSpscRing != NULL) {
+        *ppSpscRing = pSpscRing;
+    }
+
+    return retStatus;
+}
+
+STATUS freeSpscRing(PSpscRing* ppSpscRing)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(ppSpscRing != NULL, STATUS_NULL_ARG);
+
+    // The items are owned by the caller which needs to drain the ring first
+    SAFE_MEMFREE(*ppSpscRing);
+
+CleanUp:
+
+    return retStatus;
+}
+
+BOOL spscRingTryEnqueue(PSpscRing pSpscRing, UINT64 item)
+{
+    SIZE_T tail = ATOMIC_LOAD(&pSpscRing->tail);
+
+    if (tail - ATOMIC_LOAD(&pSpscRing->head) >= pSpscRing->capacity) {
+        return FALSE;
+    }
+
+    pSpscRing->items[tail & pSpscRing->mask] = item;
+
+    // Publish the item only after it has been written
+    ATOMIC_STORE(&pSpscRing->tail, tail + 1);
+
+    return TRUE;
+}
+
+BOOL spscRingTryDequeue(PSpscRing pSpscRing, PUINT64 pItem)
+{
+    SIZE_T head = ATOMIC_LOAD(&pSpscRing->head);
+
+    if (head == ATOMIC_LOAD(&pSpscRing->tail)) {
+        return FALSE;
+    }
+
+    *pItem = pSpscRing->items[head & pSpscRing->mask];
+
+    // Release the slot back to the producer only after the item has been read
+    ATOMIC_STORE(&pSpscRing->head, head + 1);
+
+    return TRUE;
+}
+
+UINT32 spscRingGetCount(PSpscRing pSpscRing)
+{
+    return (UINT32) (ATOMIC_LOAD(&pSpscRing->tail) - ATOMIC_LOAD(&pSpscRing->head));
+}
+
+STATUS createSharedFrame(PFrame pFrame, BOOL copyBits, PSharedFrame* ppSharedFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PSharedFrame pSharedFrame = NULL;
+
+    CHK(pFrame != NULL && ppSharedFrame != NULL, STATUS_NULL_ARG);
+
+    CHK(NULL != (pSharedFrame = (PSharedFrame) MEMCALLOC(1, SIZEOF(SharedFrame) + pFrame->size)), STATUS_NOT_ENOUGH_MEMORY);
+    ATOMIC_STORE(&pSharedFrame->refCount, 1);
+    pSharedFrame->frame = *pFrame;
+    pSharedFrame->frame.frameData = (PBYTE) (pSharedFrame + 1);
+
+    // The caller might choose to fill in the bits itself
+    if (copyBits) {
+        MEMCPY(pSharedFrame->frame.frameData, pFrame->frameData, pFrame->size);
+    }
+
+CleanUp:
+
+    if (ppSharedFrame != NULL) {
+        *ppSharedFrame = pSharedFrame;
+    }
+
+    return retStatus;
+}
+
+STATUS createSharedFrameFromBuffer(PFrame pFrame, GstBuffer* pBuffer, GstMapInfo* pMapInfo, PSharedFrame* ppSharedFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PSharedFrame pSharedFrame = NULL;
+
+    CHK(pFrame != NULL && pBuffer != NULL && pMapInfo != NULL && ppSharedFrame != NULL, STATUS_NULL_ARG);
+    CHK(pMapInfo->data != NULL, STATUS_INVALID_ARG);
+
+    CHK(NULL != (pSharedFrame = (PSharedFrame) MEMCALLOC(1, SIZEOF(SharedFrame))), STATUS_NOT_ENOUGH_MEMORY);
+    ATOMIC_STORE(&pSharedFrame->refCount, 1);
+    pSharedFrame->frame = *pFrame;
+
+    // Take a reference to the buffer and take over the mapping from the caller.
+    // The buffer is unmapped when the last reference to the shared frame is released.
+    pSharedFrame->pBuffer = gst_buffer_ref(pBuffer);
+    pSharedFrame->mapInfo = *pMapInfo;
+    pMapInfo->data = NULL;
+
+CleanUp:
+
+    if (ppSharedFrame != NULL) {
+        *ppSharedFrame = pSharedFrame;
+    }
+
+    return retStatus;
+}
+
+STATUS createSharedFrameAlias(PSharedFrame pParent, PSharedFrame* ppSharedFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PSharedFrame pSharedFrame = NULL;
+
+    CHK(pParent != NULL && ppSharedFrame != NULL, STATUS_NULL_ARG);
+
+    CHK(NULL != (pSharedFrame = (PSharedFrame) MEMCALLOC(1, SIZEOF(SharedFrame))), STATUS_NOT_ENOUGH_MEMORY);
+    ATOMIC_STORE(&pSharedFrame->refCount, 1);
+
+    // The alias gets its own copy of the frame info which can be modified while the bits stay with the parent
+    pSharedFrame->frame = pParent->frame;
+    pSharedFrame->pCpd = pParent->pCpd;
+    pSharedFrame->cpdSize = pParent->cpdSize;
+    pSharedFrame->disposable = pParent->disposable;
+    pSharedFrame->pParent = sharedFrameAddRef(pParent);
+
+CleanUp:
+
+    if (ppSharedFrame != NULL) {
+        *ppSharedFrame = pSharedFrame;
+    }
+
+    return retStatus;
+}
+
+BOOL isGstBufferWritableInPlace(GstBuffer* pBuffer)
+{
+    // Mapping a buffer spanning multiple or shared memories for write would make a copy
+    return pBuffer != NULL && gst_buffer_is_writable(pBuffer) && gst_buffer_n_memory(pBuffer) == 1 &&
+        gst_memory_is_writable(gst_buffer_peek_memory(pBuffer, 0));
+}
+
+PSharedFrame sharedFrameAddRef(PSharedFrame pSharedFrame)
+{
+    if (pSharedFrame != NULL) {
+        ATOMIC_INCREMENT(&pSharedFrame->refCount);
+    }
+
+    return pSharedFrame;
+}
+
+VOID sharedFrameRelease(PSharedFrame pSharedFrame)
+{
+    // The last reference frees the frame along with the payload
+    if (pSharedFrame != NULL && ATOMIC_DECREMENT(&pSharedFrame->refCount) == 1) {
+        if (pSharedFrame->pBuffer != NULL) {
+            gst_buffer_unmap(pSharedFrame->pBuffer, &pSharedFrame->mapInfo);
+            gst_buffer_unref(pSharedFrame->pBuffer);
+        }
+
+        sharedFrameRelease(pSharedFrame->pParent);
+
+        MEMFREE(pSharedFrame);
+    }
+}
+
+VOID latencyHistogramRecord(PLatencyHistogram pHistogram, UINT64 latency)
+{
+    UINT64 value;
+    SIZE_T max;
+    UINT32 shift = 0;
+
+    if (pHistogram == NULL) {
+        return;
+    }
+
+    // The values below the sub-bucket count are kept as is. The larger ones keep the top bits
+    // of their power of two range so the bucket width doubles with each range.
+    value = MIN(latency, (1ULL << LATENCY_HISTOGRAM_MAX_VALUE_BITS) - 1);
+    while ((value >> shift) >= 2 * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) {
+        shift++;
+    }
+
+    if (value >= LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) {
+        value = (shift + 1) * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + (value >> shift) - LATENCY_HISTOGRAM_SUB_BUCKET_COUNT;
+    }
+
+    ATOMIC_INCREMENT(&pHistogram->buckets[value]);
+    ATOMIC_INCREMENT(&pHistogram->count);
+
+    max = ATOMIC_LOAD(&pHistogram->max);
+    while (latency > (UINT64) max && !ATOMIC_COMPARE_EXCHANGE(&pHistogram->max, &max, (SIZE_T) latency)) {
+        // Retry against the max stored by the other writer
+    }
+}
+
+UINT64 latencyHistogramGetPercentile(PLatencyHistogram pHistogram, DOUBLE percentile)
+{
+    UINT64 count, target, total = 0;
+    UINT32 i, shift;
+
+    if (pHistogram == NULL || 0 == (count = (UINT64) ATOMIC_LOAD(&pHistogram->count))) {
+        return 0;
+    }
+
+    // The counters are read while being recorded into so the target is capped by what is seen
+    target = MAX(1, (UINT64) (count * percentile / 100.0 + 0.5));
+    for (i = 0; i < LATENCY_HISTOGRAM_BUCKET_COUNT; i++) {
+        total += (UINT64) ATOMIC_LOAD(&pHistogram->buckets[i]);
+        if (total >= target) {
+            break;
+        }
+    }
+
+    if (i < LATENCY_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return i;
+    } else if (i == LATENCY_HISTOGRAM_BUCKET_COUNT) {
+        i--;
+    }
+
+    // Highest value of the bucket without going past the recorded max
+    shift = i / LATENCY_HISTOGRAM_SUB_BUCKET_COUNT - 1;
+    return MIN((((UINT64) (i % LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + LATENCY_HISTOGRAM_SUB_BUCKET_COUNT + 1)) << shift) - 1,
+               (UINT64) ATOMIC_LOAD(&pHistogram->max));
+}
+
+VOID logLatencyHistogram(PLatencyHistogram pHistogram, PCHAR name)
+{
+    if (pHistogram == NULL || ATOMIC_LOAD(&pHistogram->count) == 0) {
+        return;
+    }
+
+    DLOGI("%s latency over %" PRIu64 " samples: p50 %" PRIu64 " us, p99 %" PRIu64 " us, p99.9 %" PRIu64 " us, max %" PRIu64 " us", name,
+          (UINT64) ATOMIC_LOAD(&pHistogram->count), latencyHistogramGetPercentile(pHistogram, 50.0) / HUNDREDS_OF_NANOS_IN_A_MICROSECOND,
+          latencyHistogramGetPercentile(pHistogram, 99.0) / HUNDREDS_OF_NANOS_IN_A_MICROSECOND,
+          latencyHistogramGetPercentile(pHistogram, 99.9) / HUNDREDS_OF_NANOS_IN_A_MICROSECOND,
+          (UINT64) ATOMIC_LOAD(&pHistogram->max) / HUNDREDS_OF_NANOS_IN_A_MICROSECOND);
+}
+
+UINT64 getThreadCpuTime()
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    struct timespec cpuTime;
+
+    if (0 == clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime)) {
+        return (UINT64) cpuTime.tv_sec * HUNDREDS_OF_NANOS_IN_A_SECOND + (UINT64) cpuTime.tv_nsec / DEFAULT_TIME_UNIT_IN_NANOS;
+    }
+#endif
+
+    // Not accounted for where the per-thread clock is not available
+    return 0;
+}
+
+gchar* getUpstreamSourceUri(GstElement* pElement)
+{
+    GstIterator* pIterator;
+    GstQuery* pQuery;
+    GValue item = G_VALUE_INIT;
+    gchar* pUri = NULL;
+    BOOL done = FALSE;
+
+    if (pElement == NULL) {
+        return NULL;
+    }
+
+    // The URI query is forwarded upstream until it reaches the source element
+    pIterator = gst_element_iterate_sink_pads(pElement);
+    while (!done) {
+        switch (gst_iterator_next(pIterator, &item)) {
+            case GST_ITERATOR_OK:
+                pQuery = gst_query_new_uri();
+                if (gst_pad_peer_query(GST_PAD(g_value_get_object(&item)), pQuery)) {
+                    gst_query_parse_uri(pQuery, &pUri);
+                    done = pUri != NULL;
+                }
+
+                gst_query_unref(pQuery);
+                g_value_reset(&item);
+                break;
+            case GST_ITERATOR_RESYNC:
+                gst_iterator_resync(pIterator);
+                break;
+            default:
+                done = TRUE;
+                break;
+        }
+    }
+
+    g_value_unset(&item);
+    gst_iterator_free(pIterator);
+
+    return pUri;
+}
@@ -24,10 +24,94 @@ struct __IotInfo {
 };
 typedef struct __IotInfo* PIotInfo;
 
+/**
+ * Bounded single-producer/single-consumer ring of 64 bit items.
+ * Capacity is rounded up to a power of two. Only the producer advances
+ * the tail and only the consumer advances the head so no locking is needed.
+ */
+typedef struct __SpscRing SpscRing;
+struct __SpscRing {
+    UINT32 capacity;
+    UINT32 mask;
+    volatile SIZE_T head;
+    volatile SIZE_T tail;
+    PUINT64 items;
+};
+typedef struct __SpscRing* PSpscRing;
+
+/**
+ * Reference counted frame handed off to multiple consumers. The bits are either
+ * allocated right after the structure or referenced in a mapped GstBuffer.
+ */
+typedef struct __SharedFrame SharedFrame;
+struct __SharedFrame {
+    volatile SIZE_T refCount;
+    Frame frame;
+
+    // Optional Annex-B CPD to be sent as a separate chunk ahead of the frame. Not owned.
+    PBYTE pCpd;
+    UINT32 cpdSize;
+
+    // Video frame no other frame references. Can be dropped without breaking the decoding of the rest of the GoP.
+    BOOL disposable;
+
+    // Buffer holding the bits when they are referenced rather than copied
+    GstBuffer* pBuffer;
+    GstMapInfo mapInfo;
+
+    // Frame holding the bits when this is an alias of it with its own frame info
+    struct __SharedFrame* pParent;
+};
+typedef struct __SharedFrame* PSharedFrame;
+
+// Monotonic time in 100ns for the latency measurements
+#define GST_PLUGIN_MONOTONIC_TIME() ((UINT64) g_get_monotonic_time() * HUNDREDS_OF_NANOS_IN_A_MICROSECOND)
+
+// Each power of two range of the latency histogram past the first one is split into linear
+// sub-buckets which keeps the relative error of the recorded values within 1/16
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS  4
+#define LATENCY_HISTOGRAM_SUB_BUCKET_COUNT (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+
+// Latencies are in 100ns. The ones over 2^36, close to two hours, are counted in the last bucket.
+#define LATENCY_HISTOGRAM_MAX_VALUE_BITS 36
+#define LATENCY_HISTOGRAM_BUCKET_COUNT                                                                                                              \
+    ((LATENCY_HISTOGRAM_MAX_VALUE_BITS - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1) * LATENCY_HISTOGRAM_SUB_BUCKET_COUNT)
+
+/**
+ * Fixed size log-linear histogram of latencies in the fashion of HdrHistogram.
+ * Recorded into from any thread with atomic increments and read without locking.
+ */
+typedef struct __LatencyHistogram LatencyHistogram;
+struct __LatencyHistogram {
+    volatile SIZE_T count;
+    volatile SIZE_T max;
+    volatile SIZE_T buckets[LATENCY_HISTOGRAM_BUCKET_COUNT];
+};
+typedef struct __LatencyHistogram* PLatencyHistogram;
+
 STATUS gstStructToTags(GstStructure*, PGstTag);
 gboolean setGstTags(GQuark, const GValue*, gpointer);
 
 STATUS gstStructToIotInfo(GstStructure*, PIotInfo);
 gboolean setGstIotInfo(GQuark, const GValue*, gpointer);
 
+STATUS createSpscRing(UINT32, PSpscRing*);
+STATUS freeSpscRing(PSpscRing*);
+BOOL spscRingTryEnqueue(PSpscRing, UINT64);
+BOOL spscRingTryDequeue(PSpscRing, PUINT64);
+UINT32 spscRingGetCount(PSpscRing);
+
+STATUS createSharedFrame(PFrame, BOOL, PSharedFrame*);
+STATUS createSharedFrameFromBuffer(PFrame, GstBuffer*, GstMapInfo*, PSharedFrame*);
+STATUS createSharedFrameAlias(PSharedFrame, PSharedFrame*);
+BOOL isGstBufferWritableInPlace(GstBuffer*);
+
+VOID latencyHistogramRecord(PLatencyHistogram, UINT64);
+UINT64 latencyHistogramGetPercentile(PLatencyHistogram, DOUBLE);
+VOID logLatencyHistogram(PLatencyHistogram, PCHAR);
+UINT64 getThreadCpuTime();
+gchar* getUpstreamSourceUri(GstElement*);
+PSharedFrame sharedFrameAddRef(PSharedFrame);
+VOID sharedFrameRelease(PSharedFrame);
+
 #endif //__KVS_GST_PLUGIN_UTILS_H__
\ No newline at end of file
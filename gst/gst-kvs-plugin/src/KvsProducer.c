@@ -1,6 +1,19 @@
 #define LOG_CLASS "KvsProducer"
 #include "GstPlugin.h"
 
+#include <glib/gstdio.h>
+
+// Producer clients shared by the elements of the process. The condition is signalled as the clients get created.
+static PKvsSharedClient gKvsSharedClients = NULL;
+static GCond gKvsSharedClientsCond;
+G_LOCK_DEFINE_STATIC(gKvsSharedClients);
+
+// Serializes the API cache file updates and the stream states of the process
+G_LOCK_DEFINE_STATIC(gKvsApiCache);
+
+// Serializes the checkpoint file updates of the process
+G_LOCK_DEFINE_STATIC(gKvsCheckpointFile);
+
 STATUS traverseDirectoryPemFileScan(UINT64 customData, DIR_ENTRY_TYPES entryType, PCHAR fullPath, PCHAR fileName)
 {
     UNUSED_PARAM(entryType);
@@ -64,6 +77,41 @@ CleanUp:
     return retStatus;
 }
 
+VOID applyStreamInfoParams(PGstKvsPlugin pGstPlugin, PStreamInfo pStreamInfo)
+{
+    STRNCPY(pStreamInfo->kmsKeyId, pGstPlugin->gstParams.kmsKeyId, MAX_ARN_LEN);
+    pStreamInfo->streamCaps.streamingType = pGstPlugin->gstParams.streamingType;
+
+    // Need to reset the NAL adaptation flags as we take care of it later with the first frame
+    pStreamInfo->streamCaps.nalAdaptationFlags = NAL_ADAPTATION_FLAG_NONE;
+
+    // Override only if specified
+    if (pGstPlugin->gstParams.maxLatencyInSeconds != DEFAULT_MAX_LATENCY_SECONDS) {
+        pStreamInfo->streamCaps.maxLatency = pGstPlugin->gstParams.maxLatencyInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    }
+
+    pStreamInfo->streamCaps.fragmentDuration = pGstPlugin->gstParams.fragmentDurationInMillis * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    pStreamInfo->streamCaps.timecodeScale = pGstPlugin->gstParams.timeCodeScaleInMillis * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    pStreamInfo->streamCaps.keyFrameFragmentation = pGstPlugin->gstParams.keyFrameFragmentation;
+    pStreamInfo->streamCaps.frameTimecodes = pGstPlugin->gstParams.frameTimecodes;
+    pStreamInfo->streamCaps.absoluteFragmentTimes = pGstPlugin->gstParams.absoluteFragmentTimecodes;
+    pStreamInfo->streamCaps.fragmentAcks = pGstPlugin->gstParams.fragmentAcks;
+    pStreamInfo->streamCaps.recoverOnError = pGstPlugin->gstParams.restartOnErrors;
+    pStreamInfo->streamCaps.frameRate = pGstPlugin->gstParams.frameRate;
+    pStreamInfo->streamCaps.avgBandwidthBps = pGstPlugin->gstParams.avgBandwidthBps;
+    pStreamInfo->streamCaps.recalculateMetrics = pGstPlugin->gstParams.recalculateMetrics;
+    pStreamInfo->streamCaps.nalAdaptationFlags = NAL_ADAPTATION_FLAG_NONE;
+
+    // Override only if specified
+    if (pGstPlugin->gstParams.replayDurationInSeconds != DEFAULT_REPLAY_DURATION_SECONDS) {
+        pStreamInfo->streamCaps.replayDuration = pGstPlugin->gstParams.replayDurationInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    }
+
+    // Override only if specified
+    if (pGstPlugin->gstParams.connectionStalenessInSeconds != DEFAULT_CONNECTION_STALENESS_SECONDS) {
+        pStreamInfo->streamCaps.connectionStalenessDuration = pGstPlugin->gstParams.connectionStalenessInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    }
+}
 
 STATUS initKinesisVideoStream(PGstKvsPlugin pGstPlugin)
 {
@@ -78,12 +126,13 @@ STATUS initKinesisVideoStream(PGstKvsPlugin pGstPlugin)
     // then force absolute fragment time. Since we will be adding the file_start_time to the timestamp
     // of each frame to make each frame's timestamp absolute. Assuming each frame's timestamp is relative
     // (i.e. starting from 0)
+    pGstPlugin->basePts = 0;
     if (pGstPlugin->gstParams.streamingType == STREAMING_TYPE_OFFLINE && pGstPlugin->gstParams.fileStartTime != 0) {
         pGstPlugin->gstParams.absoluteFragmentTimecodes = TRUE;
 
         // Store the base of the PTS which will be the file start time.
-        // NOTE: file start time is given in seconds.
-        pGstPlugin->basePts = pGstPlugin->gstParams.fileStartTime / HUNDREDS_OF_NANOS_IN_A_SECOND;
+        // NOTE: file start time is given in seconds while the PTS are in nanoseconds.
+        pGstPlugin->basePts = pGstPlugin->gstParams.fileStartTime * HUNDREDS_OF_NANOS_IN_A_SECOND * DEFAULT_TIME_UNIT_IN_NANOS;
     }
 
     switch (pGstPlugin->mediaType) {
@@ -110,41 +159,8 @@ STATUS initKinesisVideoStream(PGstKvsPlugin pGstPlugin)
 
     pGstPlugin->kvsContext.pStreamInfo->tagCount = gstTags.tagCount;
     pGstPlugin->kvsContext.pStreamInfo->tags = gstTags.tags;
-    STRNCPY(pGstPlugin->kvsContext.pStreamInfo->kmsKeyId, pGstPlugin->gstParams.kmsKeyId, MAX_ARN_LEN);
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.streamingType = pGstPlugin->gstParams.streamingType;
     STRNCPY(pGstPlugin->kvsContext.pStreamInfo->streamCaps.contentType, pGstPlugin->gstParams.contentType, MAX_CONTENT_TYPE_LEN);
-
-    // Need to reset the NAL adaptation flags as we take care of it later with the first frame
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.nalAdaptationFlags = NAL_ADAPTATION_FLAG_NONE;
-
-    // Override only if specified
-    if (pGstPlugin->gstParams.maxLatencyInSeconds != DEFAULT_MAX_LATENCY_SECONDS) {
-        pGstPlugin->kvsContext.pStreamInfo->streamCaps.maxLatency = pGstPlugin->gstParams.maxLatencyInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
-    }
-
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.fragmentDuration =
-        pGstPlugin->gstParams.fragmentDurationInMillis * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.timecodeScale = pGstPlugin->gstParams.timeCodeScaleInMillis * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.keyFrameFragmentation = pGstPlugin->gstParams.keyFrameFragmentation;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.frameTimecodes = pGstPlugin->gstParams.frameTimecodes;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.absoluteFragmentTimes = pGstPlugin->gstParams.absoluteFragmentTimecodes;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.fragmentAcks = pGstPlugin->gstParams.fragmentAcks;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.recoverOnError = pGstPlugin->gstParams.restartOnErrors;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.frameRate = pGstPlugin->gstParams.frameRate;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.avgBandwidthBps = pGstPlugin->gstParams.avgBandwidthBps;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.recalculateMetrics = pGstPlugin->gstParams.recalculateMetrics;
-    pGstPlugin->kvsContext.pStreamInfo->streamCaps.nalAdaptationFlags = NAL_ADAPTATION_FLAG_NONE;
-
-    // Override only if specified
-    if (pGstPlugin->gstParams.replayDurationInSeconds != DEFAULT_REPLAY_DURATION_SECONDS) {
-        pGstPlugin->kvsContext.pStreamInfo->streamCaps.replayDuration = pGstPlugin->gstParams.replayDurationInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
-    }
-
-    // Override only if specified
-    if (pGstPlugin->gstParams.connectionStalenessInSeconds != DEFAULT_CONNECTION_STALENESS_SECONDS) {
-        pGstPlugin->kvsContext.pStreamInfo->streamCaps.connectionStalenessDuration =
-            pGstPlugin->gstParams.connectionStalenessInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
-    }
+    applyStreamInfoParams(pGstPlugin, pGstPlugin->kvsContext.pStreamInfo);
 
     // Replace the video codecId
     STRNCPY(pGstPlugin->kvsContext.pStreamInfo->streamCaps.trackInfoList[0].codecId, pGstPlugin->gstParams.codecId, MKV_MAX_CODEC_ID_LEN);
@@ -154,51 +170,206 @@ STATUS initKinesisVideoStream(PGstKvsPlugin pGstPlugin)
         STRNCPY(pGstPlugin->kvsContext.pStreamInfo->streamCaps.trackInfoList[1].codecId, pGstPlugin->audioCodecId, MKV_MAX_CODEC_ID_LEN);
     }
 
-    CHK_STATUS(
-        createKinesisVideoStreamSync(pGstPlugin->kvsContext.clientHandle, pGstPlugin->kvsContext.pStreamInfo, &pGstPlugin->kvsContext.streamHandle));
-
+    // The stream itself is created in the background by startKinesisVideoStreamRoutine
     pGstPlugin->frameCount = 0;
 
+CleanUp:
+
+    return retStatus;
+}
+
+PVOID startKinesisVideoStreamRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) args;
+    STREAM_HANDLE streamHandle;
+    BOOL locked = FALSE;
+    UINT32 i;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    CHK_STATUS(registerKvsApiCacheStream(pGstKvsPlugin, pGstKvsPlugin->kvsContext.pStreamInfo));
+    CHK_STATUS(createKinesisVideoStreamSync(pGstKvsPlugin->kvsContext.clientHandle, pGstKvsPlugin->kvsContext.pStreamInfo,
+                                            &pGstKvsPlugin->kvsContext.streamHandle));
+    streamHandle = pGstKvsPlugin->kvsContext.streamHandle;
+
+    CHK_STATUS(attachKinesisVideoCheckpoint(pGstKvsPlugin));
+    CHK_STATUS(initKinesisVideoPadStreams(pGstKvsPlugin));
+
+    // Apply the CPD the caps have brought in the meantime before any of the queued frames is put
+    MUTEX_LOCK(pGstKvsPlugin->startupLock);
+    locked = TRUE;
+
+    if (pGstKvsPlugin->pendingNalFlagsSet) {
+        CHK_STATUS(kinesisVideoStreamSetNalAdaptationFlags(streamHandle, pGstKvsPlugin->pendingNalFlags));
+    }
+
+    for (i = 0; i < DEFAULT_AUDIO_TRACK_ID; i++) {
+        if (pGstKvsPlugin->pendingCpdSize[i] != 0) {
+            CHK_STATUS(kinesisVideoStreamFormatChanged(streamHandle, pGstKvsPlugin->pendingCpdSize[i], pGstKvsPlugin->pendingCpd[i], i + 1));
+        }
+    }
+
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->kvsStreamReady, TRUE);
+
     DLOGI("Stream is ready");
 
 CleanUp:
 
+    CHK_LOG_ERR(retStatus);
+
+    if (pGstKvsPlugin != NULL) {
+        if (!locked) {
+            MUTEX_LOCK(pGstKvsPlugin->startupLock);
+        }
+
+        ATOMIC_STORE_BOOL(&pGstKvsPlugin->kvsStartupDone, TRUE);
+        CVAR_BROADCAST(pGstKvsPlugin->startupCvar);
+        MUTEX_UNLOCK(pGstKvsPlugin->startupLock);
+
+        if (STATUS_SUCCEEDED(retStatus)) {
+            postReadyMessage(pGstKvsPlugin, (PCHAR) KVS_READY_COMPONENT_STREAM);
+        } else {
+            // Nothing is going to be put so release the queued frames and anyone waiting on them
+            ATOMIC_STORE_BOOL(&pGstKvsPlugin->streamStopped, TRUE);
+            ATOMIC_STORE_BOOL(&pGstKvsPlugin->ingestTerminate, TRUE);
+            if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->ingestLock)) {
+                MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+                CVAR_BROADCAST(pGstKvsPlugin->ingestCvar);
+                MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+            }
+
+            GST_ELEMENT_ERROR(pGstKvsPlugin, LIBRARY, INIT, (NULL), ("Failed to create the KVS stream with 0x%08x", retStatus));
+        }
+    }
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+STATUS awaitKinesisVideoStream(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    if (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStartupDone)) {
+        MUTEX_LOCK(pGstKvsPlugin->startupLock);
+        while (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStartupDone)) {
+            CVAR_WAIT(pGstKvsPlugin->startupCvar, pGstKvsPlugin->startupLock, INFINITE_TIME_VALUE);
+        }
+        MUTEX_UNLOCK(pGstKvsPlugin->startupLock);
+    }
+
+    CHK(ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady), STATUS_INVALID_OPERATION);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS setKinesisVideoStreamNalFlags(PGstKvsPlugin pGstKvsPlugin, UINT32 nalFlags)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BOOL locked = FALSE;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    MUTEX_LOCK(pGstKvsPlugin->startupLock);
+    locked = TRUE;
+
+    // Left for the startup thread if the stream isn't there yet
+    if (ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady)) {
+        CHK_STATUS(kinesisVideoStreamSetNalAdaptationFlags(pGstKvsPlugin->kvsContext.streamHandle, nalFlags));
+    } else {
+        pGstKvsPlugin->pendingNalFlags = nalFlags;
+        pGstKvsPlugin->pendingNalFlagsSet = TRUE;
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pGstKvsPlugin->startupLock);
+    }
+
+    return retStatus;
+}
+
+STATUS setKinesisVideoStreamCpd(PGstKvsPlugin pGstKvsPlugin, UINT64 trackId, PBYTE pCpd, UINT32 cpdSize)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BOOL locked = FALSE;
+
+    CHK(pGstKvsPlugin != NULL && pCpd != NULL, STATUS_NULL_ARG);
+    CHK(trackId >= DEFAULT_VIDEO_TRACK_ID && trackId <= DEFAULT_AUDIO_TRACK_ID && cpdSize != 0, STATUS_INVALID_ARG);
+    CHK(cpdSize <= GST_PLUGIN_MAX_CPD_SIZE, STATUS_INVALID_ARG_LEN);
+
+    MUTEX_LOCK(pGstKvsPlugin->startupLock);
+    locked = TRUE;
+
+    // Left for the startup thread if the stream isn't there yet. The latest CPD of the track wins.
+    if (ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady)) {
+        CHK_STATUS(kinesisVideoStreamFormatChanged(pGstKvsPlugin->kvsContext.streamHandle, cpdSize, pCpd, trackId));
+    } else {
+        MEMCPY(pGstKvsPlugin->pendingCpd[trackId - 1], pCpd, cpdSize);
+        pGstKvsPlugin->pendingCpdSize[trackId - 1] = cpdSize;
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pGstKvsPlugin->startupLock);
+    }
+
     return retStatus;
 }
 
-STATUS initKinesisVideoProducer(PGstKvsPlugin pGstPlugin)
+STATUS initKinesisVideoProducer(PGstKvsPlugin pGstPlugin, PKvsSharedClient pSharedClient)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PAuthCallbacks pAuthCallbacks;
     PStreamCallbacks pStreamCallbacks;
     BOOL freeStreamCallbacksOnError = TRUE;
 
-    CHK(pGstPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstPlugin != NULL && pSharedClient != NULL, STATUS_NULL_ARG);
 
-    CHK_STATUS(createDefaultDeviceInfo(&pGstPlugin->kvsContext.pDeviceInfo));
+    CHK_STATUS(createDefaultDeviceInfo(&pSharedClient->pDeviceInfo));
 
     // Set the overrides if specified
     if (pGstPlugin->gstParams.logLevel != LOG_LEVEL_SILENT + 1) {
-        pGstPlugin->kvsContext.pDeviceInfo->clientInfo.loggerLogLevel = pGstPlugin->gstParams.logLevel;
+        pSharedClient->pDeviceInfo->clientInfo.loggerLogLevel = pGstPlugin->gstParams.logLevel;
     }
 
-    pGstPlugin->kvsContext.pDeviceInfo->clientInfo.createStreamTimeout =
-        pGstPlugin->gstParams.streamCreateTimeoutInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
-    pGstPlugin->kvsContext.pDeviceInfo->clientInfo.stopStreamTimeout =
-        pGstPlugin->gstParams.streamStopTimeoutInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    pSharedClient->pDeviceInfo->clientInfo.createStreamTimeout = pGstPlugin->gstParams.streamCreateTimeoutInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    pSharedClient->pDeviceInfo->clientInfo.stopStreamTimeout = pGstPlugin->gstParams.streamStopTimeoutInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+
+    // The content store is shared by all of the streams on the client
+    pSharedClient->pDeviceInfo->storageInfo.storageSize = (UINT64) pGstPlugin->gstParams.storageSizeInBytes * 1024 * 1024;
 
     CHK_STATUS(createAbstractDefaultCallbacksProvider(DEFAULT_CALLBACK_CHAIN_COUNT, API_CALL_CACHE_TYPE_ALL, DEFAULT_API_CACHE_PERIOD,
                                                       pGstPlugin->pRegion, EMPTY_STRING, pGstPlugin->caCertPath, KVS_PRODUCER_CLIENT_USER_AGENT_NAME,
-                                                      NULL, &pGstPlugin->kvsContext.pClientCallbacks));
+                                                      NULL, &pSharedClient->pClientCallbacks));
 
-    CHK_STATUS(createContinuousRetryStreamCallbacks(pGstPlugin->kvsContext.pClientCallbacks, &pStreamCallbacks));
+    CHK_STATUS(createContinuousRetryStreamCallbacks(pSharedClient->pClientCallbacks, &pStreamCallbacks));
     freeStreamCallbacksOnError = FALSE;
 
-    CHK_STATUS(
-        createCredentialProviderAuthCallbacks(pGstPlugin->kvsContext.pClientCallbacks, pGstPlugin->kvsContext.pCredentialProvider, &pAuthCallbacks));
+    // The persisted acks of the offline uploads move their checkpoints forward
+    pSharedClient->checkpointLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pSharedClient->checkpointLock), STATUS_INVALID_OPERATION);
+    pSharedClient->checkpointStreamCallbacks.version = STREAM_CALLBACKS_CURRENT_VERSION;
+    pSharedClient->checkpointStreamCallbacks.customData = (UINT64) pSharedClient;
+    pSharedClient->checkpointStreamCallbacks.fragmentAckReceivedFn = fragmentAckReceivedCheckpoint;
+    CHK_STATUS(addStreamCallbacks(pSharedClient->pClientCallbacks, &pSharedClient->checkpointStreamCallbacks));
+
+    CHK_STATUS(createCredentialProviderAuthCallbacks(pSharedClient->pClientCallbacks, pSharedClient->pCredentialProvider, &pAuthCallbacks));
+
+    // The client takes a copy of the callbacks so they need to be wrapped before it's created
+    if (pGstPlugin->gstParams.loopback) {
+        CHK_STATUS(initKvsLoopback(pGstPlugin, pSharedClient));
+    } else {
+        CHK_STATUS(initKvsApiCache(pGstPlugin, pSharedClient));
+    }
 
-    CHK_STATUS(
-        createKinesisVideoClient(pGstPlugin->kvsContext.pDeviceInfo, pGstPlugin->kvsContext.pClientCallbacks, &pGstPlugin->kvsContext.clientHandle));
+    CHK_STATUS(createKinesisVideoClient(pSharedClient->pDeviceInfo, pSharedClient->pClientCallbacks, &pSharedClient->clientHandle));
 
 CleanUp:
 
@@ -214,194 +385,2397 @@ CleanUp:
     return retStatus;
 }
 
-STATUS identifyFrameNalFormat(PBYTE pData, UINT32 size, ELEMENTARY_STREAM_NAL_FORMAT* pFormat)
+gchar* getKvsSharedClientKey(PGstKvsPlugin pGstPlugin, PCHAR pAccessKey, PCHAR pSecretKey, PCHAR pSessionToken)
 {
-    STATUS retStatus = STATUS_SUCCESS;
-    PBYTE pEnd = pData + size;
-    ELEMENTARY_STREAM_NAL_FORMAT format = ELEMENTARY_STREAM_NAL_FORMAT_UNKNOWN;
-    BYTE start3ByteCode[] = {0x00, 0x00, 0x01};
-    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
-    BYTE start5ByteCode[] = {0x00, 0x00, 0x00, 0x00, 0x01};
-    UINT32 runLen;
+    IotInfo iotInfo;
+    gchar* pCredentialKey;
+    gchar* pClientKey;
+    gchar* pKey;
+
+    // Same precedence as the credential provider selection. The secrets are only kept as checksums.
+    if (pAccessKey != NULL) {
+        pCredentialKey = g_strdup_printf("static|%s|%08x|%08x", pAccessKey,
+                                         pSecretKey == NULL ? 0 : COMPUTE_CRC32((PBYTE) pSecretKey, (UINT32) STRLEN(pSecretKey)),
+                                         pSessionToken == NULL ? 0 : COMPUTE_CRC32((PBYTE) pSessionToken, (UINT32) STRLEN(pSessionToken)));
+    } else if (pGstPlugin->gstParams.iotCertificate != NULL && STATUS_SUCCEEDED(gstStructToIotInfo(pGstPlugin->gstParams.iotCertificate, &iotInfo))) {
+        // The IoT thing name is the stream name
+        pCredentialKey = g_strdup_printf("iot|%s|%s|%s|%s|%s|%s", iotInfo.endPoint, iotInfo.certPath, iotInfo.privateKeyPath, iotInfo.caCertPath,
+                                         iotInfo.roleAlias, pGstPlugin->gstParams.streamName);
+    } else {
+        pCredentialKey = g_strdup_printf("file|%s", pGstPlugin->gstParams.credentialFilePath);
+    }
 
-    CHK(pData != NULL && pFormat != NULL, STATUS_NULL_ARG);
-    CHK(size > SIZEOF(start5ByteCode), STATUS_FORMAT_ERROR);
+    // The content store, the timeouts and the log level are set on the client so the elements only share it if they agree on them
+    pClientKey = g_strdup_printf("%s|%s|%s|%u|%u|%u|%u", pGstPlugin->pRegion, pGstPlugin->caCertPath, pCredentialKey,
+                                 pGstPlugin->gstParams.storageSizeInBytes, pGstPlugin->gstParams.streamCreateTimeoutInSeconds,
+                                 pGstPlugin->gstParams.streamStopTimeoutInSeconds, pGstPlugin->gstParams.logLevel);
 
-    // We really do very crude check for the Annex-B start code
+    if (pGstPlugin->gstParams.loopback) {
+        pKey = g_strdup_printf("%s|loopback|%u|%u", pClientKey, pGstPlugin->gstParams.loopbackAckDelay, pGstPlugin->gstParams.loopbackBandwidth);
+    } else {
+        pKey = g_strdup_printf("%s|%s", pClientKey, pGstPlugin->gstParams.apiCachePath);
+    }
 
-    // First of all, we need to determine what format the CPD is in - Annex-B, Avcc or raw
-    // NOTE: Some "bad" encoders encode an extra 0 at the end of the NALu resulting in
-    // an extra zero interfering with the Annex-B start code so we check for 4 zeroes and 1
-    if ((0 == MEMCMP(pData, start5ByteCode, SIZEOF(start5ByteCode))) || (0 == MEMCMP(pData, start4ByteCode, SIZEOF(start4ByteCode))) ||
-        (0 == MEMCMP(pData, start3ByteCode, SIZEOF(start3ByteCode)))) {
-        // Must be an Annex-B format
-        format = ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B;
+    g_free(pClientKey);
+    g_free(pCredentialKey);
 
-        // Early exit
-        CHK(FALSE, retStatus);
+    return pKey;
+}
+
+STATUS createKvsSharedClient(PGstKvsPlugin pGstPlugin, PCHAR pAccessKey, PCHAR pSecretKey, PCHAR pSessionToken, PKvsSharedClient pSharedClient)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    IotInfo iotInfo;
+
+    CHK(pGstPlugin != NULL && pSharedClient != NULL, STATUS_NULL_ARG);
+
+    // Create the Credential Provider which will be used by both the producer and the signaling client
+    // Check if we have access key then use static credential provider.
+    // If we have IoT struct then use IoT credential provider.
+    // If we have File then we use file credential provider.
+    // We also need to set the appropriate free function pointer.
+    if (pAccessKey != NULL) {
+        CHK_STATUS(createStaticCredentialProvider(pAccessKey, 0, pSecretKey, 0, pSessionToken, 0, MAX_UINT64, &pSharedClient->pCredentialProvider));
+        pSharedClient->freeCredentialProviderFn = freeStaticCredentialProvider;
+    } else if (pGstPlugin->gstParams.iotCertificate != NULL) {
+        CHK_STATUS(gstStructToIotInfo(pGstPlugin->gstParams.iotCertificate, &iotInfo));
+        CHK_STATUS(createCurlIotCredentialProvider(iotInfo.endPoint, iotInfo.certPath, iotInfo.privateKeyPath, iotInfo.caCertPath, iotInfo.roleAlias,
+                                                   pGstPlugin->gstParams.streamName, &pSharedClient->pCredentialProvider));
+        pSharedClient->freeCredentialProviderFn = freeIotCredentialProvider;
+    } else if (pGstPlugin->gstParams.credentialFilePath != NULL) {
+        CHK_STATUS(createFileCredentialProvider(pGstPlugin->gstParams.credentialFilePath, &pSharedClient->pCredentialProvider));
+        pSharedClient->freeCredentialProviderFn = freeFileCredentialProvider;
     }
 
-    // For AvCC we will walk through all NALus
-    while (pData != pEnd) {
-        // Check if we can still read 32 bit
-        CHK(pData + SIZEOF(UINT32) <= pEnd, retStatus);
-        runLen = (UINT32) GET_UNALIGNED_BIG_ENDIAN((PUINT32) pData);
-        CHK(runLen != 0 && pData + runLen <= pEnd, retStatus);
+    CHK_STATUS(initKinesisVideoProducer(pGstPlugin, pSharedClient));
 
-        // Jump to the next NAL
-        pData += runLen + SIZEOF(UINT32);
-    }
+    CHK_STATUS(timerQueueCreate(&pSharedClient->timerQueueHandle));
 
-    // All checks, must be AvCC
-    format = ELEMENTARY_STREAM_NAL_FORMAT_AVCC;
+    pSharedClient->signalingWorkerLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pSharedClient->signalingWorkerLock), STATUS_INVALID_OPERATION);
 
 CleanUp:
 
-    if (pFormat != NULL) {
-        *pFormat = format;
-    }
-
     return retStatus;
 }
 
-STATUS identifyCpdNalFormat(PBYTE pData, UINT32 size, ELEMENTARY_STREAM_NAL_FORMAT* pFormat)
+VOID freeKvsSharedClient(PKvsSharedClient pSharedClient)
 {
-    STATUS retStatus = STATUS_SUCCESS;
-    ELEMENTARY_STREAM_NAL_FORMAT format = ELEMENTARY_STREAM_NAL_FORMAT_UNKNOWN;
-    BYTE start3ByteCode[] = {0x00, 0x00, 0x01};
-    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
-    BYTE start5ByteCode[] = {0x00, 0x00, 0x00, 0x00, 0x01};
+    if (pSharedClient == NULL) {
+        return;
+    }
 
-    CHK(pData != NULL && pFormat != NULL, STATUS_NULL_ARG);
-    CHK(size > SIZEOF(start5ByteCode), STATUS_FORMAT_ERROR);
+    // The elements have stopped their signaling before releasing the client
+    freeSignalingWorkers(pSharedClient->pSignalingWorkers);
+    if (IS_VALID_MUTEX_VALUE(pSharedClient->signalingWorkerLock)) {
+        MUTEX_FREE(pSharedClient->signalingWorkerLock);
+    }
 
-    // We really do very crude check for the Annex-B start code
+    if (IS_VALID_TIMER_QUEUE_HANDLE(pSharedClient->timerQueueHandle)) {
+        timerQueueFree(&pSharedClient->timerQueueHandle);
+    }
 
-    // First of all, we need to determine what format the CPD is in - Annex-B, Avcc or raw
-    // NOTE: Some "bad" encoders encode an extra 0 at the end of the NALu resulting in
-    // an extra zero interfering with the Annex-B start code so we check for 4 zeroes and 1
-    if ((0 == MEMCMP(pData, start5ByteCode, SIZEOF(start5ByteCode))) || (0 == MEMCMP(pData, start4ByteCode, SIZEOF(start4ByteCode))) ||
-        (0 == MEMCMP(pData, start3ByteCode, SIZEOF(start3ByteCode)))) {
-        // Must be an Annex-B format
-        format = ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B;
+    if (IS_VALID_CLIENT_HANDLE(pSharedClient->clientHandle)) {
+        freeKinesisVideoClient(&pSharedClient->clientHandle);
+    }
 
-        // Early exit
-        CHK(FALSE, retStatus);
-    } else if (pData[0] == AVCC_VERSION_CODE && pData[4] == AVCC_NALU_LEN_MINUS_ONE && pData[5] == AVCC_NUMBER_OF_SPS_ONE) {
-        // Looks like an AvCC format
-        format = ELEMENTARY_STREAM_NAL_FORMAT_AVCC;
-    } else if (size > HEVC_CPD_HEADER_SIZE && pData[0] == 1 && (pData[13] & 0xf0) == 0xf0 && (pData[15] & 0xfc) == 0xfc &&
-               (pData[16] & 0xfc) != 0xfc && (pData[17] & 0xf8) != 0xf8 && (pData[18] & 0xf8) != 0xf8) {
-        // Looks like an HEVC format
-        format = ELEMENTARY_STREAM_NAL_FORMAT_HEVC;
+    // The streams are gone by now so the sessions left are only joined
+    if (IS_VALID_MUTEX_VALUE(pSharedClient->loopbackLock)) {
+        reapKvsLoopbackUploads(pSharedClient, INVALID_STREAM_HANDLE_VALUE, TRUE);
+        MUTEX_FREE(pSharedClient->loopbackLock);
     }
 
-CleanUp:
+    if (pSharedClient->pClientCallbacks != NULL) {
+        freeCallbacksProvider(&pSharedClient->pClientCallbacks);
+    }
 
-    if (pFormat != NULL) {
-        *pFormat = format;
+    // The elements have detached their checkpoints before releasing the client
+    if (IS_VALID_MUTEX_VALUE(pSharedClient->checkpointLock)) {
+        MUTEX_FREE(pSharedClient->checkpointLock);
     }
 
-    return retStatus;
+    if (pSharedClient->pDeviceInfo != NULL) {
+        freeDeviceInfo(&pSharedClient->pDeviceInfo);
+    }
+
+    if (pSharedClient->pApiCacheStreams != NULL) {
+        hashTableIterateEntries(pSharedClient->pApiCacheStreams, 0, freeKvsApiCacheStreamEntry);
+        hashTableFree(pSharedClient->pApiCacheStreams);
+    }
+
+    g_free(pSharedClient->region);
+    g_free(pSharedClient->apiCachePath);
+
+    // Last object to be freed
+    if (pSharedClient->pCredentialProvider != NULL) {
+        pSharedClient->freeCredentialProviderFn(&pSharedClient->pCredentialProvider);
+    }
+
+    g_free(pSharedClient->key);
+    MEMFREE(pSharedClient);
 }
 
-STATUS convertCpdFromAvcToAnnexB(PGstKvsPlugin pGstKvsPlugin, PBYTE pData, UINT32 size)
+STATUS acquireKvsSharedClient(PGstKvsPlugin pGstPlugin, PCHAR pAccessKey, PCHAR pSecretKey, PCHAR pSessionToken)
 {
-    STATUS retStatus = STATUS_SUCCESS;
-    UINT32 i, offset = 0;
-    UINT16 spsSize, ppsSize;
-    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
-    PBYTE pSrc = pData, pEnd = pData + size;
-
-    CHK(pData != NULL && pGstKvsPlugin != NULL, STATUS_NULL_ARG);
-    CHK(size > 8, STATUS_FORMAT_ERROR);
+    STATUS retStatus = STATUS_SUCCESS, createStatus;
+    PKvsSharedClient pSharedClient = NULL, pFailedSharedClient = NULL, *ppCurSharedClient;
+    gchar* pKey = NULL;
+    BOOL locked = FALSE;
 
-    // Skip to SPS size and read the nalu count
-    pSrc += 6;
-    spsSize = GET_UNALIGNED_BIG_ENDIAN((PUINT16) pSrc);
-    pSrc += SIZEOF(UINT16);
+    CHK(pGstPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstPlugin->kvsContext.pSharedClient == NULL, STATUS_INVALID_OPERATION);
 
-    CHK(offset + SIZEOF(start4ByteCode) + spsSize < GST_PLUGIN_MAX_CPD_SIZE, STATUS_FORMAT_ERROR);
-    CHK(pSrc + spsSize <= pEnd, STATUS_FORMAT_ERROR);
+    pKey = getKvsSharedClientKey(pGstPlugin, pAccessKey, pSecretKey, pSessionToken);
 
-    // Output the Annex-B start code
-    MEMCPY(pGstKvsPlugin->videoCpd + offset, start4ByteCode, SIZEOF(start4ByteCode));
-    offset += SIZEOF(start4ByteCode);
+    G_LOCK(gKvsSharedClients);
+    locked = TRUE;
 
-    // Output the NALu
-    MEMCPY(pGstKvsPlugin->videoCpd + offset, pSrc, spsSize);
-    offset += spsSize;
-    pSrc += spsSize;
+    for (pSharedClient = gKvsSharedClients; pSharedClient != NULL && 0 != STRCMP(pSharedClient->key, pKey); pSharedClient = pSharedClient->pNext) {
+    }
 
-    // Skip pps count
-    pSrc++;
+    if (pSharedClient == NULL) {
+        // The client is listed while it's being created so the concurrently started elements end up on the same one.
+        // The lock isn't held over the creation as the credential providers and the client can take a while.
+        CHK(NULL != (pSharedClient = (PKvsSharedClient) MEMCALLOC(1, SIZEOF(KvsSharedClient))), STATUS_NOT_ENOUGH_MEMORY);
+        pSharedClient->key = pKey;
+        pKey = NULL;
+        pSharedClient->clientHandle = INVALID_CLIENT_HANDLE_VALUE;
+        pSharedClient->timerQueueHandle = INVALID_TIMER_QUEUE_HANDLE_VALUE;
+        pSharedClient->creating = TRUE;
+        pSharedClient->refCount++;
+        pSharedClient->pNext = gKvsSharedClients;
+        gKvsSharedClients = pSharedClient;
+
+        G_UNLOCK(gKvsSharedClients);
+        createStatus = createKvsSharedClient(pGstPlugin, pAccessKey, pSecretKey, pSessionToken, pSharedClient);
+        G_LOCK(gKvsSharedClients);
+
+        pSharedClient->createStatus = createStatus;
+        pSharedClient->creating = FALSE;
+        g_cond_broadcast(&gKvsSharedClientsCond);
+    } else {
+        pSharedClient->refCount++;
+        while (pSharedClient->creating) {
+            g_cond_wait(&gKvsSharedClientsCond, &G_LOCK_NAME(gKvsSharedClients));
+        }
 
-    // Read pps size
-    CHK(pSrc + SIZEOF(UINT16) <= pEnd, STATUS_FORMAT_ERROR);
-    ppsSize = GET_UNALIGNED_BIG_ENDIAN((PUINT16) pSrc);
-    pSrc += SIZEOF(UINT16);
+        if (STATUS_SUCCEEDED(pSharedClient->createStatus)) {
+            DLOGI("Reusing the KVS client of %u other element(s)", pSharedClient->refCount - 1);
+        }
+    }
 
-    CHK(offset + SIZEOF(start4ByteCode) + ppsSize < GST_PLUGIN_MAX_CPD_SIZE, STATUS_FORMAT_ERROR);
-    CHK(pSrc + ppsSize <= pEnd, STATUS_FORMAT_ERROR);
+    // The last of the elements which waited on a failed client unlists and frees it
+    if (STATUS_FAILED(pSharedClient->createStatus)) {
+        retStatus = pSharedClient->createStatus;
+        if (--pSharedClient->refCount == 0) {
+            for (ppCurSharedClient = &gKvsSharedClients; *ppCurSharedClient != pSharedClient; ppCurSharedClient = &(*ppCurSharedClient)->pNext) {
+            }
 
-    // Output the Annex-B start code
-    MEMCPY(pGstKvsPlugin->videoCpd + offset, start4ByteCode, SIZEOF(start4ByteCode));
-    offset += SIZEOF(start4ByteCode);
+            *ppCurSharedClient = pSharedClient->pNext;
+            pFailedSharedClient = pSharedClient;
+        }
 
-    // Output the NALu
-    MEMCPY(pGstKvsPlugin->videoCpd + offset, pSrc, ppsSize);
-    offset += ppsSize;
+        CHK(FALSE, retStatus);
+    }
 
-    pGstKvsPlugin->videoCpdSize = offset;
+    pGstPlugin->kvsContext.pSharedClient = pSharedClient;
+    pGstPlugin->kvsContext.pDeviceInfo = pSharedClient->pDeviceInfo;
+    pGstPlugin->kvsContext.pCredentialProvider = pSharedClient->pCredentialProvider;
+    pGstPlugin->kvsContext.freeCredentialProviderFn = pSharedClient->freeCredentialProviderFn;
+    pGstPlugin->kvsContext.pClientCallbacks = pSharedClient->pClientCallbacks;
+    pGstPlugin->kvsContext.clientHandle = pSharedClient->clientHandle;
+    pGstPlugin->kvsContext.timerQueueHandle = pSharedClient->timerQueueHandle;
 
 CleanUp:
 
+    if (locked) {
+        G_UNLOCK(gKvsSharedClients);
+    }
+
+    CHK_LOG_ERR(retStatus);
+
+    freeKvsSharedClient(pFailedSharedClient);
+    g_free(pKey);
+
     return retStatus;
 }
 
-STATUS convertCpdFromHevcToAnnexB(PGstKvsPlugin pGstKvsPlugin, PBYTE pData, UINT32 size)
+VOID releaseKvsSharedClient(PGstKvsPlugin pGstPlugin)
 {
-    STATUS retStatus = STATUS_SUCCESS;
-    UINT32 i, naluCount, offset = 0;
-    UINT16 naluUnitLen;
-    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
-    PBYTE pSrc = pData, pEnd = pData + size;
+    PKvsSharedClient pSharedClient, *ppCurSharedClient;
 
-    CHK(pData != NULL && pGstKvsPlugin != NULL, STATUS_NULL_ARG);
-    CHK(size > 23, STATUS_FORMAT_ERROR);
+    if (pGstPlugin == NULL || pGstPlugin->kvsContext.pSharedClient == NULL) {
+        return;
+    }
 
-    // Skip to numOfArrays and read the nalu count
-    pSrc += 22;
-    naluCount = *pSrc;
-    pSrc++;
+    pSharedClient = pGstPlugin->kvsContext.pSharedClient;
 
-    for (i = 0; i < naluCount; i++) {
-        // Skip array_completeness, reserved and NAL_unit_type
-        pSrc += 3;
+    pGstPlugin->kvsContext.pSharedClient = NULL;
+    pGstPlugin->kvsContext.pDeviceInfo = NULL;
+    pGstPlugin->kvsContext.pCredentialProvider = NULL;
+    pGstPlugin->kvsContext.pClientCallbacks = NULL;
+    pGstPlugin->kvsContext.clientHandle = INVALID_CLIENT_HANDLE_VALUE;
+    pGstPlugin->kvsContext.timerQueueHandle = INVALID_TIMER_QUEUE_HANDLE_VALUE;
 
-        CHK(pSrc + SIZEOF(UINT16) <= pEnd, STATUS_FORMAT_ERROR);
+    G_LOCK(gKvsSharedClients);
 
-        // Read the naluUnitLength
-        naluUnitLen = GET_UNALIGNED_BIG_ENDIAN((PUINT16) pSrc);
+    if (--pSharedClient->refCount == 0) {
+        for (ppCurSharedClient = &gKvsSharedClients; *ppCurSharedClient != pSharedClient; ppCurSharedClient = &(*ppCurSharedClient)->pNext) {
+        }
+
+        *ppCurSharedClient = pSharedClient->pNext;
+    } else {
+        pSharedClient = NULL;
+    }
+
+    G_UNLOCK(gKvsSharedClients);
+
+    // The last element frees the client outside of the lock
+    freeKvsSharedClient(pSharedClient);
+}
+
+STATUS initKvsApiCache(PGstKvsPlugin pGstPlugin, PKvsSharedClient pSharedClient)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PClientCallbacks pClientCallbacks;
+
+    CHK(pGstPlugin != NULL && pSharedClient != NULL && pSharedClient->pClientCallbacks != NULL, STATUS_NULL_ARG);
+
+    pClientCallbacks = pSharedClient->pClientCallbacks;
+    pSharedClient->region = g_strdup(pGstPlugin->pRegion);
+
+    // The key covers the region and the credentials without any of the secrets in the clear
+    pSharedClient->apiCacheIdentity = COMPUTE_CRC32((PBYTE) pSharedClient->key, (UINT32) STRLEN(pSharedClient->key));
+    if (pGstPlugin->gstParams.apiCachePath != NULL && pGstPlugin->gstParams.apiCachePath[0] != '\0') {
+        pSharedClient->apiCachePath = g_strdup(pGstPlugin->gstParams.apiCachePath);
+    } else {
+        // Not fatal if it can't be created, the results then come from the service every time
+        g_mkdir_with_parents(g_get_user_cache_dir(), 0700);
+        pSharedClient->apiCachePath = g_build_filename(g_get_user_cache_dir(), KVS_API_CACHE_FILE_NAME, NULL);
+    }
+
+    CHK_STATUS(hashTableCreateWithParams(GST_PLUGIN_HASH_TABLE_BUCKET_COUNT, GST_PLUGIN_HASH_TABLE_BUCKET_LENGTH, &pSharedClient->pApiCacheStreams));
+
+    // The aggregates of the provider still go through its in-memory cache on the misses
+    pSharedClient->describeStreamFn = pClientCallbacks->describeStreamFn;
+    pSharedClient->getStreamingEndpointFn = pClientCallbacks->getStreamingEndpointFn;
+    pSharedClient->putStreamFn = pClientCallbacks->putStreamFn;
+    pSharedClient->tagResourceFn = pClientCallbacks->tagResourceFn;
+
+    pClientCallbacks->describeStreamFn = describeStreamCachingFile;
+    pClientCallbacks->getStreamingEndpointFn = getStreamingEndpointCachingFile;
+    pClientCallbacks->putStreamFn = putStreamCachingFile;
+    pClientCallbacks->tagResourceFn = tagResourceCachingFile;
+
+CleanUp:
+
+    return retStatus;
+}
+
+PKvsSharedClient findKvsSharedClientByCallbacks(UINT64 customData)
+{
+    PKvsSharedClient pSharedClient;
+
+    // The callbacks are invoked with the custom data of the provider. The clients still being created or failed are skipped.
+    G_LOCK(gKvsSharedClients);
+    for (pSharedClient = gKvsSharedClients; pSharedClient != NULL &&
+         (pSharedClient->creating || STATUS_FAILED(pSharedClient->createStatus) || pSharedClient->pClientCallbacks->customData != customData);
+         pSharedClient = pSharedClient->pNext) {
+    }
+    G_UNLOCK(gKvsSharedClients);
+
+    return pSharedClient;
+}
+
+STATUS parseKvsApiCacheEntry(PCHAR pLine, PKvsApiCacheEntry pEntry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pFields[KVS_API_CACHE_FIELD_COUNT], pCur = pLine, pEnd;
+    UINT32 i;
+    UINT64 now = GETTIME();
+
+    CHK(pLine != NULL && pEntry != NULL, STATUS_NULL_ARG);
+
+    for (i = 0; i < KVS_API_CACHE_FIELD_COUNT; i++) {
+        CHK(pCur != NULL, STATUS_INVALID_ARG);
+        pFields[i] = pCur;
+        if (NULL != (pEnd = STRCHR(pCur, ','))) {
+            *pEnd = '\0';
+            pCur = pEnd + 1;
+        } else {
+            pCur = NULL;
+        }
+    }
+
+    CHK(pCur == NULL, STATUS_INVALID_ARG);
+    CHK(STRLEN(pFields[1]) != 0 && STRLEN(pFields[1]) <= MAX_STREAM_NAME_LEN && STRLEN(pFields[2]) != 0 &&
+            STRLEN(pFields[2]) <= MAX_REGION_NAME_LEN && STRLEN(pFields[3]) <= MAX_URI_CHAR_LEN && STRLEN(pFields[5]) <= MAX_ARN_LEN,
+        STATUS_INVALID_ARG_LEN);
+    CHK(0 == STRNCMP(pFields[3], KVS_API_CACHE_ENDPOINT_PREFIX, STRLEN(KVS_API_CACHE_ENDPOINT_PREFIX)), STATUS_INVALID_ARG);
+    CHK_STATUS(STRTOUI32(pFields[0], NULL, 16, &pEntry->identity));
+    CHK_STATUS(STRTOUI64(pFields[4], NULL, 10, &pEntry->creationTime));
+
+    // Entries from the future are as suspect as the expired ones
+    CHK(pEntry->creationTime <= now && now - pEntry->creationTime < KVS_API_CACHE_TTL, STATUS_NOT_FOUND);
+
+    STRCPY(pEntry->streamName, pFields[1]);
+    STRCPY(pEntry->region, pFields[2]);
+    STRCPY(pEntry->endpoint, pFields[3]);
+    STRCPY(pEntry->streamArn, pFields[5]);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS readKvsStateFile(PCHAR pPath, PCHAR* ppContent)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pContent = NULL;
+    UINT64 fileLength = 0;
+    BOOL exists = FALSE;
+
+    CHK(pPath != NULL && ppContent != NULL, STATUS_NULL_ARG);
+
+    CHK_STATUS(fileExists(pPath, &exists));
+    CHK(exists, STATUS_NOT_FOUND);
+
+    CHK_STATUS(readFile(pPath, FALSE, NULL, &fileLength));
+    CHK(NULL != (pContent = (PCHAR) MEMALLOC(fileLength + 1)), STATUS_NOT_ENOUGH_MEMORY);
+    CHK_STATUS(readFile(pPath, FALSE, (PBYTE) pContent, &fileLength));
+    pContent[fileLength] = '\0';
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        SAFE_MEMFREE(pContent);
+    }
+
+    if (ppContent != NULL) {
+        *ppContent = pContent;
+    }
+
+    return retStatus;
+}
+
+STATUS writeKvsStateFile(PCHAR pPath, PBYTE pData, UINT64 size)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    gchar* pTempPath = NULL;
+    gint fd = -1;
+
+    CHK(pPath != NULL && pData != NULL, STATUS_NULL_ARG);
+
+    // Replace the file in one go so the readers never see a partial one. The temporary file
+    // is unique across all of the processes and the threads writing to the same path.
+    pTempPath = g_strdup_printf("%s.XXXXXX", pPath);
+    CHK_ERR(-1 != (fd = g_mkstemp(pTempPath)), STATUS_OPEN_FILE_FAILED, "Failed to create %s (error:%s)", pTempPath, strerror(errno));
+    g_close(fd, NULL);
+
+    CHK_STATUS(writeFile(pTempPath, FALSE, FALSE, pData, size));
+    CHK(0 == rename(pTempPath, pPath), STATUS_INVALID_OPERATION);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && fd != -1) {
+        g_unlink(pTempPath);
+    }
+
+    g_free(pTempPath);
+
+    return retStatus;
+}
+
+STATUS findKvsApiCacheEntry(PKvsSharedClient pSharedClient, PCHAR pStreamName, PKvsApiCacheEntry pEntry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pContent = NULL, pLine, pNextLine;
+    BOOL found = FALSE;
+
+    CHK(pSharedClient != NULL && pStreamName != NULL && pEntry != NULL, STATUS_NULL_ARG);
+
+    CHK_STATUS(readKvsStateFile(pSharedClient->apiCachePath, &pContent));
+
+    for (pLine = pContent; !found && pLine != NULL && *pLine != '\0'; pLine = pNextLine) {
+        if (NULL != (pNextLine = STRCHR(pLine, '\n'))) {
+            *pNextLine++ = '\0';
+        }
+
+        // Invalid and expired entries are skipped and dropped by the next update
+        found = STATUS_SUCCEEDED(parseKvsApiCacheEntry(pLine, pEntry)) && pEntry->identity == pSharedClient->apiCacheIdentity &&
+            0 == STRCMP(pEntry->streamName, pStreamName) && 0 == STRCMP(pEntry->region, pSharedClient->region);
+    }
+
+    CHK(found, STATUS_NOT_FOUND);
+
+CleanUp:
+
+    SAFE_MEMFREE(pContent);
+
+    return retStatus;
+}
+
+STATUS updateKvsApiCacheEntry(PKvsSharedClient pSharedClient, PCHAR pStreamName, PCHAR pEndpoint, PCHAR pStreamArn)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pContent = NULL, pLine, pNextLine, pOutput = NULL, pCur;
+    PCHAR pKeptLines[KVS_API_CACHE_MAX_ENTRIES];
+    UINT32 keptCount = 0, i;
+    UINT64 outputSize;
+    KvsApiCacheEntry entry;
+    gchar* pLineCopy;
+
+    CHK(pSharedClient != NULL && pStreamName != NULL, STATUS_NULL_ARG);
+
+    if (pStreamArn == NULL) {
+        pStreamArn = EMPTY_STRING;
+    }
+
+    // A missing or unreadable file is rewritten from scratch
+    if (STATUS_FAILED(readKvsStateFile(pSharedClient->apiCachePath, &pContent))) {
+        pContent = NULL;
+    }
+
+    for (pLine = pContent; pLine != NULL && *pLine != '\0'; pLine = pNextLine) {
+        if (NULL != (pNextLine = STRCHR(pLine, '\n'))) {
+            *pNextLine++ = '\0';
+        }
+
+        // Parsing splits the line up so it's done on a copy
+        pLineCopy = g_strdup(pLine);
+        if (STATUS_SUCCEEDED(parseKvsApiCacheEntry(pLineCopy, &entry)) &&
+            (entry.identity != pSharedClient->apiCacheIdentity || 0 != STRCMP(entry.streamName, pStreamName) ||
+             0 != STRCMP(entry.region, pSharedClient->region))) {
+            // Make room for the newer entries. One slot is left for the updated one.
+            if (keptCount == KVS_API_CACHE_MAX_ENTRIES - 1) {
+                MEMMOVE(pKeptLines, pKeptLines + 1, (keptCount - 1) * SIZEOF(PCHAR));
+                keptCount--;
+            }
+
+            pKeptLines[keptCount++] = pLine;
+        }
+
+        g_free(pLineCopy);
+    }
+
+    outputSize = 1;
+    for (i = 0; i < keptCount; i++) {
+        outputSize += STRLEN(pKeptLines[i]) + 1;
+    }
+
+    if (pEndpoint != NULL) {
+        outputSize += KVS_API_CACHE_IDENTITY_DIGITS + STRLEN(pStreamName) + STRLEN(pSharedClient->region) + STRLEN(pEndpoint) +
+            KVS_API_CACHE_MAX_TIME_DIGITS + STRLEN(pStreamArn) + KVS_API_CACHE_FIELD_COUNT;
+    }
+
+    CHK(NULL != (pOutput = (PCHAR) MEMALLOC(outputSize)), STATUS_NOT_ENOUGH_MEMORY);
+    pCur = pOutput;
+    for (i = 0; i < keptCount; i++) {
+        pCur += SNPRINTF(pCur, outputSize - (pCur - pOutput), "%s\n", pKeptLines[i]);
+    }
+
+    if (pEndpoint != NULL) {
+        pCur += SNPRINTF(pCur, outputSize - (pCur - pOutput), "%08x,%s,%s,%s,%" PRIu64 ",%s\n", pSharedClient->apiCacheIdentity, pStreamName,
+                         pSharedClient->region, pEndpoint, GETTIME(), pStreamArn);
+    }
+
+    CHK_STATUS(writeKvsStateFile(pSharedClient->apiCachePath, (PBYTE) pOutput, (UINT64) (pCur - pOutput)));
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    SAFE_MEMFREE(pContent);
+    SAFE_MEMFREE(pOutput);
+
+    return retStatus;
+}
+
+STATUS getKvsApiCacheStream(PKvsSharedClient pSharedClient, PCHAR pStreamName, PKvsApiCacheStream* ppStream)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsApiCacheStream pStream = NULL;
+    UINT64 streamHash, value = 0;
+    BOOL found = FALSE;
+
+    CHK(pSharedClient != NULL && pStreamName != NULL && ppStream != NULL, STATUS_NULL_ARG);
+
+    streamHash = COMPUTE_CRC32((PBYTE) pStreamName, (UINT32) STRLEN(pStreamName));
+    CHK_STATUS(hashTableContains(pSharedClient->pApiCacheStreams, streamHash, &found));
+    if (found) {
+        CHK_STATUS(hashTableGet(pSharedClient->pApiCacheStreams, streamHash, &value));
+        pStream = (PKvsApiCacheStream) value;
+    } else {
+        CHK(NULL != (pStream = (PKvsApiCacheStream) MEMCALLOC(1, SIZEOF(KvsApiCacheStream))), STATUS_NOT_ENOUGH_MEMORY);
+        CHK_STATUS(hashTablePut(pSharedClient->pApiCacheStreams, streamHash, (UINT64) pStream));
+    }
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        if (!found) {
+            SAFE_MEMFREE(pStream);
+        }
+
+        pStream = NULL;
+    }
+
+    if (ppStream != NULL) {
+        *ppStream = pStream;
+    }
+
+    return retStatus;
+}
+
+STATUS freeKvsApiCacheStreamEntry(UINT64 customData, PHashEntry pHashEntry)
+{
+    UNUSED_PARAM(customData);
+
+    MEMFREE((PKvsApiCacheStream) pHashEntry->value);
+
+    return STATUS_SUCCESS;
+}
+
+STATUS registerKvsApiCacheStream(PGstKvsPlugin pGstKvsPlugin, PStreamInfo pStreamInfo)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient;
+    PKvsApiCacheStream pStream;
+    BOOL locked = FALSE;
+
+    CHK(pGstKvsPlugin != NULL && pStreamInfo != NULL, STATUS_NULL_ARG);
+
+    // Nothing to do for the loopback clients
+    pSharedClient = pGstKvsPlugin->kvsContext.pSharedClient;
+    CHK(pSharedClient != NULL && pSharedClient->pApiCacheStreams != NULL, retStatus);
+
+    G_LOCK(gKvsApiCache);
+    locked = TRUE;
+
+    CHK_STATUS(getKvsApiCacheStream(pSharedClient, pStreamInfo->name, &pStream));
+    pStream->tagged = pStreamInfo->tagCount != 0;
+
+CleanUp:
+
+    if (locked) {
+        G_UNLOCK(gKvsApiCache);
+    }
+
+    return retStatus;
+}
+
+STATUS describeStreamCachingFile(UINT64 customData, PCHAR streamName, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+    PKvsApiCacheStream pStream;
+    StreamDescription streamDescription;
+    KvsApiCacheEntry entry;
+    BOOL served = FALSE;
+
+    CHK(pSharedClient != NULL && streamName != NULL && pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    G_LOCK(gKvsApiCache);
+    if (STATUS_FAILED(getKvsApiCacheStream(pSharedClient, streamName, &pStream))) {
+        DLOGW("Describing stream %s without the API cache", streamName);
+    } else if (pStream->state != 0) {
+        // Described again after an error or a restart of the stream. The results are validated against the service from
+        // here on, dropping the cached ones in case they were the cause.
+        if (pStream->state == KVS_API_CACHE_STREAM_STATE_SERVED) {
+            DLOGI("Dropping the cached results of stream %s", streamName);
+            updateKvsApiCacheEntry(pSharedClient, streamName, NULL, NULL);
+        }
+
+        pStream->state = 0;
+    } else if (STATUS_SUCCEEDED(findKvsApiCacheEntry(pSharedClient, streamName, &entry)) && (!pStream->tagged || entry.streamArn[0] != '\0')) {
+        // The tagged streams need the ARN for the tags to be applied on this run too
+        pStream->state = KVS_API_CACHE_STREAM_STATE_SERVED;
+        STRCPY(pStream->streamArn, entry.streamArn);
+        served = TRUE;
+    }
+    G_UNLOCK(gKvsApiCache);
+
+    if (served) {
+        // Only the streams which were active are cached
+        DLOGI("Stream %s described from the API cache file", streamName);
+        MEMSET(&streamDescription, 0x00, SIZEOF(StreamDescription));
+        streamDescription.version = STREAM_DESCRIPTION_CURRENT_VERSION;
+        STRNCPY(streamDescription.streamName, streamName, MAX_STREAM_NAME_LEN);
+        STRNCPY(streamDescription.streamArn, entry.streamArn, MAX_ARN_LEN);
+        streamDescription.streamStatus = STREAM_STATUS_ACTIVE;
+        streamDescription.creationTime = entry.creationTime;
+        CHK_STATUS(describeStreamResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESULT_OK, &streamDescription));
+    } else {
+        CHK_STATUS(pSharedClient->describeStreamFn(customData, streamName, pServiceCallContext));
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getStreamingEndpointCachingFile(UINT64 customData, PCHAR streamName, PCHAR apiName, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+    PKvsApiCacheStream pStream;
+    KvsApiCacheEntry entry;
+    BOOL served = FALSE;
+
+    CHK(pSharedClient != NULL && streamName != NULL && pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    // The endpoint is only taken from the file along with the description
+    G_LOCK(gKvsApiCache);
+    served = STATUS_SUCCEEDED(getKvsApiCacheStream(pSharedClient, streamName, &pStream)) && pStream->state == KVS_API_CACHE_STREAM_STATE_SERVED &&
+        STATUS_SUCCEEDED(findKvsApiCacheEntry(pSharedClient, streamName, &entry));
+    G_UNLOCK(gKvsApiCache);
+
+    if (served) {
+        DLOGI("Stream %s endpoint %s taken from the API cache file", streamName, entry.endpoint);
+        CHK_STATUS(getStreamingEndpointResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESULT_OK, entry.endpoint));
+    } else {
+        CHK_STATUS(pSharedClient->getStreamingEndpointFn(customData, streamName, apiName, pServiceCallContext));
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS putStreamCachingFile(UINT64 customData, PCHAR streamName, PCHAR containerType, UINT64 startTimestamp, BOOL absoluteFragmentTimestamp,
+                            BOOL ackRequired, PCHAR streamingEndpoint, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+    PKvsApiCacheStream pStream;
+
+    CHK(pSharedClient != NULL && streamName != NULL, STATUS_NULL_ARG);
+
+    // The stream is active and the endpoint known once it's about to be streamed to. Stored once per stream start.
+    if (streamingEndpoint != NULL) {
+        G_LOCK(gKvsApiCache);
+        if (STATUS_SUCCEEDED(getKvsApiCacheStream(pSharedClient, streamName, &pStream)) && pStream->state == 0 &&
+            STATUS_SUCCEEDED(updateKvsApiCacheEntry(pSharedClient, streamName, streamingEndpoint, pStream->streamArn))) {
+            pStream->state = KVS_API_CACHE_STREAM_STATE_STORED;
+        }
+        G_UNLOCK(gKvsApiCache);
+    }
+
+    CHK_STATUS(pSharedClient->putStreamFn(customData, streamName, containerType, startTimestamp, absoluteFragmentTimestamp, ackRequired,
+                                          streamingEndpoint, pServiceCallContext));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS tagResourceCachingFile(UINT64 customData, PCHAR streamArn, UINT32 tagCount, PTag tags, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+    PKvsApiCacheStream pStream;
+    CHAR streamName[MAX_STREAM_NAME_LEN + 1];
+    PCHAR pStart, pEnd;
+    UINT32 nameLen;
+
+    CHK(pSharedClient != NULL && streamArn != NULL && pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    // The ARN is stored along with the results of the stream so the runs served from the file can tag it too.
+    // The stream name is the resource part of the ARN followed by the creation time.
+    if (NULL != (pStart = STRSTR(streamArn, KVS_API_CACHE_ARN_STREAM_PREFIX)) && STRLEN(streamArn) <= MAX_ARN_LEN) {
+        pStart += STRLEN(KVS_API_CACHE_ARN_STREAM_PREFIX);
+        pEnd = STRCHR(pStart, '/');
+        nameLen = pEnd == NULL ? (UINT32) STRLEN(pStart) : (UINT32) (pEnd - pStart);
+        if (nameLen != 0 && nameLen <= MAX_STREAM_NAME_LEN) {
+            STRNCPY(streamName, pStart, nameLen);
+            streamName[nameLen] = '\0';
+
+            G_LOCK(gKvsApiCache);
+            if (STATUS_SUCCEEDED(getKvsApiCacheStream(pSharedClient, streamName, &pStream))) {
+                STRCPY(pStream->streamArn, streamArn);
+            }
+            G_UNLOCK(gKvsApiCache);
+        }
+    }
+
+    CHK_STATUS(pSharedClient->tagResourceFn(customData, streamArn, tagCount, tags, pServiceCallContext));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS initKvsLoopback(PGstKvsPlugin pGstPlugin, PKvsSharedClient pSharedClient)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PClientCallbacks pClientCallbacks;
+
+    CHK(pGstPlugin != NULL && pSharedClient != NULL && pSharedClient->pClientCallbacks != NULL, STATUS_NULL_ARG);
+
+    pClientCallbacks = pSharedClient->pClientCallbacks;
+    pSharedClient->region = g_strdup(pGstPlugin->pRegion);
+    pSharedClient->loopback = TRUE;
+    pSharedClient->loopbackAckDelay = (UINT64) pGstPlugin->gstParams.loopbackAckDelay * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    pSharedClient->loopbackBandwidthBps = pGstPlugin->gstParams.loopbackBandwidth;
+    pSharedClient->loopbackLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pSharedClient->loopbackLock), STATUS_INVALID_OPERATION);
+
+    // The token is still vended by the credential provider which is static in the loopback mode
+    pSharedClient->streamShutdownFn = pClientCallbacks->streamShutdownFn;
+    pClientCallbacks->describeStreamFn = describeStreamLoopback;
+    pClientCallbacks->createStreamFn = createStreamLoopback;
+    pClientCallbacks->getStreamingEndpointFn = getStreamingEndpointLoopback;
+    pClientCallbacks->tagResourceFn = tagResourceLoopback;
+    pClientCallbacks->putStreamFn = putStreamLoopback;
+    pClientCallbacks->streamShutdownFn = streamShutdownLoopback;
+
+    DLOGI("Producer client in the loopback mode with %" PRIu64 " ms ack delay and %u bps bandwidth",
+          pSharedClient->loopbackAckDelay / HUNDREDS_OF_NANOS_IN_A_MILLISECOND, pSharedClient->loopbackBandwidthBps);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS describeStreamLoopback(UINT64 customData, PCHAR streamName, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    StreamDescription streamDescription;
+
+    UNUSED_PARAM(customData);
+    UNUSED_PARAM(streamName);
+    CHK(pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    // Every run creates the stream
+    MEMSET(&streamDescription, 0x00, SIZEOF(StreamDescription));
+    CHK_STATUS(describeStreamResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESOURCE_NOT_FOUND, &streamDescription));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS createStreamLoopback(UINT64 customData, PCHAR deviceName, PCHAR streamName, PCHAR contentType, PCHAR kmsKeyId, UINT64 retention,
+                            PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+    CHAR streamArn[MAX_ARN_LEN + 1];
+
+    UNUSED_PARAM(deviceName);
+    UNUSED_PARAM(contentType);
+    UNUSED_PARAM(kmsKeyId);
+    UNUSED_PARAM(retention);
+    CHK(pSharedClient != NULL && streamName != NULL && pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    SNPRINTF(streamArn, SIZEOF(streamArn), KVS_LOOPBACK_STREAM_ARN_FORMAT, pSharedClient->region, streamName);
+    CHK_STATUS(createStreamResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESULT_OK, streamArn));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getStreamingEndpointLoopback(UINT64 customData, PCHAR streamName, PCHAR apiName, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    UNUSED_PARAM(customData);
+    UNUSED_PARAM(streamName);
+    UNUSED_PARAM(apiName);
+    CHK(pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    CHK_STATUS(getStreamingEndpointResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESULT_OK, KVS_LOOPBACK_ENDPOINT));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS tagResourceLoopback(UINT64 customData, PCHAR streamArn, UINT32 tagCount, PTag tags, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    UNUSED_PARAM(customData);
+    UNUSED_PARAM(streamArn);
+    UNUSED_PARAM(tagCount);
+    UNUSED_PARAM(tags);
+    CHK(pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    CHK_STATUS(tagResourceResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESULT_OK));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS putStreamLoopback(UINT64 customData, PCHAR streamName, PCHAR containerType, UINT64 startTimestamp, BOOL absoluteFragmentTimestamp,
+                         BOOL ackRequired, PCHAR streamingEndpoint, PServiceCallContext pServiceCallContext)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+    PKvsLoopbackUpload pUpload = NULL;
+
+    UNUSED_PARAM(containerType);
+    UNUSED_PARAM(startTimestamp);
+    UNUSED_PARAM(absoluteFragmentTimestamp);
+    UNUSED_PARAM(ackRequired);
+    UNUSED_PARAM(streamingEndpoint);
+    CHK(pSharedClient != NULL && streamName != NULL && pServiceCallContext != NULL, STATUS_NULL_ARG);
+
+    // The sessions ended by the stream rotations and the errors are joined as the new ones start
+    reapKvsLoopbackUploads(pSharedClient, pServiceCallContext->customData, FALSE);
+
+    CHK(NULL != (pUpload = (PKvsLoopbackUpload) MEMCALLOC(1, SIZEOF(KvsLoopbackUpload))), STATUS_NOT_ENOUGH_MEMORY);
+    pUpload->pSharedClient = pSharedClient;
+    pUpload->streamHandle = pServiceCallContext->customData;
+    pUpload->uploadHandle = (UPLOAD_HANDLE) ATOMIC_INCREMENT(&pSharedClient->loopbackUploadHandle);
+    pUpload->tid = INVALID_TID_VALUE;
+    ATOMIC_STORE_BOOL(&pUpload->terminate, FALSE);
+    ATOMIC_STORE_BOOL(&pUpload->done, FALSE);
+
+    CHK_STATUS(putStreamResultEvent(pServiceCallContext->customData, SERVICE_CALL_RESULT_OK, pUpload->uploadHandle));
+    CHK_STATUS(THREAD_CREATE(&pUpload->tid, kvsLoopbackUploadRoutine, (PVOID) pUpload));
+
+    MUTEX_LOCK(pSharedClient->loopbackLock);
+    pUpload->pNext = pSharedClient->pLoopbackUploads;
+    pSharedClient->pLoopbackUploads = pUpload;
+    MUTEX_UNLOCK(pSharedClient->loopbackLock);
+
+    DLOGI("Loopback upload handle %" PRIu64 " started for stream %s", pUpload->uploadHandle, streamName);
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus)) {
+        SAFE_MEMFREE(pUpload);
+    }
+
+    return retStatus;
+}
+
+STATUS streamShutdownLoopback(UINT64 customData, STREAM_HANDLE streamHandle, BOOL resetStream)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = findKvsSharedClientByCallbacks(customData);
+
+    CHK(pSharedClient != NULL, STATUS_NULL_ARG);
+
+    // The sessions of the stream need to be gone before its data is
+    reapKvsLoopbackUploads(pSharedClient, streamHandle, TRUE);
+
+    if (pSharedClient->streamShutdownFn != NULL) {
+        CHK_STATUS(pSharedClient->streamShutdownFn(customData, streamHandle, resetStream));
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID reapKvsLoopbackUploads(PKvsSharedClient pSharedClient, STREAM_HANDLE streamHandle, BOOL terminate)
+{
+    PKvsLoopbackUpload pUpload, pNext, pReaped = NULL;
+    PKvsLoopbackUpload* ppUpload;
+
+    if (pSharedClient == NULL || !IS_VALID_MUTEX_VALUE(pSharedClient->loopbackLock)) {
+        return;
+    }
+
+    // Unlink under the lock and join outside of it
+    MUTEX_LOCK(pSharedClient->loopbackLock);
+    for (ppUpload = &pSharedClient->pLoopbackUploads; *ppUpload != NULL;) {
+        pUpload = *ppUpload;
+        if ((streamHandle == INVALID_STREAM_HANDLE_VALUE || pUpload->streamHandle == streamHandle) &&
+            (terminate || ATOMIC_LOAD_BOOL(&pUpload->done))) {
+            *ppUpload = pUpload->pNext;
+            pUpload->pNext = pReaped;
+            pReaped = pUpload;
+        } else {
+            ppUpload = &pUpload->pNext;
+        }
+    }
+    MUTEX_UNLOCK(pSharedClient->loopbackLock);
+
+    for (pUpload = pReaped; pUpload != NULL; pUpload = pNext) {
+        pNext = pUpload->pNext;
+        ATOMIC_STORE_BOOL(&pUpload->terminate, TRUE);
+        if (IS_VALID_TID_VALUE(pUpload->tid)) {
+            THREAD_JOIN(pUpload->tid, NULL);
+        }
+
+        MEMFREE(pUpload);
+    }
+}
+
+VOID queueKvsLoopbackAck(PKvsLoopbackUpload pUpload, PKvsLoopbackAck acks, PUINT32 pAckHead, PUINT32 pAckCount, UINT64 timecode, UINT64 dueTime)
+{
+    if (*pAckCount == KVS_LOOPBACK_MAX_PENDING_ACKS) {
+        // The acks are due in order so the oldest one goes out early
+        sendKvsLoopbackAck(pUpload, "RECEIVED", acks[*pAckHead].timecode);
+        sendKvsLoopbackAck(pUpload, "PERSISTED", acks[*pAckHead].timecode);
+        *pAckHead = (*pAckHead + 1) % KVS_LOOPBACK_MAX_PENDING_ACKS;
+        (*pAckCount)--;
+    }
+
+    acks[(*pAckHead + *pAckCount) % KVS_LOOPBACK_MAX_PENDING_ACKS].timecode = timecode;
+    acks[(*pAckHead + *pAckCount) % KVS_LOOPBACK_MAX_PENDING_ACKS].dueTime = dueTime;
+    (*pAckCount)++;
+}
+
+PVOID kvsLoopbackUploadRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS, dataStatus = STATUS_SUCCESS;
+    PKvsLoopbackUpload pUpload = (PKvsLoopbackUpload) args;
+    PKvsSharedClient pSharedClient;
+    PBYTE pBuffer = NULL;
+    KvsLoopbackAck acks[KVS_LOOPBACK_MAX_PENDING_ACKS];
+    UINT32 ackHead = 0, ackCount = 0, carrySize = 0, filledSize, size, offset, consumed;
+    UINT64 startTime, now, timecode, openTimecode = 0, paceTime, sleepTime, byteCount = 0;
+    BOOL clusterOpen = FALSE, endOfStream = FALSE;
+
+    CHK(pUpload != NULL, STATUS_NULL_ARG);
+
+    pSharedClient = pUpload->pSharedClient;
+    CHK(NULL != (pBuffer = (PBYTE) MEMALLOC(KVS_LOOPBACK_CLUSTER_HEADER_SIZE + KVS_LOOPBACK_READ_SIZE)), STATUS_NOT_ENOUGH_MEMORY);
+    startTime = GETTIME();
+
+    while (!ATOMIC_LOAD_BOOL(&pUpload->terminate)) {
+        filledSize = 0;
+        if (!endOfStream) {
+            dataStatus =
+                getKinesisVideoStreamData(pUpload->streamHandle, pUpload->uploadHandle, pBuffer + carrySize, KVS_LOOPBACK_READ_SIZE, &filledSize);
+        }
+
+        now = GETTIME();
+
+        // A fragment is complete, and can be acked, once the next cluster or the end of the stream is seen.
+        // The incomplete cluster headers are carried over to the next read.
+        size = carrySize + filledSize;
+        offset = 0;
+        while (STATUS_SUCCEEDED(findKvsLoopbackCluster(pBuffer + offset, size - offset, &consumed, &timecode))) {
+            offset += consumed;
+            if (clusterOpen) {
+                queueKvsLoopbackAck(pUpload, acks, &ackHead, &ackCount, openTimecode, now + pSharedClient->loopbackAckDelay);
+            }
+
+            sendKvsLoopbackAck(pUpload, "BUFFERING", timecode);
+            clusterOpen = TRUE;
+            openTimecode = timecode;
+        }
+
+        offset += consumed;
+        carrySize = size - offset;
+        MEMMOVE(pBuffer, pBuffer + offset, carrySize);
+
+        if (dataStatus == STATUS_END_OF_STREAM && !endOfStream) {
+            endOfStream = TRUE;
+            if (clusterOpen) {
+                queueKvsLoopbackAck(pUpload, acks, &ackHead, &ackCount, openTimecode, now + pSharedClient->loopbackAckDelay);
+            }
+
+            clusterOpen = FALSE;
+        } else if (STATUS_FAILED(dataStatus) && dataStatus != STATUS_NO_MORE_DATA_AVAILABLE && dataStatus != STATUS_AWAITING_PERSISTED_ACK &&
+                   dataStatus != STATUS_END_OF_STREAM) {
+            // Aborted by the stream. The acks of the session are no longer expected.
+            DLOGW("Loopback upload handle %" PRIu64 " stopped with 0x%08x", pUpload->uploadHandle, dataStatus);
+            break;
+        }
+
+        for (; ackCount != 0 && acks[ackHead].dueTime <= now; ackCount--) {
+            sendKvsLoopbackAck(pUpload, "RECEIVED", acks[ackHead].timecode);
+            sendKvsLoopbackAck(pUpload, "PERSISTED", acks[ackHead].timecode);
+            ackHead = (ackHead + 1) % KVS_LOOPBACK_MAX_PENDING_ACKS;
+        }
+
+        if (endOfStream && ackCount == 0) {
+            CHK_STATUS(kinesisVideoStreamTerminated(pUpload->streamHandle, pUpload->uploadHandle, SERVICE_CALL_RESULT_OK));
+            break;
+        }
+
+        // Throttle the reads to the bandwidth
+        byteCount += filledSize;
+        if (pSharedClient->loopbackBandwidthBps != 0) {
+            paceTime = startTime + (UINT64) ((DOUBLE) byteCount * 8 * HUNDREDS_OF_NANOS_IN_A_SECOND / pSharedClient->loopbackBandwidthBps);
+            if (paceTime > now) {
+                THREAD_SLEEP(paceTime - now);
+                continue;
+            }
+        }
+
+        if (filledSize == 0) {
+            sleepTime = KVS_LOOPBACK_POLL_PERIOD;
+            if (ackCount != 0) {
+                sleepTime = MIN(sleepTime, acks[ackHead].dueTime - now);
+            }
+
+            THREAD_SLEEP(sleepTime);
+        }
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    SAFE_MEMFREE(pBuffer);
+
+    if (pUpload != NULL) {
+        ATOMIC_STORE_BOOL(&pUpload->done, TRUE);
+    }
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+STATUS findKvsLoopbackCluster(PBYTE pData, UINT32 size, PUINT32 pConsumed, PUINT64 pTimecode)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 i = 0, j, vintSize, timecodeSize;
+    UINT64 timecode;
+    BOOL found = FALSE;
+
+    CHK(pData != NULL && pConsumed != NULL && pTimecode != NULL, STATUS_NULL_ARG);
+
+    for (i = 0; !found && i + KVS_LOOPBACK_CLUSTER_ID_SIZE <= size; i++) {
+        if (((UINT32) pData[i] << 24 | (UINT32) pData[i + 1] << 16 | (UINT32) pData[i + 2] << 8 | pData[i + 3]) != KVS_LOOPBACK_CLUSTER_ID) {
+            continue;
+        }
+
+        // Wait for the rest of the header
+        CHK(i + KVS_LOOPBACK_CLUSTER_HEADER_SIZE <= size, STATUS_NOT_FOUND);
+
+        // EBML variable size integers are prefixed with the number of their leading zero bits
+        j = i + KVS_LOOPBACK_CLUSTER_ID_SIZE;
+        for (vintSize = 1; vintSize <= 8 && (pData[j] & (0x80 >> (vintSize - 1))) == 0; vintSize++) {
+        }
+
+        j += vintSize;
+        if (vintSize > 8 || pData[j] != KVS_LOOPBACK_TIMECODE_ID || (pData[j + 1] & 0xF0) != 0x80 || (timecodeSize = pData[j + 1] & 0x0F) == 0 ||
+            timecodeSize > 8) {
+            continue;
+        }
+
+        for (j += 2, timecode = 0; timecodeSize != 0; timecodeSize--, j++) {
+            timecode = (timecode << 8) | pData[j];
+        }
+
+        *pTimecode = timecode;
+        i = j - 1;
+        found = TRUE;
+    }
+
+    CHK(found, STATUS_NOT_FOUND);
+
+CleanUp:
+
+    // Everything up to the end of the header or to a possible partial cluster ID or header is consumed
+    if (pConsumed != NULL) {
+        *pConsumed = i;
+    }
+
+    return retStatus;
+}
+
+STATUS sendKvsLoopbackAck(PKvsLoopbackUpload pUpload, PCHAR eventType, UINT64 timecode)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR ack[KVS_LOOPBACK_ACK_BUFFER_SIZE];
+    INT32 length;
+
+    CHK(pUpload != NULL && eventType != NULL, STATUS_NULL_ARG);
+
+    // Same shape as the acks of PutMedia. The fragment number only needs to be unique.
+    length = SNPRINTF(ack, SIZEOF(ack), KVS_LOOPBACK_ACK_FORMAT, eventType, timecode, timecode);
+    CHK(length > 0 && (UINT32) length < SIZEOF(ack), STATUS_BUFFER_TOO_SMALL);
+    CHK_STATUS(kinesisVideoStreamParseFragmentAck(pUpload->streamHandle, pUpload->uploadHandle, ack, (UINT32) length));
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
+STATUS identifyCpdNalFormat(PBYTE pData, UINT32 size, ELEMENTARY_STREAM_NAL_FORMAT* pFormat)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    ELEMENTARY_STREAM_NAL_FORMAT format = ELEMENTARY_STREAM_NAL_FORMAT_UNKNOWN;
+    BYTE start3ByteCode[] = {0x00, 0x00, 0x01};
+    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
+    BYTE start5ByteCode[] = {0x00, 0x00, 0x00, 0x00, 0x01};
+
+    CHK(pData != NULL && pFormat != NULL, STATUS_NULL_ARG);
+    CHK(size > SIZEOF(start5ByteCode), STATUS_FORMAT_ERROR);
+
+    // We really do very crude check for the Annex-B start code
+
+    // First of all, we need to determine what format the CPD is in - Annex-B, Avcc or raw
+    // NOTE: Some "bad" encoders encode an extra 0 at the end of the NALu resulting in
+    // an extra zero interfering with the Annex-B start code so we check for 4 zeroes and 1
+    if ((0 == MEMCMP(pData, start5ByteCode, SIZEOF(start5ByteCode))) || (0 == MEMCMP(pData, start4ByteCode, SIZEOF(start4ByteCode))) ||
+        (0 == MEMCMP(pData, start3ByteCode, SIZEOF(start3ByteCode)))) {
+        // Must be an Annex-B format
+        format = ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B;
+
+        // Early exit
+        CHK(FALSE, retStatus);
+    } else if (pData[0] == AVCC_VERSION_CODE && pData[4] == AVCC_NALU_LEN_MINUS_ONE && pData[5] == AVCC_NUMBER_OF_SPS_ONE) {
+        // Looks like an AvCC format
+        format = ELEMENTARY_STREAM_NAL_FORMAT_AVCC;
+    } else if (size > HEVC_CPD_HEADER_SIZE && pData[0] == 1 && (pData[13] & 0xf0) == 0xf0 && (pData[15] & 0xfc) == 0xfc &&
+               (pData[16] & 0xfc) != 0xfc && (pData[17] & 0xf8) != 0xf8 && (pData[18] & 0xf8) != 0xf8) {
+        // Looks like an HEVC format
+        format = ELEMENTARY_STREAM_NAL_FORMAT_HEVC;
+    }
+
+CleanUp:
+
+    if (pFormat != NULL) {
+        *pFormat = format;
+    }
+
+    return retStatus;
+}
+
+STATUS convertCpdFromAvcToAnnexB(PGstKvsPlugin pGstKvsPlugin, PBYTE pData, UINT32 size)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 i, offset = 0;
+    UINT16 spsSize, ppsSize;
+    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
+    PBYTE pSrc = pData, pEnd = pData + size;
+
+    CHK(pData != NULL && pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(size > 8, STATUS_FORMAT_ERROR);
+
+    // Skip to SPS size and read the nalu count
+    pSrc += 6;
+    spsSize = GET_UNALIGNED_BIG_ENDIAN((PUINT16) pSrc);
+    pSrc += SIZEOF(UINT16);
+
+    CHK(offset + SIZEOF(start4ByteCode) + spsSize < GST_PLUGIN_MAX_CPD_SIZE, STATUS_FORMAT_ERROR);
+    CHK(pSrc + spsSize <= pEnd, STATUS_FORMAT_ERROR);
+
+    // Output the Annex-B start code
+    MEMCPY(pGstKvsPlugin->videoCpd + offset, start4ByteCode, SIZEOF(start4ByteCode));
+    offset += SIZEOF(start4ByteCode);
+
+    // Output the NALu
+    MEMCPY(pGstKvsPlugin->videoCpd + offset, pSrc, spsSize);
+    offset += spsSize;
+    pSrc += spsSize;
+
+    // Skip pps count
+    pSrc++;
+
+    // Read pps size
+    CHK(pSrc + SIZEOF(UINT16) <= pEnd, STATUS_FORMAT_ERROR);
+    ppsSize = GET_UNALIGNED_BIG_ENDIAN((PUINT16) pSrc);
+    pSrc += SIZEOF(UINT16);
+
+    CHK(offset + SIZEOF(start4ByteCode) + ppsSize < GST_PLUGIN_MAX_CPD_SIZE, STATUS_FORMAT_ERROR);
+    CHK(pSrc + ppsSize <= pEnd, STATUS_FORMAT_ERROR);
+
+    // Output the Annex-B start code
+    MEMCPY(pGstKvsPlugin->videoCpd + offset, start4ByteCode, SIZEOF(start4ByteCode));
+    offset += SIZEOF(start4ByteCode);
+
+    // Output the NALu
+    MEMCPY(pGstKvsPlugin->videoCpd + offset, pSrc, ppsSize);
+    offset += ppsSize;
+
+    pGstKvsPlugin->videoCpdSize = offset;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS convertCpdFromHevcToAnnexB(PGstKvsPlugin pGstKvsPlugin, PBYTE pData, UINT32 size)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 i, naluCount, offset = 0;
+    UINT16 naluUnitLen;
+    BYTE start4ByteCode[] = {0x00, 0x00, 0x00, 0x01};
+    PBYTE pSrc = pData, pEnd = pData + size;
+
+    CHK(pData != NULL && pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(size > 23, STATUS_FORMAT_ERROR);
+
+    // Skip to numOfArrays and read the nalu count
+    pSrc += 22;
+    naluCount = *pSrc;
+    pSrc++;
+
+    for (i = 0; i < naluCount; i++) {
+        // Skip array_completeness, reserved and NAL_unit_type
+        pSrc += 3;
+
+        CHK(pSrc + SIZEOF(UINT16) <= pEnd, STATUS_FORMAT_ERROR);
+
+        // Read the naluUnitLength
+        naluUnitLen = GET_UNALIGNED_BIG_ENDIAN((PUINT16) pSrc);
 
         pSrc += SIZEOF(UINT16);
 
-        CHK(offset + SIZEOF(start4ByteCode) + naluUnitLen < GST_PLUGIN_MAX_CPD_SIZE, STATUS_FORMAT_ERROR);
-        CHK(pSrc + naluUnitLen <= pEnd, STATUS_FORMAT_ERROR);
+        CHK(offset + SIZEOF(start4ByteCode) + naluUnitLen < GST_PLUGIN_MAX_CPD_SIZE, STATUS_FORMAT_ERROR);
+        CHK(pSrc + naluUnitLen <= pEnd, STATUS_FORMAT_ERROR);
+
+        // Output the Annex-B start code
+        MEMCPY(pGstKvsPlugin->videoCpd + offset, start4ByteCode, SIZEOF(start4ByteCode));
+        offset += SIZEOF(start4ByteCode);
+
+        // Output the NALu
+        MEMCPY(pGstKvsPlugin->videoCpd + offset, pSrc, naluUnitLen);
+        offset += naluUnitLen;
+        pSrc += naluUnitLen;
+    }
+
+    pGstKvsPlugin->videoCpdSize = offset;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS startKinesisVideoIngest(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    // The drops are counted the same way for the synchronous puts
+    ATOMIC_STORE(&pGstKvsPlugin->ingestDroppedFrameCount, 0);
+    pGstKvsPlugin->ingestAwaitingKeyFrame = FALSE;
+
+    // Frames are put synchronously on the streaming thread if the queue is disabled
+    CHK(pGstKvsPlugin->gstParams.ingestQueueSize != 0 && pGstKvsPlugin->pIngestRing == NULL, retStatus);
+
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->ingestTerminate, FALSE);
+    ATOMIC_STORE(&pGstKvsPlugin->ingestPendingCount, 0);
+
+    pGstKvsPlugin->ingestLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pGstKvsPlugin->ingestLock), STATUS_INVALID_OPERATION);
+    pGstKvsPlugin->ingestCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pGstKvsPlugin->ingestCvar), STATUS_INVALID_OPERATION);
+    CHK_STATUS(createSpscRing(pGstKvsPlugin->gstParams.ingestQueueSize, &pGstKvsPlugin->pIngestRing));
+
+    CHK_STATUS(THREAD_CREATE(&pGstKvsPlugin->ingestTid, putKinesisVideoFramesRoutine, (PVOID) pGstKvsPlugin));
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
+STATUS stopKinesisVideoIngest(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsIngestFrame pIngestFrame;
+    UINT64 data;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->ingestTerminate, TRUE);
+
+    if (IS_VALID_TID_VALUE(pGstKvsPlugin->ingestTid)) {
+        MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+        CVAR_BROADCAST(pGstKvsPlugin->ingestCvar);
+        MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+        THREAD_JOIN(pGstKvsPlugin->ingestTid, NULL);
+        pGstKvsPlugin->ingestTid = INVALID_TID_VALUE;
+    }
+
+    // Release the frames which didn't make it to the stream
+    if (pGstKvsPlugin->pIngestRing != NULL) {
+        while (spscRingTryDequeue(pGstKvsPlugin->pIngestRing, &data)) {
+            pIngestFrame = (PKvsIngestFrame) data;
+            gst_buffer_unref(pIngestFrame->pBuffer);
+            MEMFREE(pIngestFrame);
+        }
+
+        freeSpscRing(&pGstKvsPlugin->pIngestRing);
+    }
+
+    if (IS_VALID_CVAR_VALUE(pGstKvsPlugin->ingestCvar)) {
+        CVAR_FREE(pGstKvsPlugin->ingestCvar);
+        pGstKvsPlugin->ingestCvar = INVALID_CVAR_VALUE;
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->ingestLock)) {
+        MUTEX_FREE(pGstKvsPlugin->ingestLock);
+        pGstKvsPlugin->ingestLock = INVALID_MUTEX_VALUE;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS flushKinesisVideoIngest(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pIngestRing != NULL, retStatus);
+
+    // Wait for the queued frames to be put before stopping the stream
+    MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+    while (ATOMIC_LOAD(&pGstKvsPlugin->ingestPendingCount) != 0 && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->ingestTerminate)) {
+        CVAR_WAIT(pGstKvsPlugin->ingestCvar, pGstKvsPlugin->ingestLock, KVS_INGEST_WAIT_PERIOD);
+    }
+    MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS enqueueKinesisVideoFrame(PGstKvsPlugin pGstKvsPlugin, GstBuffer* pBuffer, PFrame pFrame, UINT64 arrivalTime)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsIngestFrame pIngestFrame = NULL;
+    BOOL block;
+
+    CHK(pGstKvsPlugin != NULL && pBuffer != NULL && pFrame != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pIngestRing != NULL, STATUS_INVALID_OPERATION);
+
+    // The stream can only resume from a key frame after dropping
+    if (pGstKvsPlugin->ingestAwaitingKeyFrame) {
+        if (!CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags)) {
+            ATOMIC_INCREMENT(&pGstKvsPlugin->ingestDroppedFrameCount);
+            CHK(FALSE, retStatus);
+        }
+
+        pGstKvsPlugin->ingestAwaitingKeyFrame = FALSE;
+    }
+
+    CHK(NULL != (pIngestFrame = (PKvsIngestFrame) MEMALLOC(SIZEOF(KvsIngestFrame))), STATUS_NOT_ENOUGH_MEMORY);
+    pIngestFrame->pBuffer = gst_buffer_ref(pBuffer);
+    pIngestFrame->frame = *pFrame;
+    pIngestFrame->arrivalTime = arrivalTime;
+
+    // Offline streaming relies on the backpressure so the frames are never dropped. Neither are the
+    // pre-event frames which are flushed in one go past the queue size.
+    block = pGstKvsPlugin->gstParams.ingestDropPolicy == KVS_INGEST_DROP_POLICY_BLOCK ||
+        IS_OFFLINE_STREAMING_MODE(pGstKvsPlugin->gstParams.streamingType) || pGstKvsPlugin->preEventRing.flushing;
+
+    // Account for the frame before it's visible to the ingest thread so the flush doesn't miss it
+    ATOMIC_INCREMENT(&pGstKvsPlugin->ingestPendingCount);
+
+    while (!spscRingTryEnqueue(pGstKvsPlugin->pIngestRing, (UINT64) pIngestFrame)) {
+        if (!block || ATOMIC_LOAD_BOOL(&pGstKvsPlugin->ingestTerminate)) {
+            ATOMIC_DECREMENT(&pGstKvsPlugin->ingestPendingCount);
+            ATOMIC_INCREMENT(&pGstKvsPlugin->ingestDroppedFrameCount);
+            pGstKvsPlugin->ingestAwaitingKeyFrame = TRUE;
+            ATOMIC_STORE_BOOL(&pGstKvsPlugin->keyUnitRequested, TRUE);
+            DLOGW("KVS ingest queue is full. Dropping frames until the next key frame");
+            CHK(FALSE, retStatus);
+        }
+
+        MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+        // Re-check under the lock so the signal from the ingest thread is not missed
+        if (spscRingGetCount(pGstKvsPlugin->pIngestRing) == pGstKvsPlugin->pIngestRing->capacity &&
+            !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->ingestTerminate)) {
+            CVAR_WAIT(pGstKvsPlugin->ingestCvar, pGstKvsPlugin->ingestLock, KVS_INGEST_WAIT_PERIOD);
+        }
+        MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+    }
+
+    // The ingest thread owns the frame now
+    pIngestFrame = NULL;
+
+    MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+    CVAR_BROADCAST(pGstKvsPlugin->ingestCvar);
+    MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+
+CleanUp:
+
+    if (pIngestFrame != NULL) {
+        gst_buffer_unref(pIngestFrame->pBuffer);
+        MEMFREE(pIngestFrame);
+    }
+
+    return retStatus;
+}
+
+BOOL admitKinesisVideoSyncFrame(PGstKvsPlugin pGstKvsPlugin, PFrame pFrame)
+{
+    if (pGstKvsPlugin == NULL || pFrame == NULL) {
+        return FALSE;
+    }
+
+    // Without the queue there's nothing to hold the live frames in until the stream has been created
+    // in the background. They are dropped rather than holding up the pipeline on the stream creation.
+    // The offline uploads rely on the backpressure so they wait for the stream instead.
+    if (!IS_OFFLINE_STREAMING_MODE(pGstKvsPlugin->gstParams.streamingType) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStartupDone)) {
+        ATOMIC_INCREMENT(&pGstKvsPlugin->ingestDroppedFrameCount);
+        pGstKvsPlugin->ingestAwaitingKeyFrame = TRUE;
+        return FALSE;
+    }
+
+    if (STATUS_FAILED(awaitKinesisVideoStream(pGstKvsPlugin))) {
+        return FALSE;
+    }
+
+    // The stream can only start from a key frame after dropping
+    if (pGstKvsPlugin->ingestAwaitingKeyFrame) {
+        if (!CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags)) {
+            ATOMIC_INCREMENT(&pGstKvsPlugin->ingestDroppedFrameCount);
+            ATOMIC_STORE_BOOL(&pGstKvsPlugin->keyUnitRequested, TRUE);
+            return FALSE;
+        }
+
+        pGstKvsPlugin->ingestAwaitingKeyFrame = FALSE;
+    }
+
+    return TRUE;
+}
+
+PVOID putKinesisVideoFramesRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS, status;
+    PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) args;
+    PKvsIngestFrame pIngestFrame;
+    GstMapInfo info;
+    UINT64 data, putStartTime;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    while (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->ingestTerminate)) {
+        // The frames queued ahead of the stream creation are held until it's ready
+        if (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady)) {
+            MUTEX_LOCK(pGstKvsPlugin->startupLock);
+            if (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->ingestTerminate)) {
+                CVAR_WAIT(pGstKvsPlugin->startupCvar, pGstKvsPlugin->startupLock, KVS_INGEST_WAIT_PERIOD);
+            }
+            MUTEX_UNLOCK(pGstKvsPlugin->startupLock);
+            continue;
+        }
+
+        if (!spscRingTryDequeue(pGstKvsPlugin->pIngestRing, &data)) {
+            MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+            // Re-check under the lock so the signal from the producer is not missed
+            if (spscRingGetCount(pGstKvsPlugin->pIngestRing) == 0 && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->ingestTerminate)) {
+                CVAR_WAIT(pGstKvsPlugin->ingestCvar, pGstKvsPlugin->ingestLock, KVS_INGEST_WAIT_PERIOD);
+            }
+            MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+            continue;
+        }
+
+        pIngestFrame = (PKvsIngestFrame) data;
+
+        // Let the blocked producer know there is space in the queue
+        MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+        CVAR_BROADCAST(pGstKvsPlugin->ingestCvar);
+        MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+
+        if (gst_buffer_map(pIngestFrame->pBuffer, &info, GST_MAP_READ)) {
+            pIngestFrame->frame.frameData = info.data;
+            pIngestFrame->frame.size = (UINT32) info.size;
+
+            putStartTime = GST_PLUGIN_MONOTONIC_TIME();
+            if (STATUS_FAILED(status = putKinesisVideoStreamFrame(pGstKvsPlugin, &pIngestFrame->frame))) {
+                DLOGW("Failed to put frame with 0x%08x", status);
+            }
+
+            recordPutFrameLatency(pGstKvsPlugin, putStartTime, pIngestFrame->arrivalTime);
+
+            gst_buffer_unmap(pIngestFrame->pBuffer, &info);
+        } else {
+            DLOGW("Failed to map the buffer of frame %u", pIngestFrame->frame.index);
+        }
+
+        gst_buffer_unref(pIngestFrame->pBuffer);
+        MEMFREE(pIngestFrame);
+
+        // Wake up the flush once the queue has drained
+        if (ATOMIC_DECREMENT(&pGstKvsPlugin->ingestPendingCount) == 1) {
+            MUTEX_LOCK(pGstKvsPlugin->ingestLock);
+            CVAR_BROADCAST(pGstKvsPlugin->ingestCvar);
+            MUTEX_UNLOCK(pGstKvsPlugin->ingestLock);
+        }
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+STATUS holdKinesisVideoPreEventFrame(PGstKvsPlugin pGstKvsPlugin, GstBuffer* pBuffer, PFrame pFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsPreEventRing pRing;
+    PKvsIngestFrame pHeldFrame = NULL;
+    UINT64 duration, size;
+
+    CHK(pGstKvsPlugin != NULL && pBuffer != NULL && pFrame != NULL, STATUS_NULL_ARG);
+
+    pRing = &pGstKvsPlugin->preEventRing;
+    duration = (UINT64) pGstKvsPlugin->gstParams.preEventDurationInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+    size = gst_buffer_get_size(pBuffer);
+
+    // The oldest GoP goes once the ones after it cover the duration
+    while (dropKinesisVideoPreEventGop(pGstKvsPlugin, pFrame->presentationTs - MIN(pFrame->presentationTs, duration))) {
+    }
+
+    // Past the bounds the oldest GoPs go first. A single GoP past them is of no use so the ring starts over.
+    while (pRing->count != 0 && (pRing->count == KVS_PRE_EVENT_MAX_FRAMES || pRing->size + size > KVS_PRE_EVENT_MAX_SIZE)) {
+        if (!dropKinesisVideoPreEventGop(pGstKvsPlugin, MAX_UINT64)) {
+            DLOGV("Pre-event bounds exceeded with %u frames of %" PRIu64 " bytes", pRing->count, pRing->size);
+            clearKinesisVideoPreEventRing(pGstKvsPlugin);
+        }
+    }
+
+    // The ring always starts at a key frame
+    CHK(pRing->count != 0 || CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags), retStatus);
+
+    CHK(NULL != (pHeldFrame = (PKvsIngestFrame) MEMALLOC(SIZEOF(KvsIngestFrame))), STATUS_NOT_ENOUGH_MEMORY);
+
+    // Pooled buffers are copied so holding them for the duration doesn't starve the upstream pool
+    pHeldFrame->pBuffer = pBuffer->pool != NULL ? gst_buffer_copy_deep(pBuffer) : gst_buffer_ref(pBuffer);
+    CHK(pHeldFrame->pBuffer != NULL, STATUS_NOT_ENOUGH_MEMORY);
+    pHeldFrame->frame = *pFrame;
+    pHeldFrame->frame.size = (UINT32) size;
+    pHeldFrame->arrivalTime = 0;
+
+    pRing->frames[(pRing->head + pRing->count) % KVS_PRE_EVENT_MAX_FRAMES] = pHeldFrame;
+    pRing->count++;
+    pRing->size += size;
+
+    // The ring owns the frame now
+    pHeldFrame = NULL;
+
+CleanUp:
+
+    SAFE_MEMFREE(pHeldFrame);
+
+    return retStatus;
+}
+
+STATUS flushKinesisVideoPreEventRing(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS, status;
+    PKvsPreEventRing pRing;
+    PKvsIngestFrame pHeldFrame;
+    GstMapInfo info;
+    UINT64 putStartTime;
+    BOOL ready;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    pRing = &pGstKvsPlugin->preEventRing;
+    CHK(pRing->count != 0, retStatus);
+
+    DLOGI("Flushing %u pre-event frames of %" PRIu64 " bytes", pRing->count, pRing->size);
+
+    // Without the queue the frames are put synchronously once the stream is there
+    ready = pGstKvsPlugin->pIngestRing != NULL || STATUS_SUCCEEDED(awaitKinesisVideoStream(pGstKvsPlugin));
+
+    pRing->flushing = TRUE;
+    while (ready && pRing->count != 0) {
+        pHeldFrame = pRing->frames[pRing->head];
+
+        // The frames keep their original timestamps. The time they were held is not part of the ingest latency.
+        pHeldFrame->arrivalTime = GST_PLUGIN_MONOTONIC_TIME();
+        if (pGstKvsPlugin->pIngestRing != NULL) {
+            if (STATUS_FAILED(status = enqueueKinesisVideoFrame(pGstKvsPlugin, pHeldFrame->pBuffer, &pHeldFrame->frame, pHeldFrame->arrivalTime))) {
+                DLOGW("Failed to queue pre-event frame for KVS ingest with 0x%08x", status);
+            }
+        } else if (gst_buffer_map(pHeldFrame->pBuffer, &info, GST_MAP_READ)) {
+            pHeldFrame->frame.frameData = info.data;
+            pHeldFrame->frame.size = (UINT32) info.size;
+
+            putStartTime = GST_PLUGIN_MONOTONIC_TIME();
+            if (STATUS_FAILED(status = putKinesisVideoStreamFrame(pGstKvsPlugin, &pHeldFrame->frame))) {
+                DLOGW("Failed to put pre-event frame with 0x%08x", status);
+            }
+
+            recordPutFrameLatency(pGstKvsPlugin, putStartTime, pHeldFrame->arrivalTime);
+
+            gst_buffer_unmap(pHeldFrame->pBuffer, &info);
+        } else {
+            DLOGW("Failed to map the buffer of pre-event frame %u", pHeldFrame->frame.index);
+        }
+
+        releaseKinesisVideoPreEventFrame(pGstKvsPlugin);
+    }
+
+    pRing->flushing = FALSE;
+
+    // Nothing is going to be put if the stream didn't come up
+    clearKinesisVideoPreEventRing(pGstKvsPlugin);
+
+CleanUp:
+
+    return retStatus;
+}
+
+BOOL dropKinesisVideoPreEventGop(PGstKvsPlugin pGstKvsPlugin, UINT64 cutoff)
+{
+    PKvsPreEventRing pRing;
+    UINT32 i;
+
+    if (pGstKvsPlugin == NULL) {
+        return FALSE;
+    }
+
+    // Find the key frame starting the second GoP
+    pRing = &pGstKvsPlugin->preEventRing;
+    for (i = 1; i < pRing->count && !CHECK_FRAME_FLAG_KEY_FRAME(pRing->frames[(pRing->head + i) % KVS_PRE_EVENT_MAX_FRAMES]->frame.flags); i++) {
+    }
+
+    // The oldest GoP is only dropped if the rest still starts at a key frame at or before the cutoff
+    if (i >= pRing->count || pRing->frames[(pRing->head + i) % KVS_PRE_EVENT_MAX_FRAMES]->frame.presentationTs > cutoff) {
+        return FALSE;
+    }
+
+    while (i-- > 0) {
+        releaseKinesisVideoPreEventFrame(pGstKvsPlugin);
+    }
+
+    return TRUE;
+}
+
+VOID releaseKinesisVideoPreEventFrame(PGstKvsPlugin pGstKvsPlugin)
+{
+    PKvsPreEventRing pRing;
+    PKvsIngestFrame pHeldFrame;
+
+    if (pGstKvsPlugin == NULL || pGstKvsPlugin->preEventRing.count == 0) {
+        return;
+    }
+
+    pRing = &pGstKvsPlugin->preEventRing;
+    pHeldFrame = pRing->frames[pRing->head];
+    pRing->frames[pRing->head] = NULL;
+    pRing->head = (pRing->head + 1) % KVS_PRE_EVENT_MAX_FRAMES;
+    pRing->count--;
+    pRing->size -= pHeldFrame->frame.size;
+
+    gst_buffer_unref(pHeldFrame->pBuffer);
+    MEMFREE(pHeldFrame);
+}
+
+VOID clearKinesisVideoPreEventRing(PGstKvsPlugin pGstKvsPlugin)
+{
+    if (pGstKvsPlugin == NULL) {
+        return;
+    }
+
+    while (pGstKvsPlugin->preEventRing.count != 0) {
+        releaseKinesisVideoPreEventFrame(pGstKvsPlugin);
+    }
+
+    pGstKvsPlugin->preEventRing.head = 0;
+}
+
+STATUS createKinesisVideoPadStream(PGstKvsPlugin pGstKvsPlugin, const gchar* padName, guint padIndex, PKvsPadStream* ppPadStream)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsPadStream pPadStream = NULL, *ppCurPadStream;
+
+    CHK(pGstKvsPlugin != NULL && padName != NULL && ppPadStream != NULL, STATUS_NULL_ARG);
+
+    // The streams of the released pads are gone so a name still in the list belongs to a live pad
+    for (ppCurPadStream = &pGstKvsPlugin->pPadStreams; *ppCurPadStream != NULL; ppCurPadStream = &(*ppCurPadStream)->pNext) {
+        CHK(0 != STRCMP((*ppCurPadStream)->padName, padName), STATUS_INVALID_ARG);
+    }
+
+    CHK(NULL != (pPadStream = (PKvsPadStream) MEMCALLOC(1, SIZEOF(KvsPadStream))), STATUS_NOT_ENOUGH_MEMORY);
+    pPadStream->padName = g_strdup(padName);
+    pPadStream->padIndex = padIndex;
+    pPadStream->streamHandle = INVALID_STREAM_HANDLE_VALUE;
+    pPadStream->lock = MUTEX_CREATE(FALSE);
+    pPadStream->firstPts = GST_CLOCK_TIME_NONE;
+    pPadStream->producerStartTime = GST_CLOCK_TIME_NONE;
+
+    *ppCurPadStream = pPadStream;
+
+CleanUp:
+
+    if (ppPadStream != NULL) {
+        *ppPadStream = pPadStream;
+    }
+
+    return retStatus;
+}
+
+STATUS initKinesisVideoPadStream(PGstKvsPlugin pGstKvsPlugin, PKvsPadStream pPadStream, GstCaps* caps)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    GstTags gstTags;
+    const gchar* mediaType;
+    const gchar* configuredName = NULL;
+    gchar* streamName = NULL;
+    PCHAR pCodecId = DEFAULT_CODEC_ID_H264, pContentType = VIDEO_H264_CONTENT_TYPE;
+
+    CHK(pGstKvsPlugin != NULL && pPadStream != NULL && caps != NULL, STATUS_NULL_ARG);
+    CHK(!IS_VALID_STREAM_HANDLE(pPadStream->streamHandle), retStatus);
+    CHK(IS_VALID_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.clientHandle), STATUS_INVALID_OPERATION);
+
+    mediaType = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if (STRNCMP(mediaType, GSTREAMER_MEDIA_TYPE_H265, MAX_GSTREAMER_MEDIA_TYPE_LEN) == 0) {
+        pCodecId = DEFAULT_CODEC_ID_H265;
+        pContentType = VIDEO_H265_CONTENT_TYPE;
+    } else if (STRNCMP(mediaType, GSTREAMER_MEDIA_TYPE_H264, MAX_GSTREAMER_MEDIA_TYPE_LEN) != 0) {
+        DLOGE("Error, media type %s not accepted by pad %s", mediaType, pPadStream->padName);
+        CHK(FALSE, STATUS_INVALID_ARG);
+    }
+
+    if (pGstKvsPlugin->gstParams.padStreamNames != NULL) {
+        configuredName = gst_structure_get_string(pGstKvsPlugin->gstParams.padStreamNames, pPadStream->padName);
+    }
+
+    streamName = (configuredName != NULL) ? g_strdup(configuredName)
+                                          : g_strdup_printf("%s-%u", pGstKvsPlugin->gstParams.streamName, pPadStream->padIndex);
+
+    CHK_STATUS(gstStructToTags(pGstKvsPlugin->gstParams.streamTags, &gstTags));
+
+    if (pPadStream->pStreamInfo != NULL) {
+        freeStreamInfoProvider(&pPadStream->pStreamInfo);
+    }
+
+    CHK_STATUS(createRealtimeVideoStreamInfoProvider(streamName, pGstKvsPlugin->gstParams.retentionPeriodInHours * HUNDREDS_OF_NANOS_IN_AN_HOUR,
+                                                     pGstKvsPlugin->gstParams.bufferDurationInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND,
+                                                     &pPadStream->pStreamInfo));
+
+    pPadStream->pStreamInfo->tagCount = gstTags.tagCount;
+    pPadStream->pStreamInfo->tags = gstTags.tags;
+    STRNCPY(pPadStream->pStreamInfo->streamCaps.contentType, pContentType, MAX_CONTENT_TYPE_LEN);
+    applyStreamInfoParams(pGstKvsPlugin, pPadStream->pStreamInfo);
+    STRNCPY(pPadStream->pStreamInfo->streamCaps.trackInfoList[0].codecId, pCodecId, MKV_MAX_CODEC_ID_LEN);
+
+    CHK_STATUS(registerKvsApiCacheStream(pGstKvsPlugin, pPadStream->pStreamInfo));
+    CHK_STATUS(createKinesisVideoStreamSync(pGstKvsPlugin->kvsContext.clientHandle, pPadStream->pStreamInfo, &pPadStream->streamHandle));
+
+    pPadStream->streamStopped = FALSE;
+    pPadStream->cpdReceived = FALSE;
+    pPadStream->firstPts = GST_CLOCK_TIME_NONE;
+    pPadStream->lastDts = 0;
+    pPadStream->producerStartTime = GST_CLOCK_TIME_NONE;
+    pPadStream->frameCount = 0;
+
+    DLOGI("Stream %s of pad %s is ready", streamName, pPadStream->padName);
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    g_free(streamName);
+
+    return retStatus;
+}
+
+STATUS setKinesisVideoPadStreamCpd(PGstKvsPlugin pGstKvsPlugin, PKvsPadStream pPadStream, PBYTE pCpd, UINT32 cpdSize)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    ELEMENTARY_STREAM_NAL_FORMAT format;
+    UINT32 nalFlags = NAL_ADAPTATION_FLAG_NONE;
+
+    CHK(pGstKvsPlugin != NULL && pPadStream != NULL && pCpd != NULL, STATUS_NULL_ARG);
+    CHK(IS_VALID_STREAM_HANDLE(pPadStream->streamHandle) && !pPadStream->cpdReceived, retStatus);
 
-        // Output the Annex-B start code
-        MEMCPY(pGstKvsPlugin->videoCpd + offset, start4ByteCode, SIZEOF(start4ByteCode));
-        offset += SIZEOF(start4ByteCode);
+    CHK_STATUS(identifyCpdNalFormat(pCpd, cpdSize, &format));
 
-        // Output the NALu
-        MEMCPY(pGstKvsPlugin->videoCpd + offset, pSrc, naluUnitLen);
-        offset += naluUnitLen;
-        pSrc += naluUnitLen;
+    // Prior to setting the CPD we need to set the flags
+    if (pGstKvsPlugin->gstParams.adaptCpdNals && format == ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B) {
+        nalFlags |= NAL_ADAPTATION_ANNEXB_CPD_NALS;
     }
 
-    pGstKvsPlugin->videoCpdSize = offset;
+    if (pGstKvsPlugin->gstParams.adaptFrameNals && format == ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B) {
+        nalFlags |= NAL_ADAPTATION_ANNEXB_NALS;
+    }
+
+    CHK_STATUS(kinesisVideoStreamSetNalAdaptationFlags(pPadStream->streamHandle, nalFlags));
+    CHK_STATUS(kinesisVideoStreamFormatChanged(pPadStream->streamHandle, cpdSize, pCpd, DEFAULT_VIDEO_TRACK_ID));
+
+    pPadStream->cpdReceived = TRUE;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS putKinesisVideoPadFrame(PGstKvsPlugin pGstKvsPlugin, PKvsPadStream pPadStream, GstBuffer* buf)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    GstMapInfo info;
+    Frame frame;
+
+    info.data = NULL;
+
+    CHK(pGstKvsPlugin != NULL && pPadStream != NULL && buf != NULL, STATUS_NULL_ARG);
+    // The frames of the additional pads are dropped until their streams are created in the background
+    CHK(ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady), retStatus);
+    CHK(IS_VALID_STREAM_HANDLE(pPadStream->streamHandle) && !pPadStream->streamStopped, retStatus);
+    CHK(ATOMIC_LOAD_BOOL(&pGstKvsPlugin->enableStreaming), retStatus);
+
+    // Same timestamp handling as the main stream. The frames are put on the streaming thread of the pad
+    // which only holds up the other pads of the element when they are collected.
+    if (IS_OFFLINE_STREAMING_MODE(pGstKvsPlugin->gstParams.streamingType)) {
+        buf->dts = 0;
+        buf->pts += pGstKvsPlugin->basePts;
+    } else {
+        if (!GST_BUFFER_DTS_IS_VALID(buf)) {
+            buf->dts = pPadStream->lastDts + DEFAULT_FRAME_DURATION_MS * HUNDREDS_OF_NANOS_IN_A_MILLISECOND * DEFAULT_TIME_UNIT_IN_NANOS;
+        }
+
+        if (pPadStream->firstPts == GST_CLOCK_TIME_NONE) {
+            pPadStream->firstPts = buf->pts;
+        }
+
+        // Every stream starts at the wall clock time of its own first frame like the main stream does
+        if (pPadStream->producerStartTime == GST_CLOCK_TIME_NONE) {
+            pPadStream->producerStartTime = GETTIME() * DEFAULT_TIME_UNIT_IN_NANOS;
+        }
+
+        buf->pts += pPadStream->producerStartTime - pPadStream->firstPts;
+    }
+
+    pPadStream->lastDts = buf->dts;
+
+    CHK(gst_buffer_map(buf, &info, GST_MAP_READ), STATUS_INVALID_OPERATION);
+
+    frame.version = FRAME_CURRENT_VERSION;
+    frame.flags = GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT) ? FRAME_FLAG_NONE : FRAME_FLAG_KEY_FRAME;
+    frame.index = pPadStream->frameCount++;
+    frame.decodingTs = buf->dts / DEFAULT_TIME_UNIT_IN_NANOS;
+    frame.presentationTs = buf->pts / DEFAULT_TIME_UNIT_IN_NANOS;
+    frame.trackId = DEFAULT_VIDEO_TRACK_ID;
+    frame.size = (UINT32) info.size;
+    frame.frameData = info.data;
+    frame.duration = 0;
+
+    CHK_STATUS(putKinesisVideoFrame(pPadStream->streamHandle, &frame));
+
+CleanUp:
+
+    if (info.data != NULL) {
+        gst_buffer_unmap(buf, &info);
+    }
+
+    return retStatus;
+}
+
+STATUS stopKinesisVideoPadStream(PKvsPadStream pPadStream)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pPadStream != NULL, STATUS_NULL_ARG);
+    CHK(IS_VALID_STREAM_HANDLE(pPadStream->streamHandle) && !pPadStream->streamStopped, retStatus);
+
+    pPadStream->streamStopped = TRUE;
+    CHK_STATUS(stopKinesisVideoStreamSync(pPadStream->streamHandle));
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID freeKinesisVideoPadStream(PKvsPadStream pPadStream)
+{
+    if (pPadStream == NULL) {
+        return;
+    }
+
+    if (IS_VALID_STREAM_HANDLE(pPadStream->streamHandle)) {
+        freeKinesisVideoStream(&pPadStream->streamHandle);
+    }
+
+    if (pPadStream->pStreamInfo != NULL) {
+        freeStreamInfoProvider(&pPadStream->pStreamInfo);
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pPadStream->lock)) {
+        MUTEX_FREE(pPadStream->lock);
+    }
+
+    g_free(pPadStream->padName);
+    MEMFREE(pPadStream);
+}
+
+STATUS releaseKinesisVideoPadStream(PGstKvsPlugin pGstKvsPlugin, PKvsPadStream pPadStream)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsPadStream* ppCurPadStream;
+
+    CHK(pGstKvsPlugin != NULL && pPadStream != NULL, STATUS_NULL_ARG);
+
+    for (ppCurPadStream = &pGstKvsPlugin->pPadStreams; *ppCurPadStream != NULL && *ppCurPadStream != pPadStream;
+         ppCurPadStream = &(*ppCurPadStream)->pNext) {
+        // Find the link to the stream of the pad
+    }
+
+    CHK(*ppCurPadStream != NULL, STATUS_INVALID_ARG);
+    *ppCurPadStream = pPadStream->pNext;
+
+    // The stream is drained before it's freed so the frames of the pad put so far are not lost
+    if (STATUS_FAILED(retStatus = stopKinesisVideoPadStream(pPadStream))) {
+        DLOGW("Failed to stop the stream of pad %s with 0x%08x", pPadStream->padName, retStatus);
+    }
+
+    freeKinesisVideoPadStream(pPadStream);
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID freeKinesisVideoPadStreams(PGstKvsPlugin pGstKvsPlugin)
+{
+    PKvsPadStream pPadStream, pNext;
+
+    if (pGstKvsPlugin == NULL) {
+        return;
+    }
+
+    for (pPadStream = pGstKvsPlugin->pPadStreams; pPadStream != NULL; pPadStream = pNext) {
+        pNext = pPadStream->pNext;
+        freeKinesisVideoPadStream(pPadStream);
+    }
+
+    pGstKvsPlugin->pPadStreams = NULL;
+}
+
+STATUS getKinesisVideoSustainableBitrate(PGstKvsPlugin pGstKvsPlugin, PUINT64 pBitrate)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    ClientMetrics clientMetrics;
+    StreamMetrics streamMetrics;
+    BOOL pressure;
+
+    CHK(pGstKvsPlugin != NULL && pBitrate != NULL, STATUS_NULL_ARG);
+
+    *pBitrate = 0;
+    CHK(ATOMIC_LOAD_BOOL(&pGstKvsPlugin->enableStreaming) && IS_VALID_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.clientHandle) &&
+            ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady),
+        retStatus);
+
+    // The stream callbacks provider is shared by the elements of the client and the callbacks can't be
+    // removed once added so the storage pressure is polled from the metrics instead
+    clientMetrics.version = CLIENT_METRICS_CURRENT_VERSION;
+    streamMetrics.version = STREAM_METRICS_CURRENT_VERSION;
+    CHK_STATUS(getKinesisVideoMetrics(pGstKvsPlugin->kvsContext.clientHandle, &clientMetrics));
+    CHK_STATUS(getKinesisVideoStreamMetrics(pGstKvsPlugin->kvsContext.streamHandle, &streamMetrics));
+
+    pressure = clientMetrics.contentStoreAvailableSize * 100 < clientMetrics.contentStoreSize * KVS_STORAGE_PRESSURE_AVAILABLE_PERCENT ||
+        streamMetrics.currentViewDuration * 2 > (UINT64) pGstKvsPlugin->gstParams.maxLatencyInSeconds * HUNDREDS_OF_NANOS_IN_A_SECOND;
+
+    // The upload rate is in bytes per second
+    if (pressure) {
+        *pBitrate = streamMetrics.currentTransferRate * 8 * KVS_SUSTAINABLE_BITRATE_PERCENT / 100;
+        DLOGD("KVS stream is under pressure. Sustainable bitrate %" PRIu64 " bps", *pBitrate);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS getKinesisVideoStoreAvailablePercent(PGstKvsPlugin pGstKvsPlugin, PUINT32 pAvailablePercent)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    ClientMetrics clientMetrics;
+
+    CHK(pGstKvsPlugin != NULL && pAvailablePercent != NULL, STATUS_NULL_ARG);
+    CHK(IS_VALID_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.clientHandle), STATUS_INVALID_OPERATION);
+
+    clientMetrics.version = CLIENT_METRICS_CURRENT_VERSION;
+    CHK_STATUS(getKinesisVideoMetrics(pGstKvsPlugin->kvsContext.clientHandle, &clientMetrics));
+
+    *pAvailablePercent = 100;
+    if (clientMetrics.contentStoreSize != 0) {
+        *pAvailablePercent = (UINT32) (clientMetrics.contentStoreAvailableSize * 100 / clientMetrics.contentStoreSize);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID recordPutFrameLatency(PGstKvsPlugin pGstKvsPlugin, UINT64 putStartTime, UINT64 arrivalTime)
+{
+    UINT64 now = GST_PLUGIN_MONOTONIC_TIME();
+
+    latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_KVS_PUT], now - putStartTime);
+    latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_KVS_INGEST], now - arrivalTime);
+
+    // Frames are put by a single thread at a time so the first one is only seen once
+    if (ATOMIC_LOAD(&pGstKvsPlugin->firstPutLatency) == 0) {
+        ATOMIC_STORE(&pGstKvsPlugin->firstPutLatency, (SIZE_T) MAX(now - pGstKvsPlugin->startupTime, 1));
+        DLOGI("First frame put %" PRIu64 " ms after the start", (now - pGstKvsPlugin->startupTime) / HUNDREDS_OF_NANOS_IN_A_MILLISECOND);
+    }
+}
+
+STATUS addKinesisVideoStats(PGstKvsPlugin pGstKvsPlugin, GstStructure* pStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    ClientMetrics clientMetrics;
+    PLatencyHistogram pPutLatency;
+
+    CHK(pGstKvsPlugin != NULL && pStats != NULL, STATUS_NULL_ARG);
+
+    pPutLatency = &pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_KVS_PUT];
+    gst_structure_set(
+        pStats, "video-frames", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->trackFrameCount[DEFAULT_VIDEO_TRACK_ID - 1]), "video-bytes",
+        G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->trackByteCount[DEFAULT_VIDEO_TRACK_ID - 1]), "audio-frames", G_TYPE_UINT64,
+        (guint64) ATOMIC_LOAD(&pGstKvsPlugin->trackFrameCount[DEFAULT_AUDIO_TRACK_ID - 1]), "audio-bytes", G_TYPE_UINT64,
+        (guint64) ATOMIC_LOAD(&pGstKvsPlugin->trackByteCount[DEFAULT_AUDIO_TRACK_ID - 1]), "put-frame-count", G_TYPE_UINT64,
+        (guint64) ATOMIC_LOAD(&pPutLatency->count), "put-frame-latency-p50", G_TYPE_UINT64,
+        (guint64) latencyHistogramGetPercentile(pPutLatency, 50.0) * DEFAULT_TIME_UNIT_IN_NANOS, "put-frame-latency-p99", G_TYPE_UINT64,
+        (guint64) latencyHistogramGetPercentile(pPutLatency, 99.0) * DEFAULT_TIME_UNIT_IN_NANOS, "put-frame-latency-max", G_TYPE_UINT64,
+        (guint64) ATOMIC_LOAD(&pPutLatency->max) * DEFAULT_TIME_UNIT_IN_NANOS, "ingest-dropped-frames", G_TYPE_UINT64,
+        (guint64) ATOMIC_LOAD(&pGstKvsPlugin->ingestDroppedFrameCount), "cold-start-to-first-put", G_TYPE_UINT64,
+        (guint64) ATOMIC_LOAD(&pGstKvsPlugin->firstPutLatency) * DEFAULT_TIME_UNIT_IN_NANOS, NULL);
+
+    // The content store is shared by the elements of the client
+    if (IS_VALID_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.clientHandle)) {
+        clientMetrics.version = CLIENT_METRICS_CURRENT_VERSION;
+        CHK_STATUS(getKinesisVideoMetrics(pGstKvsPlugin->kvsContext.clientHandle, &clientMetrics));
+        gst_structure_set(pStats, "content-store-size", G_TYPE_UINT64, (guint64) clientMetrics.contentStoreSize, "content-store-available",
+                          G_TYPE_UINT64, (guint64) clientMetrics.contentStoreAvailableSize, NULL);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS startKinesisVideoCheckpoint(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS, status;
+    PKvsCheckpoint pCheckpoint = NULL;
+    KvsCheckpointEntry entry;
+    gchar* pSourceUri = NULL;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    stopKinesisVideoCheckpoint(pGstKvsPlugin, FALSE);
+    pGstKvsPlugin->resumeTimecode = 0;
+    pGstKvsPlugin->resumeSkippedFrameCount = 0;
+
+    // Live streams have nothing to resume
+    CHK(IS_OFFLINE_STREAMING_MODE(pGstKvsPlugin->gstParams.streamingType) && pGstKvsPlugin->gstParams.checkpointPath != NULL &&
+            pGstKvsPlugin->gstParams.checkpointPath[0] != '\0',
+        retStatus);
+
+    // The fragment timecodes are only comparable across the runs when they are absolute
+    CHK_WARN(pGstKvsPlugin->gstParams.fileStartTime != 0, retStatus, "Checkpointing is disabled without a file start time");
+
+    CHK(NULL != (pCheckpoint = (PKvsCheckpoint) MEMCALLOC(1, SIZEOF(KvsCheckpoint))), STATUS_NOT_ENOUGH_MEMORY);
+    pCheckpoint->streamHandle = INVALID_STREAM_HANDLE_VALUE;
+    STRNCPY(pCheckpoint->streamName, pGstKvsPlugin->gstParams.streamName, MAX_STREAM_NAME_LEN);
+    pCheckpoint->path = g_strdup(pGstKvsPlugin->gstParams.checkpointPath);
+    pCheckpoint->fileStartTime = pGstKvsPlugin->gstParams.fileStartTime;
+
+    // The sources which don't know their URI share a checkpoint per stream
+    pSourceUri = getUpstreamSourceUri(GST_ELEMENT_CAST(pGstKvsPlugin));
+    pCheckpoint->sourceUri = g_strdup(pSourceUri == NULL ? "" : pSourceUri);
+
+    G_LOCK(gKvsCheckpointFile);
+    status = findKvsCheckpointEntry(pCheckpoint->path, pCheckpoint->streamName, pCheckpoint->sourceUri, &entry);
+    G_UNLOCK(gKvsCheckpointFile);
+
+    // The timestamps are rebased the same way as in the previous run so the skipped fragments line up
+    if (STATUS_SUCCEEDED(status)) {
+        pCheckpoint->fileStartTime = entry.fileStartTime;
+        pCheckpoint->persistedTimecode = entry.persistedTimecode;
+        pCheckpoint->writtenTimecode = entry.persistedTimecode;
+        pGstKvsPlugin->gstParams.fileStartTime = entry.fileStartTime;
+        pGstKvsPlugin->resumeTimecode = entry.persistedTimecode;
+        DLOGI("Resuming the upload of %s to %s past the fragment %" PRIu64, pCheckpoint->sourceUri, pCheckpoint->streamName,
+              entry.persistedTimecode);
+    }
+
+    pGstKvsPlugin->pCheckpoint = pCheckpoint;
 
 CleanUp:
 
+    CHK_LOG_ERR(retStatus);
+
+    if (STATUS_FAILED(retStatus) && pCheckpoint != NULL) {
+        g_free(pCheckpoint->path);
+        g_free(pCheckpoint->sourceUri);
+        MEMFREE(pCheckpoint);
+    }
+
+    g_free(pSourceUri);
+
+    return retStatus;
+}
+
+STATUS attachKinesisVideoCheckpoint(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient;
+    PKvsCheckpoint pCheckpoint;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pCheckpoint != NULL, retStatus);
+
+    pSharedClient = pGstKvsPlugin->kvsContext.pSharedClient;
+    CHK(pSharedClient != NULL, STATUS_INVALID_OPERATION);
+
+    pCheckpoint = pGstKvsPlugin->pCheckpoint;
+    MUTEX_LOCK(pSharedClient->checkpointLock);
+    pCheckpoint->streamHandle = pGstKvsPlugin->kvsContext.streamHandle;
+    pCheckpoint->pNext = pSharedClient->pCheckpoints;
+    pSharedClient->pCheckpoints = pCheckpoint;
+    MUTEX_UNLOCK(pSharedClient->checkpointLock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS stopKinesisVideoCheckpoint(PGstKvsPlugin pGstKvsPlugin, BOOL completed)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient;
+    PKvsCheckpoint pCheckpoint, *ppCur;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pCheckpoint != NULL, retStatus);
+
+    pCheckpoint = pGstKvsPlugin->pCheckpoint;
+    pSharedClient = pGstKvsPlugin->kvsContext.pSharedClient;
+
+    // No more acks are routed to the checkpoint once it's off the list
+    if (pSharedClient != NULL && IS_VALID_MUTEX_VALUE(pSharedClient->checkpointLock)) {
+        MUTEX_LOCK(pSharedClient->checkpointLock);
+        for (ppCur = &pSharedClient->pCheckpoints; *ppCur != NULL && *ppCur != pCheckpoint; ppCur = &(*ppCur)->pNext) {
+        }
+
+        if (*ppCur != NULL) {
+            *ppCur = pCheckpoint->pNext;
+        }
+
+        MUTEX_UNLOCK(pSharedClient->checkpointLock);
+    }
+
+    // A completed upload has nothing left to resume so a new run of the same source starts over.
+    // Otherwise the acks held back by the write period are written out.
+    if (completed) {
+        G_LOCK(gKvsCheckpointFile);
+        retStatus = updateKvsCheckpointEntry(pCheckpoint, TRUE);
+        G_UNLOCK(gKvsCheckpointFile);
+    } else if (pCheckpoint->persistedTimecode != pCheckpoint->writtenTimecode) {
+        G_LOCK(gKvsCheckpointFile);
+        retStatus = updateKvsCheckpointEntry(pCheckpoint, FALSE);
+        G_UNLOCK(gKvsCheckpointFile);
+    }
+
+    pGstKvsPlugin->pCheckpoint = NULL;
+    g_free(pCheckpoint->path);
+    g_free(pCheckpoint->sourceUri);
+    MEMFREE(pCheckpoint);
+
+CleanUp:
+
+    return retStatus;
+}
+
+BOOL isKinesisVideoFramePersisted(PGstKvsPlugin pGstKvsPlugin, PFrame pFrame)
+{
+    UINT64 timecodeScale;
+
+    if (pGstKvsPlugin == NULL || pFrame == NULL || pGstKvsPlugin->resumeTimecode == 0) {
+        return FALSE;
+    }
+
+    // The upload picks up at the first key frame past the last persisted fragment as it starts the next one
+    timecodeScale = (UINT64) pGstKvsPlugin->gstParams.timeCodeScaleInMillis * HUNDREDS_OF_NANOS_IN_A_MILLISECOND;
+    if (CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags) && timecodeScale != 0 && pFrame->presentationTs / timecodeScale > pGstKvsPlugin->resumeTimecode) {
+        DLOGI("Resumed the upload after skipping %" PRIu64 " persisted frames", pGstKvsPlugin->resumeSkippedFrameCount);
+        pGstKvsPlugin->resumeTimecode = 0;
+        return FALSE;
+    }
+
+    pGstKvsPlugin->resumeSkippedFrameCount++;
+
+    return TRUE;
+}
+
+STATUS parseKvsCheckpointEntry(PCHAR pLine, PKvsCheckpointEntry pEntry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pFields[KVS_CHECKPOINT_FIELD_COUNT], pCur = pLine, pEnd;
+    UINT32 i;
+
+    CHK(pLine != NULL && pEntry != NULL, STATUS_NULL_ARG);
+
+    // The source URI is the last field and is taken as is as it might contain commas
+    for (i = 0; i < KVS_CHECKPOINT_FIELD_COUNT - 1; i++) {
+        CHK(NULL != (pEnd = STRCHR(pCur, ',')), STATUS_INVALID_ARG);
+        *pEnd = '\0';
+        pFields[i] = pCur;
+        pCur = pEnd + 1;
+    }
+
+    pFields[i] = pCur;
+
+    CHK(STRLEN(pFields[0]) != 0 && STRLEN(pFields[0]) <= MAX_STREAM_NAME_LEN, STATUS_INVALID_ARG_LEN);
+    CHK_STATUS(STRTOUI64(pFields[1], NULL, 10, &pEntry->fileStartTime));
+    CHK_STATUS(STRTOUI64(pFields[2], NULL, 10, &pEntry->persistedTimecode));
+
+    STRCPY(pEntry->streamName, pFields[0]);
+    pEntry->sourceUri = pFields[3];
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS findKvsCheckpointEntry(PCHAR pPath, PCHAR pStreamName, PCHAR pSourceUri, PKvsCheckpointEntry pEntry)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pContent = NULL, pLine, pNextLine;
+    BOOL found = FALSE;
+
+    CHK(pPath != NULL && pStreamName != NULL && pSourceUri != NULL && pEntry != NULL, STATUS_NULL_ARG);
+
+    CHK_STATUS(readKvsStateFile(pPath, &pContent));
+
+    for (pLine = pContent; !found && pLine != NULL && *pLine != '\0'; pLine = pNextLine) {
+        if (NULL != (pNextLine = STRCHR(pLine, '\n'))) {
+            *pNextLine++ = '\0';
+        }
+
+        // Invalid entries are skipped and dropped by the next update
+        found = STATUS_SUCCEEDED(parseKvsCheckpointEntry(pLine, pEntry)) && 0 == STRCMP(pEntry->streamName, pStreamName) &&
+            0 == STRCMP(pEntry->sourceUri, pSourceUri);
+    }
+
+    CHK(found, STATUS_NOT_FOUND);
+
+    // The source URI points into the content which is going away
+    pEntry->sourceUri = NULL;
+
+CleanUp:
+
+    SAFE_MEMFREE(pContent);
+
+    return retStatus;
+}
+
+STATUS updateKvsCheckpointEntry(PKvsCheckpoint pCheckpoint, BOOL remove)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pContent = NULL, pLine, pNextLine, pOutput = NULL, pCur;
+    PCHAR pKeptLines[KVS_CHECKPOINT_MAX_ENTRIES];
+    UINT32 keptCount = 0, i;
+    UINT64 outputSize;
+    KvsCheckpointEntry entry;
+    gchar* pLineCopy;
+
+    CHK(pCheckpoint != NULL && pCheckpoint->path != NULL, STATUS_NULL_ARG);
+
+    // A missing or unreadable file is rewritten from scratch
+    if (STATUS_FAILED(readKvsStateFile(pCheckpoint->path, &pContent))) {
+        pContent = NULL;
+    }
+
+    for (pLine = pContent; pLine != NULL && *pLine != '\0'; pLine = pNextLine) {
+        if (NULL != (pNextLine = STRCHR(pLine, '\n'))) {
+            *pNextLine++ = '\0';
+        }
+
+        // Parsing splits the line up so it's done on a copy
+        pLineCopy = g_strdup(pLine);
+        if (STATUS_SUCCEEDED(parseKvsCheckpointEntry(pLineCopy, &entry)) &&
+            (0 != STRCMP(entry.streamName, pCheckpoint->streamName) || 0 != STRCMP(entry.sourceUri, pCheckpoint->sourceUri))) {
+            // Make room for the newer entries. One slot is left for the updated one.
+            if (keptCount == KVS_CHECKPOINT_MAX_ENTRIES - 1) {
+                MEMMOVE(pKeptLines, pKeptLines + 1, (keptCount - 1) * SIZEOF(PCHAR));
+                keptCount--;
+            }
+
+            pKeptLines[keptCount++] = pLine;
+        }
+
+        g_free(pLineCopy);
+    }
+
+    outputSize = 1;
+    for (i = 0; i < keptCount; i++) {
+        outputSize += STRLEN(pKeptLines[i]) + 1;
+    }
+
+    if (!remove) {
+        outputSize += STRLEN(pCheckpoint->streamName) + STRLEN(pCheckpoint->sourceUri) + 2 * KVS_CHECKPOINT_MAX_NUMBER_DIGITS +
+            KVS_CHECKPOINT_FIELD_COUNT;
+    }
+
+    CHK(NULL != (pOutput = (PCHAR) MEMALLOC(outputSize)), STATUS_NOT_ENOUGH_MEMORY);
+    pCur = pOutput;
+    for (i = 0; i < keptCount; i++) {
+        pCur += SNPRINTF(pCur, outputSize - (pCur - pOutput), "%s\n", pKeptLines[i]);
+    }
+
+    if (!remove) {
+        pCur += SNPRINTF(pCur, outputSize - (pCur - pOutput), "%s,%" PRIu64 ",%" PRIu64 ",%s\n", pCheckpoint->streamName,
+                         pCheckpoint->fileStartTime, pCheckpoint->persistedTimecode, pCheckpoint->sourceUri);
+    }
+
+    CHK_STATUS(writeKvsStateFile(pCheckpoint->path, (PBYTE) pOutput, (UINT64) (pCur - pOutput)));
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    SAFE_MEMFREE(pContent);
+    SAFE_MEMFREE(pOutput);
+
     return retStatus;
 }
+
+STATUS fragmentAckReceivedCheckpoint(UINT64 customData, STREAM_HANDLE streamHandle, UPLOAD_HANDLE uploadHandle, PFragmentAck pFragmentAck)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient = (PKvsSharedClient) customData;
+    PKvsCheckpoint pCheckpoint;
+    UINT64 now;
+    BOOL locked = FALSE;
+
+    UNUSED_PARAM(uploadHandle);
+
+    CHK(pSharedClient != NULL && pFragmentAck != NULL, STATUS_NULL_ARG);
+    CHK(pFragmentAck->ackType == FRAGMENT_ACK_TYPE_PERSISTED, retStatus);
+
+    MUTEX_LOCK(pSharedClient->checkpointLock);
+    locked = TRUE;
+
+    for (pCheckpoint = pSharedClient->pCheckpoints; pCheckpoint != NULL && pCheckpoint->streamHandle != streamHandle;
+         pCheckpoint = pCheckpoint->pNext) {
+    }
+
+    // The acks of a restarted connection can go back in time
+    CHK(pCheckpoint != NULL && pFragmentAck->timestamp > pCheckpoint->persistedTimecode, retStatus);
+    pCheckpoint->persistedTimecode = pFragmentAck->timestamp;
+
+    // Keeps the file I/O off most of the acks on the callback thread
+    now = GST_PLUGIN_MONOTONIC_TIME();
+    CHK(pCheckpoint->lastWriteTime == 0 || now - pCheckpoint->lastWriteTime >= KVS_CHECKPOINT_WRITE_PERIOD, retStatus);
+    pCheckpoint->lastWriteTime = now;
+
+    G_LOCK(gKvsCheckpointFile);
+    retStatus = updateKvsCheckpointEntry(pCheckpoint, FALSE);
+    G_UNLOCK(gKvsCheckpointFile);
+
+    if (STATUS_SUCCEEDED(retStatus)) {
+        pCheckpoint->writtenTimecode = pCheckpoint->persistedTimecode;
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pSharedClient->checkpointLock);
+    }
+
+    // A failed checkpoint update doesn't fail the ack for the rest of the callbacks. The next one retries it.
+    CHK_LOG_ERR(retStatus);
+
+    return STATUS_SUCCESS;
+}
@@ -38,6 +38,13 @@
 #define DEFAULT_LOG_LEVEL                      LOG_LEVEL_WARN
 #define DEFAULT_API_CACHE_PERIOD               (24 * HUNDREDS_OF_NANOS_IN_AN_HOUR)
 #define DEFAULT_ENABLE_STREAMING               TRUE
+#define DEFAULT_INGEST_QUEUE_SIZE              256
+#define DEFAULT_INGEST_DROP_POLICY             KVS_INGEST_DROP_POLICY_DROP
+#define DEFAULT_SYNC_MODE                      KVS_SYNC_MODE_COLLECT
+#define DEFAULT_LOOPBACK                       FALSE
+#define DEFAULT_LOOPBACK_ACK_DELAY_MS          0
+#define DEFAULT_LOOPBACK_BANDWIDTH_BPS         0
+#define DEFAULT_PRE_EVENT_DURATION_SECONDS     0
 
 #define CA_CERT_PEM_FILE_EXTENSION ".pem"
 
@@ -46,8 +53,64 @@
 
 #define GST_PLUGIN_MAX_CPD_SIZE (10 * 1024)
 
+// The stream is under pressure once the available content store drops below the percentage or the
+// buffered duration goes past half of the max latency. The encoder is then hinted a share of the upload rate.
+#define KVS_STORAGE_PRESSURE_AVAILABLE_PERCENT 20
+#define KVS_SUSTAINABLE_BITRATE_PERCENT        90
+
+// Upper bound for the ingest waits before re-checking the termination
+#define KVS_INGEST_WAIT_PERIOD (100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+// The lead-up held while the streaming is disabled is bounded on top of the duration so a long GoP
+// or a high bitrate doesn't grow it unchecked
+#define KVS_PRE_EVENT_MAX_FRAMES 2048
+#define KVS_PRE_EVENT_MAX_SIZE   (64 * 1024 * 1024)
+
 #define KVS_PRODUCER_CLIENT_USER_AGENT_NAME "KVS_GST_PLUGIN_PRODUCER"
 
+// The DescribeStream and GetDataEndpoint results are kept on disk so the restarted processes skip
+// the round trips. Entries are keyed by the credentials, the region and the stream name, the newest ones are kept.
+// The file is in the user cache directory unless a path is given.
+#define DEFAULT_API_CACHE_PATH          ""
+#define KVS_API_CACHE_FILE_NAME         "KvsStreamCache_v1"
+#define KVS_API_CACHE_TTL               DEFAULT_API_CACHE_PERIOD
+#define KVS_API_CACHE_MAX_ENTRIES       32
+#define KVS_API_CACHE_FIELD_COUNT       6
+#define KVS_API_CACHE_ENDPOINT_PREFIX   "https://"
+#define KVS_API_CACHE_ARN_STREAM_PREFIX ":stream/"
+#define KVS_API_CACHE_IDENTITY_DIGITS   8
+#define KVS_API_CACHE_MAX_TIME_DIGITS   20
+
+// Offline uploads record the timestamp of the last persisted fragment keyed by the stream name and the source URI
+#define DEFAULT_CHECKPOINT_PATH          ""
+#define KVS_CHECKPOINT_MAX_ENTRIES       32
+#define KVS_CHECKPOINT_FIELD_COUNT       4
+#define KVS_CHECKPOINT_MAX_NUMBER_DIGITS 20
+// The acks move the checkpoint in memory while the file is rewritten at most once per period and on the stop.
+// A crash makes the next run upload the fragments of at most the last period again.
+#define KVS_CHECKPOINT_WRITE_PERIOD (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+
+// The loopback mode consumes the stream data in the process and acks the fragments as the service would.
+// The cluster header is the ID, the size, the timecode ID, its size and the timecode of at most 8 bytes each.
+#define KVS_LOOPBACK_ENDPOINT             "https://loopback.invalid"
+#define KVS_LOOPBACK_STREAM_ARN_FORMAT    "arn:aws:kinesisvideo:%s:000000000000:stream/%s/0"
+#define KVS_LOOPBACK_ACK_FORMAT           "{\"EventType\":\"%s\",\"FragmentTimecode\":%" PRIu64 ",\"FragmentNumber\":\"%" PRIu64 "\"}"
+#define KVS_LOOPBACK_ACK_BUFFER_SIZE      256
+#define KVS_LOOPBACK_READ_SIZE            (64 * 1024)
+#define KVS_LOOPBACK_MAX_PENDING_ACKS     64
+#define KVS_LOOPBACK_POLL_PERIOD          (2 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+#define KVS_LOOPBACK_CLUSTER_ID           0x1F43B675
+#define KVS_LOOPBACK_CLUSTER_ID_SIZE      4
+#define KVS_LOOPBACK_TIMECODE_ID          0xE7
+#define KVS_LOOPBACK_CLUSTER_HEADER_SIZE  (KVS_LOOPBACK_CLUSTER_ID_SIZE + 8 + 1 + 8 + 8)
+
+typedef enum {
+    // The stream has been described from the cache file by this process
+    KVS_API_CACHE_STREAM_STATE_SERVED = 1,
+    // The results of the service calls of the stream have been written to the cache file
+    KVS_API_CACHE_STREAM_STATE_STORED,
+} KVS_API_CACHE_STREAM_STATE;
+
 #define AVCC_VERSION_CODE       0x01
 #define AVCC_NALU_LEN_MINUS_ONE 0xFF
 #define AVCC_NUMBER_OF_SPS_ONE  0xE1
@@ -64,13 +127,80 @@ typedef enum {
 
 STATUS traverseDirectoryPemFileScan(UINT64, DIR_ENTRY_TYPES, PCHAR, PCHAR);
 STATUS lookForSslCert(PGstKvsPlugin);
+VOID applyStreamInfoParams(PGstKvsPlugin, PStreamInfo);
 STATUS initKinesisVideoStream(PGstKvsPlugin);
-STATUS initKinesisVideoProducer(PGstKvsPlugin);
+PVOID startKinesisVideoStreamRoutine(PVOID);
+STATUS awaitKinesisVideoStream(PGstKvsPlugin);
+STATUS setKinesisVideoStreamNalFlags(PGstKvsPlugin, UINT32);
+STATUS setKinesisVideoStreamCpd(PGstKvsPlugin, UINT64, PBYTE, UINT32);
+STATUS initKinesisVideoProducer(PGstKvsPlugin, PKvsSharedClient);
+gchar* getKvsSharedClientKey(PGstKvsPlugin, PCHAR, PCHAR, PCHAR);
+STATUS createKvsSharedClient(PGstKvsPlugin, PCHAR, PCHAR, PCHAR, PKvsSharedClient);
+VOID freeKvsSharedClient(PKvsSharedClient);
+STATUS acquireKvsSharedClient(PGstKvsPlugin, PCHAR, PCHAR, PCHAR);
+VOID releaseKvsSharedClient(PGstKvsPlugin);
+STATUS initKvsApiCache(PGstKvsPlugin, PKvsSharedClient);
+PKvsSharedClient findKvsSharedClientByCallbacks(UINT64);
+STATUS parseKvsApiCacheEntry(PCHAR, PKvsApiCacheEntry);
+STATUS readKvsStateFile(PCHAR, PCHAR*);
+STATUS writeKvsStateFile(PCHAR, PBYTE, UINT64);
+STATUS findKvsApiCacheEntry(PKvsSharedClient, PCHAR, PKvsApiCacheEntry);
+STATUS updateKvsApiCacheEntry(PKvsSharedClient, PCHAR, PCHAR, PCHAR);
+STATUS getKvsApiCacheStream(PKvsSharedClient, PCHAR, PKvsApiCacheStream*);
+STATUS freeKvsApiCacheStreamEntry(UINT64, PHashEntry);
+STATUS registerKvsApiCacheStream(PGstKvsPlugin, PStreamInfo);
+STATUS describeStreamCachingFile(UINT64, PCHAR, PServiceCallContext);
+STATUS getStreamingEndpointCachingFile(UINT64, PCHAR, PCHAR, PServiceCallContext);
+STATUS putStreamCachingFile(UINT64, PCHAR, PCHAR, UINT64, BOOL, BOOL, PCHAR, PServiceCallContext);
+STATUS tagResourceCachingFile(UINT64, PCHAR, UINT32, PTag, PServiceCallContext);
+STATUS initKvsLoopback(PGstKvsPlugin, PKvsSharedClient);
+STATUS describeStreamLoopback(UINT64, PCHAR, PServiceCallContext);
+STATUS createStreamLoopback(UINT64, PCHAR, PCHAR, PCHAR, PCHAR, UINT64, PServiceCallContext);
+STATUS getStreamingEndpointLoopback(UINT64, PCHAR, PCHAR, PServiceCallContext);
+STATUS tagResourceLoopback(UINT64, PCHAR, UINT32, PTag, PServiceCallContext);
+STATUS putStreamLoopback(UINT64, PCHAR, PCHAR, UINT64, BOOL, BOOL, PCHAR, PServiceCallContext);
+STATUS streamShutdownLoopback(UINT64, STREAM_HANDLE, BOOL);
+STATUS startKinesisVideoCheckpoint(PGstKvsPlugin);
+STATUS attachKinesisVideoCheckpoint(PGstKvsPlugin);
+STATUS stopKinesisVideoCheckpoint(PGstKvsPlugin, BOOL);
+BOOL isKinesisVideoFramePersisted(PGstKvsPlugin, PFrame);
+STATUS parseKvsCheckpointEntry(PCHAR, PKvsCheckpointEntry);
+STATUS findKvsCheckpointEntry(PCHAR, PCHAR, PCHAR, PKvsCheckpointEntry);
+STATUS updateKvsCheckpointEntry(PKvsCheckpoint, BOOL);
+STATUS fragmentAckReceivedCheckpoint(UINT64, STREAM_HANDLE, UPLOAD_HANDLE, PFragmentAck);
+VOID reapKvsLoopbackUploads(PKvsSharedClient, STREAM_HANDLE, BOOL);
+VOID queueKvsLoopbackAck(PKvsLoopbackUpload, PKvsLoopbackAck, PUINT32, PUINT32, UINT64, UINT64);
+PVOID kvsLoopbackUploadRoutine(PVOID);
+STATUS findKvsLoopbackCluster(PBYTE, UINT32, PUINT32, PUINT64);
+STATUS sendKvsLoopbackAck(PKvsLoopbackUpload, PCHAR, UINT64);
 STATUS initTrackData(PGstKvsPlugin);
-STATUS identifyFrameNalFormat(PBYTE, UINT32, ELEMENTARY_STREAM_NAL_FORMAT*);
+STATUS initKinesisVideoPadStreams(PGstKvsPlugin);
 STATUS identifyCpdNalFormat(PBYTE, UINT32, ELEMENTARY_STREAM_NAL_FORMAT*);
 STATUS convertCpdFromAvcToAnnexB(PGstKvsPlugin, PBYTE, UINT32);
 STATUS convertCpdFromHevcToAnnexB(PGstKvsPlugin, PBYTE, UINT32);
+STATUS startKinesisVideoIngest(PGstKvsPlugin);
+STATUS stopKinesisVideoIngest(PGstKvsPlugin);
+STATUS flushKinesisVideoIngest(PGstKvsPlugin);
+STATUS createKinesisVideoPadStream(PGstKvsPlugin, const gchar*, guint, PKvsPadStream*);
+STATUS initKinesisVideoPadStream(PGstKvsPlugin, PKvsPadStream, GstCaps*);
+STATUS setKinesisVideoPadStreamCpd(PGstKvsPlugin, PKvsPadStream, PBYTE, UINT32);
+STATUS putKinesisVideoPadFrame(PGstKvsPlugin, PKvsPadStream, GstBuffer*);
+STATUS stopKinesisVideoPadStream(PKvsPadStream);
+STATUS releaseKinesisVideoPadStream(PGstKvsPlugin, PKvsPadStream);
+VOID freeKinesisVideoPadStream(PKvsPadStream);
+VOID freeKinesisVideoPadStreams(PGstKvsPlugin);
+STATUS enqueueKinesisVideoFrame(PGstKvsPlugin, GstBuffer*, PFrame, UINT64);
+BOOL admitKinesisVideoSyncFrame(PGstKvsPlugin, PFrame);
+PVOID putKinesisVideoFramesRoutine(PVOID);
+STATUS holdKinesisVideoPreEventFrame(PGstKvsPlugin, GstBuffer*, PFrame);
+STATUS flushKinesisVideoPreEventRing(PGstKvsPlugin);
+BOOL dropKinesisVideoPreEventGop(PGstKvsPlugin, UINT64);
+VOID releaseKinesisVideoPreEventFrame(PGstKvsPlugin);
+VOID clearKinesisVideoPreEventRing(PGstKvsPlugin);
+STATUS getKinesisVideoSustainableBitrate(PGstKvsPlugin, PUINT64);
+STATUS getKinesisVideoStoreAvailablePercent(PGstKvsPlugin, PUINT32);
+VOID recordPutFrameLatency(PGstKvsPlugin, UINT64, UINT64);
+STATUS addKinesisVideoStats(PGstKvsPlugin, GstStructure*);
 
 #endif //__KVS_PRODUCER_FUNCTIONALITY_H__
 
@@ -0,0 +1,539 @@
+#define LOG_CLASS "KvsSpool"
+// Needed for O_DIRECT
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "GstPlugin.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+STATUS startKinesisVideoSpool(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSpool pSpool = NULL;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    // The spool is off unless a directory is given
+    CHK(pGstKvsPlugin->pSpool == NULL && pGstKvsPlugin->gstParams.spoolPath != NULL && pGstKvsPlugin->gstParams.spoolPath[0] != '\0',
+        retStatus);
+
+    // Offline streaming relies on the backpressure so the content store is never given up on
+    CHK_WARN(!IS_OFFLINE_STREAMING_MODE(pGstKvsPlugin->gstParams.streamingType), retStatus, "KVS spool is not used with offline streaming");
+
+    CHK(NULL != (pSpool = (PKvsSpool) MEMCALLOC(1, SIZEOF(KvsSpool))), STATUS_NOT_ENOUGH_MEMORY);
+    pGstKvsPlugin->pSpool = pSpool;
+
+    pSpool->pGstKvsPlugin = pGstKvsPlugin;
+    pSpool->lock = INVALID_MUTEX_VALUE;
+    pSpool->cvar = INVALID_CVAR_VALUE;
+    pSpool->replayTid = INVALID_TID_VALUE;
+    pSpool->writeFd = -1;
+    pSpool->readFd = -1;
+    STRNCPY(pSpool->directory, pGstKvsPlugin->gstParams.spoolPath, MAX_PATH_LEN);
+    STRNCPY(pSpool->streamName, pGstKvsPlugin->gstParams.streamName, MAX_STREAM_NAME_LEN);
+    pSpool->segmentCount =
+        MAX(KVS_SPOOL_MIN_SEGMENT_COUNT, (UINT32) ((UINT64) pGstKvsPlugin->gstParams.spoolSize * 1024 * 1024 / KVS_SPOOL_SEGMENT_SIZE));
+    pSpool->catchupRate = pGstKvsPlugin->gstParams.spoolCatchupRate;
+
+    CHK(NULL != (pSpool->pWriteBufferAlloc = (PBYTE) MEMALLOC(KVS_SPOOL_WRITE_BUFFER_SIZE + KVS_SPOOL_BLOCK_SIZE)), STATUS_NOT_ENOUGH_MEMORY);
+    pSpool->pWriteBuffer = (PBYTE) ROUND_UP((UINT64) pSpool->pWriteBufferAlloc, KVS_SPOOL_BLOCK_SIZE);
+
+    pSpool->lock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pSpool->lock), STATUS_INVALID_OPERATION);
+    pSpool->cvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pSpool->cvar), STATUS_INVALID_OPERATION);
+
+    // Opened upfront so an unusable directory is reported on the start rather than on the first outage
+    CHK_STATUS(openKvsSpoolSegment(pSpool));
+
+    CHK_STATUS(THREAD_CREATE(&pSpool->replayTid, replayKvsSpoolRoutine, (PVOID) pSpool));
+
+    DLOGI("KVS spool of %u segments in %s", pSpool->segmentCount, pSpool->directory);
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    if (STATUS_FAILED(retStatus) && pGstKvsPlugin != NULL) {
+        stopKinesisVideoSpool(pGstKvsPlugin);
+    }
+
+    return retStatus;
+}
+
+STATUS stopKinesisVideoSpool(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSpool pSpool;
+    CHAR path[MAX_PATH_LEN + 1];
+    UINT64 segment;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(NULL != (pSpool = pGstKvsPlugin->pSpool), retStatus);
+
+    ATOMIC_STORE_BOOL(&pSpool->terminate, TRUE);
+
+    if (IS_VALID_TID_VALUE(pSpool->replayTid)) {
+        MUTEX_LOCK(pSpool->lock);
+        CVAR_BROADCAST(pSpool->cvar);
+        MUTEX_UNLOCK(pSpool->lock);
+        THREAD_JOIN(pSpool->replayTid, NULL);
+        pSpool->replayTid = INVALID_TID_VALUE;
+    }
+
+    pGstKvsPlugin->pSpool = NULL;
+
+    if (pSpool->spilling) {
+        DLOGW("KVS spool is stopped with %" PRIu64 " segments of frames not replayed", pSpool->writeSegment - pSpool->readSegment + 1);
+    }
+
+    if (pSpool->readFd >= 0) {
+        close(pSpool->readFd);
+    }
+
+    if (pSpool->writeFd >= 0) {
+        close(pSpool->writeFd);
+    }
+
+    // The segments are private to the process
+    for (segment = pSpool->readSegment; segment <= pSpool->writeSegment; segment++) {
+        getKvsSpoolSegmentPath(pSpool, segment, path);
+        unlink(path);
+    }
+
+    if (IS_VALID_CVAR_VALUE(pSpool->cvar)) {
+        CVAR_FREE(pSpool->cvar);
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pSpool->lock)) {
+        MUTEX_FREE(pSpool->lock);
+    }
+
+    SAFE_MEMFREE(pSpool->pWriteBufferAlloc);
+    SAFE_MEMFREE(pSpool->pReadBuffer);
+    MEMFREE(pSpool);
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS putKinesisVideoStreamFrame(PGstKvsPlugin pGstKvsPlugin, PFrame pFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSpool pSpool = NULL;
+    UINT32 availablePercent;
+    BOOL locked = FALSE, spooled = FALSE;
+
+    CHK(pGstKvsPlugin != NULL && pFrame != NULL, STATUS_NULL_ARG);
+
+    if (NULL != (pSpool = pGstKvsPlugin->pSpool)) {
+        MUTEX_LOCK(pSpool->lock);
+        locked = TRUE;
+
+        // Spilling starts at a key frame so the replay starts with a decodable GoP
+        if (!pSpool->spilling && CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags) &&
+            STATUS_SUCCEEDED(getKinesisVideoStoreAvailablePercent(pGstKvsPlugin, &availablePercent)) &&
+            availablePercent < KVS_STORAGE_PRESSURE_AVAILABLE_PERCENT) {
+            DLOGW("KVS content store is %u%% available. Spilling the frames to %s", availablePercent, pSpool->directory);
+            pSpool->spilling = TRUE;
+        }
+
+        if (pSpool->spilling) {
+            spooled = TRUE;
+            CHK_STATUS(appendKvsSpoolFrame(pSpool, pFrame));
+            ATOMIC_INCREMENT(&pSpool->spilledFrameCount);
+            CVAR_BROADCAST(pSpool->cvar);
+        }
+
+        MUTEX_UNLOCK(pSpool->lock);
+        locked = FALSE;
+    }
+
+    if (!spooled) {
+        CHK_STATUS(putKinesisVideoFrame(pGstKvsPlugin->kvsContext.streamHandle, pFrame));
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pSpool->lock);
+    }
+
+    return retStatus;
+}
+
+VOID getKvsSpoolSegmentPath(PKvsSpool pSpool, UINT64 segment, PCHAR path)
+{
+    SNPRINTF(path, MAX_PATH_LEN + 1, KVS_SPOOL_SEGMENT_PATH_FORMAT, pSpool->directory, FPATHSEPARATOR, pSpool->streamName, segment);
+}
+
+STATUS openKvsSpoolSegment(PKvsSpool pSpool)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR path[MAX_PATH_LEN + 1];
+    INT32 flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    CHK(pSpool != NULL, STATUS_NULL_ARG);
+
+    getKvsSpoolSegmentPath(pSpool, pSpool->writeSegment, path);
+
+    pSpool->writeFd = -1;
+#ifdef O_DIRECT
+    // The spilled frames are not read back for a while so they are kept out of the page cache
+    pSpool->writeFd = open(path, flags | O_DIRECT, 0600);
+#endif
+
+    // Not all of the file systems take the direct IO, tmpfs being one of them
+    if (pSpool->writeFd < 0) {
+        pSpool->writeFd = open(path, flags, 0600);
+    }
+
+    CHK_ERR(pSpool->writeFd >= 0, STATUS_OPEN_FILE_FAILED, "Failed to open spool segment %s (error:%s)", path, strerror(errno));
+
+    pSpool->writeOffset = 0;
+    pSpool->writeBufferOffset = 0;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS appendKvsSpoolBytes(PKvsSpool pSpool, PBYTE pData, UINT32 size)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 copySize;
+
+    CHK(pSpool != NULL && (pData != NULL || size == 0), STATUS_NULL_ARG);
+
+    while (size != 0) {
+        copySize = MIN(size, KVS_SPOOL_WRITE_BUFFER_SIZE - pSpool->writeBufferOffset);
+        MEMCPY(pSpool->pWriteBuffer + pSpool->writeBufferOffset, pData, copySize);
+        pSpool->writeBufferOffset += copySize;
+        pData += copySize;
+        size -= copySize;
+
+        if (pSpool->writeBufferOffset == KVS_SPOOL_WRITE_BUFFER_SIZE) {
+            CHK_STATUS(flushKvsSpoolWriteBuffer(pSpool));
+        }
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS flushKvsSpoolWriteBuffer(PKvsSpool pSpool)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 alignedSize;
+    ssize_t writtenSize;
+
+    CHK(pSpool != NULL, STATUS_NULL_ARG);
+    CHK(pSpool->writeBufferOffset != 0, retStatus);
+
+    // The zeroes up to the next block are skipped by the replay
+    alignedSize = (UINT32) ROUND_UP(pSpool->writeBufferOffset, KVS_SPOOL_BLOCK_SIZE);
+    MEMSET(pSpool->pWriteBuffer + pSpool->writeBufferOffset, 0x00, alignedSize - pSpool->writeBufferOffset);
+    pSpool->writeBufferOffset = 0;
+
+    writtenSize = write(pSpool->writeFd, pSpool->pWriteBuffer, alignedSize);
+    CHK_ERR(writtenSize == (ssize_t) alignedSize, STATUS_WRITE_TO_FILE_FAILED, "Failed to write to the spool (error:%s)", strerror(errno));
+    pSpool->writeOffset += alignedSize;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS appendKvsSpoolFrame(PKvsSpool pSpool, PFrame pFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    KvsSpoolRecord record;
+    CHAR path[MAX_PATH_LEN + 1];
+
+    CHK(pSpool != NULL && pFrame != NULL, STATUS_NULL_ARG);
+
+    // Retry the segment which couldn't be opened on the rotation
+    if (pSpool->writeFd < 0) {
+        CHK_STATUS(openKvsSpoolSegment(pSpool));
+    }
+
+    // Rotated at the key frames only so each of the segments starts with one
+    if (CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags) && pSpool->writeOffset + pSpool->writeBufferOffset >= KVS_SPOOL_SEGMENT_SIZE) {
+        CHK_STATUS(flushKvsSpoolWriteBuffer(pSpool));
+        close(pSpool->writeFd);
+        pSpool->writeFd = -1;
+        pSpool->writeSegment++;
+
+        // The ring is full. The oldest segment goes and the replay carries on from the key frame of the next one.
+        if (pSpool->writeSegment - pSpool->readSegment >= pSpool->segmentCount) {
+            getKvsSpoolSegmentPath(pSpool, pSpool->readSegment, path);
+            unlink(path);
+            pSpool->readSegment++;
+            pSpool->readOffset = 0;
+            ATOMIC_INCREMENT(&pSpool->evictedSegmentCount);
+            DLOGW("KVS spool is full. Dropped the oldest %u MB of frames", KVS_SPOOL_SEGMENT_SIZE / 1024 / 1024);
+        }
+
+        CHK_STATUS(openKvsSpoolSegment(pSpool));
+    }
+
+    record.magic = KVS_SPOOL_RECORD_MAGIC;
+    record.size = pFrame->size;
+    record.index = pFrame->index;
+    record.flags = (UINT32) pFrame->flags;
+    record.decodingTs = pFrame->decodingTs;
+    record.presentationTs = pFrame->presentationTs;
+    record.duration = pFrame->duration;
+    record.trackId = pFrame->trackId;
+
+    CHK_STATUS(appendKvsSpoolBytes(pSpool, (PBYTE) &record, SIZEOF(KvsSpoolRecord)));
+    CHK_STATUS(appendKvsSpoolBytes(pSpool, pFrame->frameData, pFrame->size));
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS readKvsSpoolBytes(PKvsSpool pSpool, UINT64 segment, UINT64 offset, PBYTE pData, UINT32 size, PUINT32 pReadSize)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT64 position, diskLimit, bufferLimit;
+    UINT32 copySize;
+    BOOL locked = FALSE;
+    ssize_t readSize;
+
+    CHK(pSpool != NULL && pData != NULL && pReadSize != NULL, STATUS_NULL_ARG);
+
+    // The bytes past the write offset of the last segment are copied out of the write buffer under the lock
+    // rather than flushed to be read back. The flushed ones are read without it as the file is only appended to.
+    *pReadSize = 0;
+    while (*pReadSize < size) {
+        position = offset + *pReadSize;
+
+        MUTEX_LOCK(pSpool->lock);
+        locked = TRUE;
+
+        diskLimit = segment == pSpool->writeSegment ? pSpool->writeOffset : MAX_UINT64;
+        if (position >= diskLimit) {
+            bufferLimit = diskLimit + pSpool->writeBufferOffset;
+            copySize = position < bufferLimit ? (UINT32) MIN(size - *pReadSize, bufferLimit - position) : 0;
+            MEMCPY(pData + *pReadSize, pSpool->pWriteBuffer + (position - diskLimit), copySize);
+            *pReadSize += copySize;
+            break;
+        }
+
+        MUTEX_UNLOCK(pSpool->lock);
+        locked = FALSE;
+
+        readSize = pread(pSpool->readFd, pData + *pReadSize, (size_t) MIN(size - *pReadSize, diskLimit - position), (off_t) position);
+        CHK_ERR(readSize >= 0, STATUS_READ_FILE_FAILED, "Failed to read from the spool (error:%s)", strerror(errno));
+        if (readSize == 0) {
+            break;
+        }
+
+        *pReadSize += (UINT32) readSize;
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pSpool->lock);
+    }
+
+    return retStatus;
+}
+
+STATUS readKvsSpoolFrame(PKvsSpool pSpool, PFrame pFrame, PBOOL pRead)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    KvsSpoolRecord record;
+    CHAR path[MAX_PATH_LEN + 1];
+    UINT64 segment, offset, nextSegment, nextOffset, limit;
+    UINT32 readSize;
+    BOOL locked = FALSE, lastSegment;
+
+    CHK(pSpool != NULL && pFrame != NULL && pRead != NULL, STATUS_NULL_ARG);
+
+    *pRead = FALSE;
+
+    MUTEX_LOCK(pSpool->lock);
+    locked = TRUE;
+
+    // The write buffer always ends with a whole record when the lock is not held
+    segment = pSpool->readSegment;
+    offset = pSpool->readOffset;
+    lastSegment = segment == pSpool->writeSegment;
+    limit = lastSegment ? pSpool->writeOffset + pSpool->writeBufferOffset : MAX_UINT64;
+
+    MUTEX_UNLOCK(pSpool->lock);
+    locked = FALSE;
+
+    CHK(offset < limit, retStatus);
+
+    if (pSpool->readFd < 0 || pSpool->readFdSegment != segment) {
+        if (pSpool->readFd >= 0) {
+            close(pSpool->readFd);
+        }
+
+        getKvsSpoolSegmentPath(pSpool, segment, path);
+        pSpool->readFd = open(path, O_RDONLY);
+        CHK_ERR(pSpool->readFd >= 0, STATUS_OPEN_FILE_FAILED, "Failed to open spool segment %s (error:%s)", path, strerror(errno));
+        pSpool->readFdSegment = segment;
+    }
+
+    CHK_STATUS(readKvsSpoolBytes(pSpool, segment, offset, (PBYTE) &record, SIZEOF(KvsSpoolRecord), &readSize));
+
+    nextSegment = segment;
+    if (readSize == 0 && !lastSegment) {
+        // Done with the segment
+        nextSegment = segment + 1;
+        nextOffset = 0;
+    } else if (readSize < SIZEOF(KvsSpoolRecord) || record.magic != KVS_SPOOL_RECORD_MAGIC) {
+        // Padding of a flushed block
+        nextOffset = ROUND_UP(offset + 1, KVS_SPOOL_BLOCK_SIZE);
+    } else {
+        if (record.size > pSpool->readBufferSize) {
+            SAFE_MEMFREE(pSpool->pReadBuffer);
+            pSpool->readBufferSize = 0;
+            CHK(NULL != (pSpool->pReadBuffer = (PBYTE) MEMALLOC(record.size)), STATUS_NOT_ENOUGH_MEMORY);
+            pSpool->readBufferSize = record.size;
+        }
+
+        CHK_STATUS(readKvsSpoolBytes(pSpool, segment, offset + SIZEOF(KvsSpoolRecord), pSpool->pReadBuffer, record.size, &readSize));
+
+        // A truncated record is skipped like the padding
+        nextOffset = ROUND_UP(offset + 1, KVS_SPOOL_BLOCK_SIZE);
+        if (readSize == record.size) {
+            nextOffset = offset + SIZEOF(KvsSpoolRecord) + record.size;
+            *pRead = TRUE;
+        }
+    }
+
+    MUTEX_LOCK(pSpool->lock);
+    locked = TRUE;
+
+    // The segment might have been dropped while it was read
+    if (segment == pSpool->readSegment && offset == pSpool->readOffset) {
+        pSpool->readSegment = nextSegment;
+        pSpool->readOffset = nextOffset;
+    } else {
+        *pRead = FALSE;
+    }
+
+    CHK(*pRead, retStatus);
+
+    pFrame->version = FRAME_CURRENT_VERSION;
+    pFrame->index = record.index;
+    pFrame->flags = (FRAME_FLAGS) record.flags;
+    pFrame->decodingTs = record.decodingTs;
+    pFrame->presentationTs = record.presentationTs;
+    pFrame->duration = record.duration;
+    pFrame->trackId = record.trackId;
+    pFrame->size = record.size;
+    pFrame->frameData = pSpool->pReadBuffer;
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pSpool->lock);
+    }
+
+    return retStatus;
+}
+
+PVOID replayKvsSpoolRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS, status;
+    PKvsSpool pSpool = (PKvsSpool) args;
+    PGstKvsPlugin pGstKvsPlugin;
+    Frame frame;
+    BOOL read, spilling, replay;
+    UINT32 availablePercent;
+    UINT64 now, nextPutTime = 0, waitTime;
+
+    CHK(pSpool != NULL, STATUS_NULL_ARG);
+    pGstKvsPlugin = pSpool->pGstKvsPlugin;
+
+    while (!ATOMIC_LOAD_BOOL(&pSpool->terminate)) {
+        MUTEX_LOCK(pSpool->lock);
+        spilling = pSpool->spilling;
+        MUTEX_UNLOCK(pSpool->lock);
+
+        // Nothing is replayed until the stream is there and the upload has freed up the content store
+        replay = spilling && ATOMIC_LOAD_BOOL(&pGstKvsPlugin->kvsStreamReady) &&
+            STATUS_SUCCEEDED(getKinesisVideoStoreAvailablePercent(pGstKvsPlugin, &availablePercent)) &&
+            availablePercent >= KVS_SPOOL_REPLAY_AVAILABLE_PERCENT;
+
+        // Paced to the catch-up rate
+        now = GETTIME();
+        waitTime = !replay ? KVS_SPOOL_POLL_PERIOD : nextPutTime > now ? MIN(nextPutTime - now, KVS_SPOOL_POLL_PERIOD) : 0;
+        if (waitTime != 0) {
+            MUTEX_LOCK(pSpool->lock);
+            if (!ATOMIC_LOAD_BOOL(&pSpool->terminate)) {
+                CVAR_WAIT(pSpool->cvar, pSpool->lock, waitTime);
+            }
+            MUTEX_UNLOCK(pSpool->lock);
+            continue;
+        }
+
+        if (STATUS_FAILED(status = readKvsSpoolFrame(pSpool, &frame, &read))) {
+            DLOGW("Failed to read a frame from the spool with 0x%08x", status);
+            nextPutTime = now + KVS_SPOOL_POLL_PERIOD;
+            continue;
+        }
+
+        if (!read) {
+            // The live frames go straight to the stream again once the replay has caught up.
+            // Checked under the lock so no frame is appended in between.
+            MUTEX_LOCK(pSpool->lock);
+            if (pSpool->readSegment == pSpool->writeSegment && pSpool->readOffset >= pSpool->writeOffset && pSpool->writeBufferOffset == 0) {
+                pSpool->spilling = FALSE;
+                DLOGI("KVS spool replay has caught up after %" PRIu64 " frames", (UINT64) ATOMIC_LOAD(&pSpool->replayedFrameCount));
+            }
+            MUTEX_UNLOCK(pSpool->lock);
+            continue;
+        }
+
+        if (STATUS_FAILED(status = putKinesisVideoFrame(pGstKvsPlugin->kvsContext.streamHandle, &frame))) {
+            DLOGW("Failed to put replayed frame with 0x%08x", status);
+        }
+
+        ATOMIC_INCREMENT(&pSpool->replayedFrameCount);
+
+        if (pSpool->catchupRate != 0) {
+            nextPutTime = MAX(nextPutTime, now) + (UINT64) frame.size * 8 * HUNDREDS_OF_NANOS_IN_A_SECOND / pSpool->catchupRate;
+        }
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+STATUS addKvsSpoolStats(PGstKvsPlugin pGstKvsPlugin, GstStructure* pStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSpool pSpool;
+    UINT64 segmentCount;
+
+    CHK(pGstKvsPlugin != NULL && pStats != NULL, STATUS_NULL_ARG);
+    CHK(NULL != (pSpool = pGstKvsPlugin->pSpool), retStatus);
+
+    MUTEX_LOCK(pSpool->lock);
+    segmentCount = pSpool->spilling ? pSpool->writeSegment - pSpool->readSegment + 1 : 0;
+    MUTEX_UNLOCK(pSpool->lock);
+
+    gst_structure_set(pStats, "spool-spilled-frames", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pSpool->spilledFrameCount), "spool-replayed-frames",
+                      G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pSpool->replayedFrameCount), "spool-evicted-segments", G_TYPE_UINT64,
+                      (guint64) ATOMIC_LOAD(&pSpool->evictedSegmentCount), "spool-segments", G_TYPE_UINT64, (guint64) segmentCount, NULL);
+
+CleanUp:
+
+    return retStatus;
+}
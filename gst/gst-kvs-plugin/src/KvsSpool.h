@@ -0,0 +1,99 @@
+#ifndef __KVS_SPOOL_H__
+#define __KVS_SPOOL_H__
+
+#define DEFAULT_SPOOL_PATH         ""
+#define DEFAULT_SPOOL_SIZE_MB      1024
+#define DEFAULT_SPOOL_CATCHUP_RATE 0
+
+// The spool is a ring of segment files which are only rotated at the key frames so the oldest
+// one can be dropped without breaking the decoding of the rest. A segment goes past the size by a GoP at most.
+#define KVS_SPOOL_SEGMENT_SIZE        (64 * 1024 * 1024)
+#define KVS_SPOOL_MIN_SEGMENT_COUNT   2
+#define KVS_SPOOL_SEGMENT_PATH_FORMAT "%s%c%s-%" PRIu64 ".kvsspool"
+
+// Writes are made in whole blocks from an aligned buffer as required by O_DIRECT
+#define KVS_SPOOL_BLOCK_SIZE        4096
+#define KVS_SPOOL_WRITE_BUFFER_SIZE (1024 * 1024)
+#define KVS_SPOOL_RECORD_MAGIC      0x4C4F4F53
+
+// Frames are spilled once the available content store drops below the put pressure percentage
+// and replayed while it is above this one so the replay doesn't push the stream back under pressure
+#define KVS_SPOOL_REPLAY_AVAILABLE_PERCENT 50
+
+#define KVS_SPOOL_POLL_PERIOD (100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+/**
+ * Header of a frame record in the segment file. The frame bits follow.
+ * The spool is private to the process so the fields are in the host byte order.
+ */
+typedef struct __KvsSpoolRecord KvsSpoolRecord;
+struct __KvsSpoolRecord {
+    UINT32 magic;
+    UINT32 size;
+    UINT32 index;
+    UINT32 flags;
+    UINT64 decodingTs;
+    UINT64 presentationTs;
+    UINT64 duration;
+    UINT64 trackId;
+};
+typedef struct __KvsSpoolRecord* PKvsSpoolRecord;
+
+/**
+ * On-disk spill tier of the main KVS stream. The frames go to the spool rather than the content store
+ * once it is under pressure and stay on that path until the replay has caught up so they are put in order.
+ */
+typedef struct __KvsSpool KvsSpool;
+struct __KvsSpool {
+    PGstKvsPlugin pGstKvsPlugin;
+    CHAR directory[MAX_PATH_LEN + 1];
+    CHAR streamName[MAX_STREAM_NAME_LEN + 1];
+    UINT32 segmentCount;
+    // Replay rate in bits per second. 0 is as fast as the content store takes the frames
+    UINT64 catchupRate;
+
+    // Protects the segment positions and the write side
+    MUTEX lock;
+    CVAR cvar;
+    TID replayTid;
+    volatile ATOMIC_BOOL terminate;
+
+    // Frames are going through the spool
+    BOOL spilling;
+
+    // Segments are numbered in sequence. The ones between the read and the write segment are on disk.
+    UINT64 readSegment;
+    UINT64 readOffset;
+    UINT64 writeSegment;
+    UINT64 writeOffset;
+    INT32 writeFd;
+    PBYTE pWriteBufferAlloc;
+    PBYTE pWriteBuffer;
+    UINT32 writeBufferOffset;
+
+    // Accessed by the replay thread only
+    INT32 readFd;
+    UINT64 readFdSegment;
+    PBYTE pReadBuffer;
+    UINT32 readBufferSize;
+
+    volatile SIZE_T spilledFrameCount;
+    volatile SIZE_T replayedFrameCount;
+    volatile SIZE_T evictedSegmentCount;
+};
+typedef struct __KvsSpool* PKvsSpool;
+
+STATUS startKinesisVideoSpool(PGstKvsPlugin);
+STATUS stopKinesisVideoSpool(PGstKvsPlugin);
+STATUS putKinesisVideoStreamFrame(PGstKvsPlugin, PFrame);
+VOID getKvsSpoolSegmentPath(PKvsSpool, UINT64, PCHAR);
+STATUS openKvsSpoolSegment(PKvsSpool);
+STATUS appendKvsSpoolBytes(PKvsSpool, PBYTE, UINT32);
+STATUS flushKvsSpoolWriteBuffer(PKvsSpool);
+STATUS appendKvsSpoolFrame(PKvsSpool, PFrame);
+STATUS readKvsSpoolBytes(PKvsSpool, UINT64, UINT64, PBYTE, UINT32, PUINT32);
+STATUS readKvsSpoolFrame(PKvsSpool, PFrame, PBOOL);
+PVOID replayKvsSpoolRoutine(PVOID);
+STATUS addKvsSpoolStats(PGstKvsPlugin, GstStructure*);
+
+#endif //__KVS_SPOOL_H__
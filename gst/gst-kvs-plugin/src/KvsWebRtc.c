@@ -58,6 +58,10 @@ VOID onConnectionStateChange(UINT64 customData, RTC_PEER_CONNECTION_STATE newSta
     switch (newState) {
         case RTC_PEER_CONNECTION_STATE_CONNECTED:
             ATOMIC_STORE_BOOL(&pStreamingSession->connected, TRUE);
+            updateIceConnectLatency(pStreamingSession);
+
+            // Have the encoder start a new GoP for the viewer rather than replaying a long one
+            ATOMIC_STORE_BOOL(&pStreamingSession->pGstKvsPlugin->keyUnitRequested, TRUE);
             if (STATUS_FAILED(retStatus = logSelectedIceCandidatesInformation(pStreamingSession))) {
                 DLOGW("Failed to get information about selected Ice candidates: 0x%08x", retStatus);
             }
@@ -83,15 +87,61 @@ STATUS signalingClientMessageReceivedFn(UINT64 customData, PReceivedSignalingMes
 {
     STATUS retStatus = STATUS_SUCCESS;
     PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) customData;
-    BOOL peerConnectionFound = FALSE;
-    BOOL locked = TRUE;
+    PSignalingWorker pSignalingWorker;
+    PSignalingWorkItem pSignalingWorkItem = NULL;
+    UINT32 clientIdHash;
+    BOOL locked = FALSE;
+
+    CHK(pGstKvsPlugin != NULL && pReceivedSignalingMessage != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pSignalingWorkers != NULL, STATUS_INVALID_OPERATION);
+
+    // The messages of a peer always go to the same worker so they are handled in order
+    clientIdHash = COMPUTE_CRC32((PBYTE) pReceivedSignalingMessage->signalingMessage.peerClientId,
+                                 (UINT32) STRLEN(pReceivedSignalingMessage->signalingMessage.peerClientId));
+    pSignalingWorker = &pGstKvsPlugin->pSignalingWorkers[clientIdHash % GST_PLUGIN_SIGNALING_WORKER_COUNT];
+
+    CHK(NULL != (pSignalingWorkItem = (PSignalingWorkItem) MEMALLOC(SIZEOF(SignalingWorkItem))), STATUS_NOT_ENOUGH_MEMORY);
+    pSignalingWorkItem->pGstKvsPlugin = pGstKvsPlugin;
+    pSignalingWorkItem->receivedSignalingMessage = *pReceivedSignalingMessage;
+
+    MUTEX_LOCK(pSignalingWorker->lock);
+    locked = TRUE;
+
+    CHK(pSignalingWorker->pMessageQueue != NULL, STATUS_INVALID_OPERATION);
+    CHK_STATUS(stackQueueEnqueue(pSignalingWorker->pMessageQueue, (UINT64) pSignalingWorkItem));
+    pSignalingWorkItem = NULL;
+
+    // Elements stopping wait on the same cvar
+    CVAR_BROADCAST(pSignalingWorker->cvar);
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pSignalingWorker->lock);
+    }
+
+    SAFE_MEMFREE(pSignalingWorkItem);
+
+    CHK_LOG_ERR(retStatus);
+    return retStatus;
+}
+
+STATUS handleSignalingMessage(PGstKvsPlugin pGstKvsPlugin, PReceivedSignalingMessage pReceivedSignalingMessage)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    BOOL peerConnectionFound = FALSE, offerReserved = FALSE;
+    BOOL locked = FALSE;
     UINT32 clientIdHash;
-    UINT64 hashValue = 0;
+    UINT64 hashValue = 0, offerReceiveTime;
     PPendingMessageQueue pPendingMessageQueue = NULL;
     PWebRtcStreamingSession pStreamingSession = NULL;
-    PReceivedSignalingMessage pReceivedSignalingMessageCopy = NULL;
+    PPendingMessageQueue pPendingQueue;
+    PCHAR pCandidate = NULL;
+    RtcIceCandidateInit iceCandidate;
+    UINT32 candidateCount, candidateLen;
+    PWebRtcSessionList pSessionList;
 
-    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin != NULL && pReceivedSignalingMessage != NULL, STATUS_NULL_ARG);
 
     MUTEX_LOCK(pGstKvsPlugin->sessionLock);
     locked = TRUE;
@@ -116,30 +166,50 @@ STATUS signalingClientMessageReceivedFn(UINT64 customData, PReceivedSignalingMes
              * any ice candidate messages queued in pPendingSignalingMessageForRemoteClient. If so then submit
              * all of them.
              */
-            if (pGstKvsPlugin->streamingSessionCount == ARRAY_SIZE(pGstKvsPlugin->streamingSessionList)) {
+            pSessionList = (PWebRtcSessionList) ATOMIC_LOAD(&pGstKvsPlugin->streamingSessionList);
+            if ((pSessionList == NULL ? 0 : pSessionList->count) + pGstKvsPlugin->offersInProgress >= pGstKvsPlugin->gstParams.maxViewers) {
                 DLOGW("Max simultaneous streaming session count reached.");
 
                 // Need to remove the pending queue if any.
                 // This is a simple optimization as the session cleanup will
                 // handle the cleanup of pending message queue after a while
                 CHK_STATUS(
-                    getPendingMessageQueueForHash(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientIdHash, TRUE, &pPendingMessageQueue));
+                    getPendingMessageQueueForHash(pGstKvsPlugin, clientIdHash, TRUE, &pPendingMessageQueue));
 
                 CHK(FALSE, retStatus);
             }
+
+            // Hold the viewer slot while the session is set up outside of the lock so the other
+            // workers can answer their offers in parallel
+            pGstKvsPlugin->offersInProgress++;
+            offerReserved = TRUE;
+            MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+            locked = FALSE;
+
+            offerReceiveTime = GETTIME();
             CHK_STATUS(
                 createWebRtcStreamingSession(pGstKvsPlugin, pReceivedSignalingMessage->signalingMessage.peerClientId, TRUE, &pStreamingSession));
-            pStreamingSession->offerReceiveTime = GETTIME();
-            MUTEX_LOCK(pGstKvsPlugin->sessionListReadLock);
-            pGstKvsPlugin->streamingSessionList[pGstKvsPlugin->streamingSessionCount++] = pStreamingSession;
-            MUTEX_UNLOCK(pGstKvsPlugin->sessionListReadLock);
+            pStreamingSession->offerReceiveTime = offerReceiveTime;
+            if (STATUS_FAILED(retStatus = handleOffer(pGstKvsPlugin, pStreamingSession, &pReceivedSignalingMessage->signalingMessage))) {
+                freeWebRtcStreamingSession(&pStreamingSession);
+                CHK(FALSE, retStatus);
+            }
+
+            MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+            locked = TRUE;
+
+            pGstKvsPlugin->offersInProgress--;
+            offerReserved = FALSE;
+            if (STATUS_FAILED(retStatus = addStreamingSessionToList(pGstKvsPlugin, pStreamingSession))) {
+                freeWebRtcStreamingSession(&pStreamingSession);
+                CHK(FALSE, retStatus);
+            }
 
-            CHK_STATUS(handleOffer(pGstKvsPlugin, pStreamingSession, &pReceivedSignalingMessage->signalingMessage));
             CHK_STATUS(hashTablePut(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient, clientIdHash, (UINT64) pStreamingSession));
 
             // If there are any ice candidate messages in the queue for this client id, submit them now.
             CHK_STATUS(
-                getPendingMessageQueueForHash(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientIdHash, TRUE, &pPendingMessageQueue));
+                getPendingMessageQueueForHash(pGstKvsPlugin, clientIdHash, TRUE, &pPendingMessageQueue));
             if (pPendingMessageQueue != NULL) {
                 CHK_STATUS(submitPendingIceCandidate(pPendingMessageQueue, pStreamingSession));
 
@@ -155,13 +225,15 @@ STATUS signalingClientMessageReceivedFn(UINT64 customData, PReceivedSignalingMes
              * Lastly check if there is any ice candidate messages queued in pPendingSignalingMessageForRemoteClient.
              * If so then submit all of them.
              */
-            pStreamingSession = pGstKvsPlugin->streamingSessionList[0];
+            pSessionList = (PWebRtcSessionList) ATOMIC_LOAD(&pGstKvsPlugin->streamingSessionList);
+            CHK(pSessionList != NULL && pSessionList->count != 0, STATUS_INVALID_OPERATION);
+            pStreamingSession = pSessionList->sessions[0];
             CHK_STATUS(handleAnswer(pGstKvsPlugin, pStreamingSession, &pReceivedSignalingMessage->signalingMessage));
             CHK_STATUS(hashTablePut(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient, clientIdHash, (UINT64) pStreamingSession));
 
             // If there are any ice candidate messages in the queue for this client id, submit them now.
             CHK_STATUS(
-                getPendingMessageQueueForHash(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientIdHash, TRUE, &pPendingMessageQueue));
+                getPendingMessageQueueForHash(pGstKvsPlugin, clientIdHash, TRUE, &pPendingMessageQueue));
             if (pPendingMessageQueue != NULL) {
                 CHK_STATUS(submitPendingIceCandidate(pPendingMessageQueue, pStreamingSession));
 
@@ -176,22 +248,36 @@ STATUS signalingClientMessageReceivedFn(UINT64 customData, PReceivedSignalingMes
              * submit the signaling message into the corresponding streaming session.
              */
             if (!peerConnectionFound) {
-                CHK_STATUS(getPendingMessageQueueForHash(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientIdHash, FALSE,
-                                                         &pPendingMessageQueue));
+                // Only the candidate string is kept until the session is created
+                CHK_STATUS(deserializeRtcIceCandidateInit(pReceivedSignalingMessage->signalingMessage.payload,
+                                                          pReceivedSignalingMessage->signalingMessage.payloadLen, &iceCandidate));
+                candidateLen = (UINT32) STRLEN(iceCandidate.candidate);
+                CHK(NULL != (pCandidate = (PCHAR) MEMALLOC(candidateLen + 1)), STATUS_NOT_ENOUGH_MEMORY);
+                MEMCPY(pCandidate, iceCandidate.candidate, candidateLen + 1);
+
+                CHK_STATUS(getPendingMessageQueueForHash(pGstKvsPlugin, clientIdHash, FALSE, &pPendingMessageQueue));
                 if (pPendingMessageQueue == NULL) {
                     CHK_STATUS(createMessageQueue(clientIdHash, &pPendingMessageQueue));
-                    CHK_STATUS(stackQueueEnqueue(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, (UINT64) pPendingMessageQueue));
+                    CHK_STATUS(addPendingMessageQueue(pGstKvsPlugin, pPendingMessageQueue));
                 }
 
-                pReceivedSignalingMessageCopy = (PReceivedSignalingMessage) MEMCALLOC(1, SIZEOF(ReceivedSignalingMessage));
+                // The queue is owned by the pending store from here on
+                pPendingQueue = pPendingMessageQueue;
+                pPendingMessageQueue = NULL;
+
+                CHK_STATUS(stackQueueGetCount(pPendingQueue->messageQueue, &candidateCount));
+                if (candidateCount >= GST_PLUGIN_PENDING_CANDIDATE_MAX_COUNT) {
+                    ATOMIC_INCREMENT(&pGstKvsPlugin->droppedPendingCandidateCount);
+                }
 
-                *pReceivedSignalingMessageCopy = *pReceivedSignalingMessage;
+                CHK_WARN(candidateCount < GST_PLUGIN_PENDING_CANDIDATE_MAX_COUNT, retStatus,
+                         "Dropping the ICE candidate of peer %s as too many are pending", pReceivedSignalingMessage->signalingMessage.peerClientId);
 
-                CHK_STATUS(stackQueueEnqueue(pPendingMessageQueue->messageQueue, (UINT64) pReceivedSignalingMessageCopy));
+                CHK_STATUS(stackQueueEnqueue(pPendingQueue->messageQueue, (UINT64) pCandidate));
+                ATOMIC_INCREMENT(&pGstKvsPlugin->pendingCandidateCount);
 
-                // NULL the pointers to not free any longer
-                pPendingMessageQueue = NULL;
-                pReceivedSignalingMessageCopy = NULL;
+                // NULL the pointer to not free any longer
+                pCandidate = NULL;
             } else {
                 CHK_STATUS(handleRemoteCandidate(pStreamingSession, &pReceivedSignalingMessage->signalingMessage));
             }
@@ -204,11 +290,20 @@ STATUS signalingClientMessageReceivedFn(UINT64 customData, PReceivedSignalingMes
 
 CleanUp:
 
-    SAFE_MEMFREE(pReceivedSignalingMessageCopy);
+    SAFE_MEMFREE(pCandidate);
     if (pPendingMessageQueue != NULL) {
         freeMessageQueue(pPendingMessageQueue);
     }
 
+    if (offerReserved) {
+        if (!locked) {
+            MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+            locked = TRUE;
+        }
+
+        pGstKvsPlugin->offersInProgress--;
+    }
+
     if (locked) {
         MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
     }
@@ -217,6 +312,285 @@ CleanUp:
     return retStatus;
 }
 
+STATUS startSignalingWorkers(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PKvsSharedClient pSharedClient;
+    PSignalingWorker pSignalingWorkers = NULL, pSignalingWorker;
+    BOOL locked = FALSE;
+    UINT32 i;
+
+    CHK(pGstKvsPlugin != NULL && pGstKvsPlugin->kvsContext.pSharedClient != NULL, STATUS_NULL_ARG);
+    pSharedClient = pGstKvsPlugin->kvsContext.pSharedClient;
+
+    MUTEX_LOCK(pSharedClient->signalingWorkerLock);
+    locked = TRUE;
+
+    // The elements on the client hand their messages to the same workers
+    if (pSharedClient->pSignalingWorkers == NULL) {
+        CHK(NULL != (pSignalingWorkers = (PSignalingWorker) MEMCALLOC(GST_PLUGIN_SIGNALING_WORKER_COUNT, SIZEOF(SignalingWorker))),
+            STATUS_NOT_ENOUGH_MEMORY);
+        for (i = 0; i < GST_PLUGIN_SIGNALING_WORKER_COUNT; i++) {
+            pSignalingWorkers[i].tid = INVALID_TID_VALUE;
+            pSignalingWorkers[i].lock = INVALID_MUTEX_VALUE;
+            pSignalingWorkers[i].cvar = INVALID_CVAR_VALUE;
+        }
+
+        for (i = 0; i < GST_PLUGIN_SIGNALING_WORKER_COUNT; i++) {
+            pSignalingWorker = &pSignalingWorkers[i];
+            ATOMIC_STORE_BOOL(&pSignalingWorker->terminate, FALSE);
+            pSignalingWorker->lock = MUTEX_CREATE(FALSE);
+            CHK(IS_VALID_MUTEX_VALUE(pSignalingWorker->lock), STATUS_INVALID_OPERATION);
+            pSignalingWorker->cvar = CVAR_CREATE();
+            CHK(IS_VALID_CVAR_VALUE(pSignalingWorker->cvar), STATUS_INVALID_OPERATION);
+            CHK_STATUS(stackQueueCreate(&pSignalingWorker->pMessageQueue));
+            CHK_STATUS(THREAD_CREATE(&pSignalingWorker->tid, signalingWorkerRoutine, (PVOID) pSignalingWorker));
+        }
+
+        pSharedClient->pSignalingWorkers = pSignalingWorkers;
+        pSignalingWorkers = NULL;
+    }
+
+    pGstKvsPlugin->pSignalingWorkers = pSharedClient->pSignalingWorkers;
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pSharedClient->signalingWorkerLock);
+    }
+
+    freeSignalingWorkers(pSignalingWorkers);
+
+    CHK_LOG_ERR(retStatus);
+    return retStatus;
+}
+
+STATUS stopSignalingWorkers(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PSignalingWorker pSignalingWorker;
+    PSignalingWorkItem pSignalingWorkItem;
+    UINT64 data;
+    UINT32 i, j, count;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pSignalingWorkers != NULL, retStatus);
+
+    // The workers keep serving the other elements. Only the messages of this one are dropped
+    // and the one being handled is waited out as the element is about to be freed.
+    for (i = 0; i < GST_PLUGIN_SIGNALING_WORKER_COUNT; i++) {
+        pSignalingWorker = &pGstKvsPlugin->pSignalingWorkers[i];
+
+        MUTEX_LOCK(pSignalingWorker->lock);
+        count = 0;
+        CHK_LOG_ERR(stackQueueGetCount(pSignalingWorker->pMessageQueue, &count));
+        for (j = 0; j < count && STATUS_SUCCEEDED(stackQueueDequeue(pSignalingWorker->pMessageQueue, &data)); j++) {
+            pSignalingWorkItem = (PSignalingWorkItem) data;
+            if (pSignalingWorkItem->pGstKvsPlugin == pGstKvsPlugin ||
+                STATUS_FAILED(stackQueueEnqueue(pSignalingWorker->pMessageQueue, (UINT64) pSignalingWorkItem))) {
+                MEMFREE(pSignalingWorkItem);
+            }
+        }
+
+        while (pSignalingWorker->pActiveGstKvsPlugin == pGstKvsPlugin) {
+            CVAR_WAIT(pSignalingWorker->cvar, pSignalingWorker->lock, INFINITE_TIME_VALUE);
+        }
+        MUTEX_UNLOCK(pSignalingWorker->lock);
+    }
+
+    pGstKvsPlugin->pSignalingWorkers = NULL;
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID freeSignalingWorkers(PSignalingWorker pSignalingWorkers)
+{
+    PSignalingWorker pSignalingWorker;
+    UINT64 data;
+    UINT32 i;
+
+    if (pSignalingWorkers == NULL) {
+        return;
+    }
+
+    for (i = 0; i < GST_PLUGIN_SIGNALING_WORKER_COUNT; i++) {
+        pSignalingWorker = &pSignalingWorkers[i];
+        ATOMIC_STORE_BOOL(&pSignalingWorker->terminate, TRUE);
+
+        if (IS_VALID_TID_VALUE(pSignalingWorker->tid)) {
+            MUTEX_LOCK(pSignalingWorker->lock);
+            CVAR_BROADCAST(pSignalingWorker->cvar);
+            MUTEX_UNLOCK(pSignalingWorker->lock);
+            THREAD_JOIN(pSignalingWorker->tid, NULL);
+            pSignalingWorker->tid = INVALID_TID_VALUE;
+        }
+
+        // The elements have stopped their signaling by now so nothing is left normally
+        if (pSignalingWorker->pMessageQueue != NULL) {
+            while (STATUS_SUCCEEDED(stackQueueDequeue(pSignalingWorker->pMessageQueue, &data))) {
+                MEMFREE((PVOID) data);
+            }
+
+            stackQueueFree(pSignalingWorker->pMessageQueue);
+            pSignalingWorker->pMessageQueue = NULL;
+        }
+
+        if (IS_VALID_CVAR_VALUE(pSignalingWorker->cvar)) {
+            CVAR_FREE(pSignalingWorker->cvar);
+            pSignalingWorker->cvar = INVALID_CVAR_VALUE;
+        }
+
+        if (IS_VALID_MUTEX_VALUE(pSignalingWorker->lock)) {
+            MUTEX_FREE(pSignalingWorker->lock);
+            pSignalingWorker->lock = INVALID_MUTEX_VALUE;
+        }
+    }
+
+    MEMFREE(pSignalingWorkers);
+}
+
+PVOID signalingWorkerRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PSignalingWorker pSignalingWorker = (PSignalingWorker) args;
+    PSignalingWorkItem pSignalingWorkItem;
+    UINT64 data;
+
+    CHK(pSignalingWorker != NULL, STATUS_NULL_ARG);
+
+    while (!ATOMIC_LOAD_BOOL(&pSignalingWorker->terminate)) {
+        MUTEX_LOCK(pSignalingWorker->lock);
+        if (STATUS_FAILED(stackQueueDequeue(pSignalingWorker->pMessageQueue, &data))) {
+            // Re-check the termination under the lock so the signal is not missed
+            if (!ATOMIC_LOAD_BOOL(&pSignalingWorker->terminate)) {
+                CVAR_WAIT(pSignalingWorker->cvar, pSignalingWorker->lock, INFINITE_TIME_VALUE);
+            }
+
+            MUTEX_UNLOCK(pSignalingWorker->lock);
+            continue;
+        }
+
+        pSignalingWorkItem = (PSignalingWorkItem) data;
+        pSignalingWorker->pActiveGstKvsPlugin = pSignalingWorkItem->pGstKvsPlugin;
+        MUTEX_UNLOCK(pSignalingWorker->lock);
+
+        CHK_LOG_ERR(handleSignalingMessage(pSignalingWorkItem->pGstKvsPlugin, &pSignalingWorkItem->receivedSignalingMessage));
+        MEMFREE(pSignalingWorkItem);
+
+        MUTEX_LOCK(pSignalingWorker->lock);
+        pSignalingWorker->pActiveGstKvsPlugin = NULL;
+        CVAR_BROADCAST(pSignalingWorker->cvar);
+        MUTEX_UNLOCK(pSignalingWorker->lock);
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+STATUS startSessionWorker(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(!IS_VALID_TID_VALUE(pGstKvsPlugin->sessionWorkerTid), retStatus);
+
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->sessionWorkerTerminate, FALSE);
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->poolRefillRequested, FALSE);
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->iceConfigRefreshRequested, FALSE);
+    pGstKvsPlugin->sessionWorkerLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pGstKvsPlugin->sessionWorkerLock), STATUS_INVALID_OPERATION);
+    pGstKvsPlugin->sessionWorkerCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pGstKvsPlugin->sessionWorkerCvar), STATUS_INVALID_OPERATION);
+    CHK_STATUS(THREAD_CREATE(&pGstKvsPlugin->sessionWorkerTid, sessionWorkerRoutine, (PVOID) pGstKvsPlugin));
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+    return retStatus;
+}
+
+STATUS stopSessionWorker(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    ATOMIC_STORE_BOOL(&pGstKvsPlugin->sessionWorkerTerminate, TRUE);
+
+    if (IS_VALID_TID_VALUE(pGstKvsPlugin->sessionWorkerTid)) {
+        MUTEX_LOCK(pGstKvsPlugin->sessionWorkerLock);
+        CVAR_SIGNAL(pGstKvsPlugin->sessionWorkerCvar);
+        MUTEX_UNLOCK(pGstKvsPlugin->sessionWorkerLock);
+        THREAD_JOIN(pGstKvsPlugin->sessionWorkerTid, NULL);
+        pGstKvsPlugin->sessionWorkerTid = INVALID_TID_VALUE;
+    }
+
+    if (IS_VALID_CVAR_VALUE(pGstKvsPlugin->sessionWorkerCvar)) {
+        CVAR_FREE(pGstKvsPlugin->sessionWorkerCvar);
+        pGstKvsPlugin->sessionWorkerCvar = INVALID_CVAR_VALUE;
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->sessionWorkerLock)) {
+        MUTEX_FREE(pGstKvsPlugin->sessionWorkerLock);
+        pGstKvsPlugin->sessionWorkerLock = INVALID_MUTEX_VALUE;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID requestSessionWork(PGstKvsPlugin pGstKvsPlugin, volatile ATOMIC_BOOL* pRequested)
+{
+    if (pGstKvsPlugin == NULL || pRequested == NULL || !IS_VALID_TID_VALUE(pGstKvsPlugin->sessionWorkerTid)) {
+        return;
+    }
+
+    ATOMIC_STORE_BOOL(pRequested, TRUE);
+
+    MUTEX_LOCK(pGstKvsPlugin->sessionWorkerLock);
+    CVAR_SIGNAL(pGstKvsPlugin->sessionWorkerCvar);
+    MUTEX_UNLOCK(pGstKvsPlugin->sessionWorkerLock);
+}
+
+PVOID sessionWorkerRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) args;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    while (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->sessionWorkerTerminate)) {
+        MUTEX_LOCK(pGstKvsPlugin->sessionWorkerLock);
+        // Re-check the requests under the lock so the signal is not missed
+        if (!ATOMIC_LOAD_BOOL(&pGstKvsPlugin->sessionWorkerTerminate) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->poolRefillRequested) &&
+            !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->iceConfigRefreshRequested)) {
+            CVAR_WAIT(pGstKvsPlugin->sessionWorkerCvar, pGstKvsPlugin->sessionWorkerLock, INFINITE_TIME_VALUE);
+        }
+        MUTEX_UNLOCK(pGstKvsPlugin->sessionWorkerLock);
+
+        // Refreshed first so the refilled sessions pick up the new configuration
+        if (ATOMIC_EXCHANGE_BOOL(&pGstKvsPlugin->iceConfigRefreshRequested, FALSE) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->sessionWorkerTerminate)) {
+            CHK_LOG_ERR(refreshIceServerConfig(pGstKvsPlugin));
+        }
+
+        if (ATOMIC_EXCHANGE_BOOL(&pGstKvsPlugin->poolRefillRequested, FALSE) && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->sessionWorkerTerminate)) {
+            CHK_LOG_ERR(refillStreamingSessionPool(pGstKvsPlugin));
+        }
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
 STATUS initKinesisVideoWebRtc(PGstKvsPlugin pGstPlugin)
 {
     STATUS retStatus = STATUS_SUCCESS;
@@ -229,13 +603,24 @@ STATUS initKinesisVideoWebRtc(PGstKvsPlugin pGstPlugin)
     ATOMIC_STORE_BOOL(&pGstPlugin->signalingConnected, FALSE);
 
     pGstPlugin->sessionLock = MUTEX_CREATE(TRUE);
-
-    pGstPlugin->sessionListReadLock = MUTEX_CREATE(FALSE);
     pGstPlugin->signalingLock = MUTEX_CREATE(FALSE);
 
+    ATOMIC_STORE(&pGstPlugin->streamingSessionList, (SIZE_T) NULL);
+    ATOMIC_STORE(&pGstPlugin->sessionListEpoch, 0);
+    ATOMIC_STORE(&pGstPlugin->sessionListReaders[0], 0);
+    ATOMIC_STORE(&pGstPlugin->sessionListReaders[1], 0);
+    MEMSET(&pGstPlugin->gopCache, 0x00, SIZEOF(GopCache));
+
     pGstPlugin->pregenerateCertTimerId = MAX_UINT32;
     pGstPlugin->serviceRoutineTimerId = MAX_UINT32;
+    pGstPlugin->statsTimerId = MAX_UINT32;
+    pGstPlugin->iceCandidatePairStatsTimerId = MAX_UINT32;
+    pGstPlugin->timersCancelled = FALSE;
     pGstPlugin->iceUriCount = 0;
+    pGstPlugin->iceConfigRefreshTimerId = MAX_UINT32;
+    pGstPlugin->pIceServers = NULL;
+    pGstPlugin->iceServerCount = 0;
+    pGstPlugin->iceConfigExpiration = 0;
 
     MEMSET(&pGstPlugin->kvsContext.channelInfo, 0x00, SIZEOF(ChannelInfo));
     MEMSET(&pGstPlugin->kvsContext.signalingClientInfo, 0x00, SIZEOF(SignalingClientInfo));
@@ -269,18 +654,44 @@ STATUS initKinesisVideoWebRtc(PGstKvsPlugin pGstPlugin)
     STRCPY(pGstPlugin->kvsContext.signalingClientInfo.clientId, DEFAULT_MASTER_CLIENT_ID);
     pGstPlugin->kvsContext.signalingClientInfo.cacheFilePath = NULL; // Use the default path
 
-    CHK_STATUS(stackQueueCreate(&pGstPlugin->pPendingSignalingMessageForRemoteClient));
+    CHK_STATUS(hashTableCreateWithParams(GST_PLUGIN_HASH_TABLE_BUCKET_COUNT, GST_PLUGIN_HASH_TABLE_BUCKET_LENGTH,
+                                         &pGstPlugin->pPendingSignalingMessageForRemoteClient));
+    MEMSET(pGstPlugin->pendingMessageWheel, 0x00, SIZEOF(pGstPlugin->pendingMessageWheel));
+    pGstPlugin->pendingMessageWheelTick = 0;
+    ATOMIC_STORE(&pGstPlugin->pendingPeerCount, 0);
+    ATOMIC_STORE(&pGstPlugin->pendingCandidateCount, 0);
+    ATOMIC_STORE(&pGstPlugin->droppedPendingCandidateCount, 0);
     CHK_STATUS(hashTableCreateWithParams(GST_PLUGIN_HASH_TABLE_BUCKET_COUNT, GST_PLUGIN_HASH_TABLE_BUCKET_LENGTH,
                                          &pGstPlugin->pRtcPeerConnectionForRemoteClient));
 
-    CHK_STATUS(timerQueueCreate(&pGstPlugin->kvsContext.timerQueueHandle));
+    // The timer queue is shared with the other elements on the same client
+    CHK(IS_VALID_TIMER_QUEUE_HANDLE(pGstPlugin->kvsContext.timerQueueHandle), STATUS_INVALID_OPERATION);
 
     CHK_STATUS(stackQueueCreate(&pGstPlugin->pregeneratedCertificates));
+    CHK_STATUS(stackQueueCreate(&pGstPlugin->pPreparedSessions));
+    pGstPlugin->offersInProgress = 0;
+
+    // The workers need to be up before the signaling client starts delivering the messages
+    CHK_STATUS(startSignalingWorkers(pGstPlugin));
+    CHK_STATUS(startSessionWorker(pGstPlugin));
 
     CHK_LOG_ERR(retStatus = timerQueueAddTimer(pGstPlugin->kvsContext.timerQueueHandle, GST_PLUGIN_PRE_GENERATE_CERT_START,
                                                GST_PLUGIN_PRE_GENERATE_CERT_PERIOD, pregenerateCertTimerCallback, (UINT64) pGstPlugin,
                                                &pGstPlugin->pregenerateCertTimerId));
 
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
+STATUS connectKinesisVideoWebRtc(PGstKvsPlugin pGstPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    CHK(pGstPlugin != NULL, STATUS_NULL_ARG);
+
     // Create the signaling client
     CHK_STATUS(createSignalingClientSync(&pGstPlugin->kvsContext.signalingClientInfo, &pGstPlugin->kvsContext.channelInfo,
                                          &pGstPlugin->kvsContext.signalingClientCallbacks, pGstPlugin->kvsContext.pCredentialProvider,
@@ -289,6 +700,14 @@ STATUS initKinesisVideoWebRtc(PGstKvsPlugin pGstPlugin)
     // Get signaling client to Ready state
     CHK_STATUS(signalingClientFetchSync(pGstPlugin->kvsContext.signalingHandle));
 
+    // Keep the ICE server configuration cached for the sessions and refresh it ahead of its expiration
+    if (pGstPlugin->gstParams.connectionMode != WEBRTC_CONNECTION_MODE_P2P_ONLY) {
+        CHK_LOG_ERR(refreshIceServerConfig(pGstPlugin));
+        CHK_LOG_ERR(retStatus = timerQueueAddTimer(pGstPlugin->kvsContext.timerQueueHandle, GST_PLUGIN_ICE_CONFIG_REFRESH_PERIOD,
+                                                   GST_PLUGIN_ICE_CONFIG_REFRESH_PERIOD, iceConfigRefreshTimerCallback, (UINT64) pGstPlugin,
+                                                   &pGstPlugin->iceConfigRefreshTimerId));
+    }
+
     // Get signaling client to connect state
     if (ATOMIC_LOAD_BOOL(&pGstPlugin->connectWebRtc)) {
         CHK_STATUS(signalingClientConnectSync(pGstPlugin->kvsContext.signalingHandle));
@@ -301,100 +720,449 @@ CleanUp:
     return retStatus;
 }
 
-STATUS createMessageQueue(UINT64 hashValue, PPendingMessageQueue* ppPendingMessageQueue)
+PVOID startKinesisVideoWebRtcRoutine(PVOID args)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    PPendingMessageQueue pPendingMessageQueue = NULL;
+    PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) args;
 
-    CHK(ppPendingMessageQueue != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
 
-    CHK(NULL != (pPendingMessageQueue = (PPendingMessageQueue) MEMCALLOC(1, SIZEOF(PendingMessageQueue))), STATUS_NOT_ENOUGH_MEMORY);
-    pPendingMessageQueue->hashValue = hashValue;
-    pPendingMessageQueue->createTime = GETTIME();
-    CHK_STATUS(stackQueueCreate(&pPendingMessageQueue->messageQueue));
+    // The loopback viewers are signaled in the process so the signaling client is never created
+    if (pGstKvsPlugin->gstParams.webRtcLoopbackViewers != 0) {
+        CHK_STATUS(createWebRtcLoopbackViewers(pGstKvsPlugin));
+    } else {
+        CHK_STATUS(connectKinesisVideoWebRtc(pGstKvsPlugin));
+    }
+
+    // Schedule the WebRTC master session servicing periodic routine. It takes over the signaling client from here.
+    CHK_STATUS(timerQueueAddTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, GST_PLUGIN_SERVICE_ROUTINE_START, GST_PLUGIN_SERVICE_ROUTINE_PERIOD,
+                                  sessionServiceHandler, (UINT64) pGstKvsPlugin, &pGstKvsPlugin->serviceRoutineTimerId));
+
+    postReadyMessage(pGstKvsPlugin, (PCHAR) KVS_READY_COMPONENT_SIGNALING);
 
 CleanUp:
 
-    if (STATUS_FAILED(retStatus) && pPendingMessageQueue != NULL) {
-        freeMessageQueue(pPendingMessageQueue);
-        pPendingMessageQueue = NULL;
-    }
+    CHK_LOG_ERR(retStatus);
 
-    if (ppPendingMessageQueue != NULL) {
-        *ppPendingMessageQueue = pPendingMessageQueue;
+    if (STATUS_FAILED(retStatus) && pGstKvsPlugin != NULL) {
+        GST_ELEMENT_ERROR(pGstKvsPlugin, LIBRARY, INIT, (NULL), ("Failed to initialize KVS signaling client with 0x%08x", retStatus));
     }
 
-    return retStatus;
+    return (PVOID) (ULONG_PTR) retStatus;
 }
 
-STATUS freeMessageQueue(PPendingMessageQueue pPendingMessageQueue)
+STATUS createWebRtcLoopbackViewers(PGstKvsPlugin pGstKvsPlugin)
 {
     STATUS retStatus = STATUS_SUCCESS;
+    UINT32 i;
 
-    // free is idempotent
-    CHK(pPendingMessageQueue != NULL, retStatus);
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(ATOMIC_LOAD_BOOL(&pGstKvsPlugin->connectWebRtc), retStatus);
 
-    if (pPendingMessageQueue->messageQueue != NULL) {
-        stackQueueClear(pPendingMessageQueue->messageQueue, TRUE);
-        stackQueueFree(pPendingMessageQueue->messageQueue);
+    if (pGstKvsPlugin->gstParams.webRtcLoopbackViewers > pGstKvsPlugin->gstParams.maxViewers) {
+        DLOGW("Only %u of the %u loopback viewers will be answered", pGstKvsPlugin->gstParams.maxViewers,
+              pGstKvsPlugin->gstParams.webRtcLoopbackViewers);
     }
 
-    MEMFREE(pPendingMessageQueue);
+    CHK(NULL !=
+            (pGstKvsPlugin->pLoopbackViewers =
+                 (PWebRtcLoopbackViewer) MEMCALLOC(pGstKvsPlugin->gstParams.webRtcLoopbackViewers, SIZEOF(WebRtcLoopbackViewer))),
+        STATUS_NOT_ENOUGH_MEMORY);
+
+    // The flood goes ahead of the offers of the viewers so they are answered with the store at its fullest
+    CHK_STATUS(sendLoopbackEarlyCandidates(pGstKvsPlugin));
+
+    // The viewer count is only bumped once the viewer is set up so the shim never sees a partial one
+    for (i = 0; i < pGstKvsPlugin->gstParams.webRtcLoopbackViewers; i++) {
+        CHK_STATUS(initWebRtcLoopbackViewer(pGstKvsPlugin, i, &pGstKvsPlugin->pLoopbackViewers[i]));
+    }
 
 CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
     return retStatus;
 }
 
-STATUS freeGstKvsWebRtcPlugin(PGstKvsPlugin pGstKvsPlugin)
+STATUS initWebRtcLoopbackViewer(PGstKvsPlugin pGstKvsPlugin, UINT32 index, PWebRtcLoopbackViewer pViewer)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    UINT32 i;
-    UINT64 data;
-    StackQueueIterator iterator;
-    BOOL locked = FALSE;
-
-    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    RtcConfiguration configuration;
+    RtcMediaStreamTrack videoTrack, audioTrack;
+    RtcRtpTransceiverInit transceiverInit;
+    RtcSessionDescriptionInit offerSessionDescriptionInit;
+    PCHAR pOffer = NULL;
+    UINT32 offerLen = MAX_SIGNALING_MESSAGE_LEN + 1;
 
-    if (IS_VALID_SIGNALING_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.signalingHandle)) {
-        freeSignalingClient(&pGstKvsPlugin->kvsContext.signalingHandle);
-    }
+    CHK(pGstKvsPlugin != NULL && pViewer != NULL, STATUS_NULL_ARG);
 
-    if (pGstKvsPlugin->pPendingSignalingMessageForRemoteClient != NULL) {
-        // Iterate and free all the pending queues
-        stackQueueGetIterator(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, &iterator);
-        while (IS_VALID_ITERATOR(iterator)) {
-            stackQueueIteratorGetItem(iterator, &data);
-            stackQueueIteratorNext(&iterator);
-            freeMessageQueue((PPendingMessageQueue) data);
-        }
+    pViewer->pGstKvsPlugin = pGstKvsPlugin;
+    SNPRINTF(pViewer->peerId, SIZEOF(pViewer->peerId), GST_PLUGIN_LOOPBACK_VIEWER_ID_FORMAT, index);
 
-        stackQueueClear(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, FALSE);
-        stackQueueFree(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient);
-        pGstKvsPlugin->pPendingSignalingMessageForRemoteClient = NULL;
-    }
+    // No ICE servers so only the host candidates are gathered
+    MEMSET(&configuration, 0x00, SIZEOF(RtcConfiguration));
+    configuration.iceTransportPolicy = ICE_TRANSPORT_POLICY_ALL;
+    CHK_STATUS(createPeerConnection(&configuration, &pViewer->pPeerConnection));
+    CHK_STATUS(peerConnectionOnIceCandidate(pViewer->pPeerConnection, (UINT64) pViewer, onLoopbackViewerIceCandidate));
 
-    if (pGstKvsPlugin->pRtcPeerConnectionForRemoteClient != NULL) {
-        hashTableClear(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient);
-        hashTableFree(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient);
-        pGstKvsPlugin->pRtcPeerConnectionForRemoteClient = NULL;
+    MEMSET(&videoTrack, 0x00, SIZEOF(RtcMediaStreamTrack));
+    MEMSET(&audioTrack, 0x00, SIZEOF(RtcMediaStreamTrack));
+    videoTrack.kind = MEDIA_STREAM_TRACK_KIND_VIDEO;
+    videoTrack.codec = RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_MODE;
+    STRCPY(videoTrack.streamId, "myKvsLoopbackStream");
+    STRCPY(videoTrack.trackId, "myVideoTrack");
+    audioTrack.kind = MEDIA_STREAM_TRACK_KIND_AUDIO;
+    audioTrack.codec = RTC_CODEC_OPUS;
+    if (STRNCMP(pGstKvsPlugin->gstParams.audioContentType, AUDIO_MULAW_CONTENT_TYPE, MAX_GSTREAMER_MEDIA_TYPE_LEN) == 0) {
+        audioTrack.codec = RTC_CODEC_MULAW;
+    } else if (STRNCMP(pGstKvsPlugin->gstParams.audioContentType, AUDIO_ALAW_CONTENT_TYPE, MAX_GSTREAMER_MEDIA_TYPE_LEN) == 0) {
+        audioTrack.codec = RTC_CODEC_ALAW;
+    }
+    STRCPY(audioTrack.streamId, "myKvsLoopbackStream");
+    STRCPY(audioTrack.trackId, "myAudioTrack");
+
+    CHK_STATUS(addSupportedCodec(pViewer->pPeerConnection, videoTrack.codec));
+    CHK_STATUS(addSupportedCodec(pViewer->pPeerConnection, audioTrack.codec));
+
+    MEMSET(&transceiverInit, 0x00, SIZEOF(RtcRtpTransceiverInit));
+    transceiverInit.direction = RTC_RTP_TRANSCEIVER_DIRECTION_RECVONLY;
+    CHK_STATUS(addTransceiver(pViewer->pPeerConnection, &videoTrack, &transceiverInit, &pViewer->pVideoRtcRtpTransceiver));
+    CHK_STATUS(transceiverOnFrame(pViewer->pVideoRtcRtpTransceiver, (UINT64) pViewer, onLoopbackViewerFrame));
+    CHK_STATUS(addTransceiver(pViewer->pPeerConnection, &audioTrack, &transceiverInit, &pViewer->pAudioRtcRtpTransceiver));
+    CHK_STATUS(transceiverOnFrame(pViewer->pAudioRtcRtpTransceiver, (UINT64) pViewer, onLoopbackViewerFrame));
+
+    // Same as the trickle ICE viewer of the SDK samples. The candidates follow the offer as they are gathered.
+    MEMSET(&offerSessionDescriptionInit, 0x00, SIZEOF(RtcSessionDescriptionInit));
+    CHK_STATUS(setLocalDescription(pViewer->pPeerConnection, &offerSessionDescriptionInit));
+    CHK_STATUS(createOffer(pViewer->pPeerConnection, &offerSessionDescriptionInit));
+
+    CHK(NULL != (pOffer = (PCHAR) MEMALLOC(offerLen)), STATUS_NOT_ENOUGH_MEMORY);
+    CHK_STATUS(serializeSessionDescriptionInit(&offerSessionDescriptionInit, pOffer, &offerLen));
+
+    pGstKvsPlugin->loopbackViewerCount++;
+    CHK_STATUS(sendLoopbackViewerMessage(pViewer, SIGNALING_MESSAGE_TYPE_OFFER, pOffer, (UINT32) STRLEN(pOffer)));
+
+CleanUp:
+
+    SAFE_MEMFREE(pOffer);
+
+    return retStatus;
+}
+
+VOID freeWebRtcLoopbackViewers(PGstKvsPlugin pGstKvsPlugin)
+{
+    UINT32 i;
+
+    if (pGstKvsPlugin == NULL || pGstKvsPlugin->pLoopbackViewers == NULL) {
+        return;
+    }
+
+    // The viewers go first so no more of their candidates are delivered to the sessions being freed
+    for (i = 0; i < pGstKvsPlugin->gstParams.webRtcLoopbackViewers; i++) {
+        if (pGstKvsPlugin->pLoopbackViewers[i].pPeerConnection != NULL) {
+            CHK_LOG_ERR(closePeerConnection(pGstKvsPlugin->pLoopbackViewers[i].pPeerConnection));
+            CHK_LOG_ERR(freePeerConnection(&pGstKvsPlugin->pLoopbackViewers[i].pPeerConnection));
+        }
+    }
+
+    pGstKvsPlugin->loopbackViewerCount = 0;
+    SAFE_MEMFREE(pGstKvsPlugin->pLoopbackViewers);
+}
+
+VOID onLoopbackViewerIceCandidate(UINT64 customData, PCHAR candidateJson)
+{
+    PWebRtcLoopbackViewer pViewer = (PWebRtcLoopbackViewer) customData;
+
+    // The end of the gathering needs no message with the trickle ICE
+    if (pViewer != NULL && candidateJson != NULL) {
+        CHK_LOG_ERR(sendLoopbackViewerMessage(pViewer, SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE, candidateJson, (UINT32) STRLEN(candidateJson)));
+    }
+}
+
+VOID onLoopbackViewerFrame(UINT64 customData, PFrame pFrame)
+{
+    PWebRtcLoopbackViewer pViewer = (PWebRtcLoopbackViewer) customData;
+
+    if (pViewer != NULL && pFrame != NULL) {
+        ATOMIC_INCREMENT(&pViewer->receivedFrameCount);
+        ATOMIC_ADD(&pViewer->receivedByteCount, pFrame->size);
+    }
+}
+
+STATUS sendLoopbackViewerMessage(PWebRtcLoopbackViewer pViewer, SIGNALING_MESSAGE_TYPE messageType, PCHAR pPayload, UINT32 payloadLen)
+{
+    if (pViewer == NULL) {
+        return STATUS_NULL_ARG;
+    }
+
+    return sendLoopbackSignalingMessage(pViewer->pGstKvsPlugin, pViewer->peerId, messageType, pPayload, payloadLen);
+}
+
+STATUS sendLoopbackSignalingMessage(PGstKvsPlugin pGstKvsPlugin, PCHAR peerId, SIGNALING_MESSAGE_TYPE messageType, PCHAR pPayload,
+                                    UINT32 payloadLen)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PReceivedSignalingMessage pReceivedSignalingMessage = NULL;
+
+    CHK(pGstKvsPlugin != NULL && peerId != NULL && pPayload != NULL, STATUS_NULL_ARG);
+    CHK(payloadLen <= MAX_SIGNALING_MESSAGE_LEN, STATUS_INVALID_ARG_LEN);
+
+    CHK(NULL != (pReceivedSignalingMessage = (PReceivedSignalingMessage) MEMCALLOC(1, SIZEOF(ReceivedSignalingMessage))),
+        STATUS_NOT_ENOUGH_MEMORY);
+    pReceivedSignalingMessage->signalingMessage.version = SIGNALING_MESSAGE_CURRENT_VERSION;
+    pReceivedSignalingMessage->signalingMessage.messageType = messageType;
+    STRNCPY(pReceivedSignalingMessage->signalingMessage.peerClientId, peerId, MAX_SIGNALING_CLIENT_ID_LEN);
+    MEMCPY(pReceivedSignalingMessage->signalingMessage.payload, pPayload, payloadLen);
+    pReceivedSignalingMessage->signalingMessage.payloadLen = payloadLen;
+
+    // Handed to the workers as if it came from the signaling channel
+    CHK_STATUS(signalingClientMessageReceivedFn((UINT64) pGstKvsPlugin, pReceivedSignalingMessage));
+
+CleanUp:
+
+    SAFE_MEMFREE(pReceivedSignalingMessage);
+
+    return retStatus;
+}
+
+STATUS sendLoopbackEarlyCandidates(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    CHAR peerId[MAX_SIGNALING_CLIENT_ID_LEN + 1];
+    CHAR payload[GST_PLUGIN_LOOPBACK_FLOOD_CANDIDATE_LEN];
+    UINT32 i, peerIndex, payloadLen;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    // Distinct documentation addresses so none of the candidates of a peer are the same. The peers
+    // never send an offer so their candidates stay in the store until they expire.
+    for (i = 0; i < pGstKvsPlugin->gstParams.webRtcLoopbackEarlyCandidates; i++) {
+        peerIndex = i / GST_PLUGIN_LOOPBACK_FLOOD_PEER_CANDIDATES;
+        SNPRINTF(peerId, SIZEOF(peerId), GST_PLUGIN_LOOPBACK_FLOOD_ID_FORMAT, peerIndex);
+        payloadLen = (UINT32) SNPRINTF(payload, SIZEOF(payload), GST_PLUGIN_LOOPBACK_FLOOD_CANDIDATE_FORMAT, i, peerIndex % 254 + 1,
+                                       1024 + i % GST_PLUGIN_LOOPBACK_FLOOD_PEER_CANDIDATES);
+        CHK_STATUS(sendLoopbackSignalingMessage(pGstKvsPlugin, peerId, SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE, payload, payloadLen));
+    }
+
+    DLOGI("Sent %u early ICE candidates from %u loopback peers", pGstKvsPlugin->gstParams.webRtcLoopbackEarlyCandidates,
+          (pGstKvsPlugin->gstParams.webRtcLoopbackEarlyCandidates + GST_PLUGIN_LOOPBACK_FLOOD_PEER_CANDIDATES - 1) /
+              GST_PLUGIN_LOOPBACK_FLOOD_PEER_CANDIDATES);
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
+STATUS deliverLoopbackSignalingMessage(PGstKvsPlugin pGstKvsPlugin, PSignalingMessage pMessage)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcLoopbackViewer pViewer = NULL;
+    RtcSessionDescriptionInit answerSessionDescriptionInit;
+    RtcIceCandidateInit iceCandidate;
+    UINT32 i;
+
+    CHK(pGstKvsPlugin != NULL && pMessage != NULL, STATUS_NULL_ARG);
+
+    for (i = 0; pViewer == NULL && i < pGstKvsPlugin->loopbackViewerCount; i++) {
+        if (0 == STRCMP(pGstKvsPlugin->pLoopbackViewers[i].peerId, pMessage->peerClientId)) {
+            pViewer = &pGstKvsPlugin->pLoopbackViewers[i];
+        }
+    }
+
+    CHK(pViewer != NULL, STATUS_NOT_FOUND);
+
+    switch (pMessage->messageType) {
+        case SIGNALING_MESSAGE_TYPE_ANSWER:
+            MEMSET(&answerSessionDescriptionInit, 0x00, SIZEOF(RtcSessionDescriptionInit));
+            CHK_STATUS(deserializeSessionDescriptionInit(pMessage->payload, pMessage->payloadLen, &answerSessionDescriptionInit));
+            CHK_STATUS(setRemoteDescription(pViewer->pPeerConnection, &answerSessionDescriptionInit));
+            break;
+
+        case SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE:
+            CHK_STATUS(deserializeRtcIceCandidateInit(pMessage->payload, pMessage->payloadLen, &iceCandidate));
+            CHK_STATUS(addIceCandidate(pViewer->pPeerConnection, iceCandidate.candidate));
+            break;
+
+        default:
+            DLOGD("Unhandled loopback signaling message type %u", pMessage->messageType);
+            break;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS createMessageQueue(UINT64 hashValue, PPendingMessageQueue* ppPendingMessageQueue)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PPendingMessageQueue pPendingMessageQueue = NULL;
+
+    CHK(ppPendingMessageQueue != NULL, STATUS_NULL_ARG);
+
+    CHK(NULL != (pPendingMessageQueue = (PPendingMessageQueue) MEMCALLOC(1, SIZEOF(PendingMessageQueue))), STATUS_NOT_ENOUGH_MEMORY);
+    pPendingMessageQueue->hashValue = hashValue;
+    pPendingMessageQueue->createTime = GETTIME();
+    CHK_STATUS(stackQueueCreate(&pPendingMessageQueue->messageQueue));
+
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pPendingMessageQueue != NULL) {
+        freeMessageQueue(pPendingMessageQueue);
+        pPendingMessageQueue = NULL;
+    }
+
+    if (ppPendingMessageQueue != NULL) {
+        *ppPendingMessageQueue = pPendingMessageQueue;
+    }
+
+    return retStatus;
+}
+
+STATUS freeMessageQueue(PPendingMessageQueue pPendingMessageQueue)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+
+    // free is idempotent
+    CHK(pPendingMessageQueue != NULL, retStatus);
+
+    if (pPendingMessageQueue->messageQueue != NULL) {
+        stackQueueClear(pPendingMessageQueue->messageQueue, TRUE);
+        stackQueueFree(pPendingMessageQueue->messageQueue);
+    }
+
+    MEMFREE(pPendingMessageQueue);
+
+CleanUp:
+    return retStatus;
+}
+
+VOID cancelGstKvsPluginTimers(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS cancelStatus;
+    BOOL locked = FALSE;
+
+    // The timer queue is shared by all of the elements of the client and outlives this one. Its callbacks
+    // are run with the element as the custom data, so they have to be gone before any of its state is freed.
+    if (pGstKvsPlugin == NULL || !IS_VALID_TIMER_QUEUE_HANDLE(pGstKvsPlugin->kvsContext.timerQueueHandle)) {
+        return;
+    }
+
+    // The offers add the metrics timer under the session lock
+    if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->sessionLock)) {
+        MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+        locked = TRUE;
+    }
+
+    pGstKvsPlugin->timersCancelled = TRUE;
+
+    if (pGstKvsPlugin->iceCandidatePairStatsTimerId != MAX_UINT32) {
+        cancelStatus = timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->iceCandidatePairStatsTimerId,
+                                          (UINT64) pGstKvsPlugin);
+        if (STATUS_FAILED(cancelStatus)) {
+            DLOGE("Failed to cancel stats timer with: 0x%08x", cancelStatus);
+        }
+        pGstKvsPlugin->iceCandidatePairStatsTimerId = MAX_UINT32;
+    }
+
+    if (pGstKvsPlugin->pregenerateCertTimerId != MAX_UINT32) {
+        cancelStatus =
+            timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->pregenerateCertTimerId, (UINT64) pGstKvsPlugin);
+        if (STATUS_FAILED(cancelStatus)) {
+            DLOGE("Failed to cancel certificate pre-generation timer with: 0x%08x", cancelStatus);
+        }
+        pGstKvsPlugin->pregenerateCertTimerId = MAX_UINT32;
+    }
+
+    if (pGstKvsPlugin->iceConfigRefreshTimerId != MAX_UINT32) {
+        cancelStatus =
+            timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->iceConfigRefreshTimerId, (UINT64) pGstKvsPlugin);
+        if (STATUS_FAILED(cancelStatus)) {
+            DLOGE("Failed to cancel ICE server configuration refresh timer with: 0x%08x", cancelStatus);
+        }
+        pGstKvsPlugin->iceConfigRefreshTimerId = MAX_UINT32;
+    }
+
+    if (pGstKvsPlugin->serviceRoutineTimerId != MAX_UINT32) {
+        cancelStatus =
+            timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->serviceRoutineTimerId, (UINT64) pGstKvsPlugin);
+        if (STATUS_FAILED(cancelStatus)) {
+            DLOGE("Failed to cancel service handler routine timer with: 0x%08x", cancelStatus);
+        }
+        pGstKvsPlugin->serviceRoutineTimerId = MAX_UINT32;
+    }
+
+    if (pGstKvsPlugin->statsTimerId != MAX_UINT32) {
+        cancelStatus = timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->statsTimerId, (UINT64) pGstKvsPlugin);
+        if (STATUS_FAILED(cancelStatus)) {
+            DLOGE("Failed to cancel stats message timer with: 0x%08x", cancelStatus);
+        }
+        pGstKvsPlugin->statsTimerId = MAX_UINT32;
+    }
+
+    if (locked) {
+        MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+    }
+
+    // Nothing signals the worker from here on. The session work in progress is done outside of the session lock.
+    CHK_LOG_ERR(stopSessionWorker(pGstKvsPlugin));
+}
+
+STATUS freeGstKvsWebRtcPlugin(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    UINT32 i;
+    UINT64 data;
+    StackQueueIterator iterator;
+    BOOL locked = FALSE;
+    PWebRtcSessionList pSessionList = NULL;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    freeWebRtcLoopbackViewers(pGstKvsPlugin);
+
+    // Normally stopped along with the timers already
+    CHK_LOG_ERR(stopSessionWorker(pGstKvsPlugin));
+
+    if (IS_VALID_SIGNALING_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.signalingHandle)) {
+        freeSignalingClient(&pGstKvsPlugin->kvsContext.signalingHandle);
+    }
+
+    // No more messages are delivered once the signaling client is gone
+    CHK_LOG_ERR(stopSignalingWorkers(pGstKvsPlugin));
+
+    CHK_LOG_ERR(freePendingMessageQueues(pGstKvsPlugin));
+
+    if (pGstKvsPlugin->pRtcPeerConnectionForRemoteClient != NULL) {
+        hashTableClear(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient);
+        hashTableFree(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient);
+        pGstKvsPlugin->pRtcPeerConnectionForRemoteClient = NULL;
     }
 
     if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->sessionLock)) {
         MUTEX_LOCK(pGstKvsPlugin->sessionLock);
         locked = TRUE;
     }
-    for (i = 0; i < pGstKvsPlugin->streamingSessionCount; ++i) {
-        retStatus = gatherIceServerStats(pGstKvsPlugin->streamingSessionList[i]);
+    CHK_LOG_ERR(swapStreamingSessionList(pGstKvsPlugin, NULL, &pSessionList));
+    for (i = 0; pSessionList != NULL && i < pSessionList->count; ++i) {
+        retStatus = gatherIceServerStats(pSessionList->sessions[i]);
         if (STATUS_FAILED(retStatus)) {
             DLOGW("Failed to ICE Server Stats for streaming session %d: %08x", i, retStatus);
         }
 
-        freeWebRtcStreamingSession(&pGstKvsPlugin->streamingSessionList[i]);
+        freeWebRtcStreamingSession(&pSessionList->sessions[i]);
     }
+    SAFE_MEMFREE(pSessionList);
+    CHK_LOG_ERR(freePreparedStreamingSessions(pGstKvsPlugin));
     if (locked) {
         MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
     }
 
+    // Release the cached buffers
+    clearGopCache(pGstKvsPlugin);
+
     deinitKvsWebRtc();
 
     if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->sessionLock)) {
@@ -402,47 +1170,12 @@ STATUS freeGstKvsWebRtcPlugin(PGstKvsPlugin pGstKvsPlugin)
         pGstKvsPlugin->sessionLock = INVALID_MUTEX_VALUE;
     }
 
-    if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->sessionListReadLock)) {
-        MUTEX_FREE(pGstKvsPlugin->sessionListReadLock);
-        pGstKvsPlugin->sessionListReadLock = INVALID_MUTEX_VALUE;
-    }
-
     if (IS_VALID_MUTEX_VALUE(pGstKvsPlugin->signalingLock)) {
         MUTEX_FREE(pGstKvsPlugin->signalingLock);
         pGstKvsPlugin->signalingLock = INVALID_MUTEX_VALUE;
     }
 
-    if (IS_VALID_TIMER_QUEUE_HANDLE(pGstKvsPlugin->kvsContext.timerQueueHandle)) {
-        if (pGstKvsPlugin->iceCandidatePairStatsTimerId != MAX_UINT32) {
-            retStatus = timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->iceCandidatePairStatsTimerId,
-                                              (UINT64) pGstKvsPlugin);
-            if (STATUS_FAILED(retStatus)) {
-                DLOGE("Failed to cancel stats timer with: 0x%08x", retStatus);
-            }
-            pGstKvsPlugin->iceCandidatePairStatsTimerId = MAX_UINT32;
-        }
-
-        if (pGstKvsPlugin->pregenerateCertTimerId != MAX_UINT32) {
-            retStatus =
-                timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->pregenerateCertTimerId, (UINT64) pGstKvsPlugin);
-            if (STATUS_FAILED(retStatus)) {
-                DLOGE("Failed to cancel certificate pre-generation timer with: 0x%08x", retStatus);
-            }
-            pGstKvsPlugin->pregenerateCertTimerId = MAX_UINT32;
-        }
-
-        if (pGstKvsPlugin->serviceRoutineTimerId != MAX_UINT32) {
-            retStatus =
-                timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->serviceRoutineTimerId, (UINT64) pGstKvsPlugin);
-            if (STATUS_FAILED(retStatus)) {
-                DLOGE("Failed to cancel service handler routine timer with: 0x%08x", retStatus);
-            }
-            pGstKvsPlugin->serviceRoutineTimerId = MAX_UINT32;
-        }
-
-        timerQueueFree(&pGstKvsPlugin->kvsContext.timerQueueHandle);
-        pGstKvsPlugin->kvsContext.timerQueueHandle = INVALID_TIMER_QUEUE_HANDLE_VALUE;
-    }
+    SAFE_MEMFREE(pGstKvsPlugin->pIceServers);
 
     if (pGstKvsPlugin->pregeneratedCertificates != NULL) {
         stackQueueGetIterator(pGstKvsPlugin->pregeneratedCertificates, &iterator);
@@ -492,6 +1225,8 @@ STATUS freeWebRtcStreamingSession(PWebRtcStreamingSession* ppStreamingSession)
     STATUS retStatus = STATUS_SUCCESS;
     PWebRtcStreamingSession pStreamingSession = NULL;
     PGstKvsPlugin pGstKvsPlugin;
+    PWebRtcSessionList pSessionList;
+    UINT64 data;
 
     CHK(ppStreamingSession != NULL, STATUS_NULL_ARG);
     pStreamingSession = *ppStreamingSession;
@@ -510,18 +1245,67 @@ STATUS freeWebRtcStreamingSession(PWebRtcStreamingSession* ppStreamingSession)
         THREAD_JOIN(pStreamingSession->receiveAudioVideoSenderTid, NULL);
     }
 
+    // Wake up and join the frame sender before the transceivers go away
+    if (IS_VALID_TID_VALUE(pStreamingSession->frameSenderTid)) {
+        MUTEX_LOCK(pStreamingSession->frameSenderLock);
+        CVAR_SIGNAL(pStreamingSession->frameSenderCvar);
+        MUTEX_UNLOCK(pStreamingSession->frameSenderLock);
+        THREAD_JOIN(pStreamingSession->frameSenderTid, NULL);
+    }
+
+    if (IS_VALID_TID_VALUE(pStreamingSession->candidateSenderTid)) {
+        MUTEX_LOCK(pStreamingSession->candidateSenderLock);
+        CVAR_SIGNAL(pStreamingSession->candidateSenderCvar);
+        MUTEX_UNLOCK(pStreamingSession->candidateSenderLock);
+        THREAD_JOIN(pStreamingSession->candidateSenderTid, NULL);
+    }
+
+    // Shut the ICE agent down before the candidate queue its handler enqueues to goes away
+    CHK_LOG_ERR(closePeerConnection(pStreamingSession->pPeerConnection));
+
+    // Drop the candidates which have not been sent
+    if (pStreamingSession->pLocalCandidates != NULL) {
+        stackQueueClear(pStreamingSession->pLocalCandidates, TRUE);
+        stackQueueFree(pStreamingSession->pLocalCandidates);
+    }
+
+    if (IS_VALID_CVAR_VALUE(pStreamingSession->candidateSenderCvar)) {
+        CVAR_FREE(pStreamingSession->candidateSenderCvar);
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pStreamingSession->candidateSenderLock)) {
+        MUTEX_FREE(pStreamingSession->candidateSenderLock);
+    }
+
+    // Release the frames which have not been sent
+    if (pStreamingSession->pFrameRing != NULL) {
+        while (spscRingTryDequeue(pStreamingSession->pFrameRing, &data)) {
+            sharedFrameRelease((PSharedFrame) data);
+        }
+
+        freeSpscRing(&pStreamingSession->pFrameRing);
+    }
+
+    if (IS_VALID_CVAR_VALUE(pStreamingSession->frameSenderCvar)) {
+        CVAR_FREE(pStreamingSession->frameSenderCvar);
+    }
+
+    if (IS_VALID_MUTEX_VALUE(pStreamingSession->frameSenderLock)) {
+        MUTEX_FREE(pStreamingSession->frameSenderLock);
+    }
+
     // De-initialize the session stats timer if there are no active sessions
     // NOTE: we need to perform this under the lock which might be acquired by
     // the running thread but it's OK as it's re-entrant
     MUTEX_LOCK(pGstKvsPlugin->sessionLock);
-    if (pGstKvsPlugin->iceCandidatePairStatsTimerId != MAX_UINT32 && pGstKvsPlugin->streamingSessionCount == 0) {
+    pSessionList = (PWebRtcSessionList) ATOMIC_LOAD(&pGstKvsPlugin->streamingSessionList);
+    if (pGstKvsPlugin->iceCandidatePairStatsTimerId != MAX_UINT32 && (pSessionList == NULL || pSessionList->count == 0)) {
         CHK_LOG_ERR(
             timerQueueCancelTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, pGstKvsPlugin->iceCandidatePairStatsTimerId, (UINT64) pGstKvsPlugin));
         pGstKvsPlugin->iceCandidatePairStatsTimerId = MAX_UINT32;
     }
     MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
 
-    CHK_LOG_ERR(closePeerConnection(pStreamingSession->pPeerConnection));
     CHK_LOG_ERR(freePeerConnection(&pStreamingSession->pPeerConnection));
 
     SAFE_MEMFREE(pStreamingSession);
@@ -594,73 +1378,202 @@ CleanUp:
     return retStatus;
 }
 
-STATUS getPendingMessageQueueForHash(PStackQueue pPendingQueue, UINT64 clientHash, BOOL remove, PPendingMessageQueue* ppPendingMessageQueue)
+STATUS getPendingMessageQueueForHash(PGstKvsPlugin pGstKvsPlugin, UINT64 clientHash, BOOL remove, PPendingMessageQueue* ppPendingMessageQueue)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PPendingMessageQueue pPendingMessageQueue = NULL;
-    StackQueueIterator iterator;
-    BOOL iterate = TRUE;
+    BOOL found = FALSE;
     UINT64 data;
 
-    CHK(pPendingQueue != NULL && ppPendingMessageQueue != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin != NULL && pGstKvsPlugin->pPendingSignalingMessageForRemoteClient != NULL && ppPendingMessageQueue != NULL,
+        STATUS_NULL_ARG);
+
+    CHK_STATUS(hashTableContains(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientHash, &found));
+    CHK(found, retStatus);
+    CHK_STATUS(hashTableGet(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientHash, &data));
+    pPendingMessageQueue = (PPendingMessageQueue) data;
 
-    CHK_STATUS(stackQueueGetIterator(pPendingQueue, &iterator));
-    while (iterate && IS_VALID_ITERATOR(iterator)) {
-        CHK_STATUS(stackQueueIteratorGetItem(iterator, &data));
-        CHK_STATUS(stackQueueIteratorNext(&iterator));
+    // Check if the item needs to be removed
+    if (remove) {
+        CHK_STATUS(hashTableRemove(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, clientHash));
+        unlinkPendingMessageQueue(pGstKvsPlugin, pPendingMessageQueue);
+    }
+
+CleanUp:
 
-        pPendingMessageQueue = (PPendingMessageQueue) data;
+    if (ppPendingMessageQueue != NULL) {
+        *ppPendingMessageQueue = pPendingMessageQueue;
+    }
 
-        if (clientHash == pPendingMessageQueue->hashValue) {
-            *ppPendingMessageQueue = pPendingMessageQueue;
-            iterate = FALSE;
+    return retStatus;
+}
 
-            // Check if the item needs to be removed
-            if (remove) {
-                // This is OK to do as we are terminating the iterator anyway
-                CHK_STATUS(stackQueueRemoveItem(pPendingQueue, data));
+STATUS addPendingMessageQueue(PGstKvsPlugin pGstKvsPlugin, PPendingMessageQueue pPendingMessageQueue)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PPendingMessageQueue* ppSlot;
+
+    CHK(pGstKvsPlugin != NULL && pGstKvsPlugin->pPendingSignalingMessageForRemoteClient != NULL && pPendingMessageQueue != NULL,
+        STATUS_NULL_ARG);
+
+    CHK_STATUS(hashTablePut(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, pPendingMessageQueue->hashValue, (UINT64) pPendingMessageQueue));
+
+    // Link into the expiry wheel slot of the creation tick
+    ppSlot = &pGstKvsPlugin->pendingMessageWheel[(pPendingMessageQueue->createTime / GST_PLUGIN_SERVICE_ROUTINE_PERIOD) %
+                                                 GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE];
+    pPendingMessageQueue->pPrev = NULL;
+    pPendingMessageQueue->pNext = *ppSlot;
+    if (*ppSlot != NULL) {
+        (*ppSlot)->pPrev = pPendingMessageQueue;
+    }
+
+    *ppSlot = pPendingMessageQueue;
+    ATOMIC_INCREMENT(&pGstKvsPlugin->pendingPeerCount);
+
+CleanUp:
+
+    return retStatus;
+}
+
+VOID unlinkPendingMessageQueue(PGstKvsPlugin pGstKvsPlugin, PPendingMessageQueue pPendingMessageQueue)
+{
+    PPendingMessageQueue* ppSlot =
+        &pGstKvsPlugin->pendingMessageWheel[(pPendingMessageQueue->createTime / GST_PLUGIN_SERVICE_ROUTINE_PERIOD) %
+                                            GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE];
+    UINT32 candidateCount = 0;
+
+    // The candidates leave the store with their queue whether they are submitted or expire
+    if (STATUS_SUCCEEDED(stackQueueGetCount(pPendingMessageQueue->messageQueue, &candidateCount))) {
+        ATOMIC_SUBTRACT(&pGstKvsPlugin->pendingCandidateCount, candidateCount);
+    }
+
+    ATOMIC_DECREMENT(&pGstKvsPlugin->pendingPeerCount);
+
+    if (pPendingMessageQueue->pPrev != NULL) {
+        pPendingMessageQueue->pPrev->pNext = pPendingMessageQueue->pNext;
+    } else {
+        *ppSlot = pPendingMessageQueue->pNext;
+    }
+
+    if (pPendingMessageQueue->pNext != NULL) {
+        pPendingMessageQueue->pNext->pPrev = pPendingMessageQueue->pPrev;
+    }
+
+    pPendingMessageQueue->pPrev = NULL;
+    pPendingMessageQueue->pNext = NULL;
+}
+
+STATUS removeExpiredMessageQueues(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PPendingMessageQueue pPendingMessageQueue, pNext;
+    UINT64 tick, lastExpiredTick;
+
+    CHK(pGstKvsPlugin != NULL && pGstKvsPlugin->pPendingSignalingMessageForRemoteClient != NULL, STATUS_NULL_ARG);
+
+    // Everything created up to and including this tick is past the cleanup duration
+    tick = GETTIME() / GST_PLUGIN_SERVICE_ROUTINE_PERIOD;
+    CHK(tick > GST_PLUGIN_PENDING_MESSAGE_CLEANUP_DURATION / GST_PLUGIN_SERVICE_ROUTINE_PERIOD, retStatus);
+    lastExpiredTick = tick - GST_PLUGIN_PENDING_MESSAGE_CLEANUP_DURATION / GST_PLUGIN_SERVICE_ROUTINE_PERIOD - 1;
+
+    // Only the slots the wheel has moved past since the last run need to be visited. Catching up
+    // after a long pause takes at most one full turn.
+    tick = MAX(pGstKvsPlugin->pendingMessageWheelTick, lastExpiredTick + 1 - MIN(lastExpiredTick + 1, GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE));
+    for (; tick <= lastExpiredTick; tick++) {
+        pPendingMessageQueue = pGstKvsPlugin->pendingMessageWheel[tick % GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE];
+        while (pPendingMessageQueue != NULL) {
+            pNext = pPendingMessageQueue->pNext;
+
+            // The slot might be shared with the entries of a later turn of the wheel
+            if (pPendingMessageQueue->createTime / GST_PLUGIN_SERVICE_ROUTINE_PERIOD <= lastExpiredTick) {
+                CHK_STATUS(hashTableRemove(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient, pPendingMessageQueue->hashValue));
+                unlinkPendingMessageQueue(pGstKvsPlugin, pPendingMessageQueue);
+                CHK_STATUS(freeMessageQueue(pPendingMessageQueue));
             }
+
+            pPendingMessageQueue = pNext;
         }
     }
 
+    pGstKvsPlugin->pendingMessageWheelTick = lastExpiredTick + 1;
+
 CleanUp:
 
     return retStatus;
 }
 
-STATUS removeExpiredMessageQueues(PStackQueue pPendingQueue)
+STATUS freePendingMessageQueues(PGstKvsPlugin pGstKvsPlugin)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    PPendingMessageQueue pPendingMessageQueue = NULL;
-    UINT32 i, count;
-    UINT64 data, curTime;
+    PPendingMessageQueue pPendingMessageQueue;
+    UINT32 i;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    // Every pending queue is linked into exactly one slot of the wheel
+    for (i = 0; i < GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE; i++) {
+        while (NULL != (pPendingMessageQueue = pGstKvsPlugin->pendingMessageWheel[i])) {
+            unlinkPendingMessageQueue(pGstKvsPlugin, pPendingMessageQueue);
+            freeMessageQueue(pPendingMessageQueue);
+        }
+    }
+
+    if (pGstKvsPlugin->pPendingSignalingMessageForRemoteClient != NULL) {
+        hashTableClear(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient);
+        hashTableFree(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient);
+        pGstKvsPlugin->pPendingSignalingMessageForRemoteClient = NULL;
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS createWebRtcStreamingSession(PGstKvsPlugin pGstKvsPlugin, PCHAR peerId, BOOL isMaster, PWebRtcStreamingSession* ppStreamingSession)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcStreamingSession pStreamingSession = NULL;
+
+    CHK(pGstKvsPlugin != NULL && ppStreamingSession != NULL, STATUS_NULL_ARG);
+    CHK((isMaster && peerId != NULL) || !isMaster, STATUS_INVALID_ARG);
+
+    // Offers are answered from the pool of the prepared sessions when possible
+    if (isMaster) {
+        CHK_STATUS(takePreparedStreamingSession(pGstKvsPlugin, &pStreamingSession));
+    }
+
+    if (pStreamingSession == NULL) {
+        CHK_STATUS(prepareWebRtcStreamingSession(pGstKvsPlugin, &pStreamingSession));
+    }
 
-    CHK(pPendingQueue != NULL, STATUS_NULL_ARG);
+    if (isMaster) {
+        STRCPY(pStreamingSession->peerId, peerId);
+    } else {
+        STRCPY(pStreamingSession->peerId, DEFAULT_VIEWER_CLIENT_ID);
+    }
 
-    curTime = GETTIME();
-    CHK_STATUS(stackQueueGetCount(pPendingQueue, &count));
+    pStreamingSession->rtcMetricsHistory.prevTs = GETTIME();
+    // if we're the viewer, we control the trickle ice mode
+    pStreamingSession->remoteCanTrickleIce = !isMaster && pGstKvsPlugin->gstParams.trickleIce;
 
-    // Dequeue and enqueue in order to not break the iterator while removing an item
-    for (i = 0; i < count; i++) {
-        CHK_STATUS(stackQueueDequeue(pPendingQueue, &data));
+    // The ICE candidates can be sent out once the peer is known
+    ATOMIC_STORE_BOOL(&pStreamingSession->peerIdReceived, TRUE);
 
-        // Check for expiry
-        pPendingMessageQueue = (PPendingMessageQueue) data;
-        if (pPendingMessageQueue->createTime + GST_PLUGIN_PENDING_MESSAGE_CLEANUP_DURATION < curTime) {
-            // Message queue has expired and needs to be freed
-            CHK_STATUS(freeMessageQueue(pPendingMessageQueue));
-        } else {
-            // Enqueue back again as it's still valued
-            CHK_STATUS(stackQueueEnqueue(pPendingQueue, data));
-        }
+CleanUp:
+
+    if (STATUS_FAILED(retStatus) && pStreamingSession != NULL) {
+        freeWebRtcStreamingSession(&pStreamingSession);
+        pStreamingSession = NULL;
     }
 
-CleanUp:
+    if (ppStreamingSession != NULL) {
+        *ppStreamingSession = pStreamingSession;
+    }
 
     return retStatus;
 }
 
-STATUS createWebRtcStreamingSession(PGstKvsPlugin pGstKvsPlugin, PCHAR peerId, BOOL isMaster, PWebRtcStreamingSession* ppStreamingSession)
+STATUS prepareWebRtcStreamingSession(PGstKvsPlugin pGstKvsPlugin, PWebRtcStreamingSession* ppStreamingSession)
 {
     STATUS retStatus = STATUS_SUCCESS;
     RtcMediaStreamTrack videoTrack, audioTrack;
@@ -670,27 +1583,40 @@ STATUS createWebRtcStreamingSession(PGstKvsPlugin pGstKvsPlugin, PCHAR peerId, B
     MEMSET(&audioTrack, 0x00, SIZEOF(RtcMediaStreamTrack));
 
     CHK(pGstKvsPlugin != NULL && ppStreamingSession != NULL, STATUS_NULL_ARG);
-    CHK((isMaster && peerId != NULL) || !isMaster, STATUS_INVALID_ARG);
 
     pStreamingSession = (PWebRtcStreamingSession) MEMCALLOC(1, SIZEOF(WebRtcStreamingSession));
     CHK(pStreamingSession != NULL, STATUS_NOT_ENOUGH_MEMORY);
 
-    if (isMaster) {
-        STRCPY(pStreamingSession->peerId, peerId);
-    } else {
-        STRCPY(pStreamingSession->peerId, DEFAULT_VIEWER_CLIENT_ID);
-    }
-    ATOMIC_STORE_BOOL(&pStreamingSession->peerIdReceived, TRUE);
-
     pStreamingSession->pGstKvsPlugin = pGstKvsPlugin;
-    pStreamingSession->rtcMetricsHistory.prevTs = GETTIME();
-    // if we're the viewer, we control the trickle ice mode
-    pStreamingSession->remoteCanTrickleIce = !isMaster && pGstKvsPlugin->gstParams.trickleIce;
+    pStreamingSession->prepareTime = GETTIME();
+    ATOMIC_STORE_BOOL(&pStreamingSession->peerIdReceived, FALSE);
 
     ATOMIC_STORE_BOOL(&pStreamingSession->terminateFlag, FALSE);
     ATOMIC_STORE_BOOL(&pStreamingSession->candidateGatheringDone, FALSE);
     ATOMIC_STORE_BOOL(&pStreamingSession->connected, FALSE);
 
+    // Viewers should start decoding from a key frame
+    ATOMIC_STORE_BOOL(&pStreamingSession->awaitingKeyFrame, TRUE);
+    ATOMIC_STORE(&pStreamingSession->droppedFrameCount, 0);
+    ATOMIC_STORE(&pStreamingSession->bandwidthEstimate, 0);
+    ATOMIC_STORE(&pStreamingSession->sendBudgetRate, 0);
+    ATOMIC_STORE(&pStreamingSession->sendBudgetScale, 100);
+    ATOMIC_STORE(&pStreamingSession->thinnedFrameCount, 0);
+    ATOMIC_STORE(&pStreamingSession->outgoingBitrate, 0);
+    ATOMIC_STORE(&pStreamingSession->incomingBitrate, 0);
+    ATOMIC_STORE(&pStreamingSession->roundTripTime, 0);
+    ATOMIC_STORE(&pStreamingSession->packetsDiscardedOnSend, 0);
+    pStreamingSession->frameSenderLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pStreamingSession->frameSenderLock), STATUS_INVALID_OPERATION);
+    pStreamingSession->frameSenderCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pStreamingSession->frameSenderCvar), STATUS_INVALID_OPERATION);
+    CHK_STATUS(createSpscRing(GST_PLUGIN_SESSION_FRAME_QUEUE_SIZE, &pStreamingSession->pFrameRing));
+    pStreamingSession->candidateSenderLock = MUTEX_CREATE(FALSE);
+    CHK(IS_VALID_MUTEX_VALUE(pStreamingSession->candidateSenderLock), STATUS_INVALID_OPERATION);
+    pStreamingSession->candidateSenderCvar = CVAR_CREATE();
+    CHK(IS_VALID_CVAR_VALUE(pStreamingSession->candidateSenderCvar), STATUS_INVALID_OPERATION);
+    CHK_STATUS(stackQueueCreate(&pStreamingSession->pLocalCandidates));
+
     CHK_STATUS(initializePeerConnection(pGstKvsPlugin, &pStreamingSession->pPeerConnection));
     CHK_STATUS(peerConnectionOnIceCandidate(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession, onIceCandidateHandler));
     CHK_STATUS(peerConnectionOnConnectionStateChange(pStreamingSession->pPeerConnection, (UINT64) pStreamingSession, onConnectionStateChange));
@@ -712,8 +1638,11 @@ STATUS createWebRtcStreamingSession(PGstKvsPlugin pGstKvsPlugin, PCHAR peerId, B
     STRCPY(videoTrack.trackId, "myVideoTrack");
     CHK_STATUS(addTransceiver(pStreamingSession->pPeerConnection, &videoTrack, NULL, &pStreamingSession->pVideoRtcRtpTransceiver));
 
+    // The estimate sets the send budget of the video. The audio transceiver reports its own estimate
+    // which would overwrite the one of the video, so it isn't hooked up.
     CHK_STATUS(
         transceiverOnBandwidthEstimation(pStreamingSession->pVideoRtcRtpTransceiver, (UINT64) pStreamingSession, sampleBandwidthEstimationHandler));
+    CHK_STATUS(transceiverOnPictureLoss(pStreamingSession->pVideoRtcRtpTransceiver, (UINT64) pStreamingSession, onPictureLossHandler));
 
     // Set up audio transceiver codec id according to type of encoding used
     if (STRNCMP(pGstKvsPlugin->gstParams.audioContentType, AUDIO_MULAW_CONTENT_TYPE, MAX_GSTREAMER_MEDIA_TYPE_LEN) == 0) {
@@ -732,11 +1661,13 @@ STATUS createWebRtcStreamingSession(PGstKvsPlugin pGstKvsPlugin, PCHAR peerId, B
     STRCPY(audioTrack.trackId, "myAudioTrack");
     CHK_STATUS(addTransceiver(pStreamingSession->pPeerConnection, &audioTrack, NULL, &pStreamingSession->pAudioRtcRtpTransceiver));
 
-    CHK_STATUS(
-        transceiverOnBandwidthEstimation(pStreamingSession->pAudioRtcRtpTransceiver, (UINT64) pStreamingSession, sampleBandwidthEstimationHandler));
     pStreamingSession->firstFrame = TRUE;
     pStreamingSession->startUpLatency = 0;
 
+    // Each session writes out its frames on its own thread so a slow peer doesn't stall the others
+    CHK_STATUS(THREAD_CREATE(&pStreamingSession->frameSenderTid, sendFramesToWebRtcPeer, (PVOID) pStreamingSession));
+    CHK_STATUS(THREAD_CREATE(&pStreamingSession->candidateSenderTid, sendLocalCandidatesRoutine, (PVOID) pStreamingSession));
+
 CleanUp:
 
     if (STATUS_FAILED(retStatus) && pStreamingSession != NULL) {
@@ -751,14 +1682,218 @@ CleanUp:
     return retStatus;
 }
 
+STATUS takePreparedStreamingSession(PGstKvsPlugin pGstKvsPlugin, PWebRtcStreamingSession* ppStreamingSession)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcStreamingSession pStreamingSession = NULL;
+    UINT64 data, now = GETTIME();
+    BOOL locked = FALSE;
+
+    CHK(pGstKvsPlugin != NULL && ppStreamingSession != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pPreparedSessions != NULL, retStatus);
+
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    locked = TRUE;
+
+    // The oldest sessions are at the head. Skip over the ones which might carry stale TURN credentials.
+    while (pStreamingSession == NULL && STATUS_SUCCEEDED(stackQueueDequeue(pGstKvsPlugin->pPreparedSessions, &data))) {
+        pStreamingSession = (PWebRtcStreamingSession) data;
+        if (pStreamingSession->prepareTime + GST_PLUGIN_SESSION_POOL_MAX_AGE <= now) {
+            freeWebRtcStreamingSession(&pStreamingSession);
+            pStreamingSession = NULL;
+        }
+    }
+
+    if (pStreamingSession != NULL) {
+        pStreamingSession->pooled = TRUE;
+    }
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+    }
+
+    if (ppStreamingSession != NULL) {
+        *ppStreamingSession = pStreamingSession;
+    }
+
+    return retStatus;
+}
+
+STATUS refillStreamingSessionPool(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcStreamingSession pStreamingSession = NULL;
+    UINT64 data, now = GETTIME();
+    UINT32 count, poolSize;
+    BOOL locked = FALSE;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    poolSize = MIN(GST_PLUGIN_SESSION_POOL_SIZE, pGstKvsPlugin->gstParams.maxViewers);
+
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    locked = TRUE;
+
+    // The pool is gone once the plugin is shutting down
+    CHK(pGstKvsPlugin->pPreparedSessions != NULL, retStatus);
+
+    // Recycle the expired sessions so the pool always has fresh ICE server credentials
+    while (STATUS_SUCCEEDED(stackQueuePeek(pGstKvsPlugin->pPreparedSessions, &data)) &&
+           ((PWebRtcStreamingSession) data)->prepareTime + GST_PLUGIN_SESSION_POOL_MAX_AGE <= now) {
+        CHK_STATUS(stackQueueDequeue(pGstKvsPlugin->pPreparedSessions, &data));
+        pStreamingSession = (PWebRtcStreamingSession) data;
+        freeWebRtcStreamingSession(&pStreamingSession);
+    }
+
+    CHK_STATUS(stackQueueGetCount(pGstKvsPlugin->pPreparedSessions, &count));
+
+    MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+    locked = FALSE;
+
+    // Prepare at most one session per request so the worker gets back to the termination and the other requests
+    CHK(count < poolSize, retStatus);
+    CHK_STATUS(prepareWebRtcStreamingSession(pGstKvsPlugin, &pStreamingSession));
+
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    locked = TRUE;
+
+    CHK(pGstKvsPlugin->pPreparedSessions != NULL, retStatus);
+    CHK_STATUS(stackQueueEnqueue(pGstKvsPlugin->pPreparedSessions, (UINT64) pStreamingSession));
+    pStreamingSession = NULL;
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+    }
+
+    if (pStreamingSession != NULL) {
+        freeWebRtcStreamingSession(&pStreamingSession);
+    }
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
+STATUS freePreparedStreamingSessions(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcStreamingSession pStreamingSession;
+    UINT64 data;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->pPreparedSessions != NULL, retStatus);
+
+    while (STATUS_SUCCEEDED(stackQueueDequeue(pGstKvsPlugin->pPreparedSessions, &data))) {
+        pStreamingSession = (PWebRtcStreamingSession) data;
+        freeWebRtcStreamingSession(&pStreamingSession);
+    }
+
+    CHK_LOG_ERR(stackQueueFree(pGstKvsPlugin->pPreparedSessions));
+    pGstKvsPlugin->pPreparedSessions = NULL;
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS refreshIceServerConfig(PGstKvsPlugin pGstKvsPlugin)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PRtcIceServer pIceServers = NULL, pOldIceServers;
+    PIceConfigInfo pIceConfigInfo;
+    UINT32 i, j, iceConfigCount, uriCount = 0;
+    UINT64 ttl = MAX_UINT64, now = GETTIME();
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(IS_VALID_SIGNALING_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.signalingHandle), STATUS_INVALID_OPERATION);
+
+    // Index 0 of the peer connection configuration is reserved for the STUN server
+    CHK(NULL != (pIceServers = (PRtcIceServer) MEMCALLOC(MAX_ICE_SERVERS_COUNT - 1, SIZEOF(RtcIceServer))), STATUS_NOT_ENOUGH_MEMORY);
+
+    // The signaling client re-fetches the configuration itself when it's about to expire
+    CHK_STATUS(signalingClientGetIceConfigInfoCount(pGstKvsPlugin->kvsContext.signalingHandle, &iceConfigCount));
+
+    for (i = 0; i < iceConfigCount; i++) {
+        CHK_STATUS(signalingClientGetIceConfigInfo(pGstKvsPlugin->kvsContext.signalingHandle, i, &pIceConfigInfo));
+        ttl = MIN(ttl, pIceConfigInfo->ttl);
+        for (j = 0; j < pIceConfigInfo->uriCount && uriCount < MAX_ICE_SERVERS_COUNT - 1; j++) {
+            /*
+             * if the url is "turn:ip:port?transport=udp" then ICE will try TURN over UDP
+             * if the url is "turn:ip:port?transport=tcp" then ICE will try TURN over TCP/TLS
+             * if the url is "turns:ip:port?transport=udp", it's currently ignored because sdk dont do TURN over DTLS yet.
+             * if the url is "turns:ip:port?transport=tcp" then ICE will try TURN over TCP/TLS
+             * if the url is "turn:ip:port" then ICE will try both TURN over UPD and TCP/TLS
+             */
+            STRNCPY(pIceServers[uriCount].urls, pIceConfigInfo->uris[j], MAX_ICE_CONFIG_URI_LEN);
+            STRNCPY(pIceServers[uriCount].credential, pIceConfigInfo->password, MAX_ICE_CONFIG_CREDENTIAL_LEN);
+            STRNCPY(pIceServers[uriCount].username, pIceConfigInfo->userName, MAX_ICE_CONFIG_USER_NAME_LEN);
+
+            uriCount++;
+        }
+    }
+
+    CHK(uriCount != 0, STATUS_INVALID_OPERATION);
+
+    // The old configuration is freed on the way out
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    pOldIceServers = pGstKvsPlugin->pIceServers;
+    pGstKvsPlugin->pIceServers = pIceServers;
+    pIceServers = pOldIceServers;
+    pGstKvsPlugin->iceServerCount = uriCount;
+    pGstKvsPlugin->iceUriCount = uriCount + 1;
+    pGstKvsPlugin->iceConfigExpiration = now + ttl;
+    MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+
+    DLOGD("Cached %u TURN URIs from %u ICE server configurations expiring in %" PRIu64 " s", uriCount, iceConfigCount,
+          ttl / HUNDREDS_OF_NANOS_IN_A_SECOND);
+
+CleanUp:
+
+    SAFE_MEMFREE(pIceServers);
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
+STATUS iceConfigRefreshTimerCallback(UINT32 timerId, UINT64 currentTime, UINT64 customData)
+{
+    UNUSED_PARAM(timerId);
+    STATUS retStatus = STATUS_SUCCESS;
+    PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) customData;
+    BOOL refresh;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    CHK(pGstKvsPlugin->gstParams.connectionMode != WEBRTC_CONNECTION_MODE_P2P_ONLY && !ATOMIC_LOAD_BOOL(&pGstKvsPlugin->terminate), retStatus);
+
+    // Refresh ahead of the expiration so the sessions never wait on the signaling calls. The calls can take a while
+    // so they're left to the worker rather than holding up the other timers of the client.
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    refresh = pGstKvsPlugin->iceConfigExpiration <= currentTime + GST_PLUGIN_ICE_CONFIG_REFRESH_AHEAD;
+    MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+
+    if (refresh) {
+        requestSessionWork(pGstKvsPlugin, &pGstKvsPlugin->iceConfigRefreshRequested);
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return retStatus;
+}
+
 STATUS initializePeerConnection(PGstKvsPlugin pGstKvsPlugin, PRtcPeerConnection* ppRtcPeerConnection)
 {
     ENTERS();
     STATUS retStatus = STATUS_SUCCESS;
     RtcConfiguration configuration;
-    UINT32 i, j, iceConfigCount, uriCount = 0, maxTurnServer = 1;
-    PIceConfigInfo pIceConfigInfo;
     UINT64 data, curTime;
+    BOOL expired, hostOnly;
     PRtcCertificate pRtcCertificate = NULL;
 
     CHK(pGstKvsPlugin != NULL && ppRtcPeerConnection != NULL, STATUS_NULL_ARG);
@@ -772,43 +1907,34 @@ STATUS initializePeerConnection(PGstKvsPlugin pGstKvsPlugin, PRtcPeerConnection*
     configuration.iceTransportPolicy =
         pGstKvsPlugin->gstParams.connectionMode == WEBRTC_CONNECTION_MODE_TURN_ONLY ? ICE_TRANSPORT_POLICY_RELAY : ICE_TRANSPORT_POLICY_ALL;
 
+    // The loopback viewers are reached over the host candidates alone
+    hostOnly = pGstKvsPlugin->gstParams.webRtcLoopbackViewers != 0;
+
     // Set the  STUN server
-    SNPRINTF(configuration.iceServers[0].urls, MAX_ICE_CONFIG_URI_LEN, KINESIS_VIDEO_STUN_URL, pGstKvsPlugin->kvsContext.channelInfo.pRegion);
-
-    if (pGstKvsPlugin->gstParams.connectionMode != WEBRTC_CONNECTION_MODE_P2P_ONLY) {
-        // Set the URIs from the configuration
-        CHK_STATUS(signalingClientGetIceConfigInfoCount(pGstKvsPlugin->kvsContext.signalingHandle, &iceConfigCount));
-
-        /* signalingClientGetIceConfigInfoCount can return more than one turn server. Use only one to optimize
-         * candidate gathering latency. But user can also choose to use more than 1 turn server. */
-        for (uriCount = 0, i = 0; i < maxTurnServer; i++) {
-            CHK_STATUS(signalingClientGetIceConfigInfo(pGstKvsPlugin->kvsContext.signalingHandle, i, &pIceConfigInfo));
-            for (j = 0; j < pIceConfigInfo->uriCount; j++) {
-                CHECK(uriCount < MAX_ICE_SERVERS_COUNT);
-                /*
-                 * if configuration.iceServers[uriCount + 1].urls is "turn:ip:port?transport=udp" then ICE will try TURN over UDP
-                 * if configuration.iceServers[uriCount + 1].urls is "turn:ip:port?transport=tcp" then ICE will try TURN over TCP/TLS
-                 * if configuration.iceServers[uriCount + 1].urls is "turns:ip:port?transport=udp", it's currently ignored because sdk dont do TURN
-                 * over DTLS yet. if configuration.iceServers[uriCount + 1].urls is "turns:ip:port?transport=tcp" then ICE will try TURN over TCP/TLS
-                 * if configuration.iceServers[uriCount + 1].urls is "turn:ip:port" then ICE will try both TURN over UPD and TCP/TLS
-                 *
-                 * It's recommended to not pass too many TURN iceServers to configuration because it will slow down ice gathering in non-trickle mode.
-                 */
-
-                STRNCPY(configuration.iceServers[uriCount + 1].urls, pIceConfigInfo->uris[j], MAX_ICE_CONFIG_URI_LEN);
-                STRNCPY(configuration.iceServers[uriCount + 1].credential, pIceConfigInfo->password, MAX_ICE_CONFIG_CREDENTIAL_LEN);
-                STRNCPY(configuration.iceServers[uriCount + 1].username, pIceConfigInfo->userName, MAX_ICE_CONFIG_USER_NAME_LEN);
-
-                uriCount++;
-            }
+    if (!hostOnly) {
+        SNPRINTF(configuration.iceServers[0].urls, MAX_ICE_CONFIG_URI_LEN, KINESIS_VIDEO_STUN_URL, pGstKvsPlugin->kvsContext.channelInfo.pRegion);
+    }
+
+    // The TURN servers come from the cache so no signaling calls are made here unless it's cold
+    if (!hostOnly && pGstKvsPlugin->gstParams.connectionMode != WEBRTC_CONNECTION_MODE_P2P_ONLY) {
+        MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+        expired = pGstKvsPlugin->pIceServers == NULL || pGstKvsPlugin->iceConfigExpiration <= GETTIME();
+        MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+
+        if (expired) {
+            CHK_STATUS(refreshIceServerConfig(pGstKvsPlugin));
         }
     }
 
-    pGstKvsPlugin->iceUriCount = uriCount + 1;
+    // NOTE: The pooled sessions are prepared outside of the session lock
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    if (pGstKvsPlugin->gstParams.connectionMode != WEBRTC_CONNECTION_MODE_P2P_ONLY && pGstKvsPlugin->pIceServers != NULL) {
+        MEMCPY(&configuration.iceServers[1], pGstKvsPlugin->pIceServers, pGstKvsPlugin->iceServerCount * SIZEOF(RtcIceServer));
+    }
 
     // Check if we have any pre-generated certs and use them
-    // NOTE: We are running under the config lock
     retStatus = stackQueueDequeue(pGstKvsPlugin->pregeneratedCertificates, &data);
+    MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
     CHK(retStatus == STATUS_SUCCESS || retStatus == STATUS_NOT_FOUND, retStatus);
 
     if (retStatus == STATUS_NOT_FOUND) {
@@ -838,7 +1964,6 @@ VOID onIceCandidateHandler(UINT64 customData, PCHAR candidateJson)
 {
     STATUS retStatus = STATUS_SUCCESS;
     PWebRtcStreamingSession pStreamingSession = (PWebRtcStreamingSession) customData;
-    SignalingMessage message;
 
     CHK(pStreamingSession != NULL, STATUS_NULL_ARG);
 
@@ -858,18 +1983,131 @@ VOID onIceCandidateHandler(UINT64 customData, PCHAR candidateJson)
         }
 
     } else if (pStreamingSession->remoteCanTrickleIce && ATOMIC_LOAD_BOOL(&pStreamingSession->peerIdReceived)) {
-        message.version = SIGNALING_MESSAGE_CURRENT_VERSION;
-        message.messageType = SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE;
-        STRNCPY(message.peerClientId, pStreamingSession->peerId, MAX_SIGNALING_CLIENT_ID_LEN);
-        message.payloadLen = (UINT32) STRNLEN(candidateJson, MAX_SIGNALING_MESSAGE_LEN);
-        STRNCPY(message.payload, candidateJson, message.payloadLen);
-        message.correlationId[0] = '\0';
-        CHK_STATUS(sendSignalingMessage(pStreamingSession, &message));
+        // Hand the candidate off to the sender so the ICE agent doesn't wait on the signaling channel
+        CHK_STATUS(enqueueLocalCandidate(pStreamingSession, candidateJson));
+    }
+
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+}
+
+STATUS enqueueLocalCandidate(PWebRtcStreamingSession pStreamingSession, PCHAR candidateJson)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PCHAR pCandidateJson = NULL;
+    UINT32 length;
+    BOOL locked = FALSE;
+
+    CHK(pStreamingSession != NULL && candidateJson != NULL, STATUS_NULL_ARG);
+
+    // Only accessed on the ICE agent thread
+    if (pStreamingSession->firstCandidateTime == 0) {
+        pStreamingSession->firstCandidateTime = GETTIME();
+    }
+
+    length = (UINT32) STRNLEN(candidateJson, MAX_SIGNALING_MESSAGE_LEN - 1);
+    CHK(NULL != (pCandidateJson = (PCHAR) MEMALLOC(length + 1)), STATUS_NOT_ENOUGH_MEMORY);
+    MEMCPY(pCandidateJson, candidateJson, length);
+    pCandidateJson[length] = '\0';
+
+    MUTEX_LOCK(pStreamingSession->candidateSenderLock);
+    locked = TRUE;
+
+    CHK_STATUS(stackQueueEnqueue(pStreamingSession->pLocalCandidates, (UINT64) pCandidateJson));
+    pCandidateJson = NULL;
+    CVAR_SIGNAL(pStreamingSession->candidateSenderCvar);
+
+CleanUp:
+
+    if (locked) {
+        MUTEX_UNLOCK(pStreamingSession->candidateSenderLock);
+    }
+
+    SAFE_MEMFREE(pCandidateJson);
+
+    return retStatus;
+}
+
+PVOID sendLocalCandidatesRoutine(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcStreamingSession pStreamingSession = (PWebRtcStreamingSession) args;
+    PGstKvsPlugin pGstKvsPlugin;
+    PCHAR candidates[GST_PLUGIN_CANDIDATE_BATCH_SIZE];
+    SignalingMessage message;
+    UINT32 i, count;
+    UINT64 data;
+
+    CHK(pStreamingSession != NULL && pStreamingSession->pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+    pGstKvsPlugin = pStreamingSession->pGstKvsPlugin;
+
+    message.version = SIGNALING_MESSAGE_CURRENT_VERSION;
+    message.messageType = SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE;
+    STRNCPY(message.peerClientId, pStreamingSession->peerId, MAX_SIGNALING_CLIENT_ID_LEN);
+    message.correlationId[0] = '\0';
+
+    while (!ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag)) {
+        // Take whatever has been gathered by the time the cvar fires in one go, no waiting for more
+        MUTEX_LOCK(pStreamingSession->candidateSenderLock);
+        count = 0;
+        CHK_LOG_ERR(stackQueueGetCount(pStreamingSession->pLocalCandidates, &count));
+        if (count == 0 && !ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag)) {
+            CVAR_WAIT(pStreamingSession->candidateSenderCvar, pStreamingSession->candidateSenderLock, INFINITE_TIME_VALUE);
+        }
+
+        for (count = 0; count < GST_PLUGIN_CANDIDATE_BATCH_SIZE; count++) {
+            if (STATUS_FAILED(stackQueueDequeue(pStreamingSession->pLocalCandidates, &data))) {
+                break;
+            }
+
+            candidates[count] = (PCHAR) data;
+        }
+        MUTEX_UNLOCK(pStreamingSession->candidateSenderLock);
+
+        // The batch goes out under a single hold of the signaling lock
+        MUTEX_LOCK(pGstKvsPlugin->signalingLock);
+        for (i = 0; i < count && !ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag); i++) {
+            message.payloadLen = (UINT32) STRLEN(candidates[i]);
+            MEMCPY(message.payload, candidates[i], message.payloadLen + 1);
+
+            if (pGstKvsPlugin->pLoopbackViewers != NULL) {
+                CHK_LOG_ERR(deliverLoopbackSignalingMessage(pGstKvsPlugin, &message));
+            } else if (IS_VALID_SIGNALING_CLIENT_HANDLE(pGstKvsPlugin->kvsContext.signalingHandle)) {
+                CHK_LOG_ERR(signalingClientSendMessageSync(pGstKvsPlugin->kvsContext.signalingHandle, &message));
+            }
+        }
+        MUTEX_UNLOCK(pGstKvsPlugin->signalingLock);
+
+        for (i = 0; i < count; i++) {
+            SAFE_MEMFREE(candidates[i]);
+        }
     }
 
 CleanUp:
 
     CHK_LOG_ERR(retStatus);
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+VOID updateIceConnectLatency(PWebRtcStreamingSession pStreamingSession)
+{
+    PGstKvsPlugin pGstKvsPlugin = pStreamingSession->pGstKvsPlugin;
+    UINT64 latency;
+    SIZE_T count;
+
+    if (pStreamingSession->firstCandidateTime == 0) {
+        return;
+    }
+
+    latency = GETTIME() - pStreamingSession->firstCandidateTime;
+    count = ATOMIC_INCREMENT(&pGstKvsPlugin->iceConnectCount) + 1;
+    ATOMIC_ADD(&pGstKvsPlugin->iceConnectTotalTime, (SIZE_T) (latency / HUNDREDS_OF_NANOS_IN_A_MILLISECOND));
+
+    DLOGD("Candidate gathering to connected for peer %s took %" PRIu64 " ms. Average %" PRIu64 " ms over %" PRIu64 " sessions",
+          pStreamingSession->peerId, latency / HUNDREDS_OF_NANOS_IN_A_MILLISECOND,
+          (UINT64) ATOMIC_LOAD(&pGstKvsPlugin->iceConnectTotalTime) / count, (UINT64) count);
 }
 
 STATUS sendSignalingMessage(PWebRtcStreamingSession pStreamingSession, PSignalingMessage pMessage)
@@ -880,12 +2118,17 @@ STATUS sendSignalingMessage(PWebRtcStreamingSession pStreamingSession, PSignalin
     // Validate the input params
     CHK(pStreamingSession != NULL && pStreamingSession->pGstKvsPlugin != NULL && pMessage != NULL, STATUS_NULL_ARG);
     CHK(IS_VALID_MUTEX_VALUE(pStreamingSession->pGstKvsPlugin->signalingLock) &&
-            IS_VALID_SIGNALING_CLIENT_HANDLE(pStreamingSession->pGstKvsPlugin->kvsContext.signalingHandle),
+            (pStreamingSession->pGstKvsPlugin->pLoopbackViewers != NULL ||
+             IS_VALID_SIGNALING_CLIENT_HANDLE(pStreamingSession->pGstKvsPlugin->kvsContext.signalingHandle)),
         STATUS_INVALID_OPERATION);
 
     MUTEX_LOCK(pStreamingSession->pGstKvsPlugin->signalingLock);
     locked = TRUE;
-    CHK_STATUS(signalingClientSendMessageSync(pStreamingSession->pGstKvsPlugin->kvsContext.signalingHandle, pMessage));
+    if (pStreamingSession->pGstKvsPlugin->pLoopbackViewers != NULL) {
+        CHK_STATUS(deliverLoopbackSignalingMessage(pStreamingSession->pGstKvsPlugin, pMessage));
+    } else {
+        CHK_STATUS(signalingClientSendMessageSync(pStreamingSession->pGstKvsPlugin->kvsContext.signalingHandle, pMessage));
+    }
 
 CleanUp:
 
@@ -900,6 +2143,7 @@ CleanUp:
 STATUS respondWithAnswer(PWebRtcStreamingSession pStreamingSession)
 {
     STATUS retStatus = STATUS_SUCCESS;
+    PGstKvsPlugin pGstKvsPlugin;
     SignalingMessage message;
     UINT32 buffLen = MAX_SIGNALING_MESSAGE_LEN;
 
@@ -913,6 +2157,12 @@ STATUS respondWithAnswer(PWebRtcStreamingSession pStreamingSession)
 
     CHK_STATUS(sendSignalingMessage(pStreamingSession, &message));
 
+    // Compare the answers from the prepared sessions with the ones created on the offer
+    pGstKvsPlugin = pStreamingSession->pGstKvsPlugin;
+    latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[pStreamingSession->pooled ? GST_PLUGIN_LATENCY_STAGE_POOLED_ANSWER
+                                                                                          : GST_PLUGIN_LATENCY_STAGE_COLD_ANSWER],
+                           GETTIME() - pStreamingSession->offerReceiveTime);
+
 CleanUp:
 
     CHK_LOG_ERR(retStatus);
@@ -922,39 +2172,48 @@ CleanUp:
 STATUS submitPendingIceCandidate(PPendingMessageQueue pPendingMessageQueue, PWebRtcStreamingSession pStreamingSession)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    BOOL noPendingSignalingMessageForClient = FALSE;
-    PReceivedSignalingMessage pReceivedSignalingMessage = NULL;
-    UINT64 hashValue;
+    PCHAR pCandidate = NULL;
+    UINT64 data;
 
     CHK(pPendingMessageQueue != NULL && pPendingMessageQueue->messageQueue != NULL && pStreamingSession != NULL, STATUS_NULL_ARG);
 
-    do {
-        CHK_STATUS(stackQueueIsEmpty(pPendingMessageQueue->messageQueue, &noPendingSignalingMessageForClient));
-        if (!noPendingSignalingMessageForClient) {
-            hashValue = 0;
-            CHK_STATUS(stackQueueDequeue(pPendingMessageQueue->messageQueue, &hashValue));
-            pReceivedSignalingMessage = (PReceivedSignalingMessage) hashValue;
-            CHK(pReceivedSignalingMessage != NULL, STATUS_INTERNAL_ERROR);
-            if (pReceivedSignalingMessage->signalingMessage.messageType == SIGNALING_MESSAGE_TYPE_ICE_CANDIDATE) {
-                CHK_STATUS(handleRemoteCandidate(pStreamingSession, &pReceivedSignalingMessage->signalingMessage));
-            }
-            SAFE_MEMFREE(pReceivedSignalingMessage);
-        }
-    } while (!noPendingSignalingMessageForClient);
+    while (STATUS_SUCCEEDED(stackQueueDequeue(pPendingMessageQueue->messageQueue, &data))) {
+        pCandidate = (PCHAR) data;
+        CHK(pCandidate != NULL, STATUS_INTERNAL_ERROR);
+        CHK_STATUS(addIceCandidate(pStreamingSession->pPeerConnection, pCandidate));
+        SAFE_MEMFREE(pCandidate);
+    }
 
     CHK_STATUS(freeMessageQueue(pPendingMessageQueue));
 
 CleanUp:
 
-    SAFE_MEMFREE(pReceivedSignalingMessage);
+    SAFE_MEMFREE(pCandidate);
     CHK_LOG_ERR(retStatus);
     return retStatus;
 }
 
-VOID sampleBandwidthEstimationHandler(UINT64 customData, DOUBLE maxiumBitrate)
+VOID sampleBandwidthEstimationHandler(UINT64 customData, DOUBLE maxiumBitrate)
+{
+    PWebRtcStreamingSession pStreamingSession = (PWebRtcStreamingSession) customData;
+
+    DLOGD("Received bitrate suggestion: %f", maxiumBitrate);
+
+    if (pStreamingSession != NULL && maxiumBitrate > 0.0) {
+        ATOMIC_STORE(&pStreamingSession->bandwidthEstimate, (SIZE_T) maxiumBitrate);
+        updateSendBudget(pStreamingSession);
+    }
+}
+
+VOID onPictureLossHandler(UINT64 customData)
 {
-    UNUSED_PARAM(customData);
-    DLOGD("Received bitrate suggestion: %f", maxiumBitrate);
+    PWebRtcStreamingSession pStreamingSession = (PWebRtcStreamingSession) customData;
+
+    // PLI/FIR from the viewer. The requests of all the viewers are coalesced into a single force key unit event.
+    if (pStreamingSession != NULL && pStreamingSession->pGstKvsPlugin != NULL) {
+        DLOGV("Picture loss reported by peer %s", pStreamingSession->peerId);
+        ATOMIC_STORE_BOOL(&pStreamingSession->pGstKvsPlugin->keyUnitRequested, TRUE);
+    }
 }
 
 STATUS handleRemoteCandidate(PWebRtcStreamingSession pStreamingSession, PSignalingMessage pSignalingMessage)
@@ -1032,8 +2291,9 @@ STATUS handleOffer(PGstKvsPlugin pGstKvsPlugin, PWebRtcStreamingSession pStreami
     }
 
     // We need the metrics timer only when there isn't one already in progress
-    // IMPORTANT: This is called under the lock
-    if (pGstKvsPlugin->iceCandidatePairStatsTimerId == MAX_UINT32 &&
+    // NOTE: Offers are handled outside of the session lock
+    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
+    if (!pGstKvsPlugin->timersCancelled && pGstKvsPlugin->iceCandidatePairStatsTimerId == MAX_UINT32 &&
         STATUS_FAILED(retStatus = timerQueueAddTimer(pGstKvsPlugin->kvsContext.timerQueueHandle, GST_PLUGIN_STATS_DURATION, GST_PLUGIN_STATS_DURATION,
                                                      getIceCandidatePairStatsCallback, (UINT64) pGstKvsPlugin,
                                                      &pGstKvsPlugin->iceCandidatePairStatsTimerId))) {
@@ -1041,6 +2301,7 @@ STATUS handleOffer(PGstKvsPlugin pGstKvsPlugin, PWebRtcStreamingSession pStreami
               "periodically",
               retStatus);
     }
+    MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
 
     // The audio video receive routine should be per streaming session
     THREAD_CREATE(&pStreamingSession->receiveAudioVideoSenderTid, receiveGstreamerAudioVideo, (PVOID) pStreamingSession);
@@ -1082,21 +2343,33 @@ STATUS getIceCandidatePairStatsCallback(UINT32 timerId, UINT64 currentTime, UINT
     DOUBLE averageNumberOfPacketsReceivedPerSecond = 0.0;
     DOUBLE outgoingBitrate = 0.0;
     DOUBLE incomingBitrate = 0.0;
-    BOOL locked = FALSE;
+    BOOL acquired = FALSE;
+    PWebRtcSessionList pSessionList;
+    PWebRtcStreamingSession pStreamingSession;
+    PRtcIceCandidatePairStats pCandidatePairStats;
+    UINT32 sendBudgetScale, epochSlot;
+    UINT64 webRtcFrameCount;
 
     CHK_WARN(pGstKvsPlugin != NULL, STATUS_NULL_ARG, "GetPeriodicStats(): Passed argument is NULL");
 
+    webRtcFrameCount = (UINT64) ATOMIC_LOAD(&pGstKvsPlugin->webRtcFrameCount);
+    if (webRtcFrameCount != 0) {
+        DLOGD("Bytes copied per frame on the WebRTC media path: %lf",
+              (DOUBLE) ATOMIC_LOAD(&pGstKvsPlugin->webRtcCopiedBytes) / (DOUBLE) webRtcFrameCount);
+    }
+
     pGstKvsPlugin->rtcIceCandidatePairMetrics.requestedTypeOfStats = RTC_STATS_TYPE_CANDIDATE_PAIR;
+    pCandidatePairStats = &pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats;
 
-    // We need to execute this under the object lock due to race conditions that it could pose
-    MUTEX_LOCK(pGstKvsPlugin->sessionLock);
-    locked = TRUE;
+    // The sessions can't be freed until the snapshot is released. The metrics scratch is only used by this timer.
+    pSessionList = acquireStreamingSessionList(pGstKvsPlugin, &epochSlot);
+    acquired = TRUE;
 
-    for (i = 0; i < pGstKvsPlugin->streamingSessionCount; ++i) {
-        if (STATUS_SUCCEEDED(rtcPeerConnectionGetMetrics(pGstKvsPlugin->streamingSessionList[i]->pPeerConnection, NULL,
+    for (i = 0; pSessionList != NULL && i < pSessionList->count; ++i) {
+        if (STATUS_SUCCEEDED(rtcPeerConnectionGetMetrics(pSessionList->sessions[i]->pPeerConnection, NULL,
                                                          &pGstKvsPlugin->rtcIceCandidatePairMetrics))) {
             currentMeasureDuration =
-                (pGstKvsPlugin->rtcIceCandidatePairMetrics.timestamp - pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevTs) /
+                (pGstKvsPlugin->rtcIceCandidatePairMetrics.timestamp - pSessionList->sessions[i]->rtcMetricsHistory.prevTs) /
                 HUNDREDS_OF_NANOS_IN_A_SECOND;
             DLOGD("Current duration: %" PRIu64 " seconds", currentMeasureDuration);
             if (currentMeasureDuration > 0) {
@@ -1110,47 +2383,70 @@ STATUS getIceCandidatePairStatsCallback(UINT32 timerId, UINT64 currentTime, UINT
                       pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.nominated ? "nominated" : "not nominated");
                 averageNumberOfPacketsSentPerSecond =
                     (DOUBLE)(pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsSent -
-                             pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsSent) /
+                             pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfPacketsSent) /
                     (DOUBLE) currentMeasureDuration;
                 DLOGD("Packet send rate: %lf pkts/sec", averageNumberOfPacketsSentPerSecond);
 
                 averageNumberOfPacketsReceivedPerSecond =
                     (DOUBLE)(pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsReceived -
-                             pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsReceived) /
+                             pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfPacketsReceived) /
                     (DOUBLE) currentMeasureDuration;
                 DLOGD("Packet receive rate: %lf pkts/sec", averageNumberOfPacketsReceivedPerSecond);
 
-                outgoingBitrate = (DOUBLE)(pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesSent -
-                                           pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesSent * 8.0) /
-                    currentMeasureDuration;
+                outgoingBitrate =
+                    (DOUBLE)(pCandidatePairStats->bytesSent - pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfBytesSent) * 8.0 /
+                    (DOUBLE) currentMeasureDuration;
                 DLOGD("Outgoing bit rate: %lf bps", outgoingBitrate);
 
-                incomingBitrate = (DOUBLE)(pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesReceived -
-                                           pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesReceived * 8.0) /
-                    currentMeasureDuration;
+                incomingBitrate =
+                    (DOUBLE)(pCandidatePairStats->bytesReceived - pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfBytesReceived) * 8.0 /
+                    (DOUBLE) currentMeasureDuration;
                 DLOGD("Incoming bit rate: %lf bps", incomingBitrate);
 
                 averagePacketsDiscardedOnSend =
                     (DOUBLE)(pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend -
-                             pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend) /
+                             pSessionList->sessions[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend) /
                     (DOUBLE) currentMeasureDuration;
                 DLOGD("Packet discard rate: %lf pkts/sec", averagePacketsDiscardedOnSend);
 
+                // Tighten the send budget below the estimate while the packets are being discarded and
+                // loosen it back up once they are not
+                pStreamingSession = pSessionList->sessions[i];
+                sendBudgetScale = (UINT32) ATOMIC_LOAD(&pStreamingSession->sendBudgetScale);
+                if (averagePacketsDiscardedOnSend > 0.0) {
+                    sendBudgetScale = MAX(GST_PLUGIN_SEND_BUDGET_MIN_SCALE, sendBudgetScale - GST_PLUGIN_SEND_BUDGET_SCALE_DOWN);
+                } else {
+                    sendBudgetScale = MIN(100, sendBudgetScale + GST_PLUGIN_SEND_BUDGET_SCALE_UP);
+                }
+
+                ATOMIC_STORE(&pStreamingSession->sendBudgetScale, sendBudgetScale);
+                updateSendBudget(pStreamingSession);
+                DLOGD("Send budget: %" PRIu64 " bps (%u%% of the estimate). Thinned frames: %" PRIu64,
+                      (UINT64) ATOMIC_LOAD(&pStreamingSession->sendBudgetRate), sendBudgetScale,
+                      (UINT64) ATOMIC_LOAD(&pStreamingSession->thinnedFrameCount));
+
                 DLOGD("Current STUN request round trip time: %lf sec",
                       pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.currentRoundTripTime);
                 DLOGD("Number of STUN responses received: %llu",
                       pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.responsesReceived);
 
-                pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevTs = pGstKvsPlugin->rtcIceCandidatePairMetrics.timestamp;
-                pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsSent =
+                // Published for the stats property and messages
+                ATOMIC_STORE(&pStreamingSession->outgoingBitrate, (SIZE_T) outgoingBitrate);
+                ATOMIC_STORE(&pStreamingSession->incomingBitrate, (SIZE_T) incomingBitrate);
+                ATOMIC_STORE(&pStreamingSession->roundTripTime,
+                             (SIZE_T) (pCandidatePairStats->currentRoundTripTime * HUNDREDS_OF_NANOS_IN_A_SECOND));
+                ATOMIC_STORE(&pStreamingSession->packetsDiscardedOnSend, (SIZE_T) pCandidatePairStats->packetsDiscardedOnSend);
+
+                pSessionList->sessions[i]->rtcMetricsHistory.prevTs = pGstKvsPlugin->rtcIceCandidatePairMetrics.timestamp;
+                pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfPacketsSent =
                     pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsSent;
-                pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfPacketsReceived =
+                pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfPacketsReceived =
                     pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsReceived;
-                pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesSent =
+                pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfBytesSent =
                     pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesSent;
-                pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevNumberOfBytesReceived =
+                pSessionList->sessions[i]->rtcMetricsHistory.prevNumberOfBytesReceived =
                     pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.bytesReceived;
-                pGstKvsPlugin->streamingSessionList[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend =
+                pSessionList->sessions[i]->rtcMetricsHistory.prevPacketsDiscardedOnSend =
                     pGstKvsPlugin->rtcIceCandidatePairMetrics.rtcStatsObject.iceCandidatePairStats.packetsDiscardedOnSend;
             }
         }
@@ -1158,8 +2454,8 @@ STATUS getIceCandidatePairStatsCallback(UINT32 timerId, UINT64 currentTime, UINT
 
 CleanUp:
 
-    if (locked) {
-        MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
+    if (acquired) {
+        releaseStreamingSessionList(pGstKvsPlugin, epochSlot);
     }
 
     return retStatus;
@@ -1267,9 +2563,8 @@ STATUS sessionServiceHandler(UINT32 timerId, UINT64 currentTime, UINT64 customDa
 {
     STATUS retStatus = STATUS_SUCCESS;
     PGstKvsPlugin pGstKvsPlugin = (PGstKvsPlugin) customData;
-    PWebRtcStreamingSession pStreamingSession = NULL;
-    UINT32 i, clientIdHash;
-    BOOL locked = FALSE, peerConnectionFound = FALSE;
+    BOOL locked = FALSE;
+    BOOL refillPool = FALSE;
     SIGNALING_CLIENT_STATE signalingClientState;
 
     CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
@@ -1278,28 +2573,7 @@ STATUS sessionServiceHandler(UINT32 timerId, UINT64 currentTime, UINT64 customDa
     locked = TRUE;
 
     // scan and cleanup terminated streaming session
-    for (i = 0; i < pGstKvsPlugin->streamingSessionCount; ++i) {
-        if (ATOMIC_LOAD_BOOL(&pGstKvsPlugin->streamingSessionList[i]->terminateFlag)) {
-            pStreamingSession = pGstKvsPlugin->streamingSessionList[i];
-
-            MUTEX_LOCK(pGstKvsPlugin->sessionListReadLock);
-
-            // swap with last element and decrement count
-            pGstKvsPlugin->streamingSessionCount--;
-            pGstKvsPlugin->streamingSessionList[i] = pGstKvsPlugin->streamingSessionList[pGstKvsPlugin->streamingSessionCount];
-
-            // Remove from the hash table
-            clientIdHash = COMPUTE_CRC32((PBYTE) pStreamingSession->peerId, (UINT32) STRLEN(pStreamingSession->peerId));
-            CHK_STATUS(hashTableContains(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient, clientIdHash, &peerConnectionFound));
-            if (peerConnectionFound) {
-                CHK_STATUS(hashTableRemove(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient, clientIdHash));
-            }
-
-            MUTEX_UNLOCK(pGstKvsPlugin->sessionListReadLock);
-
-            CHK_STATUS(freeWebRtcStreamingSession(&pStreamingSession));
-        }
-    }
+    CHK_STATUS(removeTerminatedStreamingSessions(pGstKvsPlugin));
 
     // Check if we need to re-create the signaling client on-the-fly
     if (ATOMIC_LOAD_BOOL(&pGstKvsPlugin->recreateSignalingClient) &&
@@ -1310,6 +2584,9 @@ STATUS sessionServiceHandler(UINT32 timerId, UINT64 currentTime, UINT64 customDa
         STATUS_SUCCEEDED(signalingClientFetchSync(pGstKvsPlugin->kvsContext.signalingHandle))) {
         // Re-set the variable again
         ATOMIC_STORE_BOOL(&pGstKvsPlugin->recreateSignalingClient, FALSE);
+
+        // Have the ICE server configuration of the new client picked up by the next refresh
+        pGstKvsPlugin->iceConfigExpiration = 0;
     }
 
     // Check the signaling client state and connect if needed
@@ -1318,15 +2595,24 @@ STATUS sessionServiceHandler(UINT32 timerId, UINT64 currentTime, UINT64 customDa
         if (signalingClientState == SIGNALING_CLIENT_STATE_READY) {
             UNUSED_PARAM(signalingClientConnectSync(pGstKvsPlugin->kvsContext.signalingHandle));
         }
+
+        // The ICE server configuration is available once connected
+        refillPool = signalingClientState == SIGNALING_CLIENT_STATE_CONNECTED;
     }
 
     // Check if any lingering pending message queues
-    CHK_STATUS(removeExpiredMessageQueues(pGstKvsPlugin->pPendingSignalingMessageForRemoteClient));
+    CHK_STATUS(removeExpiredMessageQueues(pGstKvsPlugin));
 
     // periodically wake up and clean up terminated streaming session
     MUTEX_UNLOCK(pGstKvsPlugin->sessionLock);
     locked = FALSE;
 
+    // Keep a few sessions ready for the incoming offers. Preparing one takes a while so it's left to the worker
+    // rather than holding up the other timers of the client.
+    if (refillPool) {
+        requestSessionWork(pGstKvsPlugin, &pGstKvsPlugin->poolRefillRequested);
+    }
+
 CleanUp:
 
     CHK_LOG_ERR(retStatus);
@@ -1338,131 +2624,630 @@ CleanUp:
     return retStatus;
 }
 
-STATUS putFrameToWebRtcPeers(PGstKvsPlugin pGstKvsPlugin, PFrame pFrame, ELEMENTARY_STREAM_NAL_FORMAT nalFormat)
+STATUS createStreamingSessionList(UINT32 capacity, PWebRtcSessionList* ppSessionList)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcSessionList pSessionList = NULL;
+
+    CHK(ppSessionList != NULL, STATUS_NULL_ARG);
+
+    CHK(NULL !=
+            (pSessionList = (PWebRtcSessionList) MEMCALLOC(1, SIZEOF(WebRtcSessionList) + capacity * SIZEOF(PWebRtcStreamingSession))),
+        STATUS_NOT_ENOUGH_MEMORY);
+    pSessionList->count = 0;
+    pSessionList->sessions = (PWebRtcStreamingSession*) (pSessionList + 1);
+
+CleanUp:
+
+    if (ppSessionList != NULL) {
+        *ppSessionList = pSessionList;
+    }
+
+    return retStatus;
+}
+
+PWebRtcSessionList acquireStreamingSessionList(PGstKvsPlugin pGstKvsPlugin, PUINT32 pEpochSlot)
+{
+    SIZE_T epoch;
+
+    // Register as a reader of the current epoch. If a writer has moved the epoch in the meantime
+    // it might have already checked our slot so we need to retry with the new epoch.
+    while (TRUE) {
+        epoch = ATOMIC_LOAD(&pGstKvsPlugin->sessionListEpoch);
+        ATOMIC_INCREMENT(&pGstKvsPlugin->sessionListReaders[epoch & 1]);
+        if (epoch == ATOMIC_LOAD(&pGstKvsPlugin->sessionListEpoch)) {
+            break;
+        }
+
+        ATOMIC_DECREMENT(&pGstKvsPlugin->sessionListReaders[epoch & 1]);
+    }
+
+    *pEpochSlot = (UINT32) (epoch & 1);
+
+    return (PWebRtcSessionList) ATOMIC_LOAD(&pGstKvsPlugin->streamingSessionList);
+}
+
+VOID releaseStreamingSessionList(PGstKvsPlugin pGstKvsPlugin, UINT32 epochSlot)
+{
+    ATOMIC_DECREMENT(&pGstKvsPlugin->sessionListReaders[epochSlot]);
+}
+
+STATUS swapStreamingSessionList(PGstKvsPlugin pGstKvsPlugin, PWebRtcSessionList pSessionList, PWebRtcSessionList* ppOldSessionList)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    SIZE_T epoch;
+
+    // NOTE: The writers are serialized by the session lock
+    CHK(pGstKvsPlugin != NULL && ppOldSessionList != NULL, STATUS_NULL_ARG);
+
+    *ppOldSessionList = (PWebRtcSessionList) ATOMIC_EXCHANGE(&pGstKvsPlugin->streamingSessionList, (SIZE_T) pSessionList);
+
+    // Move the new readers to the other slot and wait out the ones that could still see the old list
+    epoch = ATOMIC_LOAD(&pGstKvsPlugin->sessionListEpoch);
+    ATOMIC_STORE(&pGstKvsPlugin->sessionListEpoch, epoch + 1);
+    while (ATOMIC_LOAD(&pGstKvsPlugin->sessionListReaders[epoch & 1]) != 0) {
+        THREAD_SLEEP(GST_PLUGIN_SESSION_LIST_SYNC_SLEEP);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+STATUS addStreamingSessionToList(PGstKvsPlugin pGstKvsPlugin, PWebRtcStreamingSession pStreamingSession)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcSessionList pSessionList, pNewSessionList = NULL, pOldSessionList = NULL;
+    UINT32 count;
+
+    CHK(pGstKvsPlugin != NULL && pStreamingSession != NULL, STATUS_NULL_ARG);
+
+    pSessionList = (PWebRtcSessionList) ATOMIC_LOAD(&pGstKvsPlugin->streamingSessionList);
+    count = pSessionList == NULL ? 0 : pSessionList->count;
+
+    CHK_STATUS(createStreamingSessionList(count + 1, &pNewSessionList));
+    if (count != 0) {
+        MEMCPY(pNewSessionList->sessions, pSessionList->sessions, count * SIZEOF(PWebRtcStreamingSession));
+    }
+
+    pNewSessionList->sessions[count] = pStreamingSession;
+    pNewSessionList->count = count + 1;
+
+    CHK_STATUS(swapStreamingSessionList(pGstKvsPlugin, pNewSessionList, &pOldSessionList));
+    pNewSessionList = NULL;
+
+CleanUp:
+
+    SAFE_MEMFREE(pNewSessionList);
+    SAFE_MEMFREE(pOldSessionList);
+
+    return retStatus;
+}
+
+STATUS removeTerminatedStreamingSessions(PGstKvsPlugin pGstKvsPlugin)
 {
     STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcSessionList pSessionList, pNewSessionList = NULL, pOldSessionList = NULL;
     PWebRtcStreamingSession pStreamingSession;
-    PRtcRtpTransceiver pRtcRtpTransceiver;
-    UINT32 i;
+    PWebRtcStreamingSession* pTerminatedSessions = NULL;
+    UINT32 i, terminatedCount = 0, clientIdHash;
+    BOOL peerConnectionFound;
+
+    CHK(pGstKvsPlugin != NULL, STATUS_NULL_ARG);
+
+    pSessionList = (PWebRtcSessionList) ATOMIC_LOAD(&pGstKvsPlugin->streamingSessionList);
+    CHK(pSessionList != NULL, retStatus);
+
+    // Quick check if there is anything that needs to be done.
+    for (i = 0; i < pSessionList->count && terminatedCount == 0; ++i) {
+        if (ATOMIC_LOAD_BOOL(&pSessionList->sessions[i]->terminateFlag)) {
+            terminatedCount++;
+        }
+    }
+
+    CHK(terminatedCount != 0, retStatus);
+
+    CHK_STATUS(createStreamingSessionList(pSessionList->count, &pNewSessionList));
+    CHK(NULL != (pTerminatedSessions = (PWebRtcStreamingSession*) MEMCALLOC(pSessionList->count, SIZEOF(PWebRtcStreamingSession))),
+        STATUS_NOT_ENOUGH_MEMORY);
+
+    // Split the sessions in a single pass so none can end up in both lists
+    for (terminatedCount = 0, i = 0; i < pSessionList->count; ++i) {
+        pStreamingSession = pSessionList->sessions[i];
+        if (ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag)) {
+            pTerminatedSessions[terminatedCount++] = pStreamingSession;
+        } else {
+            pNewSessionList->sessions[pNewSessionList->count++] = pStreamingSession;
+        }
+    }
+
+    // Once swapped, the media path can no longer reference the terminated sessions
+    CHK_STATUS(swapStreamingSessionList(pGstKvsPlugin, pNewSessionList, &pOldSessionList));
+    pNewSessionList = NULL;
+
+    for (i = 0; i < terminatedCount; ++i) {
+        pStreamingSession = pTerminatedSessions[i];
+
+        // Remove from the hash table
+        clientIdHash = COMPUTE_CRC32((PBYTE) pStreamingSession->peerId, (UINT32) STRLEN(pStreamingSession->peerId));
+        peerConnectionFound = FALSE;
+        CHK_LOG_ERR(hashTableContains(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient, clientIdHash, &peerConnectionFound));
+        if (peerConnectionFound) {
+            CHK_LOG_ERR(hashTableRemove(pGstKvsPlugin->pRtcPeerConnectionForRemoteClient, clientIdHash));
+        }
+
+        CHK_LOG_ERR(freeWebRtcStreamingSession(&pStreamingSession));
+    }
+
+CleanUp:
+
+    SAFE_MEMFREE(pNewSessionList);
+    SAFE_MEMFREE(pOldSessionList);
+    SAFE_MEMFREE(pTerminatedSessions);
 
-    CHK(pGstKvsPlugin != NULL && pFrame != NULL, STATUS_NULL_ARG);
+    return retStatus;
+}
+
+STATUS putFrameToWebRtcPeers(PGstKvsPlugin pGstKvsPlugin, PFrame pFrame, GstBuffer* pBuffer, GstMapInfo* pMapInfo, PNalIndex pNalIndex)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcSessionList pSessionList;
+    PSharedFrame pSharedFrame = NULL;
+    PWebRtcStreamingSession pStreamingSession;
+    BOOL acquired = FALSE, adapt, includeCpd = FALSE, cacheFrame, isKeyFrame;
+    UINT32 i, epochSlot;
+    UINT64 adaptStartTime;
+
+    CHK(pGstKvsPlugin != NULL && pFrame != NULL && pBuffer != NULL && pMapInfo != NULL, STATUS_NULL_ARG);
 
     // Adjust the duration as some peers are sensitive to 0 duration
     if (pFrame->duration == 0) {
         pFrame->duration = GST_PLUGIN_DEFAULT_FRAME_DURATION;
     }
 
-    MUTEX_LOCK(pGstKvsPlugin->sessionListReadLock);
-    // Check if the bits need adaptation and if we have any active sessions
-    if (IS_AVCC_HEVC_CPD_NAL_FORMAT(nalFormat) && pFrame->trackId == DEFAULT_VIDEO_TRACK_ID && pGstKvsPlugin->streamingSessionCount != 0) {
-        CHK_STATUS(adaptVideoFrameFromAvccToAnnexB(pGstKvsPlugin, pFrame, nalFormat));
+    // No locking on the media path. The snapshot stays valid until released.
+    pSessionList = acquireStreamingSessionList(pGstKvsPlugin, &epochSlot);
+    acquired = TRUE;
+
+    // The video frames are cached from the key frame onward for the peers yet to connect
+    isKeyFrame = pFrame->trackId == DEFAULT_VIDEO_TRACK_ID && CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags);
+    cacheFrame = pFrame->trackId == DEFAULT_VIDEO_TRACK_ID && ATOMIC_LOAD_BOOL(&pGstKvsPlugin->connectWebRtc) &&
+        (isKeyFrame || pGstKvsPlugin->gopCache.valid);
+
+    // Nothing to do if we have no active sessions and nothing to cache
+    CHK((pSessionList != NULL && pSessionList->count != 0) || cacheFrame, retStatus);
+
+    // Check if the bits need adaptation. Only the video frames are indexed.
+    adapt = pNalIndex != NULL && IS_AVCC_HEVC_CPD_NAL_FORMAT(pNalIndex->format);
+
+    // Check if we need to send the stored Annex-B format CPD ahead of an IDR frame
+    // which doesn't carry the parameter sets itself
+    includeCpd = pNalIndex != NULL && CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags) && pNalIndex->idr && !pNalIndex->parameterSets &&
+        pGstKvsPlugin->videoCpdSize != 0;
+
+    if (pBuffer->pool == NULL && (!adapt || (pMapInfo->flags & GST_MAP_WRITE) != 0)) {
+        // The AvCC/HEVC NALu run lengths are the same size as the Annex-B start codes so the bits are
+        // adapted in place. The buffer is referenced by all of the session senders without copying.
+        if (adapt) {
+            adaptStartTime = GST_PLUGIN_MONOTONIC_TIME();
+            CHK_STATUS(adaptVideoFrameFromAvccToAnnexB(pFrame, pFrame->frameData, pNalIndex));
+            latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_NAL_ADAPT],
+                                   GST_PLUGIN_MONOTONIC_TIME() - adaptStartTime);
+
+            // The index stays valid for the adapted bits
+            pNalIndex->format = ELEMENTARY_STREAM_NAL_FORMAT_ANNEX_B;
+        }
+
+        CHK_STATUS(createSharedFrameFromBuffer(pFrame, pBuffer, pMapInfo, &pSharedFrame));
+    } else {
+        // Holding on to pooled buffers would starve the upstream pool and read-only bits can't be adapted.
+        // The bits are copied once, adapting on the way, and the copy is shared between the session senders.
+        CHK_STATUS(createSharedFrame(pFrame, !adapt, &pSharedFrame));
+        if (adapt) {
+            adaptStartTime = GST_PLUGIN_MONOTONIC_TIME();
+            CHK_STATUS(adaptVideoFrameFromAvccToAnnexB(pFrame, pSharedFrame->frame.frameData, pNalIndex));
+            latencyHistogramRecord(&pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_NAL_ADAPT],
+                                   GST_PLUGIN_MONOTONIC_TIME() - adaptStartTime);
+        }
+
+        ATOMIC_ADD(&pGstKvsPlugin->webRtcCopiedBytes, pFrame->size);
     }
 
-    for (i = 0; i < pGstKvsPlugin->streamingSessionCount; ++i) {
-        pStreamingSession = pGstKvsPlugin->streamingSessionList[i];
-        pRtcRtpTransceiver =
-            pFrame->trackId == DEFAULT_AUDIO_TRACK_ID ? pStreamingSession->pAudioRtcRtpTransceiver : pStreamingSession->pVideoRtcRtpTransceiver;
+    ATOMIC_INCREMENT(&pGstKvsPlugin->webRtcFrameCount);
 
-        retStatus = writeFrame(pRtcRtpTransceiver, pFrame);
+    // The viewers short on bandwidth drop the frames which are not referenced first
+    pSharedFrame->disposable = pNalIndex != NULL && pNalIndex->nalCount != 0 && !pNalIndex->reference && !isKeyFrame;
 
-        CHK(retStatus == STATUS_SUCCESS || retStatus == STATUS_SRTP_NOT_READY_YET, retStatus);
-        retStatus = STATUS_SUCCESS;
+    // The stored Annex-B CPD goes out as a separate chunk ahead of the IDR frame.
+    // It's only stored once on the first caps so it outlives the queued frames.
+    if (includeCpd) {
+        pSharedFrame->pCpd = pGstKvsPlugin->videoCpd;
+        pSharedFrame->cpdSize = pGstKvsPlugin->videoCpdSize;
+    }
+
+    for (i = 0; pSessionList != NULL && i < pSessionList->count; ++i) {
+        pStreamingSession = pSessionList->sessions[i];
+
+        // Prime the newly connected peer with the current GoP unless this frame starts a new one
+        if (pStreamingSession->firstFrame && ATOMIC_LOAD_BOOL(&pStreamingSession->connected)) {
+            pStreamingSession->firstFrame = FALSE;
+            if (!isKeyFrame) {
+                CHK_LOG_ERR(replayGopCacheToStreamingSession(pGstKvsPlugin, pStreamingSession, pFrame->presentationTs));
+            }
+        }
+
+        CHK_LOG_ERR(enqueueFrameToStreamingSession(pStreamingSession, pSharedFrame));
+    }
+
+    if (cacheFrame) {
+        CHK_STATUS(updateGopCache(pGstKvsPlugin, pSharedFrame));
     }
-    MUTEX_UNLOCK(pGstKvsPlugin->sessionListReadLock);
 
 CleanUp:
 
+    if (acquired) {
+        releaseStreamingSessionList(pGstKvsPlugin, epochSlot);
+    }
+
+    // Release the creator reference
+    sharedFrameRelease(pSharedFrame);
+
     CHK_LOG_ERR(retStatus);
     return retStatus;
 }
 
-STATUS adaptVideoFrameFromAvccToAnnexB(PGstKvsPlugin pGstKvsPlugin, PFrame pFrame, ELEMENTARY_STREAM_NAL_FORMAT nalFormat)
+STATUS enqueueFrameToStreamingSession(PWebRtcStreamingSession pStreamingSession, PSharedFrame pSharedFrame)
 {
     STATUS retStatus = STATUS_SUCCESS;
-    PBYTE pCurPnt, pEndPnt, pDst;
-    UINT32 runLen = 0, overallSize;
-    BOOL includeCpd, iterate = TRUE;
-    BYTE naluHeader;
-
-    CHK(pGstKvsPlugin != NULL && pFrame != NULL, STATUS_NULL_ARG);
-    CHK(pFrame->size > SIZEOF(UINT32) + 1, STATUS_FORMAT_ERROR);
-
-    pCurPnt = pFrame->frameData;
-    pEndPnt = pCurPnt + pFrame->size;
-
-    // Pre-set the defaults before determining whether we need to include the CPD
-    includeCpd = FALSE;
-    overallSize = pFrame->size;
-
-    // Check if we need to prepend the Annex-B format stored CPD
-    // It should only be prepended to an IDR frame.
-    // We are skipping over non-RBSP NALus and check if we have an IDR or VPS/SPS/PPS
-    if (CHECK_FRAME_FLAG_KEY_FRAME(pFrame->flags)) {
-        while (iterate && pCurPnt != pEndPnt) {
-            CHK(pCurPnt + SIZEOF(UINT32) < pEndPnt, STATUS_FORMAT_ERROR);
-
-            // Skip the AvCC/HEVC NALu run length
-            naluHeader = *(pCurPnt + SIZEOF(UINT32));
-            runLen = (UINT32) GET_UNALIGNED_BIG_ENDIAN((PUINT32) pCurPnt);
-
-            // Check if we need to prepend the stored Annex-B formatted CPD only to a key frame
-            if ((nalFormat == ELEMENTARY_STREAM_NAL_FORMAT_AVCC && IS_NALU_H264_IDR_HEADER(naluHeader)) ||
-                (nalFormat == ELEMENTARY_STREAM_NAL_FORMAT_HEVC && IS_NALU_H265_IDR_HEADER(naluHeader))) {
-                includeCpd = TRUE;
-                overallSize += pGstKvsPlugin->videoCpdSize;
-                iterate = FALSE;
-            } else if ((nalFormat == ELEMENTARY_STREAM_NAL_FORMAT_AVCC && IS_NALU_H264_SPS_PPS_HEADER(naluHeader)) ||
-                       (nalFormat == ELEMENTARY_STREAM_NAL_FORMAT_HEVC && IS_NALU_H265_VPS_SPS_PPS_HEADER(naluHeader))) {
-                iterate = FALSE;
-            }
+    BOOL isVideo;
+
+    CHK(pStreamingSession != NULL && pSharedFrame != NULL, STATUS_NULL_ARG);
+
+    // Frames can't be delivered until the peer connection is up
+    CHK(ATOMIC_LOAD_BOOL(&pStreamingSession->connected) && !ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag), retStatus);
+
+    isVideo = pSharedFrame->frame.trackId == DEFAULT_VIDEO_TRACK_ID;
+    if (isVideo && ATOMIC_LOAD_BOOL(&pStreamingSession->awaitingKeyFrame)) {
+        // Dropping the rest of the GoP as the decoder can't make use of it
+        CHK(CHECK_FRAME_FLAG_KEY_FRAME(pSharedFrame->frame.flags), retStatus);
+        ATOMIC_STORE_BOOL(&pStreamingSession->awaitingKeyFrame, FALSE);
+    }
+
+    // Thin the video down to what the viewer's network can take. The frames which are not referenced go
+    // first. Losing a reference frame stops the video until the next key frame. Audio and key frames
+    // always go out and are paid for from the following frames.
+    if (!withinSendBudget(pStreamingSession, pSharedFrame->frame.size + pSharedFrame->cpdSize,
+                          !isVideo || CHECK_FRAME_FLAG_KEY_FRAME(pSharedFrame->frame.flags))) {
+        ATOMIC_INCREMENT(&pStreamingSession->thinnedFrameCount);
+        if (!pSharedFrame->disposable) {
+            ATOMIC_STORE_BOOL(&pStreamingSession->awaitingKeyFrame, TRUE);
+            ATOMIC_STORE_BOOL(&pStreamingSession->pGstKvsPlugin->keyUnitRequested, TRUE);
+        }
 
-            pCurPnt += runLen + SIZEOF(UINT32);
+        DLOGV("Send budget exceeded for peer %s. Dropping %s frame", pStreamingSession->peerId,
+              pSharedFrame->disposable ? "non-reference" : "reference");
+        CHK(FALSE, retStatus);
+    }
+
+    if (!spscRingTryEnqueue(pStreamingSession->pFrameRing, (UINT64) sharedFrameAddRef(pSharedFrame))) {
+        // The peer is not keeping up. Drop the frame and resume the video from the next key frame.
+        sharedFrameRelease(pSharedFrame);
+        ATOMIC_INCREMENT(&pStreamingSession->droppedFrameCount);
+        if (isVideo) {
+            ATOMIC_STORE_BOOL(&pStreamingSession->awaitingKeyFrame, TRUE);
+            ATOMIC_STORE_BOOL(&pStreamingSession->pGstKvsPlugin->keyUnitRequested, TRUE);
         }
+
+        DLOGV("Frame queue is full for peer %s. Dropping frame", pStreamingSession->peerId);
+        CHK(FALSE, retStatus);
     }
 
-    pCurPnt = pFrame->frameData;
+    MUTEX_LOCK(pStreamingSession->frameSenderLock);
+    CVAR_SIGNAL(pStreamingSession->frameSenderCvar);
+    MUTEX_UNLOCK(pStreamingSession->frameSenderLock);
+
+CleanUp:
+
+    return retStatus;
+}
+
+BOOL withinSendBudget(PWebRtcStreamingSession pStreamingSession, UINT32 size, BOOL force)
+{
+    UINT64 now, elapsed, rate = (UINT64) ATOMIC_LOAD(&pStreamingSession->sendBudgetRate);
+    INT64 burst;
 
-    // Check if we need to allocate/re-allocate
-    if (pGstKvsPlugin->adaptedFrameBufSize < overallSize) {
-        CHK(NULL != (pGstKvsPlugin->pAdaptedFrameBuf = (PBYTE) MEMREALLOC(pGstKvsPlugin->pAdaptedFrameBuf, overallSize)), STATUS_NOT_ENOUGH_MEMORY);
-        pGstKvsPlugin->adaptedFrameBufSize = overallSize;
+    // No estimate yet
+    if (rate == 0) {
+        return TRUE;
     }
 
-    pDst = pGstKvsPlugin->pAdaptedFrameBuf;
+    // Refill the bucket at the budget rate. It holds at most a burst worth of bytes.
+    now = GETTIME();
+    elapsed = MIN(now - pStreamingSession->sendTokensTime, HUNDREDS_OF_NANOS_IN_A_SECOND);
+    pStreamingSession->sendTokensTime = now;
+    burst = (INT64) (rate / 8 * GST_PLUGIN_SEND_BUDGET_BURST / HUNDREDS_OF_NANOS_IN_A_SECOND);
+    pStreamingSession->sendTokens = MIN(burst, pStreamingSession->sendTokens + (INT64) (rate * elapsed / 8 / HUNDREDS_OF_NANOS_IN_A_SECOND));
 
-    // Copy the stored Annex-B format CPD
-    if (includeCpd) {
-        MEMCPY(pDst, pGstKvsPlugin->videoCpd, pGstKvsPlugin->videoCpdSize);
-        pDst += pGstKvsPlugin->videoCpdSize;
+    if (pStreamingSession->sendTokens < (INT64) size && !force) {
+        return FALSE;
     }
 
-    pEndPnt = pCurPnt + pFrame->size;
+    pStreamingSession->sendTokens -= size;
 
-    while (pCurPnt != pEndPnt) {
-        // Check if we can still read 32 bit
-        CHK(pCurPnt + SIZEOF(UINT32) <= pEndPnt, STATUS_FORMAT_ERROR);
+    return TRUE;
+}
 
-        runLen = (UINT32) GET_UNALIGNED_BIG_ENDIAN((PUINT32) pCurPnt);
-        pCurPnt += SIZEOF(UINT32);
+VOID updateSendBudget(PWebRtcStreamingSession pStreamingSession)
+{
+    UINT64 estimate = (UINT64) ATOMIC_LOAD(&pStreamingSession->bandwidthEstimate);
 
-        CHK(pCurPnt + runLen <= pEndPnt, STATUS_FORMAT_ERROR);
+    ATOMIC_STORE(&pStreamingSession->sendBudgetRate, (SIZE_T) (estimate * ATOMIC_LOAD(&pStreamingSession->sendBudgetScale) / 100));
+}
 
-        // Adapt with 4 byte version of the start sequence
-        PUT_UNALIGNED_BIG_ENDIAN((PINT32) pDst, 0x0001);
+STATUS addWebRtcStats(PGstKvsPlugin pGstKvsPlugin, GstStructure* pStats)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcSessionList pSessionList;
+    PWebRtcStreamingSession pStreamingSession;
+    GstStructure* pSessionStats;
+    CHAR fieldName[GST_PLUGIN_STATS_FIELD_NAME_LEN + 1];
+    UINT32 i, epochSlot;
+    UINT64 receivedFrameCount, receivedByteCount;
+
+    CHK(pGstKvsPlugin != NULL && pStats != NULL, STATUS_NULL_ARG);
+
+    gst_structure_set(pStats, "webrtc-frames", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->webRtcFrameCount), "webrtc-copied-bytes",
+                      G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->webRtcCopiedBytes), NULL);
+
+    // Only the counters are read so the snapshot is enough. The RTP stats are published by the stats timer.
+    pSessionList = acquireStreamingSessionList(pGstKvsPlugin, &epochSlot);
+    gst_structure_set(pStats, "sessions", G_TYPE_UINT, pSessionList == NULL ? 0 : pSessionList->count, NULL);
+    for (i = 0; pSessionList != NULL && i < pSessionList->count; ++i) {
+        pStreamingSession = pSessionList->sessions[i];
+        pSessionStats = gst_structure_new(
+            GST_PLUGIN_SESSION_STATS_G_STRUCT_NAME, "peer-id", G_TYPE_STRING, pStreamingSession->peerId, "connected", G_TYPE_BOOLEAN,
+            (gboolean) ATOMIC_LOAD_BOOL(&pStreamingSession->connected), "outgoing-bitrate", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->outgoingBitrate), "incoming-bitrate", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->incomingBitrate), "round-trip-time", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->roundTripTime) * DEFAULT_TIME_UNIT_IN_NANOS, "packets-discarded-on-send", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->packetsDiscardedOnSend), "send-budget", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->sendBudgetRate), "dropped-frames", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->droppedFrameCount), "thinned-frames", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->thinnedFrameCount), "written-frames", G_TYPE_UINT64,
+            (guint64) ATOMIC_LOAD(&pStreamingSession->writtenFrameCount), "write-latency-p50", G_TYPE_UINT64,
+            (guint64) latencyHistogramGetPercentile(&pStreamingSession->writeLatency, 50.0) * DEFAULT_TIME_UNIT_IN_NANOS, "write-latency-p99",
+            G_TYPE_UINT64, (guint64) latencyHistogramGetPercentile(&pStreamingSession->writeLatency, 99.0) * DEFAULT_TIME_UNIT_IN_NANOS,
+            "write-latency-max", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pStreamingSession->writeLatency.max) * DEFAULT_TIME_UNIT_IN_NANOS,
+            "write-cpu-time", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pStreamingSession->writeCpuTime) * DEFAULT_TIME_UNIT_IN_NANOS, NULL);
+
+        SNPRINTF(fieldName, SIZEOF(fieldName), "session-%u", i);
+        gst_structure_set(pStats, fieldName, GST_TYPE_STRUCTURE, pSessionStats, NULL);
+        gst_structure_free(pSessionStats);
+    }
+
+    releaseStreamingSessionList(pGstKvsPlugin, epochSlot);
+
+    gst_structure_set(pStats, "pending-candidate-peers", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->pendingPeerCount),
+                      "pending-candidates", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->pendingCandidateCount),
+                      "dropped-pending-candidates", G_TYPE_UINT64, (guint64) ATOMIC_LOAD(&pGstKvsPlugin->droppedPendingCandidateCount), NULL);
+
+    // What made it through to the in-process viewers
+    if (pGstKvsPlugin->gstParams.webRtcLoopbackViewers != 0) {
+        receivedFrameCount = 0;
+        receivedByteCount = 0;
+        for (i = 0; i < pGstKvsPlugin->loopbackViewerCount; i++) {
+            receivedFrameCount += ATOMIC_LOAD(&pGstKvsPlugin->pLoopbackViewers[i].receivedFrameCount);
+            receivedByteCount += ATOMIC_LOAD(&pGstKvsPlugin->pLoopbackViewers[i].receivedByteCount);
+        }
+
+        gst_structure_set(pStats, "loopback-viewers", G_TYPE_UINT, pGstKvsPlugin->loopbackViewerCount, "loopback-received-frames", G_TYPE_UINT64,
+                          (guint64) receivedFrameCount, "loopback-received-bytes", G_TYPE_UINT64, (guint64) receivedByteCount, NULL);
+    }
+
+CleanUp:
+
+    return retStatus;
+}
+
+UINT64 getWebRtcSustainableBitrate(PGstKvsPlugin pGstKvsPlugin)
+{
+    PWebRtcSessionList pSessionList;
+    PWebRtcStreamingSession pStreamingSession;
+    UINT64 bitrate = 0, rate;
+    UINT32 i, epochSlot;
+
+    // The rate of the slowest connected viewer with an estimate
+    pSessionList = acquireStreamingSessionList(pGstKvsPlugin, &epochSlot);
+    for (i = 0; pSessionList != NULL && i < pSessionList->count; ++i) {
+        pStreamingSession = pSessionList->sessions[i];
+        rate = (UINT64) ATOMIC_LOAD(&pStreamingSession->sendBudgetRate);
+        if (ATOMIC_LOAD_BOOL(&pStreamingSession->connected) && rate != 0 && (bitrate == 0 || rate < bitrate)) {
+            bitrate = rate;
+        }
+    }
+
+    releaseStreamingSessionList(pGstKvsPlugin, epochSlot);
+
+    return bitrate;
+}
+
+STATUS updateGopCache(PGstKvsPlugin pGstKvsPlugin, PSharedFrame pSharedFrame)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PGopCache pGopCache;
+    UINT64 size;
+
+    CHK(pGstKvsPlugin != NULL && pSharedFrame != NULL, STATUS_NULL_ARG);
+
+    pGopCache = &pGstKvsPlugin->gopCache;
+    size = pSharedFrame->frame.size + pSharedFrame->cpdSize;
+
+    // A key frame starts a new GoP
+    if (CHECK_FRAME_FLAG_KEY_FRAME(pSharedFrame->frame.flags)) {
+        clearGopCache(pGstKvsPlugin);
+        pGopCache->valid = TRUE;
+    }
+
+    CHK(pGopCache->valid, retStatus);
+
+    // A partial GoP is of no use so the cache is dropped until the next key frame once over the bounds
+    if (pGopCache->frameCount == GST_PLUGIN_GOP_CACHE_MAX_FRAMES || pGopCache->size + size > GST_PLUGIN_GOP_CACHE_MAX_SIZE ||
+        (pGopCache->frameCount != 0 &&
+         pSharedFrame->frame.presentationTs > pGopCache->frames[0]->frame.presentationTs + GST_PLUGIN_GOP_CACHE_MAX_DURATION)) {
+        DLOGV("GoP cache bounds exceeded with %u frames of %" PRIu64 " bytes", pGopCache->frameCount, pGopCache->size);
+        clearGopCache(pGstKvsPlugin);
+        CHK(FALSE, retStatus);
+    }
 
-        // Copy the bits to adapted destination
-        pDst += SIZEOF(UINT32);
-        MEMCPY(pDst, pCurPnt, runLen);
+    pGopCache->frames[pGopCache->frameCount++] = sharedFrameAddRef(pSharedFrame);
+    pGopCache->size += size;
 
-        pDst += runLen;
+CleanUp:
+
+    return retStatus;
+}
+
+VOID clearGopCache(PGstKvsPlugin pGstKvsPlugin)
+{
+    PGopCache pGopCache;
+    UINT32 i;
+
+    if (pGstKvsPlugin == NULL) {
+        return;
+    }
+
+    pGopCache = &pGstKvsPlugin->gopCache;
+    for (i = 0; i < pGopCache->frameCount; i++) {
+        sharedFrameRelease(pGopCache->frames[i]);
+        pGopCache->frames[i] = NULL;
+    }
+
+    pGopCache->frameCount = 0;
+    pGopCache->size = 0;
+    pGopCache->valid = FALSE;
+}
+
+STATUS replayGopCacheToStreamingSession(PGstKvsPlugin pGstKvsPlugin, PWebRtcStreamingSession pStreamingSession, UINT64 presentationTs)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PGopCache pGopCache;
+    PSharedFrame pAlias = NULL;
+    UINT64 timestamp;
+    UINT32 i;
+
+    CHK(pGstKvsPlugin != NULL && pStreamingSession != NULL, STATUS_NULL_ARG);
+
+    pGopCache = &pGstKvsPlugin->gopCache;
+    CHK(pGopCache->valid && pGopCache->frameCount != 0, retStatus);
+
+    DLOGD("Replaying %u cached frames to peer %s", pGopCache->frameCount, pStreamingSession->peerId);
+
+    for (i = 0; i < pGopCache->frameCount; i++) {
+        // Squeeze the cached frames right before the current one so the peer doesn't fall behind the live stream
+        timestamp = presentationTs - MIN(presentationTs, (pGopCache->frameCount - i) * GST_PLUGIN_GOP_CACHE_REPLAY_SPACING);
+
+        CHK_STATUS(createSharedFrameAlias(pGopCache->frames[i], &pAlias));
+        pAlias->frame.presentationTs = timestamp;
+        pAlias->frame.decodingTs = timestamp;
+        pAlias->frame.duration = GST_PLUGIN_GOP_CACHE_REPLAY_SPACING;
+
+        CHK_STATUS(enqueueFrameToStreamingSession(pStreamingSession, pAlias));
+
+        sharedFrameRelease(pAlias);
+        pAlias = NULL;
+    }
+
+CleanUp:
+
+    sharedFrameRelease(pAlias);
+
+    return retStatus;
+}
+
+PVOID sendFramesToWebRtcPeer(PVOID args)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PWebRtcStreamingSession pStreamingSession = (PWebRtcStreamingSession) args;
+    PRtcRtpTransceiver pRtcRtpTransceiver;
+    PSharedFrame pSharedFrame;
+    Frame cpdFrame;
+    UINT64 data, writeStartTime, writeLatency, cpuStartTime;
+
+    CHK(pStreamingSession != NULL, STATUS_NULL_ARG);
+
+    while (!ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag)) {
+        if (!spscRingTryDequeue(pStreamingSession->pFrameRing, &data)) {
+            MUTEX_LOCK(pStreamingSession->frameSenderLock);
+            // Re-check under the lock so the signal from the producer is not missed
+            if (spscRingGetCount(pStreamingSession->pFrameRing) == 0 && !ATOMIC_LOAD_BOOL(&pStreamingSession->terminateFlag)) {
+                CVAR_WAIT(pStreamingSession->frameSenderCvar, pStreamingSession->frameSenderLock, GST_PLUGIN_FRAME_SENDER_WAIT_PERIOD);
+            }
+            MUTEX_UNLOCK(pStreamingSession->frameSenderLock);
+            continue;
+        }
+
+        pSharedFrame = (PSharedFrame) data;
+        pRtcRtpTransceiver = pSharedFrame->frame.trackId == DEFAULT_AUDIO_TRACK_ID ? pStreamingSession->pAudioRtcRtpTransceiver
+                                                                                   : pStreamingSession->pVideoRtcRtpTransceiver;
+
+        writeStartTime = GST_PLUGIN_MONOTONIC_TIME();
+        cpuStartTime = getThreadCpuTime();
+        if (pSharedFrame->cpdSize != 0) {
+            // The CPD chunk carries the timestamps of the IDR frame it precedes
+            cpdFrame = pSharedFrame->frame;
+            cpdFrame.frameData = pSharedFrame->pCpd;
+            cpdFrame.size = pSharedFrame->cpdSize;
+            retStatus = writeFrame(pRtcRtpTransceiver, &cpdFrame);
+            if (STATUS_FAILED(retStatus) && retStatus != STATUS_SRTP_NOT_READY_YET) {
+                DLOGV("writeFrame failed for the CPD of peer %s with 0x%08x", pStreamingSession->peerId, retStatus);
+            }
+        }
 
-        // Jump to the next NAL
-        pCurPnt += runLen;
+        retStatus = writeFrame(pRtcRtpTransceiver, &pSharedFrame->frame);
+        if (STATUS_FAILED(retStatus) && retStatus != STATUS_SRTP_NOT_READY_YET) {
+            DLOGV("writeFrame failed for peer %s with 0x%08x", pStreamingSession->peerId, retStatus);
+        }
+
+        // Kept per viewer as well so the fan-out cost shows up next to the aggregate
+        writeLatency = GST_PLUGIN_MONOTONIC_TIME() - writeStartTime;
+        latencyHistogramRecord(&pStreamingSession->pGstKvsPlugin->latencyHistograms[GST_PLUGIN_LATENCY_STAGE_WEBRTC_WRITE], writeLatency);
+        latencyHistogramRecord(&pStreamingSession->writeLatency, writeLatency);
+        ATOMIC_ADD(&pStreamingSession->writeCpuTime, (SIZE_T) (getThreadCpuTime() - cpuStartTime));
+        ATOMIC_INCREMENT(&pStreamingSession->writtenFrameCount);
+
+        retStatus = STATUS_SUCCESS;
+        sharedFrameRelease(pSharedFrame);
     }
 
-    // Set the adapted frame buffer
-    pFrame->frameData = pGstKvsPlugin->pAdaptedFrameBuf;
-    pFrame->size = overallSize;
+CleanUp:
+
+    CHK_LOG_ERR(retStatus);
+
+    return (PVOID) (ULONG_PTR) retStatus;
+}
+
+STATUS adaptVideoFrameFromAvccToAnnexB(PFrame pFrame, PBYTE pDst, PNalIndex pNalIndex)
+{
+    STATUS retStatus = STATUS_SUCCESS;
+    PNalIndexEntry pEntry;
+    UINT32 i;
+
+    CHK(pFrame != NULL && pDst != NULL && pNalIndex != NULL, STATUS_NULL_ARG);
+    CHK(IS_AVCC_HEVC_CPD_NAL_FORMAT(pNalIndex->format), STATUS_INVALID_ARG);
+
+    // The 4 byte run length is the same size as the Annex-B start sequence so the adapted
+    // frame has the same layout. The destination can be the frame bits themselves.
+    for (i = 0; i < pNalIndex->nalCount; i++) {
+        pEntry = &pNalIndex->nals[i];
+
+        // Adapt with 4 byte version of the start sequence
+        PUT_UNALIGNED_BIG_ENDIAN((PINT32) (pDst + pEntry->offset - NAL_INDEX_RUN_LENGTH_SIZE), 0x0001);
+
+        // Copy the bits to adapted destination unless adapting in place
+        if (pDst != pFrame->frameData) {
+            MEMCPY(pDst + pEntry->offset, pFrame->frameData + pEntry->offset, pEntry->length);
+        }
+    }
 
 CleanUp:
 
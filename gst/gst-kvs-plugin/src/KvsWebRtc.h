@@ -1,12 +1,15 @@
 #ifndef __KVS_WEBRTC_FUNCTIONALITY_H__
 #define __KVS_WEBRTC_FUNCTIONALITY_H__
 
-#define DEFAULT_MASTER_CLIENT_ID       "KvsPluginMaster"
-#define DEFAULT_VIEWER_CLIENT_ID       "KvsPluginViewer"
-#define DEFAULT_CHANNEL_NAME           "DEFAULT_CHANNEL"
-#define DEFAULT_TRICKLE_ICE_MODE       TRUE
-#define DEFAULT_WEBRTC_CONNECTION_MODE WEBRTC_CONNECTION_MODE_DEFAULT
-#define DEFAULT_WEBRTC_CONNECT         TRUE
+#define DEFAULT_MASTER_CLIENT_ID                 "KvsPluginMaster"
+#define DEFAULT_VIEWER_CLIENT_ID                 "KvsPluginViewer"
+#define DEFAULT_CHANNEL_NAME                     "DEFAULT_CHANNEL"
+#define DEFAULT_TRICKLE_ICE_MODE                 TRUE
+#define DEFAULT_WEBRTC_CONNECTION_MODE           WEBRTC_CONNECTION_MODE_DEFAULT
+#define DEFAULT_WEBRTC_CONNECT                   TRUE
+#define DEFAULT_MAX_VIEWERS                      DEFAULT_MAX_CONCURRENT_WEBRTC_STREAMING_SESSION
+#define DEFAULT_WEBRTC_LOOPBACK_VIEWERS          0
+#define DEFAULT_WEBRTC_LOOPBACK_EARLY_CANDIDATES 0
 
 #define GST_PLUGIN_HASH_TABLE_BUCKET_COUNT  50
 #define GST_PLUGIN_HASH_TABLE_BUCKET_LENGTH 2
@@ -18,6 +21,71 @@
 #define GST_PLUGIN_SERVICE_ROUTINE_START            (300 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
 #define GST_PLUGIN_SERVICE_ROUTINE_PERIOD           (1000 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
 
+// The cached ICE server configuration is checked periodically and refreshed this long before it expires
+#define GST_PLUGIN_ICE_CONFIG_REFRESH_PERIOD (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+#define GST_PLUGIN_ICE_CONFIG_REFRESH_AHEAD  (30 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+
+// The early ICE candidates expire on a wheel turned by the service routine. One slot per period
+// with the room for the entries which are not yet due.
+#define GST_PLUGIN_PENDING_MESSAGE_WHEEL_SIZE (GST_PLUGIN_PENDING_MESSAGE_CLEANUP_DURATION / GST_PLUGIN_SERVICE_ROUTINE_PERIOD + 2)
+
+// Bound of the early ICE candidates kept for a single peer
+#define GST_PLUGIN_PENDING_CANDIDATE_MAX_COUNT 64
+
+// Number of the threads handling the signaling messages. The messages of a peer are always handled by the same thread.
+#define GST_PLUGIN_SIGNALING_WORKER_COUNT 4
+
+// Number of the fully configured sessions kept ready for the incoming offers. Capped by the max viewers.
+#define GST_PLUGIN_SESSION_POOL_SIZE 2
+
+// Prepared sessions are recreated well before the TURN credentials they were configured with expire
+#define GST_PLUGIN_SESSION_POOL_MAX_AGE (2 * HUNDREDS_OF_NANOS_IN_A_MINUTE)
+
+// Per-session frame queue depth. Should cover a few hundred milliseconds of audio and video
+// on top of the GoP cache replayed to a newly connected viewer
+#define GST_PLUGIN_SESSION_FRAME_QUEUE_SIZE 256
+
+// Upper bound for the sender thread to sleep on an empty queue before re-checking the termination
+#define GST_PLUGIN_FRAME_SENDER_WAIT_PERIOD (100 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+// Upper bound for the local ICE candidates sent out under one hold of the signaling lock
+#define GST_PLUGIN_CANDIDATE_BATCH_SIZE 16
+
+// Bytes the per-viewer send budget can bank for a burst, in time at the budget rate
+#define GST_PLUGIN_SEND_BUDGET_BURST (500 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
+// Percentage of the bandwidth estimate making up the send budget. Stepped down while the packets
+// are discarded on send and back up once they are not.
+#define GST_PLUGIN_SEND_BUDGET_MIN_SCALE  50
+#define GST_PLUGIN_SEND_BUDGET_SCALE_DOWN 20
+#define GST_PLUGIN_SEND_BUDGET_SCALE_UP   10
+
+// Client id of the in-process viewers of the loopback mode
+#define GST_PLUGIN_LOOPBACK_VIEWER_ID_FORMAT "KvsPluginLoopbackViewer%u"
+
+// Client id and early ICE candidate of the peers flooding the pending store in the loopback mode. The peers never send
+// an offer. Each sends twice the bound of the candidates so that half of them are dropped.
+#define GST_PLUGIN_LOOPBACK_FLOOD_ID_FORMAT       "KvsPluginLoopbackFlood%u"
+#define GST_PLUGIN_LOOPBACK_FLOOD_PEER_CANDIDATES (2 * GST_PLUGIN_PENDING_CANDIDATE_MAX_COUNT)
+#define GST_PLUGIN_LOOPBACK_FLOOD_CANDIDATE_LEN   256
+#define GST_PLUGIN_LOOPBACK_FLOOD_CANDIDATE_FORMAT                                                                                                   \
+    "{\"candidate\":\"candidate:%u 1 udp 2130706431 192.0.2.%u %u typ host\",\"sdpMid\":\"0\",\"sdpMLineIndex\":0}"
+
+// Per-session entries of the stats structure
+#define GST_PLUGIN_SESSION_STATS_G_STRUCT_NAME "kvs-session-stats"
+#define GST_PLUGIN_STATS_FIELD_NAME_LEN        32
+
+// Back-off while waiting for the readers of a retired session list
+#define GST_PLUGIN_SESSION_LIST_SYNC_SLEEP (100 * HUNDREDS_OF_NANOS_IN_A_MICROSECOND)
+
+// Bounds of the GoP cache. Exceeding any of them invalidates the cache until the next key frame.
+#define GST_PLUGIN_GOP_CACHE_MAX_FRAMES   (GST_PLUGIN_SESSION_FRAME_QUEUE_SIZE * 3 / 4)
+#define GST_PLUGIN_GOP_CACHE_MAX_SIZE     (8 * 1024 * 1024)
+#define GST_PLUGIN_GOP_CACHE_MAX_DURATION (5 * HUNDREDS_OF_NANOS_IN_A_SECOND)
+
+// Spacing of the rewritten timestamps of the replayed GoP cache frames so the viewer catches up right away
+#define GST_PLUGIN_GOP_CACHE_REPLAY_SPACING (1 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
+
 // Default opus frame duration
 #define GST_PLUGIN_DEFAULT_FRAME_DURATION (20 * HUNDREDS_OF_NANOS_IN_A_MILLISECOND)
 
@@ -46,19 +114,52 @@ typedef VOID (*StreamSessionShutdownCallback)(UINT64, PWebRtcStreamingSession);
 STATUS signalingClientStateChangedFn(UINT64, SIGNALING_CLIENT_STATE);
 STATUS signalingClientErrorFn(UINT64, STATUS, PCHAR, UINT32);
 STATUS signalingClientMessageReceivedFn(UINT64, PReceivedSignalingMessage);
+STATUS handleSignalingMessage(PGstKvsPlugin, PReceivedSignalingMessage);
+STATUS startSignalingWorkers(PGstKvsPlugin);
+STATUS stopSignalingWorkers(PGstKvsPlugin);
+VOID freeSignalingWorkers(PSignalingWorker);
+PVOID signalingWorkerRoutine(PVOID);
+STATUS startSessionWorker(PGstKvsPlugin);
+STATUS stopSessionWorker(PGstKvsPlugin);
+VOID requestSessionWork(PGstKvsPlugin, volatile ATOMIC_BOOL*);
+PVOID sessionWorkerRoutine(PVOID);
 STATUS initKinesisVideoWebRtc(PGstKvsPlugin);
+STATUS connectKinesisVideoWebRtc(PGstKvsPlugin);
+PVOID startKinesisVideoWebRtcRoutine(PVOID);
+STATUS createWebRtcLoopbackViewers(PGstKvsPlugin);
+STATUS initWebRtcLoopbackViewer(PGstKvsPlugin, UINT32, PWebRtcLoopbackViewer);
+VOID freeWebRtcLoopbackViewers(PGstKvsPlugin);
+VOID onLoopbackViewerIceCandidate(UINT64, PCHAR);
+VOID onLoopbackViewerFrame(UINT64, PFrame);
+STATUS sendLoopbackViewerMessage(PWebRtcLoopbackViewer, SIGNALING_MESSAGE_TYPE, PCHAR, UINT32);
+STATUS sendLoopbackSignalingMessage(PGstKvsPlugin, PCHAR, SIGNALING_MESSAGE_TYPE, PCHAR, UINT32);
+STATUS sendLoopbackEarlyCandidates(PGstKvsPlugin);
+STATUS deliverLoopbackSignalingMessage(PGstKvsPlugin, PSignalingMessage);
 STATUS freeGstKvsWebRtcPlugin(PGstKvsPlugin);
+VOID cancelGstKvsPluginTimers(PGstKvsPlugin);
 STATUS createMessageQueue(UINT64, PPendingMessageQueue*);
 STATUS freeMessageQueue(PPendingMessageQueue);
 STATUS gatherIceServerStats(PWebRtcStreamingSession);
 STATUS freeWebRtcStreamingSession(PWebRtcStreamingSession*);
 STATUS streamingSessionOnShutdown(PWebRtcStreamingSession, UINT64, StreamSessionShutdownCallback);
 STATUS pregenerateCertTimerCallback(UINT32, UINT64, UINT64);
-STATUS removeExpiredMessageQueues(PStackQueue);
-STATUS getPendingMessageQueueForHash(PStackQueue, UINT64, BOOL, PPendingMessageQueue*);
+STATUS removeExpiredMessageQueues(PGstKvsPlugin);
+STATUS getPendingMessageQueueForHash(PGstKvsPlugin, UINT64, BOOL, PPendingMessageQueue*);
+STATUS addPendingMessageQueue(PGstKvsPlugin, PPendingMessageQueue);
+VOID unlinkPendingMessageQueue(PGstKvsPlugin, PPendingMessageQueue);
+STATUS freePendingMessageQueues(PGstKvsPlugin);
 STATUS createWebRtcStreamingSession(PGstKvsPlugin, PCHAR, BOOL, PWebRtcStreamingSession*);
+STATUS prepareWebRtcStreamingSession(PGstKvsPlugin, PWebRtcStreamingSession*);
+STATUS takePreparedStreamingSession(PGstKvsPlugin, PWebRtcStreamingSession*);
+STATUS refillStreamingSessionPool(PGstKvsPlugin);
+STATUS freePreparedStreamingSessions(PGstKvsPlugin);
+STATUS refreshIceServerConfig(PGstKvsPlugin);
+STATUS iceConfigRefreshTimerCallback(UINT32, UINT64, UINT64);
 STATUS initializePeerConnection(PGstKvsPlugin, PRtcPeerConnection*);
 VOID onIceCandidateHandler(UINT64, PCHAR);
+STATUS enqueueLocalCandidate(PWebRtcStreamingSession, PCHAR);
+PVOID sendLocalCandidatesRoutine(PVOID);
+VOID updateIceConnectLatency(PWebRtcStreamingSession);
 STATUS sendSignalingMessage(PWebRtcStreamingSession, PSignalingMessage);
 STATUS respondWithAnswer(PWebRtcStreamingSession);
 VOID onDataChannel(UINT64, PRtcDataChannel);
@@ -68,6 +169,7 @@ STATUS submitPendingIceCandidate(PPendingMessageQueue, PWebRtcStreamingSession);
 STATUS logSelectedIceCandidatesInformation(PWebRtcStreamingSession);
 STATUS handleRemoteCandidate(PWebRtcStreamingSession, PSignalingMessage);
 VOID sampleBandwidthEstimationHandler(UINT64, DOUBLE);
+VOID onPictureLossHandler(UINT64);
 STATUS handleOffer(PGstKvsPlugin, PWebRtcStreamingSession, PSignalingMessage);
 STATUS handleAnswer(PGstKvsPlugin, PWebRtcStreamingSession, PSignalingMessage);
 STATUS getIceCandidatePairStatsCallback(UINT32, UINT64, UINT64);
@@ -75,7 +177,22 @@ PVOID receiveGstreamerAudioVideo(PVOID);
 VOID onGstAudioFrameReady(UINT64, PFrame);
 VOID onSampleStreamingSessionShutdown(UINT64, PWebRtcStreamingSession);
 STATUS sessionServiceHandler(UINT32, UINT64, UINT64);
-STATUS putFrameToWebRtcPeers(PGstKvsPlugin, PFrame, ELEMENTARY_STREAM_NAL_FORMAT);
-STATUS adaptVideoFrameFromAvccToAnnexB(PGstKvsPlugin, PFrame, ELEMENTARY_STREAM_NAL_FORMAT);
+STATUS createStreamingSessionList(UINT32, PWebRtcSessionList*);
+STATUS swapStreamingSessionList(PGstKvsPlugin, PWebRtcSessionList, PWebRtcSessionList*);
+STATUS addStreamingSessionToList(PGstKvsPlugin, PWebRtcStreamingSession);
+STATUS removeTerminatedStreamingSessions(PGstKvsPlugin);
+PWebRtcSessionList acquireStreamingSessionList(PGstKvsPlugin, PUINT32);
+VOID releaseStreamingSessionList(PGstKvsPlugin, UINT32);
+STATUS putFrameToWebRtcPeers(PGstKvsPlugin, PFrame, GstBuffer*, GstMapInfo*, PNalIndex);
+STATUS enqueueFrameToStreamingSession(PWebRtcStreamingSession, PSharedFrame);
+BOOL withinSendBudget(PWebRtcStreamingSession, UINT32, BOOL);
+VOID updateSendBudget(PWebRtcStreamingSession);
+UINT64 getWebRtcSustainableBitrate(PGstKvsPlugin);
+STATUS addWebRtcStats(PGstKvsPlugin, GstStructure*);
+STATUS updateGopCache(PGstKvsPlugin, PSharedFrame);
+VOID clearGopCache(PGstKvsPlugin);
+STATUS replayGopCacheToStreamingSession(PGstKvsPlugin, PWebRtcStreamingSession, UINT64);
+PVOID sendFramesToWebRtcPeer(PVOID);
+STATUS adaptVideoFrameFromAvccToAnnexB(PFrame, PBYTE, PNalIndex);
 
 #endif //__KVS_WEBRTC_FUNCTIONALITY_H__
\ No newline at end of file